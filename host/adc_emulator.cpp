@@ -0,0 +1,182 @@
+// adc_emulator.cpp
+// pot_scan.h のホスト実装。ポットごとに ADC の入力値（POT_ADC_BITS の値）を持ち、変換のたびに
+// setPotNoise() の乱数を加えます。potScanValue() は実機のスキャンと同じく POT_SCAN_SAMPLES 回の変換を足して
+// オーバーサンプリングします。setPotTrace() で記録したポットのトレースを渡すと、サンプルクロックに合わせて
+// 入力値をトレースの値へ切り替えます（スクリプトの pot と併用した場合は後から来たほうが残ります）。
+//
+// トレースは 1 行 1 時刻のテキストです（'#' 以降はコメント）:
+//   <ms> <v0> [<v1> ... <v5>]   analogPins の順に ADC の値 (0..2^POT_ADC_BITS-1)。'-' はその本を変えない
+
+#include "pot_scan.h"
+
+#include "host_platform.h"
+#include "synth_state.h"
+
+#include <Arduino.h>
+#include <MozziHeadersOnly.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+constexpr uint16_t ADC_MAX = (1u << POT_ADC_BITS) - 1;
+
+struct TracePoint {
+  uint64_t sample;
+  int16_t values[ANALOG_INPUT_COUNT];  // -1 は変えない
+};
+
+uint16_t adcInputs[ANALOG_INPUT_COUNT];
+uint16_t adcNoise = 0;
+uint32_t noiseState = 1;
+std::vector<TracePoint> trace;
+size_t traceNext = 0;
+
+struct AdcDefaults {
+  AdcDefaults() {
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+      adcInputs[i] = ADC_MAX / 2;
+    }
+  }
+} adcDefaults;
+
+int potIndexForPin(uint8_t pin) {
+  for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+    if (analogPins[i] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void applyTrace() {
+  // サンプルクロックまでのトレースの点を入力値へ反映する
+  const uint64_t now = host::sampleClock();
+  while (traceNext < trace.size() && trace[traceNext].sample <= now) {
+    const TracePoint &point = trace[traceNext++];
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+      if (point.values[i] >= 0) {
+        adcInputs[i] = static_cast<uint16_t>(point.values[i]);
+      }
+    }
+  }
+}
+
+uint16_t convert(uint8_t index) {
+  // 1 回の変換: 入力値 ± ノイズ（0..ADC_MAX に収める）
+  if (adcNoise == 0) {
+    return adcInputs[index];
+  }
+  noiseState = noiseState * 1664525u + 1013904223u;
+  const int32_t noise = static_cast<int32_t>((noiseState >> 8) % (2u * adcNoise + 1)) - adcNoise;
+  return static_cast<uint16_t>(constrain(static_cast<int32_t>(adcInputs[index]) + noise, 0, static_cast<int32_t>(ADC_MAX)));
+}
+
+bool parseTrace(FILE *f, const char *path) {
+  char line[256];
+  unsigned lineNo = 0;
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    ++lineNo;
+    char *comment = strchr(line, '#');
+    if (comment != nullptr) {
+      *comment = '\0';
+    }
+    char *token = strtok(line, " \t\r\n");
+    if (token == nullptr) {
+      continue;
+    }
+    TracePoint point;
+    point.sample = static_cast<uint64_t>(atof(token) * AUDIO_RATE / 1000.0);
+    uint8_t count = 0;
+    for (; count < ANALOG_INPUT_COUNT; ++count) {
+      token = strtok(nullptr, " \t\r\n");
+      if (token == nullptr) {
+        break;
+      }
+      const long value = strcmp(token, "-") == 0 ? -1 : strtol(token, nullptr, 10);
+      if (value > ADC_MAX) {
+        fprintf(stderr, "%s:%u: pot value %ld exceeds %u\n", path, lineNo, value, ADC_MAX);
+        return false;
+      }
+      point.values[count] = static_cast<int16_t>(value < 0 ? -1 : value);
+    }
+    if (count == 0) {
+      fprintf(stderr, "%s:%u: expected <ms> <v0> [<v1> ...]\n", path, lineNo);
+      return false;
+    }
+    for (; count < ANALOG_INPUT_COUNT; ++count) {
+      point.values[count] = -1;
+    }
+    if (!trace.empty() && point.sample < trace.back().sample) {
+      fprintf(stderr, "%s:%u: time goes backwards\n", path, lineNo);
+      return false;
+    }
+    trace.push_back(point);
+  }
+  return true;
+}
+}  // namespace
+
+namespace host {
+
+void setPot(uint8_t index, float value) {
+  if (index < ANALOG_INPUT_COUNT) {
+    value = constrain(value, 0.0f, 1.0f);
+    adcInputs[index] = static_cast<uint16_t>(value * ADC_MAX + 0.5f);
+  }
+}
+
+void setPotNoise(uint16_t amplitude) {
+  adcNoise = amplitude;
+}
+
+bool setPotTrace(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == nullptr) {
+    fprintf(stderr, "cannot open pot trace: %s\n", path);
+    return false;
+  }
+  trace.clear();
+  traceNext = 0;
+  const bool ok = parseTrace(f, path);
+  fclose(f);
+  return ok;
+}
+
+uint64_t potTraceEnd() {
+  return trace.empty() ? 0 : trace.back().sample;
+}
+
+}  // namespace host
+
+bool potScanBegin() {
+  return true;
+}
+
+uint16_t potScanValue(uint8_t index) {
+  if (index >= ANALOG_INPUT_COUNT) {
+    return 0;
+  }
+  applyTrace();
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < POT_SCAN_SAMPLES; ++i) {
+    sum += convert(index);
+  }
+  return static_cast<uint16_t>(sum >> POT_OVERSAMPLE_BITS);
+}
+
+uint16_t mozziAnalogRead(uint8_t pin) {
+  const int index = potIndexForPin(pin);
+  if (index < 0) {
+    return 0;
+  }
+  applyTrace();
+  return convert(static_cast<uint8_t>(index));
+}
+
+int analogRead(uint8_t pin) {
+  return mozziAnalogRead(pin);
+}
@@ -0,0 +1,148 @@
+// clock_bench.cpp
+// midi_clock.h のクロック推定 (ClockEstimator) を合成したクロック列で確かめるベンチマーク。
+//
+// 使い方:
+//   clock_bench [seed]
+//
+// 一定テンポ、受信の揺れ (±1ms)、テンポの急変、クロックの抜け、テンポの連続変化のそれぞれで、
+// ロック後の推定テンポの誤差と推定時刻（位相）の誤差、急変後に追従するまでのクロック数を表示します。
+// 比較のため、直前の間隔だけから求めたテンポの誤差も出します。許容値を超えたら終了コード 1。
+
+#include "midi_clock.h"
+
+#include "config.h"
+
+#include <MozziHeadersOnly.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+constexpr double CLOCKS_PER_BEAT = 24.0;
+// 受信の揺れ: ±1ms
+constexpr double JITTER_SAMPLES = AUDIO_RATE / 1000.0;
+
+uint32_t rngState = 1;
+
+double nextUniform() {
+  // -1..1
+  rngState = rngState * 1664525u + 1013904223u;
+  return static_cast<double>(rngState >> 8) / static_cast<double>(1u << 23) - 1.0;
+}
+
+double periodFor(double bpm) {
+  return AUDIO_RATE * 60.0 / (bpm * CLOCKS_PER_BEAT);
+}
+
+struct Scenario {
+  const char *name;
+  double (*tempoAt)(uint32_t clock);  // クロック番号でのテンポ
+  double jitter;                      // 揺れの幅（サンプル）
+  uint32_t dropEvery;                 // この数ごとにクロックを 1 つ落とす（0 = 落とさない）
+  double maxBpmError;                 // ロック後の推定テンポの許容誤差
+  double maxPhaseError;               // ロック後の推定時刻の許容誤差（サンプル）
+};
+
+double steady(uint32_t) {
+  return 120.0;
+}
+
+double step(uint32_t clock) {
+  return clock < 480 ? 120.0 : 140.0;
+}
+
+double ramp(uint32_t clock) {
+  // 16 小節 (1536 クロック) で 100 → 160
+  return clock < 1536 ? 100.0 + 60.0 * clock / 1536.0 : 160.0;
+}
+
+constexpr uint32_t CLOCKS = 2400;
+constexpr uint32_t STEP_CLOCK = 480;
+
+bool run(const Scenario &scenario) {
+  ClockEstimator estimator;
+  double ideal = 1000.0;
+  double worstBpm = 0.0;
+  double worstNaive = 0.0;
+  double worstPhase = 0.0;
+  double sumPhase = 0.0;
+  uint32_t measured = 0;
+  int32_t lockedAt = -1;
+  int32_t settledAfterStep = -1;
+  uint32_t lastRaw = 0;
+  bool hasLast = false;
+
+  for (uint32_t k = 0; k < CLOCKS; ++k) {
+    const double bpm = scenario.tempoAt(k);
+    if (k > 0) {
+      ideal += periodFor(bpm);
+    }
+    if (scenario.dropEvery != 0 && k % scenario.dropEvery == scenario.dropEvery - 1) {
+      hasLast = false;
+      continue;
+    }
+    const uint32_t raw = static_cast<uint32_t>(lround(ideal + scenario.jitter * nextUniform()));
+    if (hasLast) {
+      const double naive = AUDIO_RATE * 60.0 / (CLOCKS_PER_BEAT * (raw - lastRaw));
+      if (estimator.locked()) {
+        worstNaive = fmax(worstNaive, fabs(naive - bpm));
+      }
+    }
+    lastRaw = raw;
+    hasLast = true;
+    if (!estimator.clock(raw)) {
+      continue;
+    }
+    if (lockedAt < 0 && estimator.locked()) {
+      lockedAt = static_cast<int32_t>(k);
+    }
+    const double bpmError = fabs(estimator.bpm() - bpm);
+    if (scenario.tempoAt == step && k >= STEP_CLOCK && settledAfterStep < 0 && bpmError < scenario.maxBpmError) {
+      settledAfterStep = static_cast<int32_t>(k - STEP_CLOCK);
+    }
+    // 急変の直後と連続変化の途中は追従中なので誤差に含めない
+    const bool transient = (scenario.tempoAt == step && k >= STEP_CLOCK && k < STEP_CLOCK + 96) ||
+                           (scenario.tempoAt == ramp && k < 1536 + 96);
+    if (!estimator.locked() || transient) {
+      continue;
+    }
+    const int32_t phase = static_cast<int32_t>(estimator.lastClockSample() - static_cast<uint32_t>(lround(ideal)));
+    const double phaseError = fabs(static_cast<double>(phase));
+    worstBpm = fmax(worstBpm, bpmError);
+    worstPhase = fmax(worstPhase, phaseError);
+    sumPhase += phaseError;
+    measured++;
+  }
+
+  const bool ok = lockedAt >= 0 && measured > 0 && worstBpm <= scenario.maxBpmError &&
+                  worstPhase <= scenario.maxPhaseError && (scenario.tempoAt != step || settledAfterStep >= 0);
+  printf("%-8s lock@%4d  bpm err %.3f (naive %6.3f)  phase err max %5.1f avg %5.2f smp", scenario.name, lockedAt,
+         worstBpm, worstNaive, worstPhase, measured > 0 ? sumPhase / measured : 0.0);
+  if (scenario.tempoAt == step) {
+    printf("  settle %d clk", settledAfterStep);
+  }
+  printf("  %s\n", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    rngState = static_cast<uint32_t>(strtoul(argv[1], nullptr, 0));
+  }
+  const Scenario scenarios[] = {
+      {"steady", steady, 0.0, 0, 0.05, 1.0},
+      // 揺れがあるときの推定時刻の誤差は揺れの幅 (±1ms) より小さいこと
+      {"jitter", steady, JITTER_SAMPLES, 0, 1.0, JITTER_SAMPLES - 1.0},
+      {"step", step, JITTER_SAMPLES, 0, 1.0, JITTER_SAMPLES - 1.0},
+      {"drop", steady, JITTER_SAMPLES, 17, 1.0, JITTER_SAMPLES - 1.0},
+      {"ramp", ramp, JITTER_SAMPLES, 0, 1.0, JITTER_SAMPLES - 1.0},
+  };
+  bool ok = true;
+  for (const Scenario &scenario : scenarios) {
+    ok = run(scenario) && ok;
+  }
+  return ok ? 0 : 1;
+}
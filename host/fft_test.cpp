@@ -0,0 +1,161 @@
+// fft_test.cpp
+// fixed_fft.h の固定小数点 FFT を倍精度の DFT と比べる検証。
+//
+// 使い方:
+//   fft_test [seed]
+//
+// 正弦波（ビンの中心/ビンの間、振幅を変えて）、インパルス、DC、白色雑音を 128 点の環状バッファに置き、
+// fixedFftLoad → fixedFftTransform → fixedFftMagnitude の結果を、同じ Hamming 窓を倍精度で掛けた
+// DFT の振幅とビンごとに比べます。許容誤差は
+//   |固定小数点 - 参照| <= 参照 x MAGNITUDE_TOLERANCE + そのテストの最大ビン x FLOOR_TOLERANCE + ABSOLUTE_TOLERANCE
+// で、最初の項が振幅近似 (alpha-max-plus-beta-min、最大誤差 約 6%)、残りが Q15 の丸めの分です
+// （窓とバタフライごとの丸めは信号の大きさによらず数カウント残る）。
+// fixedFftResume() を小さな予算で分割して回した結果が一括の結果と一致することも確かめます。
+// どれかが許容値を超えたら終了コード 1。
+
+#include "fixed_fft.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+constexpr double MAGNITUDE_TOLERANCE = 0.065;
+constexpr double FLOOR_TOLERANCE = 0.002;
+constexpr double ABSOLUTE_TOLERANCE = 12.0;
+
+uint32_t rngState = 1;
+
+double nextUniform() {
+  // -1..1
+  rngState = rngState * 1664525u + 1013904223u;
+  return static_cast<double>(rngState >> 8) / static_cast<double>(1u << 23) - 1.0;
+}
+
+void referenceMagnitude(const int16_t *ring, uint16_t start, double *magnitude) {
+  // 窓 0.54 - 0.46 cos(2*pi*n/(N-1)) を掛けた正規化しない DFT の振幅
+  double x[FIXED_FFT_SIZE];
+  for (uint16_t n = 0; n < FIXED_FFT_SIZE; ++n) {
+    const double w = 0.54 - 0.46 * cos(2.0 * M_PI * n / (FIXED_FFT_SIZE - 1));
+    x[n] = ring[(start + n) & (FIXED_FFT_SIZE - 1)] * w;
+  }
+  for (uint16_t k = 0; k < FIXED_FFT_BINS; ++k) {
+    double re = 0.0;
+    double im = 0.0;
+    for (uint16_t n = 0; n < FIXED_FFT_SIZE; ++n) {
+      const double angle = 2.0 * M_PI * k * n / FIXED_FFT_SIZE;
+      re += x[n] * cos(angle);
+      im -= x[n] * sin(angle);
+    }
+    magnitude[k] = sqrt(re * re + im * im);
+  }
+}
+
+bool compare(const char *name, const int16_t *ring, uint16_t start) {
+  FixedFftComplex work[FIXED_FFT_BINS];
+  uint32_t magnitude[FIXED_FFT_BINS];
+  fixedFftLoad(ring, start, work);
+  fixedFftTransform(work);
+  fixedFftMagnitude(work, magnitude);
+
+  // 分割実行（予算 1, 7, 64）が一括と同じ結果になること
+  bool resumeOk = true;
+  const uint16_t budgets[] = {1, 7, 64};
+  for (uint16_t budget : budgets) {
+    FixedFftComplex resumed[FIXED_FFT_BINS];
+    uint32_t resumedMagnitude[FIXED_FFT_BINS];
+    fixedFftLoad(ring, start, resumed);
+    uint16_t cursor = 0;
+    while (!fixedFftResume(resumed, resumedMagnitude, cursor, budget)) {
+    }
+    resumeOk = resumeOk && memcmp(resumedMagnitude, magnitude, sizeof(magnitude)) == 0;
+  }
+
+  double reference[FIXED_FFT_BINS];
+  referenceMagnitude(ring, start, reference);
+  double peak = 0.0;
+  for (uint16_t k = 0; k < FIXED_FFT_BINS; ++k) {
+    peak = fmax(peak, reference[k]);
+  }
+  double worstRatio = 0.0;  // 誤差 / 許容値 の最大
+  uint16_t worstBin = 0;
+  double worstError = 0.0;
+  for (uint16_t k = 0; k < FIXED_FFT_BINS; ++k) {
+    const double error = fabs(static_cast<double>(magnitude[k]) - reference[k]);
+    const double allowed = reference[k] * MAGNITUDE_TOLERANCE + peak * FLOOR_TOLERANCE + ABSOLUTE_TOLERANCE;
+    const double ratio = error / allowed;
+    if (ratio > worstRatio) {
+      worstRatio = ratio;
+      worstBin = k;
+      worstError = error;
+    }
+  }
+  const bool ok = worstRatio <= 1.0 && resumeOk;
+  printf("%-22s peak %9.0f  worst bin %2u err %7.1f (%5.1f%% of allowed)  resume %s  %s\n", name, peak, worstBin,
+         worstError, worstRatio * 100.0, resumeOk ? "same" : "DIFF", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool sine(double cycles, double amplitude, double phase) {
+  int16_t ring[FIXED_FFT_SIZE];
+  for (uint16_t n = 0; n < FIXED_FFT_SIZE; ++n) {
+    ring[n] = static_cast<int16_t>(lround(amplitude * sin(2.0 * M_PI * cycles * n / FIXED_FFT_SIZE + phase)));
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "sine %.1f x %.0f", cycles, amplitude);
+  // 環状バッファの先頭をずらしても同じになるよう、start を 0 以外にもする
+  return compare(name, ring, 0) && compare(name, ring, 37);
+}
+
+bool impulse(uint16_t position) {
+  int16_t ring[FIXED_FFT_SIZE] = {0};
+  ring[position] = 32767;
+  char name[32];
+  snprintf(name, sizeof(name), "impulse @%u", position);
+  return compare(name, ring, 0);
+}
+
+bool constant(int16_t value) {
+  int16_t ring[FIXED_FFT_SIZE];
+  for (int16_t &sample : ring) {
+    sample = value;
+  }
+  return compare("dc", ring, 0);
+}
+
+bool noise(double amplitude) {
+  int16_t ring[FIXED_FFT_SIZE];
+  for (int16_t &sample : ring) {
+    sample = static_cast<int16_t>(lround(amplitude * nextUniform()));
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "noise x %.0f", amplitude);
+  return compare(name, ring, 0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    rngState = static_cast<uint32_t>(strtoul(argv[1], nullptr, 0));
+  }
+  bool ok = true;
+  const double cycles[] = {1.0, 5.0, 12.5, 31.0, 47.3, 63.0};
+  const double amplitudes[] = {32767.0, 1000.0, 64.0};
+  for (double c : cycles) {
+    for (double a : amplitudes) {
+      ok = sine(c, a, 0.3) && ok;
+    }
+  }
+  ok = impulse(0) && ok;
+  ok = impulse(64) && ok;
+  ok = impulse(101) && ok;
+  ok = constant(20000) && ok;
+  for (int i = 0; i < 4; ++i) {
+    ok = noise(32767.0) && ok;
+    ok = noise(500.0) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// flash_emulator.cpp
+// flash_port.h のホスト実装。FLASH_STORE_PAGES ページ分の領域をメモリに持ち、
+// setFlashImage() でファイルを指定するとその内容を読み込み、書き込み/消去のたびにファイルへ反映します。
+// NOR フラッシュと同じく消去で 0xFF になり、書き込みは消去済み (0xFFFF) のハーフワードにしか行えません。
+// 実機で CPU が止まる時間（書き込み 52.5us、消去 20ms）をサイクル数で積算し、cycleCount() に加えます。
+
+#include "flash_port.h"
+
+#include "cycle_counter.h"
+#include "host_platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+constexpr uint32_t IMAGE_BYTES = static_cast<uint32_t>(FLASH_STORE_PAGES) * FLASH_STORE_PAGE_SIZE;
+constexpr uint64_t PROGRAM_STALL_CYCLES = static_cast<uint64_t>(CPU_CLOCK_HZ * 52.5e-6);
+constexpr uint64_t ERASE_STALL_CYCLES = static_cast<uint64_t>(CPU_CLOCK_HZ * 20e-3);
+
+struct FlashImage {
+  FlashImage() { memset(bytes, 0xFF, sizeof(bytes)); }
+  ~FlashImage() {
+    if (file != nullptr) {
+      fclose(file);
+    }
+  }
+  uint8_t bytes[IMAGE_BYTES];
+  uint32_t pageErases[FLASH_STORE_PAGES] = {0};
+  FILE *file = nullptr;
+  uint32_t operationsLeft = UINT32_MAX;
+  host::FlashStats stats = {};
+} image;
+
+bool powerAvailable() {
+  // 電源断の模擬: 残り回数を使い切ったら以降の操作はすべて失敗する
+  if (image.operationsLeft == 0) {
+    return false;
+  }
+  if (image.operationsLeft != UINT32_MAX) {
+    image.operationsLeft--;
+  }
+  return true;
+}
+
+void persist(uint32_t offset, uint32_t length) {
+  if (image.file == nullptr) {
+    return;
+  }
+  fseek(image.file, static_cast<long>(offset), SEEK_SET);
+  fwrite(image.bytes + offset, 1, length, image.file);
+  fflush(image.file);
+}
+}  // namespace
+
+namespace host {
+
+bool setFlashImage(const char *path) {
+  FILE *file = fopen(path, "r+b");
+  if (file == nullptr) {
+    file = fopen(path, "w+b");
+  }
+  if (file == nullptr) {
+    return false;
+  }
+  memset(image.bytes, 0xFF, sizeof(image.bytes));
+  const size_t loaded = fread(image.bytes, 1, sizeof(image.bytes), file);
+  if (image.file != nullptr) {
+    fclose(image.file);
+  }
+  image.file = file;
+  // 短いファイル（新規を含む）は消去済みの内容で埋めておく
+  if (loaded < sizeof(image.bytes)) {
+    persist(static_cast<uint32_t>(loaded), static_cast<uint32_t>(sizeof(image.bytes) - loaded));
+  }
+  return true;
+}
+
+void cutFlashPowerAfter(uint32_t operations) {
+  image.operationsLeft = operations;
+}
+
+FlashStats flashStats() {
+  FlashStats stats = image.stats;
+  stats.minPageErases = UINT32_MAX;
+  stats.maxPageErases = 0;
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    stats.minPageErases = image.pageErases[p] < stats.minPageErases ? image.pageErases[p] : stats.minPageErases;
+    stats.maxPageErases = image.pageErases[p] > stats.maxPageErases ? image.pageErases[p] : stats.maxPageErases;
+  }
+  return stats;
+}
+
+uint64_t flashStallCycles() {
+  return image.stats.stallCycles;
+}
+
+}  // namespace host
+
+bool flashPortBegin() {
+  return true;
+}
+
+const uint8_t *flashPageData(uint8_t page) {
+  return image.bytes + static_cast<uint32_t>(page) * FLASH_STORE_PAGE_SIZE;
+}
+
+bool flashErasePage(uint8_t page) {
+  if (page >= FLASH_STORE_PAGES || !powerAvailable()) {
+    return false;
+  }
+  const uint32_t offset = static_cast<uint32_t>(page) * FLASH_STORE_PAGE_SIZE;
+  memset(image.bytes + offset, 0xFF, FLASH_STORE_PAGE_SIZE);
+  persist(offset, FLASH_STORE_PAGE_SIZE);
+  image.pageErases[page]++;
+  image.stats.erases++;
+  image.stats.stallCycles += ERASE_STALL_CYCLES;
+  return true;
+}
+
+bool flashProgramHalfword(uint8_t page, uint16_t offset, uint16_t value) {
+  if (page >= FLASH_STORE_PAGES || (offset & 1) != 0 || offset >= FLASH_STORE_PAGE_SIZE || !powerAvailable()) {
+    return false;
+  }
+  const uint32_t address = static_cast<uint32_t>(page) * FLASH_STORE_PAGE_SIZE + offset;
+  // 実機 (PGERR) と同じく、消去されていない位置への書き込みは失敗させる
+  if (image.bytes[address] != 0xFF || image.bytes[address + 1] != 0xFF) {
+    return false;
+  }
+  image.bytes[address] = static_cast<uint8_t>(value);
+  image.bytes[address + 1] = static_cast<uint8_t>(value >> 8);
+  persist(address, 2);
+  image.stats.programs++;
+  image.stats.stallCycles += PROGRAM_STALL_CYCLES;
+  return true;
+}
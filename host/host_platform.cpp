@@ -0,0 +1,200 @@
+#include "host_platform.h"
+
+#include "cycle_counter.h"
+#include "synth_state.h"
+
+#include <Arduino.h>
+#include <MozziHeadersOnly.h>
+#include <U8g2lib.h>
+#include <Wire.h>
+
+#include <chrono>
+
+HardwareSerial Serial(true);
+HardwareSerial Serial1(false);
+TwoWire Wire;
+const u8g2_cb_t u8g2_cb_r0 = {};
+const uint8_t u8g2_font_5x8_tr[] = {0};
+
+namespace {
+uint64_t samples = 0;
+uint32_t randomState = 1;
+std::chrono::steady_clock::time_point cycleEpoch = std::chrono::steady_clock::now();
+double cycleScale = 1.0;
+
+#if defined(KEYBOARD_DRIVER_TTP229)
+// TTP229 の 2 線式シリアル出力の模擬。SCL の立ち下がりごとに次のキーのビットを SDO に出し、
+// SCL が 2ms 以上 HIGH のままならフレームを先頭からやり直す。キー変化時は DV パルスとして
+// SDO に登録された割り込みハンドラを呼ぶ。
+struct Ttp229Model {
+  uint16_t keys = 0;
+  int8_t outputBit = -1;
+  bool sclHigh = true;
+  uint64_t sclHighSince = 0;
+  void (*dataValidHandler)() = nullptr;
+} ttp229Model;
+
+void ttp229ClockEdge(uint8_t level) {
+  bool high = level != LOW;
+  if (high == ttp229Model.sclHigh) {
+    return;
+  }
+  if (high) {
+    ttp229Model.sclHighSince = samples;
+  } else {
+    bool timedOut = samples - ttp229Model.sclHighSince > AUDIO_RATE * 2 / 1000;
+    ttp229Model.outputBit = timedOut ? 0 : static_cast<int8_t>(ttp229Model.outputBit + 1);
+  }
+  ttp229Model.sclHigh = high;
+}
+
+int ttp229DataLevel() {
+  bool active = ttp229Model.outputBit >= 0 && ttp229Model.outputBit < 16 &&
+                (ttp229Model.keys & (1u << ttp229Model.outputBit)) != 0;
+  return active ? TTP229_ACTIVE_STATE : !TTP229_ACTIVE_STATE;
+}
+#endif
+}  // namespace
+
+namespace host {
+
+void advanceSamples(uint32_t count) {
+  samples += count;
+}
+
+uint64_t sampleClock() {
+  return samples;
+}
+
+void setSwitch(uint8_t index, bool pressed) {
+  switchExpander.hostSetInput(index, pressed ? LOW : HIGH);
+}
+
+void setKey(uint8_t index, bool pressed) {
+  if (index >= KEY_COUNT) {
+    return;
+  }
+#if !defined(KEYBOARD_DRIVER_TTP229)
+  // 列 = GPA0..4（出力）、行 = GPB0..4（入力）。index = row * KEY_COLS + col
+  keyboardExpander.hostSetMatrixKey(index % KEY_COLS, 8 + index / KEY_COLS, pressed);
+#else
+  uint16_t mask = static_cast<uint16_t>(1u << index);
+  ttp229Model.keys = pressed ? (ttp229Model.keys | mask) : (ttp229Model.keys & static_cast<uint16_t>(~mask));
+  if (ttp229Model.dataValidHandler != nullptr) {
+    ttp229Model.dataValidHandler();
+  }
+#endif
+}
+
+uint32_t keyboardTransactions() {
+#if !defined(KEYBOARD_DRIVER_TTP229)
+  return keyboardExpander.hostTransactions();
+#else
+  return 0;
+#endif
+}
+
+bool pushMidiByte(uint8_t value) {
+  return Serial1.pushRx(value);
+}
+
+bool pushSerialLine(const char *text) {
+  for (const char *p = text; *p != '\0'; ++p) {
+    if (!Serial.pushRx(static_cast<uint8_t>(*p))) {
+      return false;
+    }
+  }
+  return Serial.pushRx('\n');
+}
+
+void setCycleScale(double scale) {
+  cycleScale = scale > 0.0 ? scale : 1.0;
+}
+
+}  // namespace host
+
+uint32_t millis() {
+  return static_cast<uint32_t>(samples * 1000 / AUDIO_RATE);
+}
+
+uint32_t micros() {
+  return static_cast<uint32_t>(samples * 1000000 / AUDIO_RATE);
+}
+
+void beginCycleCounter() {
+  cycleEpoch = std::chrono::steady_clock::now();
+}
+
+uint32_t cycleCount() {
+  // 実時間 (ns) を CPU_CLOCK_HZ のサイクル数に換算する。擬似サンプルクロックとは無関係。
+  // フラッシュエミュレータが模擬した CPU 停止時間も加える。
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - cycleEpoch).count();
+  return static_cast<uint32_t>(static_cast<uint64_t>(ns * (CPU_CLOCK_HZ / 1e9) * cycleScale) + host::flashStallCycles());
+}
+
+void delay(uint32_t) {}
+void delayMicroseconds(uint32_t) {}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+#if defined(KEYBOARD_DRIVER_TTP229)
+  if (pin == TTP229_SCL_PIN) {
+    ttp229ClockEdge(value);
+  }
+#else
+  (void)pin;
+  (void)value;
+#endif
+}
+
+int digitalRead(uint8_t pin) {
+#if defined(KEYBOARD_DRIVER_TTP229)
+  if (pin == TTP229_SDO_PIN) {
+    return ttp229DataLevel();
+  }
+#else
+  (void)pin;
+#endif
+  return HIGH;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int) {
+#if defined(KEYBOARD_DRIVER_TTP229)
+  // TTP229 の DV パルスは SDO に出る
+  if (interrupt == TTP229_SDO_PIN) {
+    ttp229Model.dataValidHandler = isr;
+  }
+#elif defined(KEYBOARD_MCP23017_INT_PIN)
+  // キーボード用エキスパンダの INTB はこのピンに配線されている想定
+  if (interrupt == KEYBOARD_MCP23017_INT_PIN) {
+    keyboardExpander.hostOnInterrupt(isr);
+  }
+#else
+  (void)interrupt;
+  (void)isr;
+#endif
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  attachInterrupt(interrupt, nullptr, 0);
+}
+
+long random(long howbig) {
+  if (howbig <= 0) {
+    return 0;
+  }
+  randomState = randomState * 1103515245u + 12345u;
+  return static_cast<long>((randomState >> 1) % static_cast<uint32_t>(howbig));
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  randomState = seed ? static_cast<uint32_t>(seed) : 1;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+// host_platform.h
+// ホストビルドの擬似ハードウェア。時刻はオーディオサンプル数から導出し、
+// ポット・スイッチ・MIDI 受信はレンダラ（スクリプト）から注入します。
+
+#include <stdint.h>
+
+namespace host {
+
+/**
+ * @brief 擬似クロックをオーディオサンプル単位で進める
+ */
+void advanceSamples(uint32_t count);
+
+/**
+ * @brief 現在のサンプルクロックを返す
+ */
+uint64_t sampleClock();
+
+/**
+ * @brief ポット値を設定する（ADC エミュレータの入力値）
+ * @param index analogPins のインデックス (0..5)
+ * @param value 正規化値 (0.0..1.0)
+ */
+void setPot(uint8_t index, float value);
+
+/**
+ * @brief ADC のノイズを模擬する: 変換のたびに ±amplitude（POT_ADC_BITS の ADC の値）の乱数を加える（0 で無効）
+ */
+void setPotNoise(uint16_t amplitude);
+
+/**
+ * @brief 記録したポットのトレースを読み込む（書式は host/adc_emulator.cpp）
+ *
+ * サンプルクロックがトレースの各時刻に達すると、ポットの入力値をその値へ切り替えます。
+ * @return 読めなければ false（エラーは標準エラーへ出力）
+ */
+bool setPotTrace(const char *path);
+
+/**
+ * @brief 読み込んだトレースの最後の時刻（サンプル数。トレースが無ければ 0）
+ */
+uint64_t potTraceEnd();
+
+/**
+ * @brief スイッチ用エキスパンダの入力を設定する（押下で LOW）
+ */
+void setSwitch(uint8_t index, bool pressed);
+
+/**
+ * @brief キーボードマトリクスのキーを押す/離す（MCP23017 ドライバ時のみ有効）
+ * @param index keyMidiNotes のインデックス
+ */
+void setKey(uint8_t index, bool pressed);
+
+/**
+ * @brief キーボード用エキスパンダへの I2C トランザクション累計を返す
+ */
+uint32_t keyboardTransactions();
+
+/**
+ * @brief Serial1 の受信バッファへ MIDI バイトを注入する
+ */
+bool pushMidiByte(uint8_t value);
+
+/**
+ * @brief Serial（USB シリアル）の受信バッファへ 1 行を注入する（改行は自動で付加）
+ */
+bool pushSerialLine(const char *text);
+
+/**
+ * @brief cycleCount() の換算倍率を設定する
+ *
+ * ホストは実時間をサイクル数に換算するため、実機より大幅に速く見えます。
+ * 倍率を上げると遅い CPU を模擬でき、ボイス数の自動調整を確認できます。
+ */
+void setCycleScale(double scale);
+
+/**
+ * @brief フラッシュエミュレータの統計
+ */
+struct FlashStats {
+  uint32_t programs;       // ハーフワード書き込み回数
+  uint32_t erases;         // ページ消去回数
+  uint32_t minPageErases;  // ページごとの消去回数の最小/最大（書き換えの偏りの確認用）
+  uint32_t maxPageErases;
+  uint64_t stallCycles;    // 実機で CPU が止まる時間の累計（サイクル数換算）
+};
+
+/**
+ * @brief フラッシュ領域をファイルに保存する（既存のファイルがあれば読み込む）
+ *
+ * 指定しなければ領域はメモリ上だけにあり、消去済みの状態から始まります。
+ * @return ファイルを開けなければ false
+ */
+bool setFlashImage(const char *path);
+
+/**
+ * @brief 書き込み/消去をあと operations 回だけ成功させ、それ以降を失敗させる（電源断の模擬）
+ *
+ * UINT32_MAX で元に戻します。
+ */
+void cutFlashPowerAfter(uint32_t operations);
+
+FlashStats flashStats();
+
+/**
+ * @brief 実機でフラッシュ操作により CPU が止まる時間の累計（cycleCount() がこの分を加える）
+ */
+uint64_t flashStallCycles();
+
+}  // namespace host
@@ -0,0 +1,162 @@
+// osc_bench.cpp
+// fast_osc.h のオシレータをホスト上で回し、1 サンプルあたりのコストを計測するベンチマーク。
+//
+// 使い方:
+//   osc_bench [samples]
+//
+// 計測の前に FastOscFixed の素朴な波形 (SINE/TRIANGLE/SAW/SQUARE) を全位相で理想波形と比べ、
+// fast_osc.h に書いた誤差の上限を超えたら終了コード 1 で終わります。
+// x86 では TSC サイクル、その他では ns/sample を表示します。ホスト CPU での相対比較用で、
+// Cortex-M3 上の絶対値ではありません（ソフト float の差はホストでは小さく出ます）。
+
+#include "config.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OSC_BENCH_HAS_TSC 1
+#endif
+
+#include "fast_osc.h"
+
+namespace {
+
+constexpr int RATE = 32768;
+constexpr float BENCH_FREQ = 1046.5f;  // C6: 鍵盤上端付近
+constexpr uint8_t BLOCK = 32;
+
+volatile int32_t sink;
+
+// 理想波形（振幅 1.0 = 32767）。位相は 0..1
+double idealSine(double p) {
+  return 32767.0 * sin(2.0 * M_PI * p);
+}
+
+double idealTriangle(double p) {
+  return 32767.0 * (p < 0.25 ? 4.0 * p : (p < 0.75 ? 2.0 - 4.0 * p : -4.0 + 4.0 * p));
+}
+
+double idealSaw(double p) {
+  return 32767.0 * (2.0 * p - 1.0);
+}
+
+double idealSquare(double p) {
+  return p < 0.5 ? 32767.0 : -32767.0;
+}
+
+bool checkError(const char *name, int16_t (*wave)(uint32_t), double (*ideal)(double), double bound) {
+  // 位相を 2^10 刻み + 下位ビットをずらしながら全周期走査し、最大誤差 (LSB) を求める
+  double worst = 0.0;
+  uint32_t worstPhase = 0;
+  for (uint32_t k = 0; k < (1u << 22); ++k) {
+    const uint32_t phase = (k << 10) | ((k * 613u) & 0x3FFu);
+    const double error = fabs(wave(phase) - ideal(phase / 4294967296.0));
+    if (error > worst) {
+      worst = error;
+      worstPhase = phase;
+    }
+  }
+  const bool ok = worst <= bound;
+  printf("%-28s max |err| %.2f LSB at phase 0x%08X (bound %.0f)  %s\n", name, worst, worstPhase, bound,
+         ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int16_t squareQ15(uint32_t p) {
+  // FastOscFixed::next() の SQUARE と同じ式
+  return (p < 0x80000000u) ? 32767 : -32767;
+}
+
+template <typename Fn>
+void measure(const char *name, uint32_t samples, Fn fn) {
+  using Clock = std::chrono::steady_clock;
+  int32_t acc = 0;
+#if defined(OSC_BENCH_HAS_TSC)
+  uint64_t c0 = __rdtsc();
+#endif
+  Clock::time_point t0 = Clock::now();
+  for (uint32_t n = 0; n < samples; n += BLOCK) {
+    acc += fn();
+  }
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+#if defined(OSC_BENCH_HAS_TSC)
+  double cycles = static_cast<double>(__rdtsc() - c0);
+  printf("%-28s %7.2f ns/sample %7.2f cycles/sample\n", name, ns / samples, cycles / samples);
+#else
+  printf("%-28s %7.2f ns/sample\n", name, ns / samples);
+#endif
+  sink = acc;
+}
+
+template <typename Osc>
+int32_t runBlock(Osc &osc) {
+  int32_t acc = 0;
+  for (uint8_t i = 0; i < BLOCK; ++i) {
+    acc += static_cast<int32_t>(osc.next());
+  }
+  return acc;
+}
+
+void benchFixed(const char *name, FastOscFixed<RATE>::Wave wave, uint32_t samples) {
+  FastOscFixed<RATE> osc(wave);
+  osc.setFreq(BENCH_FREQ);
+  osc.setPulseWidth(0x60000000u);
+  measure(name, samples, [&] { return runBlock(osc); });
+}
+
+void benchFloat(const char *name, FastOsc<RATE>::Wave wave, uint32_t samples) {
+  FastOsc<RATE> osc(wave);
+  osc.setFreq(BENCH_FREQ);
+  measure(name, samples, [&] { return static_cast<int32_t>(runBlock(osc)); });
+}
+
+void benchMorph(const char *name, uint8_t region, int32_t blendQ8, uint32_t samples) {
+  MorphOsc<RATE> osc;
+  osc.setFreq(BENCH_FREQ);
+  int16_t buf[BLOCK];
+  measure(name, samples, [&] {
+    osc.render(buf, BLOCK, region, blendQ8, 0x60000000u);
+    return static_cast<int32_t>(buf[0]) + buf[BLOCK - 1];
+  });
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t samples = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 0)) : (1u << 22);
+  samples = (samples + BLOCK - 1) / BLOCK * BLOCK;
+
+  printf("FastOscFixed error vs ideal\n");
+  bool ok = checkError("  SINE", FastOscFixed<RATE>::sin_q15, idealSine, 3.0);
+  ok = checkError("  TRIANGLE", FastOscFixed<RATE>::triangle_q15, idealTriangle, 2.0) && ok;
+  ok = checkError("  SAW", FastOscFixed<RATE>::saw_q15, idealSaw, 2.0) && ok;
+  ok = checkError("  SQUARE", squareQ15, idealSquare, 0.0) && ok;
+
+  printf("FastOsc (float)\n");
+  benchFloat("  SINE", FastOsc<RATE>::SINE, samples);
+  benchFloat("  TRIANGLE", FastOsc<RATE>::TRIANGLE, samples);
+  benchFloat("  SAW", FastOsc<RATE>::SAW, samples);
+  benchFloat("  SQUARE", FastOsc<RATE>::SQUARE, samples);
+
+  printf("FastOscFixed\n");
+  benchFixed("  SINE", FastOscFixed<RATE>::SINE, samples);
+  benchFixed("  TRIANGLE", FastOscFixed<RATE>::TRIANGLE, samples);
+  benchFixed("  SAW", FastOscFixed<RATE>::SAW, samples);
+  benchFixed("  SQUARE", FastOscFixed<RATE>::SQUARE, samples);
+  benchFixed("  TRIANGLE_BL", FastOscFixed<RATE>::TRIANGLE_BL, samples);
+  benchFixed("  SAW_BL", FastOscFixed<RATE>::SAW_BL, samples);
+  benchFixed("  SQUARE_BL", FastOscFixed<RATE>::SQUARE_BL, samples);
+  benchFixed("  PULSE_BL", FastOscFixed<RATE>::PULSE_BL, samples);
+
+  printf("MorphOsc (block %u)\n", BLOCK);
+  benchMorph("  region 0 SINE/TRIANGLE", 0, 128, samples);
+  benchMorph("  region 1 TRIANGLE/SAW", 1, 128, samples);
+  benchMorph("  region 2 SAW/PULSE", 2, 128, samples);
+  benchMorph("  region 3 PULSE/SQUARE", 3, 128, samples);
+  benchMorph("  region 4 SQUARE", 4, 0, samples);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// pot_tool.cpp
+// ポットの入力経路（pot_scan のオーバーサンプリング → PotFilter の平滑化とヒステリシス）を確かめるツール。
+//
+// 使い方:
+//   pot_tool test          合成した入力（静止 + ノイズ、ゆっくり回す、急に回す）で検証する
+//   pot_tool <trace.txt>   記録したポットのトレース（書式は host/adc_emulator.cpp）を流し、
+//                          確定値が変わったコントロールティックごとに "<ms> <v0> .. <v5>" を出力する
+//
+// どちらもコントロールティックごとに potScanValue() を読み、hardware_inputs.cpp と同じく
+// 最初の読み取りでフィルタを初期化してから PotFilter::push() に渡します。
+// test は許容値を超えたら終了コード 1。
+
+#include "host_platform.h"
+#include "pot_filter.h"
+#include "pot_scan.h"
+#include "synth_state.h"
+
+#include <MozziHeadersOnly.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+constexpr uint32_t TICK_SAMPLES = AUDIO_RATE / MOZZI_CONTROL_RATE;
+constexpr float ADC_MAX = (1u << POT_ADC_BITS) - 1;
+// 検証に使うノイズ: ±4（12bit の ADC の値。ブレッドボード上の Blue Pill でよく見る程度）
+constexpr uint16_t TEST_NOISE = 4;
+
+struct Inputs {
+  PotFilter filters[ANALOG_INPUT_COUNT];
+  bool primed = false;
+
+  // 1 コントロールティック進めて全ポットを読む。確定値が変わった本をビットで返す
+  uint8_t tick() {
+    host::advanceSamples(TICK_SAMPLES);
+    uint8_t changed = 0;
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+      const uint16_t raw = potScanValue(i);
+      if (!primed) {
+        filters[i].reset(raw);
+      } else if (filters[i].push(raw)) {
+        changed |= static_cast<uint8_t>(1u << i);
+      }
+    }
+    primed = true;
+    return changed;
+  }
+};
+
+float toMs(uint32_t ticks) {
+  return ticks * 1000.0f / MOZZI_CONTROL_RATE;
+}
+
+bool testStill(uint16_t noise) {
+  // 止まっているポット: 確定値が一度も変わらないこと。オーバーサンプリングした値の揺れも出す
+  host::setPotNoise(noise);
+  host::setPot(0, 0.37f);
+  Inputs inputs;
+  uint32_t changes = 0;
+  uint16_t scanMin = UINT16_MAX;
+  uint16_t scanMax = 0;
+  uint16_t convMin = UINT16_MAX;
+  uint16_t convMax = 0;
+  for (uint32_t t = 0; t < 30u * MOZZI_CONTROL_RATE; ++t) {
+    if (inputs.tick() & 1u) {
+      changes++;
+    }
+    const uint16_t scan = potScanValue(0);
+    scanMin = scan < scanMin ? scan : scanMin;
+    scanMax = scan > scanMax ? scan : scanMax;
+    const uint16_t conv = static_cast<uint16_t>(mozziAnalogRead(analogPins[0]) << POT_OVERSAMPLE_BITS);
+    convMin = conv < convMin ? conv : convMin;
+    convMax = conv > convMax ? conv : convMax;
+  }
+  const bool ok = changes == 0;
+  printf("still ±%-2u 30s   changes %u  spread: 1 conversion %u, oversampled %u (of %u)  %s\n", noise, changes,
+         convMax - convMin, scanMax - scanMin, POT_MAX_VALUE, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool testSweep() {
+  // 2 秒で 0 → 最大 → 0: 確定値が逆向きに動かず、遅れが 2% 以内で、端では必ず端の値になること
+  host::setPotNoise(TEST_NOISE);
+  host::setPot(0, 0.0f);
+  Inputs inputs;
+  inputs.tick();
+  const uint32_t sweepTicks = 2u * MOZZI_CONTROL_RATE;
+  float worstLag = 0.0f;
+  uint32_t changes = 0;
+  uint32_t reversals = 0;
+  bool reachedMax = false;
+  for (uint8_t direction = 0; direction < 2; ++direction) {
+    for (uint32_t t = 0; t <= sweepTicks + MOZZI_CONTROL_RATE / 2; ++t) {
+      const float position = t < sweepTicks ? static_cast<float>(t) / sweepTicks : 1.0f;
+      const float value = direction == 0 ? position : 1.0f - position;
+      host::setPot(0, value);
+      const uint16_t before = inputs.filters[0].value();
+      if ((inputs.tick() & 1u) == 0) {
+        continue;
+      }
+      changes++;
+      const uint16_t after = inputs.filters[0].value();
+      if ((direction == 0) != (after > before)) {
+        reversals++;
+      }
+      if (t < sweepTicks) {
+        worstLag = fmaxf(worstLag, fabsf(value - static_cast<float>(after) / POT_MAX_VALUE));
+      }
+    }
+    if (direction == 0) {
+      reachedMax = inputs.filters[0].value() == POT_MAX_VALUE;
+    }
+  }
+  const bool reachedZero = inputs.filters[0].value() == 0;
+  const bool ok = reversals == 0 && worstLag <= 0.02f && reachedMax && reachedZero;
+  printf("sweep 2s+2s     changes %u  reversals %u  lag max %.2f%%  ends %s/%s  %s\n", changes, reversals,
+         worstLag * 100.0f, reachedZero ? "0" : "miss", reachedMax ? "max" : "miss", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool testStep() {
+  // 1/4 → 3/4 へ急に回す: 確定値が目標のヒステリシス幅に入るまでのティック数
+  host::setPotNoise(TEST_NOISE);
+  host::setPot(0, 0.25f);
+  Inputs inputs;
+  for (uint32_t t = 0; t < MOZZI_CONTROL_RATE; ++t) {
+    inputs.tick();
+  }
+  host::setPot(0, 0.75f);
+  const int32_t target = static_cast<int32_t>(lroundf(0.75f * ADC_MAX)) << POT_OVERSAMPLE_BITS;
+  int32_t settledAt = -1;
+  uint32_t changes = 0;
+  for (uint32_t t = 1; t <= MOZZI_CONTROL_RATE; ++t) {
+    if (inputs.tick() & 1u) {
+      changes++;
+    }
+    if (settledAt < 0 && abs(static_cast<int32_t>(inputs.filters[0].value()) - target) <= POT_HYSTERESIS) {
+      settledAt = static_cast<int32_t>(t);
+    }
+  }
+  // 1/2^POT_SMOOTHING_SHIFT ずつ近づくので、半分の距離から幅に入るまで約 20 ティック (160ms)
+  const bool ok = settledAt > 0 && settledAt <= 24;
+  printf("step 1/4->3/4   changes %u  settled after %d ticks (%.0fms)  %s\n", changes, settledAt,
+         toMs(settledAt > 0 ? settledAt : 0), ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int playTrace(const char *path) {
+  if (!host::setPotTrace(path)) {
+    return 1;
+  }
+  Inputs inputs;
+  uint32_t changes[ANALOG_INPUT_COUNT] = {0};
+  const uint64_t end = host::potTraceEnd() + AUDIO_RATE;
+  for (uint32_t t = 1; host::sampleClock() < end; ++t) {
+    uint8_t changed = inputs.tick();
+    if (t > 1 && changed == 0) {
+      continue;
+    }
+    printf("%.1f", toMs(t));
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+      printf(" %u", inputs.filters[i].value());
+      if (changed & (1u << i)) {
+        changes[i]++;
+      }
+    }
+    printf("\n");
+  }
+  fprintf(stderr, "changes per pot:");
+  for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+    fprintf(stderr, " %u", changes[i]);
+  }
+  fprintf(stderr, "  (values 0..%u)\n", POT_MAX_VALUE);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: pot_tool test | pot_tool <trace.txt>\n");
+    return 2;
+  }
+  if (strcmp(argv[1], "test") != 0) {
+    return playTrace(argv[1]);
+  }
+  bool ok = testStill(TEST_NOISE);
+  ok = testStill(TEST_NOISE * 2) && ok;
+  ok = testSweep() && ok;
+  ok = testStep() && ok;
+  return ok ? 0 : 1;
+}
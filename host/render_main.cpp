@@ -0,0 +1,366 @@
+// render_main.cpp
+// オーディオエンジンをホスト上でオフラインレンダリングし、WAV に書き出すツール。
+//
+// 使い方:
+//   synthe_render [-o out.wav] [-s script.txt] [-d duration_ms] [-c cycle_scale] [-p] [-e] [-m] [-n noise] [-t pots.txt] [-f flash.bin]
+//
+// -c は計測したサイクル数に掛ける倍率です（実機より遅い CPU を模擬してボイス数の自動調整を確認する）。
+// -p は終了時にサイクル計測の結果（シリアルの "prof" と同じ表）を出力します。
+// -e はシーケンサ再生のノートイベントを発火したサンプル時刻とともに標準出力へ書き出します
+//   （"<sample> on|off <note>"。録音/再生のタイミング検証用）。
+// -m は Serial1 (MIDI 出力) へ送ったバイトを送信したサンプル時刻とともに標準出力へ書き出します
+//   （"<sample> tx <hex>"。MIDI クロックのマスター動作の検証用）。
+// -n は ADC の変換のたびに ±noise（12bit の ADC の値）の乱数を加えます（ADC ノイズの模擬）。
+// -t は記録したポットのトレース（書式は adc_emulator.cpp）をサンプルクロックに合わせてポットへ流します。
+// -f はフラッシュ保存領域をファイルに置きます（次の実行で "load song" などで読み込める）。
+//
+// スクリプトは 1 行 1 イベントのテキストです（'#' 以降はコメント）:
+//   <ms> on <note> [velocity]   MIDI ノートオンを Serial1 に注入
+//   <ms> off <note>             MIDI ノートオフを Serial1 に注入
+//   <ms> pot <index> <0..1>     ポット値を設定
+//   <ms> switch <index> down|up スイッチ押下/解放
+//   <ms> key <index> down|up    キーボードマトリクスのキー押下/解放
+//   <ms> midi <hex> [<hex>...]  任意の MIDI バイト列を注入
+//   <ms> serial <text>          Serial（USB シリアル）へ 1 行を注入（例: "prof"）
+//   <ms> end                    レンダリング終了時刻
+// スクリプト未指定時は組み込みのデモシーケンスを使います。
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "audio_engine.h"
+#include "hardware_inputs.h"
+#include "host_platform.h"
+#include "midi_clock.h"
+#include "midi_input.h"
+#include "pot_scan.h"
+#include "profiler.h"
+#include "storage.h"
+#include "synth_state.h"
+#include "voice_manager.h"
+#include "wav_writer.h"
+
+namespace {
+
+constexpr uint32_t CONTROL_PERIOD = AUDIO_RATE / MOZZI_CONTROL_RATE;
+constexpr uint32_t RENDER_CHUNK = 1024;
+
+const char *DEMO_SCRIPT =
+    "0 pot 0 0.0\n"
+    "0 pot 1 0.02\n"
+    "0 pot 2 0.8\n"
+    "0 pot 3 0.3\n"
+    "0 pot 4 0.4\n"
+    "0 pot 5 0.3\n"
+    "100 on 60\n"
+    "100 on 64\n"
+    "100 on 67\n"
+    "900 off 60\n"
+    "900 off 64\n"
+    "900 off 67\n"
+    "1000 pot 0 0.25\n"
+    "1000 on 48\n"
+    "1250 on 55\n"
+    "1500 pot 0 0.5\n"
+    "1500 on 60\n"
+    "1750 pot 0 0.75\n"
+    "1750 off 55\n"
+    "2000 pot 0 1.0\n"
+    "2000 on 63\n"
+    "2500 off 48\n"
+    "2500 off 60\n"
+    "2500 off 63\n"
+    "3000 end\n";
+
+enum class EventType { NoteOn, NoteOff, Pot, Switch, Key, Midi, Serial, End };
+
+struct ScriptEvent {
+  uint32_t sample;
+  EventType type;
+  std::vector<uint8_t> bytes;
+  std::string text;
+  uint8_t index;
+  float value;
+};
+
+bool parseScript(const char *text, std::vector<ScriptEvent> &events, uint32_t &endSample) {
+  const char *p = text;
+  unsigned lineNo = 0;
+  while (*p) {
+    const char *eol = strchr(p, '\n');
+    std::string line = eol ? std::string(p, eol) : std::string(p);
+    p = eol ? eol + 1 : p + line.size();
+    ++lineNo;
+
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.resize(hash);
+    }
+    char cmd[16] = {0};
+    double ms = 0;
+    int consumed = 0;
+    if (sscanf(line.c_str(), " %lf %15s %n", &ms, cmd, &consumed) < 2) {
+      continue;
+    }
+    const char *args = line.c_str() + consumed;
+    ScriptEvent e{static_cast<uint32_t>(ms * AUDIO_RATE / 1000.0), EventType::End, {}, {}, 0, 0.0f};
+
+    if (strcmp(cmd, "on") == 0 || strcmp(cmd, "off") == 0) {
+      int note = 0, velocity = 100;
+      if (sscanf(args, "%d %d", &note, &velocity) < 1) {
+        fprintf(stderr, "line %u: note number expected\n", lineNo);
+        return false;
+      }
+      bool on = cmd[1] == 'n';
+      e.type = on ? EventType::NoteOn : EventType::NoteOff;
+      e.bytes = {static_cast<uint8_t>(on ? 0x90 : 0x80), static_cast<uint8_t>(note & 0x7F),
+                 static_cast<uint8_t>(on ? (velocity & 0x7F) : 0)};
+    } else if (strcmp(cmd, "pot") == 0) {
+      int index = 0;
+      if (sscanf(args, "%d %f", &index, &e.value) < 2) {
+        fprintf(stderr, "line %u: pot <index> <value> expected\n", lineNo);
+        return false;
+      }
+      e.type = EventType::Pot;
+      e.index = static_cast<uint8_t>(index);
+    } else if (strcmp(cmd, "switch") == 0 || strcmp(cmd, "key") == 0) {
+      int index = 0;
+      char state[8] = {0};
+      if (sscanf(args, "%d %7s", &index, state) < 2) {
+        fprintf(stderr, "line %u: %s <index> down|up expected\n", lineNo, cmd);
+        return false;
+      }
+      e.type = cmd[0] == 's' ? EventType::Switch : EventType::Key;
+      e.index = static_cast<uint8_t>(index);
+      e.value = strcmp(state, "down") == 0 ? 1.0f : 0.0f;
+    } else if (strcmp(cmd, "midi") == 0) {
+      e.type = EventType::Midi;
+      unsigned value = 0;
+      int n = 0;
+      while (sscanf(args, "%x %n", &value, &n) == 1) {
+        e.bytes.push_back(static_cast<uint8_t>(value));
+        args += n;
+      }
+    } else if (strcmp(cmd, "serial") == 0) {
+      e.type = EventType::Serial;
+      e.text = args;
+      while (!e.text.empty() && (e.text.back() == ' ' || e.text.back() == '\r')) {
+        e.text.pop_back();
+      }
+    } else if (strcmp(cmd, "end") == 0) {
+      endSample = e.sample;
+      continue;
+    } else {
+      fprintf(stderr, "line %u: unknown command '%s'\n", lineNo, cmd);
+      return false;
+    }
+    events.push_back(e);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const ScriptEvent &a, const ScriptEvent &b) { return a.sample < b.sample; });
+  return true;
+}
+
+void applyEvent(const ScriptEvent &e) {
+  switch (e.type) {
+    case EventType::NoteOn:
+    case EventType::NoteOff:
+    case EventType::Midi:
+      for (uint8_t b : e.bytes) {
+        host::pushMidiByte(b);
+      }
+      break;
+    case EventType::Pot:
+      host::setPot(e.index, e.value);
+      break;
+    case EventType::Switch:
+      host::setSwitch(e.index, e.value > 0.5f);
+      break;
+    case EventType::Key:
+      host::setKey(e.index, e.value > 0.5f);
+      break;
+    case EventType::Serial:
+      host::pushSerialLine(e.text.c_str());
+      break;
+    case EventType::End:
+      break;
+  }
+}
+
+std::string readFile(const char *path) {
+  std::string text;
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    return text;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    text.append(buf, n);
+  }
+  fclose(f);
+  return text;
+}
+
+void printScheduledNote(uint32_t sample, uint8_t note, bool noteOn) {
+  printf("%u %s %u\n", sample, noteOn ? "on" : "off", note);
+}
+
+void printMidiOutput(uint8_t value) {
+  printf("%u tx %02X\n", static_cast<uint32_t>(host::sampleClock()), value);
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: synthe_render [-o out.wav] [-s script.txt] [-d duration_ms] [-c cycle_scale] [-p] [-e] [-m] "
+          "[-n noise] [-t pots.txt] [-f flash.bin]\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *outPath = "render.wav";
+  const char *scriptPath = nullptr;
+  double durationMs = -1.0;
+  bool printProfile = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      scriptPath = argv[++i];
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      durationMs = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      host::setCycleScale(atof(argv[++i]));
+    } else if (strcmp(argv[i], "-p") == 0) {
+      printProfile = true;
+    } else if (strcmp(argv[i], "-e") == 0) {
+      setScheduledNoteObserver(printScheduledNote);
+    } else if (strcmp(argv[i], "-m") == 0) {
+      Serial1.setTxObserver(printMidiOutput);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      host::setPotNoise(static_cast<uint16_t>(atoi(argv[++i])));
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      if (!host::setPotTrace(argv[++i])) {
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      if (!host::setFlashImage(argv[++i])) {
+        fprintf(stderr, "cannot open flash image: %s\n", argv[i]);
+        return 1;
+      }
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  std::string scriptText = DEMO_SCRIPT;
+  if (scriptPath != nullptr) {
+    scriptText = readFile(scriptPath);
+    if (scriptText.empty()) {
+      fprintf(stderr, "cannot read script: %s\n", scriptPath);
+      return 1;
+    }
+  }
+
+  std::vector<ScriptEvent> events;
+  uint32_t endSample = 0;
+  if (!parseScript(scriptText.c_str(), events, endSample)) {
+    return 1;
+  }
+  if (durationMs >= 0.0) {
+    endSample = static_cast<uint32_t>(durationMs * AUDIO_RATE / 1000.0);
+  } else if (endSample == 0) {
+    endSample = (events.empty() ? 0 : events.back().sample) + AUDIO_RATE;
+  }
+
+  WavWriter wav;
+  if (!wav.open(outPath, AUDIO_RATE)) {
+    fprintf(stderr, "cannot open output: %s\n", outPath);
+    return 1;
+  }
+
+  // setup() 相当（ディスプレイと MIDI シリアルはスタブなので省略）
+  setupKeyboardExpander();
+  setupSwitchExpander();
+  setupAudioEngine();
+  setupStorage();
+  potScanBegin();
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration controlTime{0};
+  Clock::duration controlWorst{0};
+  size_t nextEvent = 0;
+  int16_t chunk[RENDER_CHUNK];
+  uint32_t fill = 0;
+  uint8_t minVoiceBudget = voiceBudget;
+  const host::FlashStats flashAtStart = host::flashStats();
+  uint64_t flashStallWorst = 0;
+
+  const Clock::time_point start = Clock::now();
+  for (uint32_t n = 0; n < endSample; ++n) {
+    while (nextEvent < events.size() && events[nextEvent].sample <= n) {
+      applyEvent(events[nextEvent++]);
+    }
+    if (n % CONTROL_PERIOD == 0) {
+      const Clock::time_point t0 = Clock::now();
+      const uint64_t stall0 = host::flashStallCycles();
+      updateControl();
+      const Clock::duration elapsed = Clock::now() - t0;
+      flashStallWorst = std::max(flashStallWorst, host::flashStallCycles() - stall0);
+      controlTime += elapsed;
+      controlWorst = std::max(controlWorst, elapsed);
+      minVoiceBudget = std::min(minVoiceBudget, voiceBudget);
+    }
+    AudioOutput out = updateAudio();
+    pollMidiInput();    // loop() で audioHook() の後に呼ぶのと同じ
+    serviceMidiClock();
+    serviceKeyboard();
+    chunk[fill++] = static_cast<int16_t>(constrain(out.l(), -32768, 32767));
+    host::advanceSamples(1);
+    if (fill == RENDER_CHUNK) {
+      wav.write(chunk, fill);
+      fill = 0;
+    }
+  }
+  const Clock::duration total = Clock::now() - start;
+  wav.write(chunk, fill);
+  wav.close();
+
+  const double totalSec = std::chrono::duration<double>(total).count();
+  const double controlSec = std::chrono::duration<double>(controlTime).count();
+  const double audioSec = totalSec - controlSec;
+  const double renderedSec = static_cast<double>(endSample) / AUDIO_RATE;
+  const uint32_t controlTicks = (endSample + CONTROL_PERIOD - 1) / CONTROL_PERIOD;
+  fprintf(stderr, "rendered %u samples (%.3f s) to %s\n", endSample, renderedSec, outPath);
+  fprintf(stderr, "  wall %.3f s, %.1fx realtime\n", totalSec, totalSec > 0 ? renderedSec / totalSec : 0.0);
+  fprintf(stderr, "  updateAudio   %.1f ns/sample\n", endSample ? audioSec * 1e9 / endSample : 0.0);
+  fprintf(stderr, "  keyboard I2C  %.1f transactions/tick\n",
+          controlTicks ? static_cast<double>(host::keyboardTransactions()) / controlTicks : 0.0);
+  fprintf(stderr, "  updateControl %.1f us/tick (worst %.1f us)\n", controlTicks ? controlSec * 1e6 / controlTicks : 0.0,
+          std::chrono::duration<double>(controlWorst).count() * 1e6);
+  fprintf(stderr, "  voice budget  %u (min %u of %u)\n", voiceBudget, minVoiceBudget, POLY_VOICES);
+  const host::FlashStats flash = host::flashStats();
+  if (flash.programs != flashAtStart.programs || flash.erases != flashAtStart.erases) {
+    fprintf(stderr, "  flash         %u programs, %u erases (worst stall %.2f ms/tick, page erases %u..%u)\n",
+            flash.programs - flashAtStart.programs, flash.erases - flashAtStart.erases,
+            static_cast<double>(flashStallWorst) * 1e3 / CPU_CLOCK_HZ, flash.minPageErases, flash.maxPageErases);
+  }
+  const MidiInputStats midi = midiInputStats();
+  if (midi.bytes > 0) {
+    fprintf(stderr, "  midi          %u bytes, %u messages (dropped %u bytes, %u messages, late %u)\n", midi.bytes,
+            midi.events, midi.ringOverflows, midi.queueOverflows, midi.lateEvents);
+  }
+  if (printProfile) {
+    printProfileReport(Serial);
+  }
+  return 0;
+}
@@ -0,0 +1,210 @@
+// sequence_test.cpp
+// packed_sequence.h の符号化を往復させて、時刻・ノート・オン/オフがそのまま戻ることを確かめる検証。
+//
+// 使い方:
+//   sequence_test [seed]
+//
+// VLQ の境目 (127/128, 16383/16384, 2097151/2097152) の差分、同時刻、直前より前の時刻、乱数の列を
+// append() で書き、Reader と load(data(), bytesUsed()) の両方で復号して、書いた列と完全に一致するか比べます。
+// 容量ちょうどまで詰めたときの append() の失敗（何も書かないこと）と、load() の失敗も確かめます。
+// どれかが一致しなければ終了コード 1。
+
+#include "packed_sequence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace {
+
+constexpr uint16_t CAPACITY = 3072;
+
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+  rngState = rngState * 1664525u + 1013904223u;
+  return rngState >> 8;
+}
+
+uint8_t vlqBytes(uint32_t delta) {
+  uint8_t n = 1;
+  while (delta >>= 7) {
+    n++;
+  }
+  return n;
+}
+
+bool sameEvents(const PackedSequence::Event &a, const PackedSequence::Event &b) {
+  return a.time == b.time && a.note == b.note && a.noteOn == b.noteOn;
+}
+
+bool decodeMatches(const char *how, PackedSequence::Reader reader, const std::vector<PackedSequence::Event> &expected) {
+  size_t index = 0;
+  for (; !reader.done(); reader.advance(), ++index) {
+    if (index >= expected.size()) {
+      printf("  %s: extra event after %zu\n", how, expected.size());
+      return false;
+    }
+    const PackedSequence::Event &e = reader.event();
+    if (!sameEvents(e, expected[index])) {
+      printf("  %s: event %zu is %u/%u/%d, expected %u/%u/%d\n", how, index, e.time, e.note, e.noteOn,
+             expected[index].time, expected[index].note, expected[index].noteOn);
+      return false;
+    }
+  }
+  if (index != expected.size()) {
+    printf("  %s: %zu events, expected %zu\n", how, index, expected.size());
+    return false;
+  }
+  return true;
+}
+
+bool roundTrip(const char *name, const PackedSequence &sequence, const std::vector<PackedSequence::Event> &expected,
+               uint32_t expectedBytes) {
+  // Reader と load() の両方で復号して書いた列と比べ、件数/バイト数/末尾時刻も確かめる
+  bool ok = sequence.bytesUsed() == expectedBytes && sequence.eventCount() == expected.size() &&
+            sequence.lastTime() == (expected.empty() ? 0 : expected.back().time);
+  if (!ok) {
+    printf("  %s: %u bytes / %u events / last %u, expected %u / %zu / %u\n", name, sequence.bytesUsed(),
+           sequence.eventCount(), sequence.lastTime(), expectedBytes, expected.size(),
+           expected.empty() ? 0 : expected.back().time);
+  }
+  ok = decodeMatches("reader", sequence.reader(), expected) && ok;
+
+  static uint8_t copyStorage[CAPACITY];
+  PackedSequence copy(copyStorage, CAPACITY);
+  const bool loaded = copy.load(sequence.data(), sequence.bytesUsed());
+  ok = loaded && copy.bytesUsed() == sequence.bytesUsed() && copy.eventCount() == sequence.eventCount() &&
+       copy.lastTime() == sequence.lastTime() && ok;
+  ok = decodeMatches("load", copy.reader(), expected) && ok;
+
+  printf("%-24s %5zu events %5u bytes  %s\n", name, expected.size(), sequence.bytesUsed(), ok ? "ok" : "FAIL");
+  return ok;
+}
+
+bool testBoundaries() {
+  // VLQ の境目の前後の差分。バイト数が 2/3/4/5 に切り替わる
+  static uint8_t storage[CAPACITY];
+  PackedSequence sequence(storage, CAPACITY);
+  const uint32_t deltas[] = {0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 0, 268435455, 268435456, 0};
+  std::vector<PackedSequence::Event> expected;
+  uint32_t time = 0;
+  uint32_t bytes = 0;
+  uint8_t note = 0;
+  for (uint32_t delta : deltas) {
+    time += delta;
+    const bool noteOn = (note & 1u) == 0;
+    if (!sequence.append(time, note, noteOn)) {
+      printf("  append failed at delta %u\n", delta);
+      return false;
+    }
+    expected.push_back({time, note, noteOn});
+    bytes += vlqBytes(delta) + 1u;
+    note = static_cast<uint8_t>((note + 37) & 0x7F);
+  }
+  return roundTrip("vlq boundaries", sequence, expected, bytes);
+}
+
+bool testEarlierTime() {
+  // 直前より前の時刻は直前と同時刻として記録される
+  static uint8_t storage[CAPACITY];
+  PackedSequence sequence(storage, CAPACITY);
+  sequence.append(1000, 60, true);
+  sequence.append(400, 64, true);
+  sequence.append(1000, 60, false);
+  const std::vector<PackedSequence::Event> expected = {{1000, 60, true}, {1000, 64, true}, {1000, 60, false}};
+  return roundTrip("earlier time clamps", sequence, expected, 3u + 2u + 2u);
+}
+
+bool testRandom(uint8_t run) {
+  // 乱数の列（同時刻、短い/長い差分、境目の差分を混ぜる）を容量いっぱいまで書く
+  static uint8_t storage[CAPACITY];
+  PackedSequence sequence(storage, CAPACITY);
+  std::vector<PackedSequence::Event> expected;
+  uint32_t time = 0;
+  uint32_t bytes = 0;
+  const uint32_t boundaries[] = {127, 128, 16383, 16384, 2097151, 2097152};
+  for (;;) {
+    uint32_t delta;
+    switch (nextRandom() % 6) {
+      case 0: delta = 0; break;
+      case 1: delta = nextRandom() % 128; break;
+      case 2: delta = nextRandom() % 16384; break;
+      case 3: delta = boundaries[nextRandom() % 6]; break;
+      case 4: delta = nextRandom() % 480; break;
+      default: delta = nextRandom() % 4000000; break;
+    }
+    const uint8_t note = static_cast<uint8_t>(nextRandom() & 0x7F);
+    const bool noteOn = (nextRandom() & 1u) != 0;
+    const uint16_t before = sequence.bytesUsed();
+    if (!sequence.append(time + delta, note, noteOn)) {
+      // 収まらないときは何も書かない
+      if (sequence.bytesUsed() != before || before + vlqBytes(delta) + 1u <= CAPACITY) {
+        printf("  append failed with room left or changed the sequence\n");
+        return false;
+      }
+      break;
+    }
+    time += delta;
+    expected.push_back({time, note, noteOn});
+    bytes += vlqBytes(delta) + 1u;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "random #%u", run);
+  return roundTrip(name, sequence, expected, bytes);
+}
+
+bool testFull() {
+  // 容量ちょうど: 残り 2 バイトで 3 バイトのイベントは失敗し、2 バイトのイベントは入る。その後は何も入らない
+  constexpr uint16_t SMALL = 10;
+  uint8_t storage[SMALL];
+  PackedSequence sequence(storage, SMALL);
+  std::vector<PackedSequence::Event> expected;
+  for (uint8_t i = 0; i < 4; ++i) {
+    sequence.append(i * 100u, 60, (i & 1u) == 0);
+    expected.push_back({i * 100u, 60, (i & 1u) == 0});
+  }
+  bool ok = sequence.bytesUsed() == 8;
+  ok = !sequence.append(300 + 200, 62, true) && sequence.bytesUsed() == 8 && sequence.eventCount() == 4 && ok;
+  ok = sequence.append(300 + 100, 62, true) && sequence.bytesUsed() == SMALL && ok;
+  expected.push_back({400, 62, true});
+  ok = !sequence.append(400, 62, false) && sequence.bytesUsed() == SMALL && sequence.eventCount() == 5 &&
+       sequence.lastTime() == 400 && ok;
+  if (!ok) {
+    printf("  full: append accepted an event that does not fit or rejected one that does\n");
+  }
+  return roundTrip("full capacity", sequence, expected, SMALL) && ok;
+}
+
+bool testLoadFailures() {
+  // 容量を超える長さと、途中で切れたデータは false
+  static uint8_t storage[CAPACITY];
+  PackedSequence sequence(storage, CAPACITY);
+  sequence.append(0, 60, true);
+  sequence.append(20000, 60, false);
+  uint8_t small[4];
+  PackedSequence tooSmall(small, sizeof(small));
+  bool ok = !tooSmall.load(sequence.data(), sequence.bytesUsed());
+  static uint8_t copyStorage[CAPACITY];
+  PackedSequence copy(copyStorage, CAPACITY);
+  ok = !copy.load(sequence.data(), static_cast<uint16_t>(sequence.bytesUsed() - 1)) && copy.eventCount() == 1 && ok;
+  printf("%-24s %s\n", "load failures", ok ? "ok" : "FAIL");
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    rngState = static_cast<uint32_t>(strtoul(argv[1], nullptr, 0));
+  }
+  bool ok = testBoundaries();
+  ok = testEarlierTime() && ok;
+  for (uint8_t run = 0; run < 8; ++run) {
+    ok = testRandom(run) && ok;
+  }
+  ok = testFull() && ok;
+  ok = testLoadFailures() && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,428 @@
+// smf_tool.cpp
+// smf.h / smf_transfer.h をホストで動かすツール。スケッチ本体と同じコードで SMF を読み書きします。
+//
+// 使い方:
+//   smf_tool gen <out.mid> [tracks] [notes]   検証用の Type 1 ファイルを作る（CC/ピッチベンド/SysEx/メタを含む）
+//   smf_tool bench [in.mid]                  パースの処理速度（64 バイトずつ流す）。省略時は数 MB のファイルを作って使う
+//   smf_tool import <in.mid> [out.mid]       シーケンサへ読み込んで結果を表示し、指定があれば書き出す
+//   smf_tool roundtrip <in.mid>              読み込み → 書き出し → 読み込み → 書き出しで内容が変わらないことを確かめる
+//   smf_tool test                            生成したファイルの読み込み結果を期待値と比べ、往復も確かめる
+//
+// roundtrip/test は不一致があれば終了コード 1 を返します。
+
+#include "config.h"
+#include "sequencer.h"
+#include "smf.h"
+#include "smf_transfer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+  rngState = rngState * 1664525u + 1013904223u;
+  return rngState >> 8;
+}
+
+bool readFile(const char *path, Bytes &out) {
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.insert(out.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+bool writeFile(const char *path, const Bytes &data) {
+  FILE *f = fopen(path, "wb");
+  if (f == nullptr) {
+    return false;
+  }
+  const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+// ---- 検証用ファイルの生成（smf.h の書き出しとは別に、素朴に組み立てる） ----
+
+struct ExpectedNote {
+  uint8_t track;  // 読み込み先のトラック
+  uint32_t tick;  // SEQ_PPQN でのティック
+  uint8_t note;
+  bool noteOn;
+};
+
+void putVlq(Bytes &out, uint32_t value) {
+  uint8_t groups[5];
+  uint8_t count = 0;
+  do {
+    groups[count++] = static_cast<uint8_t>(value & 0x7F);
+    value >>= 7;
+  } while (value != 0);
+  while (count > 1) {
+    out.push_back(static_cast<uint8_t>(groups[--count] | 0x80));
+  }
+  out.push_back(groups[0]);
+}
+
+void putU32(Bytes &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+Bytes generate(uint16_t tracks, uint32_t notesPerTrack, uint16_t division, std::vector<ExpectedNote> *expected) {
+  // Type 1 のファイルを作る
+  // 説明: 先頭にテンポ/拍子/曲名のトラックと未知のチャンクを置き、続く各トラックにはチャンネルを変えて
+  //   重ならないノートを並べます。間に CC、ピッチベンド、プログラムチェンジ、SysEx、テキストを挟み、
+  //   ランニングステータスとノートオフの 2 つの書き方 (8n / 9n vel 0) を混ぜます。
+  //   expected には読み込み後にトラックへ入るはずのイベントを SEQ_PPQN のティックで積みます。
+  Bytes file;
+  putU32(file, 0x4D546864UL);
+  putU32(file, 6);
+  file.push_back(0);
+  file.push_back(1);
+  file.push_back(static_cast<uint8_t>((tracks + 1) >> 8));
+  file.push_back(static_cast<uint8_t>(tracks + 1));
+  file.push_back(static_cast<uint8_t>(division >> 8));
+  file.push_back(static_cast<uint8_t>(division));
+
+  // 未知のチャンクは読み飛ばされる
+  putU32(file, 0x58595A57UL);
+  putU32(file, 5);
+  for (int i = 0; i < 5; ++i) {
+    file.push_back(0xAA);
+  }
+
+  const Bytes conductor = {0x00, 0xFF, 0x03, 0x04, 't',  'e',  's',  't',  0x00, 0xFF, 0x51, 0x03, 0x07,
+                           0xA1, 0x20, 0x00, 0xFF, 0x58, 0x04, 0x04, 0x02, 0x18, 0x08, 0x00, 0xFF, 0x2F, 0x00};
+  putU32(file, 0x4D54726BUL);
+  putU32(file, static_cast<uint32_t>(conductor.size()));
+  file.insert(file.end(), conductor.begin(), conductor.end());
+
+  for (uint16_t t = 0; t < tracks; ++t) {
+    Bytes body;
+    const uint8_t channel = static_cast<uint8_t>((t * 3 + 1) & 0x0F);
+    uint8_t status = 0;
+    uint32_t time = 0;
+    uint32_t last = 0;
+    auto event = [&](uint32_t at, const std::initializer_list<uint8_t> &bytes) {
+      putVlq(body, at - last);
+      last = at;
+      body.insert(body.end(), bytes.begin(), bytes.end());
+    };
+    auto channelEvent = [&](uint32_t at, uint8_t kind, uint8_t a, int b) {
+      // 同じステータスが続けばランニングステータスで書く（SysEx の後は取り消されるので必ず書く）
+      const uint8_t s = static_cast<uint8_t>(kind | channel);
+      putVlq(body, at - last);
+      last = at;
+      if (s != status) {
+        body.push_back(s);
+        status = s;
+      }
+      body.push_back(a);
+      if (b >= 0) {
+        body.push_back(static_cast<uint8_t>(b));
+      }
+    };
+    for (uint32_t n = 0; n < notesPerTrack; ++n) {
+      // 分解能の 1/4 単位に置くので、SEQ_PPQN への換算は割り切れる
+      const uint32_t step = division / 4;
+      const uint32_t on = time + step * (nextRandom() % 3);
+      const uint32_t off = on + step * (1 + nextRandom() % 4);
+      const uint8_t note = static_cast<uint8_t>(36 + nextRandom() % 48);
+      switch (nextRandom() % 8) {
+        case 0:
+          channelEvent(on, 0xB0, 1, static_cast<int>(nextRandom() % 128));
+          break;
+        case 1:
+          channelEvent(on, 0xE0, 0, static_cast<int>(nextRandom() % 128));
+          break;
+        case 2:
+          channelEvent(on, 0xC0, static_cast<uint8_t>(nextRandom() % 128), -1);
+          break;
+        case 3:
+          event(on, {0xF0, 0x03, 0x7E, 0x09, 0xF7});
+          status = 0;
+          break;
+        case 4:
+          event(on, {0xFF, 0x01, 0x02, 'h', 'i'});
+          break;
+        default:
+          break;
+      }
+      channelEvent(on, 0x90, note, static_cast<int>(1 + nextRandom() % 127));
+      if (nextRandom() % 2) {
+        channelEvent(off, 0x80, note, 64);
+      } else {
+        channelEvent(off, 0x90, note, 0);
+      }
+      time = off;
+      if (expected != nullptr) {
+        expected->push_back({static_cast<uint8_t>(t), on * SEQ_PPQN / division, note, true});
+        expected->push_back({static_cast<uint8_t>(t), off * SEQ_PPQN / division, note, false});
+      }
+    }
+    event(time, {0xFF, 0x2F, 0x00});
+    putU32(file, 0x4D54726BUL);
+    putU32(file, static_cast<uint32_t>(body.size()));
+    file.insert(file.end(), body.begin(), body.end());
+  }
+  return file;
+}
+
+// ---- シーケンサとのやりとり ----
+
+struct SongSnapshot {
+  Bytes tracks[SEQ_TRACK_COUNT];
+  uint32_t loopTicks;
+  float bpm;
+};
+
+SongSnapshot snapshot() {
+  SongSnapshot s;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    const PackedSequence &seq = getSequencerTrack(t);
+    s.tracks[t].assign(seq.data(), seq.data() + seq.bytesUsed());
+  }
+  s.loopTicks = getSequencerLoopTicks();
+  s.bpm = getSequencerTempo();
+  return s;
+}
+
+bool sameSong(const SongSnapshot &a, const SongSnapshot &b) {
+  bool same = a.loopTicks == b.loopTicks && static_cast<uint32_t>(a.bpm * 100.0f + 0.5f) ==
+                                                static_cast<uint32_t>(b.bpm * 100.0f + 0.5f);
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    if (a.tracks[t] != b.tracks[t]) {
+      fprintf(stderr, "  track %u differs (%zu / %zu bytes)\n", t + 1, a.tracks[t].size(), b.tracks[t].size());
+      same = false;
+    }
+  }
+  return same;
+}
+
+bool importBytes(const Bytes &file, bool randomChunks) {
+  // ファイルを区切って読み込む（randomChunks なら 1..64 バイトのばらばらの区切り）
+  beginSmfImport();
+  size_t pos = 0;
+  bool ok = true;
+  while (pos < file.size() && ok) {
+    const size_t size = randomChunks ? 1 + nextRandom() % 64 : 64;
+    const size_t n = pos + size <= file.size() ? size : file.size() - pos;
+    ok = pushSmfImport(file.data() + pos, static_cast<uint16_t>(n));
+    pos += n;
+  }
+  return endSmfImport() && ok;
+}
+
+Bytes exportBytes() {
+  Bytes out;
+  const uint32_t expectedSize = beginSmfExport();
+  uint8_t buf[48];
+  uint16_t n;
+  while ((n = readSmfExport(buf, sizeof(buf))) > 0) {
+    out.insert(out.end(), buf, buf + n);
+  }
+  if (out.size() != expectedSize) {
+    fprintf(stderr, "  export size %zu, announced %u\n", out.size(), expectedSize);
+  }
+  return out;
+}
+
+void printImport() {
+  const SmfImportStatus s = smfImportStatus();
+  printf("import %s: type %u, %u MTrk, division %u, %u notes, %u dropped, loop %u ticks, %.2f bpm\n",
+         s.ok ? "ok" : "FAILED", s.format, s.smfTracks, s.division, s.notes, s.dropped, getSequencerLoopTicks(),
+         static_cast<double>(getSequencerTempo()));
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    const PackedSequence &seq = getSequencerTrack(t);
+    printf("  T%u %u ev %u/%u B\n", t + 1, seq.eventCount(), seq.bytesUsed(), seq.capacity());
+  }
+}
+
+bool roundTrip(const Bytes &file) {
+  // 読み込み → 書き出し → 読み込み → 書き出し: シーケンサの内容と書き出したファイルが変わらないこと
+  if (!importBytes(file, true)) {
+    printImport();
+    return false;
+  }
+  const SongSnapshot first = snapshot();
+  const Bytes exported = exportBytes();
+  if (!importBytes(exported, true)) {
+    fprintf(stderr, "  re-import of the exported file failed\n");
+    return false;
+  }
+  const SongSnapshot second = snapshot();
+  const Bytes again = exportBytes();
+  const bool sameState = sameSong(first, second);
+  const bool sameFile = exported == again;
+  printf("roundtrip %s: %zu -> %zu bytes, song %s, file %s\n", sameState && sameFile ? "ok" : "FAILED", file.size(),
+         exported.size(), sameState ? "same" : "DIFFERS", sameFile ? "same" : "DIFFERS");
+  return sameState && sameFile;
+}
+
+bool runTest() {
+  // 生成したファイルを読み込み、トラックの内容を期待値と 1 イベントずつ比べる。分解能を変えて 2 回。
+  bool ok = true;
+  const uint16_t divisions[] = {96, 480};
+  for (uint16_t division : divisions) {
+    std::vector<ExpectedNote> expected;
+    // SEQ_TRACK_COUNT より 1 つ多いトラック: 最後のトラックは捨てられる
+    const Bytes file = generate(SEQ_TRACK_COUNT + 1, 40, division, &expected);
+    if (!importBytes(file, true)) {
+      fprintf(stderr, "division %u: import failed\n", division);
+      ok = false;
+      continue;
+    }
+    printImport();
+    size_t index[SEQ_TRACK_COUNT] = {0};
+    std::vector<ExpectedNote> perTrack[SEQ_TRACK_COUNT];
+    uint32_t droppedExpected = 0;
+    for (const ExpectedNote &e : expected) {
+      if (e.track < SEQ_TRACK_COUNT) {
+        perTrack[e.track].push_back(e);
+      } else {
+        droppedExpected++;
+      }
+    }
+    for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+      for (PackedSequence::Reader r = getSequencerTrack(t).reader(); !r.done(); r.advance()) {
+        const PackedSequence::Event &e = r.event();
+        const size_t i = index[t]++;
+        if (i >= perTrack[t].size() || perTrack[t][i].tick != e.time || perTrack[t][i].note != e.note ||
+            perTrack[t][i].noteOn != e.noteOn) {
+          fprintf(stderr, "division %u: T%u event %zu mismatch\n", division, t + 1, i);
+          ok = false;
+          break;
+        }
+      }
+      if (index[t] != perTrack[t].size()) {
+        fprintf(stderr, "division %u: T%u has %zu events, expected %zu\n", division, t + 1, index[t],
+                perTrack[t].size());
+        ok = false;
+      }
+    }
+    if (smfImportStatus().dropped != droppedExpected || getSequencerTempo() < 119.99f ||
+        getSequencerTempo() > 120.01f) {
+      fprintf(stderr, "division %u: dropped %u (expected %u), bpm %.2f\n", division, smfImportStatus().dropped,
+              droppedExpected, static_cast<double>(getSequencerTempo()));
+      ok = false;
+    }
+    ok = roundTrip(file) && ok;
+  }
+
+  // 壊れたファイル: 途中で切れたファイルは読めたところまで、ヘッダが違えば失敗
+  const Bytes file = generate(2, 10, 480, nullptr);
+  const Bytes truncated(file.begin(), file.begin() + static_cast<long>(file.size() / 2));
+  const bool truncatedOk = importBytes(truncated, false);
+  const uint32_t partialNotes = smfImportStatus().notes;
+  Bytes smpte = file;
+  smpte[12] = 0xE7;  // SMPTE 分解能
+  const bool smpteOk = importBytes(smpte, false);
+  printf("broken: truncated %s (%u notes kept), SMPTE division %s\n", truncatedOk ? "ACCEPTED" : "rejected",
+         partialNotes, smpteOk ? "ACCEPTED" : "rejected");
+  ok = ok && !truncatedOk && partialNotes > 0 && !smpteOk;
+
+  printf("test %s\n", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+void bench(const Bytes &file) {
+  // パースだけの処理速度（SmfReader）と、シーケンサへの読み込みを含めた処理速度
+  uint32_t events = 0;
+  uint32_t rounds = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0.0;
+  do {
+    SmfReader reader;
+    for (size_t pos = 0; pos < file.size(); pos += 64) {
+      const size_t end = pos + 64 < file.size() ? pos + 64 : file.size();
+      for (size_t i = pos; i < end; ++i) {
+        events += reader.push(file[i]) ? 1 : 0;
+      }
+    }
+    if (reader.failed() || !reader.finished()) {
+      fprintf(stderr, "parse failed\n");
+      return;
+    }
+    rounds++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < 0.5);
+  const double bytes = static_cast<double>(file.size()) * rounds;
+  printf("parse   %zu bytes x %u: %.1f MB/s, %.1f M events/s, %.2f ns/byte\n", file.size(), rounds,
+         bytes / seconds / 1e6, events / seconds / 1e6, seconds * 1e9 / bytes);
+
+  const auto importStart = std::chrono::steady_clock::now();
+  importBytes(file, false);
+  const double importSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - importStart).count();
+  printf("import  %.1f MB/s (sequencer keeps %u notes, drops %u)\n", file.size() / importSeconds / 1e6,
+         smfImportStatus().notes, smfImportStatus().dropped);
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: smf_tool gen <out.mid> [tracks] [notes] | bench [in.mid] | import <in.mid> [out.mid] | "
+          "roundtrip <in.mid> | test\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  const std::string command = argv[1];
+  if (command == "test") {
+    return runTest() ? 0 : 1;
+  }
+  if (command == "gen" && argc >= 3) {
+    const uint16_t tracks = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : SEQ_TRACK_COUNT);
+    const uint32_t notes = static_cast<uint32_t>(argc > 4 ? atol(argv[4]) : 50);
+    return writeFile(argv[2], generate(tracks, notes, 480, nullptr)) ? 0 : 1;
+  }
+  if (command == "bench") {
+    Bytes file;
+    if (argc >= 3 ? !readFile(argv[2], file) : (file = generate(16, 40000, 480, nullptr), false)) {
+      fprintf(stderr, "cannot read %s\n", argv[2]);
+      return 1;
+    }
+    bench(file);
+    return 0;
+  }
+  if ((command == "import" || command == "roundtrip") && argc >= 3) {
+    Bytes file;
+    if (!readFile(argv[2], file)) {
+      fprintf(stderr, "cannot read %s\n", argv[2]);
+      return 1;
+    }
+    if (command == "roundtrip") {
+      return roundTrip(file) ? 0 : 1;
+    }
+    const bool ok = importBytes(file, false);
+    printImport();
+    if (argc >= 4 && !writeFile(argv[3], exportBytes())) {
+      fprintf(stderr, "cannot write %s\n", argv[3]);
+      return 1;
+    }
+    return ok ? 0 : 1;
+  }
+  usage();
+  return 2;
+}
@@ -0,0 +1,167 @@
+// store_bench.cpp
+// flash_store.h をフラッシュエミュレータ (flash_emulator.cpp) 上で回す耐久ベンチマーク。
+//
+// 使い方:
+//   store_bench [writes] [seed]
+//
+// パッチ/ソング/トラックに似た大きさのレコードを乱数で書き換え続け、1 ティックあたりの書き込み量と
+// CPU 停止時間、書き込み 1 回にかかるティック数、ページごとの消去回数の偏りを表示します。
+// 途中でときどき電源断（以降の書き込み/消去の失敗）を起こしてからマウントし直し、
+// 各キーが直前に書き終えた内容か書きかけの内容のどちらかで読めることを確かめます（不一致なら終了コード 1）。
+
+#include "flash_store.h"
+
+#include "cycle_counter.h"
+#include "host_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+
+constexpr uint8_t KEYS = 9;
+// storage.cpp と同じ並び: パッチ 4 つ、ソング設定、トラック 4 つ
+constexpr uint16_t MAX_LENGTH[KEYS] = {46, 46, 46, 46, 16, 512, 512, 512, 512};
+constexpr uint32_t MAX_TICKS_PER_WRITE = 20000;
+
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+  rngState = rngState * 1664525u + 1013904223u;
+  return rngState >> 8;
+}
+
+std::vector<uint8_t> committed[KEYS];
+bool hasCommitted[KEYS] = {false};
+std::vector<uint8_t> content[KEYS];
+
+bool serialize(uint8_t key, uint8_t *out, uint16_t capacity, uint16_t *length) {
+  if (key >= KEYS || content[key].size() > capacity) {
+    return false;
+  }
+  memcpy(out, content[key].data(), content[key].size());
+  *length = static_cast<uint16_t>(content[key].size());
+  return true;
+}
+
+bool hasRecord(uint8_t key) {
+  const uint8_t *data = nullptr;
+  uint16_t length = 0;
+  return storeRead(key, &data, &length);
+}
+
+bool readMatches(uint8_t key, const std::vector<uint8_t> &expected) {
+  const uint8_t *data = nullptr;
+  uint16_t length = 0;
+  return storeRead(key, &data, &length) && length == expected.size() && memcmp(data, expected.data(), length) == 0;
+}
+
+struct TickStats {
+  uint32_t ticks = 0;
+  uint32_t worstPrograms = 0;
+  uint64_t worstLoudStall = 0;
+};
+
+bool runUntilIdle(TickStats &stats) {
+  // 書き込みが終わるまでティックを回す。3 割ほどのティックは「音が出ている」扱いで消去させない。
+  for (uint32_t tick = 0; tick < MAX_TICKS_PER_WRITE; ++tick) {
+    if (isFlashStoreIdle()) {
+      return true;
+    }
+    const bool quiet = nextRandom() % 10 >= 3;
+    const host::FlashStats before = host::flashStats();
+    serviceFlashStore(quiet);
+    const host::FlashStats after = host::flashStats();
+    stats.ticks++;
+    if (after.programs - before.programs > stats.worstPrograms) {
+      stats.worstPrograms = after.programs - before.programs;
+    }
+    if (!quiet && after.stallCycles - before.stallCycles > stats.worstLoudStall) {
+      stats.worstLoudStall = after.stallCycles - before.stallCycles;
+    }
+  }
+  return isFlashStoreIdle();
+}
+
+void fillContent(uint8_t key) {
+  content[key].resize(nextRandom() % (MAX_LENGTH[key] + 1));
+  for (uint8_t &b : content[key]) {
+    b = static_cast<uint8_t>(nextRandom());
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t writes = argc > 1 ? static_cast<uint32_t>(atol(argv[1])) : 20000;
+  rngState = argc > 2 ? static_cast<uint32_t>(atol(argv[2])) : 1;
+
+  if (!mountFlashStore(serialize)) {
+    fprintf(stderr, "mount failed\n");
+    return 1;
+  }
+
+  TickStats stats;
+  uint32_t failures = 0;
+  uint32_t powerCuts = 0;
+  uint32_t stuck = 0;
+  for (uint32_t n = 0; n < writes; ++n) {
+    const uint8_t key = static_cast<uint8_t>(nextRandom() % KEYS);
+    fillContent(key);
+    requestStoreWrite(key);
+
+    if (n % 64 == 63) {
+      // 電源断: 数百回以内の操作で止め、マウントし直して読めるものを確かめる
+      powerCuts++;
+      host::cutFlashPowerAfter(nextRandom() % 400);
+      runUntilIdle(stats);
+      host::cutFlashPowerAfter(UINT32_MAX);
+      mountFlashStore(serialize);
+      for (uint8_t k = 0; k < KEYS; ++k) {
+        if (k == key && readMatches(k, content[k])) {
+          committed[k] = content[k];
+          hasCommitted[k] = true;
+        } else if (hasCommitted[k] ? !readMatches(k, committed[k]) : hasRecord(k)) {
+          fprintf(stderr, "write %u: key %u lost after power cut\n", n, k);
+          failures++;
+        }
+      }
+      continue;
+    }
+
+    if (!runUntilIdle(stats)) {
+      stuck++;
+      continue;
+    }
+    if (!readMatches(key, content[key])) {
+      fprintf(stderr, "write %u: key %u read back differs\n", n, key);
+      failures++;
+      continue;
+    }
+    committed[key] = content[key];
+    hasCommitted[key] = true;
+  }
+
+  // 最後にもう一度マウントし直して全キーを確かめる
+  mountFlashStore(serialize);
+  for (uint8_t k = 0; k < KEYS; ++k) {
+    if (hasCommitted[k] && !readMatches(k, committed[k])) {
+      fprintf(stderr, "final: key %u differs\n", k);
+      failures++;
+    }
+  }
+
+  const host::FlashStats flash = host::flashStats();
+  const StoreStatus status = flashStoreStatus();
+  printf("writes %u (power cuts %u), %.1f ticks/write\n", writes, powerCuts,
+         writes ? static_cast<double>(stats.ticks) / writes : 0.0);
+  printf("flash  %u programs, %u erases, page erases %u..%u\n", flash.programs, flash.erases, flash.minPageErases,
+         flash.maxPageErases);
+  printf("tick   worst %u programs (%.2f ms stall), worst stall while sounding %.2f ms\n", stats.worstPrograms,
+         stats.worstPrograms * 52.5e-3, static_cast<double>(stats.worstLoudStall) * 1e3 / CPU_CLOCK_HZ);
+  printf("store  live %u B, errors %u, stuck %u, failures %u\n", status.liveBytes, status.errors, stuck, failures);
+  return failures == 0 && stuck == 0 ? 0 : 1;
+}
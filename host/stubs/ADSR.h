@@ -0,0 +1,120 @@
+#pragma once
+
+// ADSR.h (ホストビルド用スタブ)
+// Mozzi 2 の ADSR と同じ振る舞い（コントロールレートで段階遷移、オーディオレートで
+// 線形補間）を再現します。レベルは 8bit、内部は Q15n16 で補間します。
+
+#include <Arduino.h>
+
+template <unsigned int CONTROL_UPDATE_RATE, unsigned int LERP_RATE, typename T = unsigned int>
+class ADSR {
+public:
+  ADSR() : lerpsPerControl(LERP_RATE / CONTROL_UPDATE_RATE) {
+    attack.phaseType = ATTACK;
+    decay.phaseType = DECAY;
+    sustain.phaseType = SUSTAIN;
+    release.phaseType = RELEASE;
+    idle.phaseType = IDLE;
+    release.level = 0;
+    current = &idle;
+  }
+
+  void update() {
+    switch (current->phaseType) {
+      case ATTACK: checkForAndSetNextPhase(&decay); break;
+      case DECAY: checkForAndSetNextPhase(&sustain); break;
+      case SUSTAIN: checkForAndSetNextPhase(&release); break;
+      case RELEASE: checkForAndSetNextPhase(&idle); break;
+      case IDLE: playingFlag = false; break;
+    }
+  }
+
+  unsigned char next() {
+    if (!playingFlag) {
+      return 0;
+    }
+    if (lerpRemaining > 0) {
+      lerpValue += lerpStep;
+      --lerpRemaining;
+    } else {
+      lerpValue = lerpTarget;
+    }
+    return static_cast<unsigned char>(lerpValue >> 16);
+  }
+
+  void noteOn(bool reset = false) {
+    if (reset) {
+      lerpValue = 0;
+    }
+    setPhase(&attack);
+    playingFlag = true;
+  }
+  void noteOff() { setPhase(&release); }
+
+  void setAttackLevel(uint8_t v) { attack.level = v; }
+  void setDecayLevel(uint8_t v) { decay.level = v; }
+  void setSustainLevel(uint8_t v) { sustain.level = v; }
+  void setReleaseLevel(uint8_t v) { release.level = v; }
+  void setIdleLevel(uint8_t v) { idle.level = v; }
+  void setADLevels(uint8_t a, uint8_t d) {
+    setAttackLevel(a);
+    setDecayLevel(d);
+    setSustainLevel(d);
+    setReleaseLevel(0);
+    setIdleLevel(0);
+  }
+
+  void setAttackTime(unsigned int ms) { setTime(&attack, ms); }
+  void setDecayTime(unsigned int ms) { setTime(&decay, ms); }
+  void setSustainTime(unsigned int ms) { setTime(&sustain, ms); }
+  void setReleaseTime(unsigned int ms) { setTime(&release, ms); }
+  void setIdleTime(unsigned int ms) { setTime(&idle, ms); }
+
+  bool playing() const { return playingFlag; }
+
+private:
+  enum { ATTACK, DECAY, SUSTAIN, RELEASE, IDLE };
+  struct Phase {
+    uint8_t phaseType = IDLE;
+    T updateSteps = 0;
+    int32_t lerpSteps = 0;
+    uint8_t level = 0;
+  };
+
+  void setTime(Phase *p, unsigned int ms) {
+    p->updateSteps = static_cast<T>((static_cast<uint32_t>(ms) * CONTROL_UPDATE_RATE) >> 10);
+    p->lerpSteps = static_cast<int32_t>(p->updateSteps) * lerpsPerControl;
+  }
+
+  void setPhase(Phase *p) {
+    updateCounter = 0;
+    numUpdateSteps = p->updateSteps;
+    lerpTarget = static_cast<int32_t>(p->level) << 16;
+    if (p->lerpSteps > 0) {
+      lerpStep = (lerpTarget - lerpValue) / p->lerpSteps;
+      lerpRemaining = p->lerpSteps;
+    } else {
+      lerpValue = lerpTarget;
+      lerpStep = 0;
+      lerpRemaining = 0;
+    }
+    current = p;
+  }
+
+  void checkForAndSetNextPhase(Phase *p) {
+    if (++updateCounter >= numUpdateSteps) {
+      setPhase(p);
+    }
+  }
+
+  const unsigned int lerpsPerControl;
+  Phase attack, decay, sustain, release, idle;
+  Phase *current;
+  T updateCounter = 0;
+  T numUpdateSteps = 0;
+  int32_t lerpValue = 0;
+  int32_t lerpTarget = 0;
+  int32_t lerpStep = 0;
+  int32_t lerpRemaining = 0;
+  bool playingFlag = false;
+};
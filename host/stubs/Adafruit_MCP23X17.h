@@ -0,0 +1,150 @@
+#pragma once
+
+// Adafruit_MCP23X17.h (ホストビルド用スタブ)
+// 16 本の GPIO を持つエキスパンダを模擬します。入力ピンの電位はホスト側から
+// hostSetInput() で与えます（未設定のピンはプルアップ相当で HIGH）。
+// hostSetMatrixKey() で「出力ピンと入力ピンをつなぐスイッチ」を押すと、その出力が LOW の間だけ
+// 入力が LOW に引かれます（キーマトリクスの模擬）。
+// I2C トランザクション数は実ライブラリに合わせて数えます（digitalWrite は OLAT 読み出し + 書き込みの 2 回）。
+// 割り込みは interrupt-on-change（前回の読み出し値との比較）のみを模擬し、INT がアサートされた瞬間に
+// hostOnInterrupt() で登録したハンドラを呼びます（MCU 側の FALLING 割り込みに相当）。
+// GPIO または INTCAP を読むと INT は解除されます。
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_MCP23X17 {
+public:
+  bool begin_I2C(uint8_t = 0x20, TwoWire * = &Wire) { return true; }
+
+  void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= 16) return;
+    uint16_t mask = static_cast<uint16_t>(1u << pin);
+    if (mode == OUTPUT) {
+      direction &= static_cast<uint16_t>(~mask);
+    } else {
+      direction |= mask;
+    }
+  }
+  uint8_t digitalRead(uint8_t pin) {
+    transactions++;
+    return (readGPIOLevel() >> pin) & 1u;
+  }
+  void digitalWrite(uint8_t pin, uint8_t value) {
+    transactions += 2;
+    uint16_t mask = static_cast<uint16_t>(1u << pin);
+    setLatch(value ? (latch | mask) : (latch & static_cast<uint16_t>(~mask)));
+  }
+
+  uint8_t readGPIOA() {
+    transactions++;
+    return static_cast<uint8_t>(readGPIOLevel());
+  }
+  uint8_t readGPIOB() {
+    transactions++;
+    return static_cast<uint8_t>(readGPIOLevel() >> 8);
+  }
+  uint16_t readGPIOAB() {
+    transactions++;
+    return readGPIOLevel();
+  }
+  void writeGPIOA(uint8_t value) {
+    transactions++;
+    setLatch(static_cast<uint16_t>((latch & 0xFF00u) | value));
+  }
+  void writeGPIOB(uint8_t value) {
+    transactions++;
+    setLatch(static_cast<uint16_t>((latch & 0x00FFu) | (static_cast<uint16_t>(value) << 8)));
+  }
+  void writeGPIOAB(uint16_t value) {
+    transactions++;
+    setLatch(value);
+  }
+
+  void setupInterrupts(bool, bool, uint8_t) { transactions += 4; }
+  void setupInterruptPin(uint8_t pin, uint8_t = CHANGE) {
+    transactions += 4;
+    intEnable |= static_cast<uint16_t>(1u << pin);
+    intReference = readPort();
+  }
+  void disableInterruptPin(uint8_t pin) {
+    transactions += 2;
+    intEnable &= static_cast<uint16_t>(~(1u << pin));
+  }
+  void clearInterrupts() {
+    transactions++;
+    clearInterrupt();
+  }
+  uint16_t getCapturedInterrupt() {
+    transactions++;
+    uint16_t value = intCapture;
+    clearInterrupt();
+    return value;
+  }
+
+  // ---- ホスト専用 ----
+  void hostSetInput(uint8_t pin, uint8_t level) {
+    uint16_t mask = static_cast<uint16_t>(1u << pin);
+    inputs = level ? (inputs | mask) : (inputs & static_cast<uint16_t>(~mask));
+    evaluateInterrupt();
+  }
+  void hostSetMatrixKey(uint8_t outputPin, uint8_t inputPin, bool pressed) {
+    uint16_t mask = static_cast<uint16_t>(1u << inputPin);
+    matrix[outputPin] = pressed ? (matrix[outputPin] | mask) : (matrix[outputPin] & static_cast<uint16_t>(~mask));
+    evaluateInterrupt();
+  }
+  void hostOnInterrupt(void (*handler)()) { interruptHandler = handler; }
+  bool hostInterruptAsserted() const { return intAsserted; }
+  uint16_t hostOutputLatch() const { return latch; }
+  uint32_t hostTransactions() const { return transactions; }
+
+private:
+  void setLatch(uint16_t value) {
+    latch = value;
+    evaluateInterrupt();
+  }
+  uint16_t readGPIOLevel() {
+    uint16_t level = readPort();
+    clearInterrupt();
+    return level;
+  }
+  void clearInterrupt() {
+    intAsserted = false;
+    intReference = readPort();
+  }
+  void evaluateInterrupt() {
+    if (intAsserted) {
+      return;
+    }
+    uint16_t level = readPort();
+    if (((level ^ intReference) & intEnable) != 0) {
+      intAsserted = true;
+      intCapture = level;
+      if (interruptHandler != nullptr) {
+        interruptHandler();
+      }
+    }
+  }
+
+  uint16_t readPort() const {
+    uint16_t level = inputs;
+    for (uint8_t pin = 0; pin < 16; ++pin) {
+      bool drivenLow = (direction & (1u << pin)) == 0 && (latch & (1u << pin)) == 0;
+      if (drivenLow) {
+        level &= static_cast<uint16_t>(~matrix[pin]);
+      }
+    }
+    return (latch & static_cast<uint16_t>(~direction)) | (level & direction);
+  }
+
+  uint16_t direction = 0xFFFF;
+  uint16_t latch = 0;
+  uint16_t inputs = 0xFFFF;
+  uint16_t matrix[16] = {};
+  uint16_t intEnable = 0;
+  uint16_t intReference = 0xFFFF;
+  uint16_t intCapture = 0;
+  bool intAsserted = false;
+  void (*interruptHandler)() = nullptr;
+  uint32_t transactions = 0;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+// Arduino.h (ホストビルド用スタブ)
+// スケッチを Linux 上でコンパイルするための最小限の Arduino API 代替です。
+// 時刻は host_platform.cpp が管理する擬似サンプルクロックから導出されるため、
+// レンダリング結果は実時間に依存せず再現可能です。
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+enum AnalogPin : uint8_t { A0 = 100, A1, A2, A3, A4, A5, A6, A7 };
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+/**
+ * @brief Arduino の Print クラス相当
+ *
+ * write() だけを派生クラスが実装し、print/println は書式化してから write() に流します。
+ */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+
+  size_t print(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int v) { return printFormatted("%d", v); }
+  size_t print(unsigned int v) { return printFormatted("%u", v); }
+  size_t print(long v) { return printFormatted("%ld", v); }
+  size_t print(unsigned long v) { return printFormatted("%lu", v); }
+  size_t print(double v, int digits = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return print(buf);
+  }
+
+  size_t println() { return print("\r\n"); }
+  template <typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  size_t println(double v, int digits) {
+    size_t n = print(v, digits);
+    return n + println();
+  }
+
+private:
+  template <typename T>
+  size_t printFormatted(const char *fmt, T v) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), fmt, v);
+    return print(buf);
+  }
+};
+
+/**
+ * @brief HardwareSerial 相当
+ *
+ * 受信側はホストが pushRx() で注入したバイト列を返し、送信側は標準エラー
+ * (Serial) に書き出すか、送信の観測者 (setTxObserver()) に渡します。
+ */
+class HardwareSerial : public Print {
+public:
+  explicit HardwareSerial(bool echoToStderr) : echo(echoToStderr) {}
+  void begin(unsigned long) {}
+  int available() { return static_cast<int>((rxHead - rxTail) & (RX_SIZE - 1)); }
+  int read() {
+    if (rxHead == rxTail) {
+      return -1;
+    }
+    uint8_t b = rx[rxTail];
+    rxTail = (rxTail + 1) & (RX_SIZE - 1);
+    return b;
+  }
+  int peek() { return rxHead == rxTail ? -1 : rx[rxTail]; }
+  // 送信はすぐに終わるので、送信バッファは常に空いているものとする
+  int availableForWrite() { return 256; }
+  using Print::write;
+  size_t write(uint8_t c) override {
+    if (echo) {
+      fputc(c, stderr);
+    }
+    if (txObserver != nullptr) {
+      txObserver(c);
+    }
+    txCount++;
+    return 1;
+  }
+  operator bool() const { return true; }
+
+  // ---- ホスト専用 ----
+  bool pushRx(uint8_t b) {
+    uint16_t next = (rxHead + 1) & (RX_SIZE - 1);
+    if (next == rxTail) {
+      return false;
+    }
+    rx[rxHead] = b;
+    rxHead = next;
+    return true;
+  }
+  uint32_t transmittedBytes() const { return txCount; }
+  void setTxObserver(void (*observer)(uint8_t)) { txObserver = observer; }
+
+private:
+  static constexpr uint16_t RX_SIZE = 256;
+  uint8_t rx[RX_SIZE] = {};
+  uint16_t rxHead = 0;
+  uint16_t rxTail = 0;
+  uint32_t txCount = 0;
+  void (*txObserver)(uint8_t) = nullptr;
+  bool echo;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
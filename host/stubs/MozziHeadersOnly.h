@@ -0,0 +1,47 @@
+#pragma once
+
+// MozziHeadersOnly.h (ホストビルド用スタブ)
+// Mozzi 2 のうちスケッチが使う定数と AudioOutput のみを提供します。
+
+#include <Arduino.h>
+
+#ifndef MOZZI_AUDIO_RATE
+#define MOZZI_AUDIO_RATE 32768
+#endif
+#ifndef MOZZI_CONTROL_RATE
+#define MOZZI_CONTROL_RATE 64
+#endif
+#ifndef MOZZI_AUDIO_BITS
+#define MOZZI_AUDIO_BITS 16
+#endif
+
+#define AUDIO_RATE MOZZI_AUDIO_RATE
+#define CONTROL_RATE MOZZI_CONTROL_RATE
+
+typedef int32_t AudioOutputStorage_t;
+
+/**
+ * @brief Mozzi の MonoOutput 相当（ホストでは 16bit をそのまま保持）
+ */
+class MonoOutput {
+public:
+  MonoOutput() : value(0) {}
+  explicit MonoOutput(AudioOutputStorage_t v) : value(v) {}
+  static MonoOutput from16Bit(int16_t v) { return fromNBit(16, v); }
+  static MonoOutput from8Bit(int16_t v) { return fromNBit(8, v); }
+  static MonoOutput fromNBit(uint8_t bits, int32_t v) {
+    if (bits > MOZZI_AUDIO_BITS) {
+      return MonoOutput(v >> (bits - MOZZI_AUDIO_BITS));
+    }
+    return MonoOutput(v << (MOZZI_AUDIO_BITS - bits));
+  }
+  AudioOutputStorage_t l() const { return value; }
+  AudioOutputStorage_t r() const { return value; }
+
+private:
+  AudioOutputStorage_t value;
+};
+
+typedef MonoOutput AudioOutput;
+
+uint16_t mozziAnalogRead(uint8_t pin);
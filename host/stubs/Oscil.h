@@ -0,0 +1,35 @@
+#pragma once
+
+// Oscil.h (ホストビルド用スタブ)
+// Mozzi 2 の Oscil と同様、16.16 固定小数点の位相でテーブルを引きます。
+
+#include <MozziHeadersOnly.h>
+
+#ifndef CONSTTABLE_STORAGE
+#define CONSTTABLE_STORAGE(type) const type
+#endif
+
+template <uint16_t NUM_TABLE_CELLS, uint16_t UPDATE_RATE>
+class Oscil {
+public:
+  explicit Oscil(const int8_t *table) : table(table), phaseFractional(0), phaseIncrement(0) {}
+  Oscil() : table(nullptr), phaseFractional(0), phaseIncrement(0) {}
+
+  void setTable(const int8_t *t) { table = t; }
+  void setFreq(int frequency) { phaseIncrement = (static_cast<uint32_t>(frequency) * NUM_TABLE_CELLS << 16) / UPDATE_RATE; }
+  void setFreq(float frequency) {
+    phaseIncrement = static_cast<uint32_t>(frequency * NUM_TABLE_CELLS / UPDATE_RATE * 65536.0f);
+  }
+  void setPhaseInc(uint32_t phaseinc_fractional) { phaseIncrement = phaseinc_fractional; }
+  void setPhase(unsigned int phase) { phaseFractional = static_cast<uint32_t>(phase) << 16; }
+  int8_t next() {
+    int8_t out = table[(phaseFractional >> 16) & (NUM_TABLE_CELLS - 1)];
+    phaseFractional += phaseIncrement;
+    return out;
+  }
+
+private:
+  const int8_t *table;
+  uint32_t phaseFractional;
+  uint32_t phaseIncrement;
+};
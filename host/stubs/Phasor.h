@@ -0,0 +1,25 @@
+#pragma once
+
+// Phasor.h (ホストビルド用スタブ)
+// Mozzi 2 の Phasor と同じく 32bit の位相値を返します。
+
+#include <MozziHeadersOnly.h>
+
+template <unsigned int UPDATE_RATE>
+class Phasor {
+public:
+  Phasor() : current(0), step(0) {}
+  uint32_t next() {
+    current += step;
+    return current;
+  }
+  void set(uint32_t value) { current = value; }
+  void setFreq(int frequency) { step = static_cast<uint32_t>(4294967296.0 / UPDATE_RATE * frequency); }
+  void setFreq(float frequency) { step = static_cast<uint32_t>(4294967296.0 / UPDATE_RATE * frequency); }
+  uint32_t phaseIncFromFreq(int frequency) { return static_cast<uint32_t>(4294967296.0 / UPDATE_RATE * frequency); }
+  void setPhaseInc(uint32_t inc) { step = inc; }
+
+private:
+  uint32_t current;
+  uint32_t step;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+// ResonantFilter.h (ホストビルド用スタブ)
+// Mozzi 2 の ResonantFilter と同じ固定小数点アルゴリズム（2 段のバッファと帰還）を
+// 再現します。cutoff / resonance は su 型（既定 uint8_t: 0..255）で指定します。
+
+#include <MozziHeadersOnly.h>
+
+enum filter_types { LOWPASS, BANDPASS, HIGHPASS, NOTCH };
+
+template <int8_t FILTER_TYPE, typename su = uint8_t>
+class ResonantFilter {
+public:
+  ResonantFilter() : q(0), f(0), fb(0), buf0(0), buf1(0) {}
+
+  void setCutoffFreq(su cutoff) {
+    f = cutoff;
+    fb = q + ucfxmul(q, SHIFTED_1 - cutoff);
+  }
+  void setResonance(su resonance) { q = resonance; }
+  void setCutoffFreqAndResonance(su cutoff, su resonance) {
+    f = cutoff;
+    q = resonance;
+    fb = q + ucfxmul(q, SHIFTED_1 - cutoff);
+  }
+
+  AudioOutputStorage_t next(AudioOutputStorage_t in) {
+    buf0 += fxmul(((in - buf0) + fxmul(fb, buf0 - buf1)), f);
+    buf1 += ifxmul(buf0 - buf1, f);
+    switch (FILTER_TYPE) {
+      case HIGHPASS: return in - buf0;
+      case BANDPASS: return buf0 - buf1;
+      case NOTCH: return in - buf0 + buf1;
+      default: return buf1;
+    }
+  }
+
+private:
+  static constexpr uint8_t FX_SHIFT = sizeof(su) << 3;
+  static constexpr uint32_t SHIFTED_1 = (1UL << FX_SHIFT) - 1;
+
+  static uint32_t ucfxmul(su a, uint32_t b) { return (static_cast<uint32_t>(a) * b) >> FX_SHIFT; }
+  static int32_t ifxmul(int32_t a, su b) { return (a * static_cast<int32_t>(b)) >> FX_SHIFT; }
+  static int64_t fxmul(int64_t a, int64_t b) { return (a * b) >> FX_SHIFT; }
+
+  su q;
+  su f;
+  uint32_t fb;
+  AudioOutputStorage_t buf0;
+  AudioOutputStorage_t buf1;
+};
+
+typedef ResonantFilter<LOWPASS> LowPassFilter;
+typedef ResonantFilter<LOWPASS, uint16_t> LowPassFilter16;
@@ -0,0 +1,74 @@
+#pragma once
+
+// U8g2lib.h (ホストビルド用スタブ)
+// 描画呼び出しは 128x64 のモノクロフレームバッファに反映し、文字列出力は捨てます。
+
+#include <Arduino.h>
+
+struct u8g2_cb_t {};
+extern const u8g2_cb_t u8g2_cb_r0;
+#define U8G2_R0 (&u8g2_cb_r0)
+#define U8X8_PIN_NONE 255
+
+extern const uint8_t u8g2_font_5x8_tr[];
+
+class U8G2_SSD1306_128X64_NONAME_F_HW_I2C : public Print {
+public:
+  static constexpr uint8_t WIDTH = 128;
+  static constexpr uint8_t HEIGHT = 64;
+
+  U8G2_SSD1306_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *, uint8_t) {}
+
+  bool begin() { return true; }
+  void clearBuffer() { memset(frame, 0, sizeof(frame)); }
+  void sendBuffer() { frameCount++; }
+  void setFont(const uint8_t *) {}
+  void setCursor(int x, int y) {
+    cursorX = x;
+    cursorY = y;
+  }
+  void drawPixel(int x, int y) {
+    if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT) {
+      frame[y][x] = 1;
+    }
+  }
+  void drawLine(int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+      drawPixel(x0, y0);
+      if (x0 == x1 && y0 == y1) break;
+      int e2 = 2 * err;
+      if (e2 >= dy) { err += dy; x0 += sx; }
+      if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+  }
+  void drawFrame(int x, int y, int w, int h) {
+    drawLine(x, y, x + w - 1, y);
+    drawLine(x, y + h - 1, x + w - 1, y + h - 1);
+    drawLine(x, y, x, y + h - 1);
+    drawLine(x + w - 1, y, x + w - 1, y + h - 1);
+  }
+  void drawBox(int x, int y, int w, int h) {
+    for (int i = 0; i < h; ++i) {
+      drawLine(x, y + i, x + w - 1, y + i);
+    }
+  }
+
+  using Print::write;
+  size_t write(uint8_t) override {
+    cursorX += 5;
+    return 1;
+  }
+
+  // ---- ホスト専用 ----
+  uint32_t sentFrames() const { return frameCount; }
+  bool pixel(int x, int y) const { return frame[y][x] != 0; }
+
+private:
+  uint8_t frame[HEIGHT][WIDTH] = {};
+  int cursorX = 0;
+  int cursorY = 0;
+  uint32_t frameCount = 0;
+};
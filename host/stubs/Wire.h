@@ -0,0 +1,13 @@
+#pragma once
+
+// Wire.h (ホストビルド用スタブ)
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+  void begin() {}
+  void setClock(uint32_t) {}
+};
+
+extern TwoWire Wire;
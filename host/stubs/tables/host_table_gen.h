@@ -0,0 +1,22 @@
+#pragma once
+
+// ホストビルド用の波形テーブル生成ヘルパ
+// Mozzi 同梱テーブルの代わりに、静的初期化時に 2048 セルの int8 テーブルを計算します。
+
+#include <stdint.h>
+#include <math.h>
+
+#define HOST_WAVETABLE_2048(NAME, EXPR)                                  \
+  static int8_t NAME##_DATA_STORAGE[2048];                               \
+  static const int8_t *const NAME##_DATA = NAME##_DATA_STORAGE;          \
+  namespace {                                                            \
+  struct NAME##_Initializer {                                            \
+    NAME##_Initializer() {                                               \
+      for (int i = 0; i < 2048; ++i) {                                   \
+        double p = i / 2048.0;                                           \
+        double v = (EXPR);                                               \
+        NAME##_DATA_STORAGE[i] = static_cast<int8_t>(lround(v * 127.0)); \
+      }                                                                  \
+    }                                                                    \
+  } NAME##_initializer;                                                  \
+  }
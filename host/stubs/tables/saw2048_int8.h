@@ -0,0 +1,10 @@
+#pragma once
+
+// saw2048_int8.h (ホストビルド用スタブ)
+
+#include "host_table_gen.h"
+
+#define SAW2048_NUM_CELLS 2048
+#define SAW2048_SAMPLERATE 2048
+
+HOST_WAVETABLE_2048(SAW2048, (2.0 * p - 1.0))
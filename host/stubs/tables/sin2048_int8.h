@@ -0,0 +1,10 @@
+#pragma once
+
+// sin2048_int8.h (ホストビルド用スタブ)
+
+#include "host_table_gen.h"
+
+#define SIN2048_NUM_CELLS 2048
+#define SIN2048_SAMPLERATE 2048
+
+HOST_WAVETABLE_2048(SIN2048, sin(2.0 * M_PI * p))
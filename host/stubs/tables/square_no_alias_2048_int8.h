@@ -0,0 +1,10 @@
+#pragma once
+
+// square_no_alias_2048_int8.h (ホストビルド用スタブ)
+
+#include "host_table_gen.h"
+
+#define SQUARE_NO_ALIAS_2048_NUM_CELLS 2048
+#define SQUARE_NO_ALIAS_2048_SAMPLERATE 2048
+
+HOST_WAVETABLE_2048(SQUARE_NO_ALIAS_2048, (p < 0.5 ? 1.0 : -1.0))
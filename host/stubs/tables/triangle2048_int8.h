@@ -0,0 +1,10 @@
+#pragma once
+
+// triangle2048_int8.h (ホストビルド用スタブ)
+
+#include "host_table_gen.h"
+
+#define TRIANGLE2048_NUM_CELLS 2048
+#define TRIANGLE2048_SAMPLERATE 2048
+
+HOST_WAVETABLE_2048(TRIANGLE2048, (p < 0.25 ? 4.0 * p : (p < 0.75 ? 2.0 - 4.0 * p : 4.0 * p - 4.0)))
@@ -0,0 +1,72 @@
+#include "wav_writer.h"
+
+namespace {
+void put16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void put32(uint8_t *p, uint32_t v) {
+  put16(p, static_cast<uint16_t>(v));
+  put16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+}  // namespace
+
+bool WavWriter::open(const char *path, uint32_t rate) {
+  close();
+  file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  sampleRate = rate;
+  frames = 0;
+  writeHeader();
+  return true;
+}
+
+void WavWriter::write(const int16_t *samples, uint32_t count) {
+  if (file == nullptr) {
+    return;
+  }
+  uint8_t buf[512];
+  while (count > 0) {
+    uint32_t chunk = count > sizeof(buf) / 2 ? sizeof(buf) / 2 : count;
+    for (uint32_t i = 0; i < chunk; ++i) {
+      put16(buf + i * 2, static_cast<uint16_t>(samples[i]));
+    }
+    fwrite(buf, 2, chunk, file);
+    samples += chunk;
+    count -= chunk;
+    frames += chunk;
+  }
+}
+
+void WavWriter::close() {
+  if (file == nullptr) {
+    return;
+  }
+  fseek(file, 0, SEEK_SET);
+  writeHeader();
+  fclose(file);
+  file = nullptr;
+}
+
+void WavWriter::writeHeader() {
+  // RIFF/WAVE, fmt (PCM, mono, 16bit), data
+  uint8_t h[44];
+  const uint32_t dataBytes = frames * 2;
+  h[0] = 'R'; h[1] = 'I'; h[2] = 'F'; h[3] = 'F';
+  put32(h + 4, 36 + dataBytes);
+  h[8] = 'W'; h[9] = 'A'; h[10] = 'V'; h[11] = 'E';
+  h[12] = 'f'; h[13] = 'm'; h[14] = 't'; h[15] = ' ';
+  put32(h + 16, 16);
+  put16(h + 20, 1);
+  put16(h + 22, 1);
+  put32(h + 24, sampleRate);
+  put32(h + 28, sampleRate * 2);
+  put16(h + 32, 2);
+  put16(h + 34, 16);
+  h[36] = 'd'; h[37] = 'a'; h[38] = 't'; h[39] = 'a';
+  put32(h + 40, dataBytes);
+  fwrite(h, 1, sizeof(h), file);
+}
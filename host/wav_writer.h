@@ -0,0 +1,39 @@
+#pragma once
+
+// wav_writer.h
+// 16bit PCM モノラルの WAV ファイルを逐次書き出す最小実装。
+// ヘッダのデータ長は close() 時に書き戻します。
+
+#include <stdint.h>
+#include <stdio.h>
+
+class WavWriter {
+public:
+  WavWriter() : file(nullptr), sampleRate(0), frames(0) {}
+  ~WavWriter() { close(); }
+
+  /**
+   * @brief 出力ファイルを開いて仮ヘッダを書く
+   * @return 成功時 true
+   */
+  bool open(const char *path, uint32_t rate);
+
+  /**
+   * @brief サンプルをまとめて追記する
+   */
+  void write(const int16_t *samples, uint32_t count);
+
+  /**
+   * @brief ヘッダを確定させてファイルを閉じる
+   */
+  void close();
+
+  uint32_t frameCount() const { return frames; }
+
+private:
+  void writeHeader();
+
+  FILE *file;
+  uint32_t sampleRate;
+  uint32_t frames;
+};
@@ -1,10 +1,15 @@
 #include "audio_engine.h"
 
+#include "cycle_counter.h"
 #include "hardware_inputs.h"
 #include "midi_input.h"
+#include "profiler.h"
 #include "sequencer.h"
+#include "serial_console.h"
+#include "storage.h"
 #include "synth_state.h"
 #include "visualizer.h"
+#include "voice_manager.h"
 
 #include <Arduino.h>
 #include <math.h>
@@ -12,155 +17,522 @@
 namespace {
 constexpr uint16_t CLICK_LENGTH = (AUDIO_RATE / 400) ? (AUDIO_RATE / 400) : 1;
 volatile uint16_t clickSamplesRemaining = 0;
+// サステインを noteOff まで保持するための時間（ADSR の上限付近、約 63 秒）
+constexpr unsigned int ENVELOPE_HOLD_MS = 65000;
 
-int16_t computeWaveSample() {
-  // 波形選択・ブレンドを行い最終波形サンプルを計算する
-  // 引数: なし
-  // 説明: 4 種類のオシレーター（sin, tri, saw, square/pulse）から現在のモーフ位置に
-  //   基づき2波形を線形補間して出力を決定します。
-  // 戻り値: 16ビット波形サンプル（-32768..32767）
-  // 副作用: なし（オシレーターの next() を呼ぶ副作用はオシレーター内部に限定される）
-  // 既存の単一波形生成ロジックをボイスに適用するため、この関数は使わなくなりました。
-  // 各ボイスごとに同様の処理を audio 更新内で行います。
-  return 0;
-}
+// ブロック単位レンダリング用バッファ（updateAudio() はここから 1 サンプルずつ払い出す）
+int32_t mixBlock[AUDIO_BLOCK_SIZE];
+int16_t voiceBlock[AUDIO_BLOCK_SIZE];
+int16_t outputBlock[AUDIO_BLOCK_SIZE];
+uint8_t outputBlockPos = AUDIO_BLOCK_SIZE;
+// 前回のコントロールティック以降で最も重かった renderBlock() のサイクル数（ボイス数の調整に使う）
+uint32_t renderCyclesPeak = 0;
+
+// オーディオのサンプル時刻。blockStartSample は生成中（または次に生成する）ブロックの先頭、
+// renderPosition はそのブロック内で生成済みのサンプル数。
+uint32_t blockStartSample = 0;
+uint8_t renderPosition = 0;
+
+// シーケンサが先行して積むノートイベント（サンプル時刻順の FIFO、容量は 2 の冪）。
+// 積む側 (updateControl) と取り出す側 (renderBlock) はどちらも audioHook() から呼ばれるので排他は不要。
+struct ScheduledNote {
+  uint32_t sample;
+  uint8_t note;
+  bool noteOn;
+};
+constexpr uint8_t SCHEDULE_CAPACITY = 32;
+ScheduledNote scheduledNotes[SCHEDULE_CAPACITY];
+uint8_t scheduleHead = 0;
+uint8_t scheduleTail = 0;
+ScheduledNoteObserver scheduledNoteObserver = nullptr;
+
+// コントロールレートで計算した変調値をオーディオ側でランプさせるためのブロック数
+constexpr uint8_t BLOCKS_PER_CONTROL_TICK = (AUDIO_RATE / MOZZI_CONTROL_RATE) / AUDIO_BLOCK_SIZE;
+static_assert(BLOCKS_PER_CONTROL_TICK >= 1, "AUDIO_BLOCK_SIZE はコントロール周期以下にしてください");
+
+// ボイスごとの変調ランプ（updateModulation() が目標を置き、advanceVoiceModulation() が 1 ブロックずつ進める）
+struct VoiceModulation {
+  uint32_t phaseInc;       // 位相増分 Q0.32 / sample
+  int32_t phaseIncStep;    // 1 ブロックあたりの増分変化量
+  uint32_t phaseIncTarget;
+  uint16_t cutoff;         // Mozzi フィルタのカットオフ 0..255 を Q8.8 で保持
+  int16_t cutoffStep;
+  uint16_t cutoffTarget;
+  int32_t velocityCutoff;  // ベロシティによるカットオフの加算分（cutoff と同じ Q8.8）
+  int32_t velocityGainQ8;  // ベロシティによる音量 (Q8, 256 = 1.0)
+  uint8_t rampBlocks;      // 目標到達までの残りブロック数
+  uint8_t trigger;         // 最後に見た Voice::trigger（変わったら新しいノート）
+};
+VoiceModulation voiceModulation[POLY_VOICES];
+
+// 全ボイス共通で params から導出する値（コントロールレートで更新）
+struct SharedModulation {
+  uint8_t firstWave;
+  uint8_t secondWave;
+  int32_t blendQ8;
+  uint32_t pulseWidth;     // PULSE のデューティ (Q0.32)
+  uint8_t resonance;
+  int32_t gainQ8;
+  float pitchFactor;       // LFO によるピッチ係数（ブロック途中で発音したボイスの初期値に使う）
+  uint16_t cutoffTarget;
+};
+SharedModulation sharedModulation = {0, 1, 0, 0x80000000u, 0, 179, 1.0f, 0};
+
+// ピッチベンドと CC1。受信した値を目標に、updateModulation() が 1 ティックごとに近づける（Q4 で保持して
+// 端数で止まらないようにする）。
+constexpr int32_t CONTROLLER_FRACTION_BITS = 4;
+int32_t pitchBendTarget = 0;  // -8192..8191
+int32_t pitchBendSmoothed = 0;
+int32_t modWheelTarget = 0;   // 0..127
+int32_t modWheelSmoothed = 0;
+// 平滑化した値 1 あたりの半音 / ピッチ LFO の深さ（半音）/ フィルタ LFO の深さ (Hz)
+constexpr float PITCH_BEND_SEMITONES_PER_STEP = PITCH_BEND_RANGE / (8192.0f * (1 << CONTROLLER_FRACTION_BITS));
+constexpr float MOD_WHEEL_PITCH_PER_STEP = MOD_WHEEL_PITCH_CENTS / (100.0f * 127.0f * (1 << CONTROLLER_FRACTION_BITS));
+constexpr float MOD_WHEEL_FILTER_PER_STEP = MOD_WHEEL_FILTER_HZ / (127.0f * (1 << CONTROLLER_FRACTION_BITS));
+
+// ベロシティの換算（ノートオンごとに 1 回、整数演算のみ）。音量はベロシティの 2 乗のカーブで
+// VELOCITY_GAIN_FLOOR_Q8..256、カットオフは 64 を中心に ±VELOCITY_TO_CUTOFF_HZ / 2。
+constexpr int32_t VELOCITY_GAIN_FLOOR_Q8 = 256 * (100 - VELOCITY_TO_AMP_PERCENT) / 100;
+constexpr int32_t CUTOFF_Q8_PER_VELOCITY_Q16 =
+    static_cast<int32_t>(VELOCITY_TO_CUTOFF_HZ * 65536.0 * 65536.0 / (127.0 * (AUDIO_RATE / 2)));
+
+uint32_t freqToPhaseInc(float freq) {
+  return static_cast<uint32_t>(freq * (4294967296.0f / AUDIO_RATE));
 }
 
-void triggerClick() {
-  // クリック音をトリガーする（UI の再生クリック用）
-  // 引数: なし
-  // 説明: クリック用のサンプル残数をセットし、次回のオーディオ更新でクリックを付加させます。
-  // 戻り値: なし
-  // 副作用: `clickSamplesRemaining` を変更する。
-  clickSamplesRemaining = CLICK_LENGTH;
+uint16_t cutoffToFilterQ8(float cutoffHz) {
+  // Mozzi の ResonantFilter はカットオフ 0..255 で 0..AUDIO_RATE/2 を表す
+  float value = cutoffHz * (256.0f * 256.0f / (AUDIO_RATE / 2));
+  return static_cast<uint16_t>(constrain(value, 0.0f, 255.0f * 256.0f));
 }
 
-AudioOutput updateAudio() {
-  // オーディオフレームの生成
-  // 引数: なし
-  // 説明: 現在の目標周波数へスムーズに追従させ、波形生成、エンベロープ、LFO、フィルタ処理を適用して
-  //   最終的な 16bit サンプルを返します。また、FFT 用のサンプルをバッファへプッシュします。
-  // 戻り値: AudioOutput（モノラル）
-  // 副作用: グローバル状態（currentFreq, oscの位相, envelope, filter など）を進める。
-  // ポリフォニック対応のオーディオ生成
-  int32_t mix = 0;
-  for (uint8_t v = 0; v < POLY_VOICES; ++v) {
-    if (!voiceActive[v]) continue;
+uint16_t addCutoff(uint16_t cutoff, int32_t offset) {
+  return static_cast<uint16_t>(constrain(static_cast<int32_t>(cutoff) + offset, 0, 255 * 256));
+}
 
-    float freqDiff = voiceTargetFreq[v] - voiceCurrentFreq[v];
-    voiceCurrentFreq[v] += freqDiff * 0.02f;
+void applyVelocity(VoiceModulation &mod, uint8_t velocity) {
+  // 新しいノートのベロシティを音量とカットオフの係数にする
+  const int32_t vel = min<int32_t>(velocity, 127);
+  mod.velocityGainQ8 = VELOCITY_GAIN_FLOOR_Q8 + (256 - VELOCITY_GAIN_FLOOR_Q8) * vel * vel / (127 * 127);
+  mod.velocityCutoff = ((vel - 64) * CUTOFF_Q8_PER_VELOCITY_Q16) >> 16;
+}
 
+void setVoicePhaseInc(uint8_t v, uint32_t phaseInc) {
 #if defined(FAST_OSC_USE)
-  fastOscSin[v].setFreq(voiceCurrentFreq[v]);
-  fastOscTri[v].setFreq(voiceCurrentFreq[v]);
-  fastOscSaw[v].setFreq(voiceCurrentFreq[v]);
-  fastOscSquare[v].setFreq(voiceCurrentFreq[v]);
+  voiceOsc[v].setPhaseInc(phaseInc);
 #else
-  oscSin[v].setFreq(voiceCurrentFreq[v]);
-  oscTri[v].setFreq(voiceCurrentFreq[v]);
-  oscSaw[v].setFreq(voiceCurrentFreq[v]);
-  oscSquare[v].setFreq(voiceCurrentFreq[v]);
+  // Oscil は 16bit 小数部 + テーブル index (2048 = 11bit) の位相を使う（ノコギリ/矩形は FastOscFixed）
+  uint32_t oscilInc = phaseInc >> (32 - 16 - 11);
+  oscSin[v].setPhaseInc(oscilInc);
+  oscTri[v].setPhaseInc(oscilInc);
+  oscSaw[v].setPhaseInc(phaseInc);
+  oscSquare[v].setPhaseInc(phaseInc);
+  pulsePhasor[v].setPhaseInc(phaseInc);
 #endif
-  pulsePhasor[v].setFreq(voiceCurrentFreq[v]);
+}
 
-#if defined(FAST_OSC_USE)
-  auto nextFastSample = [](FastOsc<AUDIO_RATE>& osc) -> int16_t {
-    return static_cast<int16_t>(osc.next() * 127.0f);
-  };
-
-  int16_t sinSample = nextFastSample(fastOscSin[v]);
-  int16_t triSample = nextFastSample(fastOscTri[v]);
-  int16_t sawSample = nextFastSample(fastOscSaw[v]);
-  int16_t squareSample = nextFastSample(fastOscSquare[v]);
+void updateModulation() {
+  // コントロールレートの変調ステージ
+  // 引数: なし
+  // 説明: LFO を 1 ステップ進め、params / LFO 値とピッチベンド・CC1 から各ボイスのピッチ係数 (powf) と
+  //   フィルタのカットオフを計算します。ピッチベンドと CC1 はここで 1 ティック分だけ目標へ近づけ、
+  //   CC1 は LFO の深さに足します。カットオフにはボイスごとにベロシティの分を加えます。
+  //   結果は目標値としてボイスごとのランプに渡し、
+  //   オーディオ側は次のコントロール周期の間に線形に追従させます（ジッパーノイズ防止）。
+  //   オーディオパスから超越関数と float → 係数変換を取り除くのが目的です。
+  // 戻り値: なし
+  //   波形モーフ/レゾナンス/ゲインの係数は PARAM_DIRTY_TIMBRE が立っているときだけ計算し直します。
+  // 副作用: lfoPitch / lfoFilter を進め、voiceModulation, sharedModulation, voiceCurrentFreq, paramsDirty を更新する。
+  float lfoPitchValue;
+  float lfoFilterValue;
+#if defined(FAST_OSC_FIXED)
+  lfoPitchValue = static_cast<float>(lfoPitch.next() >> 8);
+  lfoFilterValue = static_cast<float>(lfoFilter.next() >> 8);
+#elif defined(FAST_OSC_USE)
+  lfoPitchValue = lfoPitch.next() * 127.0f;
+  lfoFilterValue = lfoFilter.next() * 127.0f;
 #else
-  int16_t sinSample = oscSin[v].next();
-  int16_t triSample = oscTri[v].next();
-  int16_t sawSample = oscSaw[v].next();
-  int16_t squareSample = oscSquare[v].next();
+  lfoPitchValue = static_cast<float>(lfoPitch.next());
+  lfoFilterValue = static_cast<float>(lfoFilter.next());
 #endif
 
+  pitchBendSmoothed += ((pitchBendTarget << CONTROLLER_FRACTION_BITS) - pitchBendSmoothed) >> CONTROLLER_SMOOTHING_SHIFT;
+  modWheelSmoothed += ((modWheelTarget << CONTROLLER_FRACTION_BITS) - modWheelSmoothed) >> CONTROLLER_SMOOTHING_SHIFT;
+  const float depthPitch = params.lfoDepthPitch + modWheelSmoothed * MOD_WHEEL_PITCH_PER_STEP;
+  const float depthFilter = params.lfoDepthFilter + modWheelSmoothed * MOD_WHEEL_FILTER_PER_STEP;
+
+  float lfoPitchOffset = (lfoPitchValue * depthPitch) / 128.0f + pitchBendSmoothed * PITCH_BEND_SEMITONES_PER_STEP;
+  float pitchFactor = powf(2.0f, lfoPitchOffset / 12.0f);
+  float modulatedCutoff = params.filterCutoff + (lfoFilterValue * depthFilter) / 128.0f;
+  modulatedCutoff = constrain(modulatedCutoff, 40.0f, 5000.0f);
+  uint16_t cutoffTarget = cutoffToFilterQ8(modulatedCutoff * pitchFactor);
+
+  if ((paramsDirty & PARAM_DIRTY_TIMBRE) != 0) {
+    // 波形モーフ/レゾナンス/ゲインの係数は params が変わったときだけ計算し直す
+    paramsDirty &= static_cast<uint8_t>(~PARAM_DIRTY_TIMBRE);
     float morph = constrain(params.waveMorph, 0.0f, 4.0f);
     int region = static_cast<int>(morph);
     float blend = morph - region;
-
     float pulseWidth = 0.5f;
     if (region == 2) {
       pulseWidth = 0.1f + 0.8f * blend;
     } else if (region == 3) {
       pulseWidth = 0.9f - 0.4f * blend;
     }
+    sharedModulation.firstWave = static_cast<uint8_t>(region);
+    sharedModulation.secondWave = static_cast<uint8_t>(min(region + 1, 4));
+    sharedModulation.blendQ8 = static_cast<int32_t>(blend * 256.0f);
+    sharedModulation.pulseWidth = static_cast<uint32_t>(pulseWidth * 4294967295.0f);
+    sharedModulation.resonance = static_cast<uint8_t>(constrain(params.filterResonance, 0.0f, 1.0f) * 255.0f);
+    sharedModulation.gainQ8 = static_cast<int32_t>(params.masterGain * 256.0f);
+  }
+  sharedModulation.pitchFactor = pitchFactor;
+  sharedModulation.cutoffTarget = cutoffTarget;
 
-  uint16_t phase = pulsePhasor[v].next();
-    int16_t pulseSample = (phase < static_cast<uint16_t>(pulseWidth * 65535.0f)) ? 127 : -128;
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    uint8_t v = soundingVoices[i];
+    VoiceModulation &mod = voiceModulation[v];
+    voiceCurrentFreq[v] = voiceTargetFreq[v] * pitchFactor;
+    mod.phaseIncTarget = freqToPhaseInc(voiceCurrentFreq[v]);
+    if (mod.trigger != voices[v].trigger) {
+      // 新たに発音した（または奪われた）ボイスは前のノートからランプさせず、目標値から始める
+      applyVelocity(mod, voices[v].velocity);
+      mod.phaseInc = mod.phaseIncTarget;
+      mod.cutoff = addCutoff(cutoffTarget, mod.velocityCutoff);
+      mod.trigger = voices[v].trigger;
+    }
+    mod.cutoffTarget = addCutoff(cutoffTarget, mod.velocityCutoff);
+    mod.phaseIncStep = (static_cast<int32_t>(mod.phaseIncTarget - mod.phaseInc)) / BLOCKS_PER_CONTROL_TICK;
+    mod.cutoffStep = static_cast<int16_t>((static_cast<int32_t>(mod.cutoffTarget) - mod.cutoff) / BLOCKS_PER_CONTROL_TICK);
+    mod.rampBlocks = BLOCKS_PER_CONTROL_TICK;
+  }
+}
 
-    auto selectWave = [&](int index) -> int16_t {
-      switch (index) {
-        case 0: return sinSample;
-        case 1: return triSample;
-        case 2: return sawSample;
-        case 3: return pulseSample;
-        default: return squareSample;
-      }
-    };
+void advanceVoiceModulation(uint8_t v) {
+  // ボイスの変調ランプを 1 ブロック分進めてオシレータとフィルタへ反映する
+  VoiceModulation &mod = voiceModulation[v];
+  if (mod.rampBlocks > 1) {
+    mod.phaseInc += static_cast<uint32_t>(mod.phaseIncStep);
+    mod.cutoff = static_cast<uint16_t>(mod.cutoff + mod.cutoffStep);
+    mod.rampBlocks--;
+  } else {
+    mod.phaseInc = mod.phaseIncTarget;
+    mod.cutoff = mod.cutoffTarget;
+    mod.rampBlocks = 0;
+  }
+  setVoicePhaseInc(v, mod.phaseInc);
+  filterInstance[v].setCutoffFreqAndResonance(static_cast<uint8_t>(mod.cutoff >> 8), sharedModulation.resonance);
+}
 
-    int16_t first = selectWave(region);
-    int16_t second = selectWave(min(region + 1, 4));
-    int16_t baseSample = first + static_cast<int16_t>((second - first) * blend);
+void primeTriggeredVoices() {
+  // ブロックの途中で発音した（または奪われた）ボイスの変調を目標値から始める
+  // 説明: updateModulation() を待たずに、直前のコントロールティックの LFO 値で周波数と
+  //   カットオフを決め、ベロシティを係数にします。ノートオンごとに 1 回だけなので float 演算でも問題ありません。
+  // 副作用: voiceModulation, voiceCurrentFreq, オシレータ/フィルタの設定を更新する。
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    uint8_t v = soundingVoices[i];
+    VoiceModulation &mod = voiceModulation[v];
+    if (mod.trigger == voices[v].trigger) {
+      continue;
+    }
+    voiceCurrentFreq[v] = voiceTargetFreq[v] * sharedModulation.pitchFactor;
+    mod.phaseIncTarget = freqToPhaseInc(voiceCurrentFreq[v]);
+    mod.phaseInc = mod.phaseIncTarget;
+    applyVelocity(mod, voices[v].velocity);
+    mod.cutoffTarget = addCutoff(sharedModulation.cutoffTarget, mod.velocityCutoff);
+    mod.cutoff = mod.cutoffTarget;
+    mod.rampBlocks = 0;
+    mod.trigger = voices[v].trigger;
+    setVoicePhaseInc(v, mod.phaseInc);
+    filterInstance[v].setCutoffFreqAndResonance(static_cast<uint8_t>(mod.cutoff >> 8), sharedModulation.resonance);
+  }
+}
 
-  int16_t envVal = envelopeInstance[v].next();
-    int16_t amplitude = (baseSample * envVal) >> 8;
+void renderVoiceSegment(uint8_t v, uint8_t offset, uint8_t count) {
+  // 1 ボイス分の区間を生成して mixBlock に加算する
+  // 引数:
+  //   v: ボイス番号
+  //   offset, count: ブロック内の生成区間（ノートイベントの位置でブロックを区切る）
+  // 説明: 内側のループは整数演算のみで回します。ピッチ/カットオフの計算は updateModulation() と
+  //   advanceVoiceModulation() で済んでいます。
+  // 戻り値: なし
+  // 副作用: ボイスのオシレータ位相、エンベロープ、フィルタ状態を count サンプル分進める。
+  const uint8_t firstIndex = sharedModulation.firstWave;
+  const int32_t blendQ8 = sharedModulation.blendQ8;
+  const uint32_t pulseWidth = sharedModulation.pulseWidth;
 
-    float lfoPitchValue;
-    float lfoFilterValue;
+  // 波形生成とモーフ補間（voiceBlock は Q15）
 #if defined(FAST_OSC_USE)
-    lfoPitchValue = lfoPitch.next() * 127.0f;
-    lfoFilterValue = lfoFilter.next() * 127.0f;
+  voiceOsc[v].render(voiceBlock + offset, count, firstIndex, blendQ8, pulseWidth);
 #else
-    lfoPitchValue = static_cast<float>(lfoPitch.next());
-    lfoFilterValue = static_cast<float>(lfoFilter.next());
+  const uint8_t secondIndex = sharedModulation.secondWave;
+  for (uint8_t i = offset; i < offset + count; ++i) {
+    int16_t wave[5];
+    wave[0] = oscSin[v].next();
+    wave[1] = oscTri[v].next();
+    wave[2] = static_cast<int16_t>(oscSaw[v].next() >> 8);
+    wave[4] = static_cast<int16_t>(oscSquare[v].next() >> 8);
+    uint32_t phase = pulsePhasor[v].next();
+    wave[3] = (phase < pulseWidth) ? 127 : -128;
+
+    int32_t first = wave[firstIndex];
+    int32_t second = wave[secondIndex];
+    voiceBlock[i] = static_cast<int16_t>((first << 8) + (((second - first) * blendQ8)));
+  }
 #endif
-    float lfoPitchOffset = (lfoPitchValue * params.lfoDepthPitch) / 128.0f;
-    float pitchFactor = powf(2.0f, lfoPitchOffset / 12.0f);
-    float modulatedCutoff = params.filterCutoff + (lfoFilterValue * params.lfoDepthFilter) / 128.0f;
-    modulatedCutoff = constrain(modulatedCutoff, 40.0f, 5000.0f);
 
-  filterInstance[v].setCutoffFreqAndResonance(modulatedCutoff * pitchFactor, params.filterResonance);
-  int16_t filtered = filterInstance[v].next(amplitude);
+  // ベロシティの音量はマスターゲインに畳み込むので、サンプルごとの演算は増えない
+  const int32_t gainQ8 = (sharedModulation.gainQ8 * voiceModulation[v].velocityGainQ8) >> 8;
 
-    int16_t finalSample = static_cast<int16_t>(filtered * params.masterGain);
+  // エンベロープ・フィルタ・ゲインを掛けてミックスへ加算
+  int32_t envVal = 0;
+  for (uint8_t i = offset; i < offset + count; ++i) {
+    envVal = envelopeInstance[v].next();
+    int16_t amplitude = static_cast<int16_t>((voiceBlock[i] * envVal) >> 16);
+    int32_t filtered = filterInstance[v].next(amplitude);
+    mixBlock[i] += (filtered * gainQ8) >> 8;
+  }
+  voices[v].level = static_cast<uint8_t>(envVal);
+}
 
-    mix += finalSample;
+void dispatchDueNotes() {
+  // 現在のサンプル時刻までに予定されたノートイベントと MIDI 入力のメッセージを発火する
+  const uint32_t now = blockStartSample + renderPosition;
+  while (scheduleTail != scheduleHead) {
+    const ScheduledNote &event = scheduledNotes[scheduleTail];
+    if (static_cast<int32_t>(event.sample - now) > 0) {
+      break;
+    }
+    scheduleTail = (scheduleTail + 1) & (SCHEDULE_CAPACITY - 1);
+    if (scheduledNoteObserver != nullptr) {
+      scheduledNoteObserver(now, event.note, event.noteOn);
+    }
+    playSequencerNote(event.note, event.noteOn);
   }
+  for (const MidiEvent *event = peekMidiEvent(); event != nullptr; event = peekMidiEvent()) {
+    if (static_cast<int32_t>(event->sample - now) > 0) {
+      break;
+    }
+    const MidiMessage message = event->message;
+    popMidiEvent();
+    const bool isNote = message.type == MidiMessage::Type::NoteOn || message.type == MidiMessage::Type::NoteOff;
+    if (isNote && scheduledNoteObserver != nullptr) {
+      scheduledNoteObserver(now, message.data1, message.type == MidiMessage::Type::NoteOn);
+    }
+    playMidiEvent(message);
+  }
+}
 
-  // ミキシング: クリッピングを防ぎつつ 16bit に収める
-  mix = constrain(mix, -32767, 32767);
-  int16_t outSample = static_cast<int16_t>(mix);
+uint8_t nextSegmentEnd() {
+  // 次のノートイベントか MIDI メッセージの位置（ブロック内に無ければ AUDIO_BLOCK_SIZE）
+  int32_t offset = AUDIO_BLOCK_SIZE;
+  if (scheduleTail != scheduleHead) {
+    offset = min(offset, static_cast<int32_t>(scheduledNotes[scheduleTail].sample - blockStartSample));
+  }
+  const MidiEvent *event = peekMidiEvent();
+  if (event != nullptr) {
+    offset = min(offset, static_cast<int32_t>(event->sample - blockStartSample));
+  }
+  return static_cast<uint8_t>(max(offset, static_cast<int32_t>(0)));
+}
 
-  if (clickSamplesRemaining > 0) {
-    float env = static_cast<float>(clickSamplesRemaining) / static_cast<float>(CLICK_LENGTH);
-    int16_t clickValue = static_cast<int16_t>(((clickSamplesRemaining & 1) ? 1 : -1) * env * 6000.0f);
-    outSample = constrain(outSample + clickValue, -32767, 32767);
-    clickSamplesRemaining--;
+void renderBlock() {
+  // AUDIO_BLOCK_SIZE サンプル分のミックスを outputBlock に生成する
+  // 引数: なし
+  // 説明: 発音中ボイスのリスト（リリース中を含む）を順にレンダリングしてミックスし、
+  //   クリップ・クリック付加・FFT バッファへの投入を行います。
+  //   予定されたノートイベントや MIDI 入力のメッセージがブロック内にあれば、その位置でブロックを区切って
+  //   発火させ、ノートオン（とクリック）をちょうどそのサンプルから鳴らします。
+  // 戻り値: なし
+  // 副作用: outputBlock, clickSamplesRemaining, FFT 用波形バッファ, renderCyclesPeak,
+  //   サンプル時刻を更新する。ノートイベントの発火でボイスの状態が変わる。
+  const uint32_t startCycles = cycleCount();
+  for (uint8_t i = 0; i < AUDIO_BLOCK_SIZE; ++i) {
+    mixBlock[i] = 0;
+  }
+
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    advanceVoiceModulation(soundingVoices[i]);
+  }
+
+  renderPosition = 0;
+  while (renderPosition < AUDIO_BLOCK_SIZE) {
+    dispatchDueNotes();
+    primeTriggeredVoices();
+    const uint8_t begin = renderPosition;
+    const uint8_t end = max(static_cast<uint8_t>(begin + 1), nextSegmentEnd());
+
+    for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+      renderVoiceSegment(soundingVoices[i], begin, end - begin);
+    }
+
+    for (uint8_t i = begin; i < end; ++i) {
+      // ミキシング: クリッピングを防ぎつつ 16bit に収める
+      int32_t mix = constrain(mixBlock[i], -32767, 32767);
+      if (clickSamplesRemaining > 0) {
+        int32_t clickValue = (static_cast<int32_t>(clickSamplesRemaining) * 6000) / CLICK_LENGTH;
+        mix += (clickSamplesRemaining & 1) ? clickValue : -clickValue;
+        mix = constrain(mix, -32767, 32767);
+        clickSamplesRemaining--;
+      }
+      outputBlock[i] = static_cast<int16_t>(mix);
+      pushSampleForFFT(outputBlock[i]);
+    }
+    renderPosition = end;
+  }
+  blockStartSample += AUDIO_BLOCK_SIZE;
+  renderPosition = 0;
+
+  const uint32_t elapsed = cycleCount() - startCycles;
+  if (elapsed > renderCyclesPeak) {
+    renderCyclesPeak = elapsed;
+  }
+}
+}
+
+void setupAudioEngine() {
+  // オーディオエンジン初期化
+  // 引数: なし
+  // 説明: 各ボイスのエンベロープ（アタック/サステイン/リリース）と LFO の初期値を設定します。
+  //   サステインは noteOff まで保持したいので、サステイン時間は十分長く取ります。
+  // 戻り値: なし
+  // 副作用: envelopeInstance, lfoPitch, lfoFilter の設定を変更する。サイクルカウンタを有効にする。
+  beginCycleCounter();
+  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
+    uint8_t sustainLevel = static_cast<uint8_t>(params.envSustain * 255.0f);
+    envelopeInstance[i].setADLevels(255, sustainLevel);
+    envelopeInstance[i].setAttackTime(static_cast<unsigned int>(params.envAttack));
+    envelopeInstance[i].setDecayTime(0);
+    envelopeInstance[i].setSustainTime(ENVELOPE_HOLD_MS);
+    envelopeInstance[i].setReleaseTime(static_cast<unsigned int>(params.envRelease));
+  }
+
+  lfoPitch.setFreq(params.lfoRate);
+  lfoFilter.setFreq(params.lfoRate * 0.75f);
+}
+
+uint32_t audioSampleClock() {
+  return blockStartSample + renderPosition;
+}
+
+uint32_t audioOutputClock() {
+  // 返し終えたサンプル数 = 最後に生成したブロックの先頭 + そこから払い出した数
+  return blockStartSample - AUDIO_BLOCK_SIZE + outputBlockPos;
+}
+
+bool scheduleNoteEvent(uint32_t sample, uint8_t note, bool noteOn) {
+  // ノートイベントの予約
+  // 引数:
+  //   sample: 発火させるサンプル時刻（audioSampleClock() と同じ基準、直前の予約より前にしないこと）
+  //   note, noteOn: playSequencerNote() に渡す値
+  // 説明: FIFO の末尾に積みます。renderBlock() がその時刻でブロックを区切って発火させます。
+  //   既に生成済みの時刻を指定した場合は次に生成するサンプルで発火します。
+  // 戻り値: FIFO が満杯なら false
+  // 副作用: scheduledNotes, scheduleHead を更新する。
+  uint8_t next = (scheduleHead + 1) & (SCHEDULE_CAPACITY - 1);
+  if (next == scheduleTail) {
+    return false;
+  }
+  scheduledNotes[scheduleHead] = {sample, note, noteOn};
+  scheduleHead = next;
+  return true;
+}
+
+uint8_t scheduledNoteSpace() {
+  return static_cast<uint8_t>((scheduleTail - scheduleHead - 1) & (SCHEDULE_CAPACITY - 1));
+}
+
+void flushScheduledNotes() {
+  // 予約済みイベントの破棄
+  // 説明: ノートオンは捨て、ノートオフはその場で発火させます（鳴りっぱなしを防ぐ）。
+  // 副作用: scheduledNotes を空にし、ボイスをリリースへ移すことがある。
+  while (scheduleTail != scheduleHead) {
+    const ScheduledNote event = scheduledNotes[scheduleTail];
+    scheduleTail = (scheduleTail + 1) & (SCHEDULE_CAPACITY - 1);
+    if (!event.noteOn) {
+      playSequencerNote(event.note, false);
+    }
   }
+}
+
+void setScheduledNoteObserver(ScheduledNoteObserver observer) {
+  scheduledNoteObserver = observer;
+}
+
+void setPitchBend(int16_t value) {
+  pitchBendTarget = constrain(value, -8192, 8191);
+}
 
-  pushSampleForFFT(outSample);
+void setModWheel(uint8_t value) {
+  modWheelTarget = min<int32_t>(value, 127);
+}
 
-  return MonoOutput::from16Bit(outSample);
+void resetControllers() {
+  pitchBendTarget = 0;
+  modWheelTarget = 0;
+}
+
+void triggerClick() {
+  // クリック音をトリガーする（UI の再生クリック用）
+  // 引数: なし
+  // 説明: クリック用のサンプル残数をセットし、次回のオーディオ更新でクリックを付加させます。
+  // 戻り値: なし
+  // 副作用: `clickSamplesRemaining` を変更する。
+  clickSamplesRemaining = CLICK_LENGTH;
+}
+
+AudioOutput updateAudio() {
+  // オーディオフレームの生成
+  // 引数: なし
+  // 説明: ブロックバッファから 1 サンプルを取り出して返します。バッファが空になったら
+  //   renderBlock() で次の AUDIO_BLOCK_SIZE サンプルをまとめて生成します。
+  // 戻り値: AudioOutput（モノラル）
+  // 副作用: ブロック境界で全ボイスの状態（周波数、オシレータ位相、エンベロープ、フィルタ）を進める。
+  const uint32_t profileStart = profileBegin();
+  if (outputBlockPos >= AUDIO_BLOCK_SIZE) {
+    renderBlock();
+    outputBlockPos = 0;
+  }
+  const int16_t sample = outputBlock[outputBlockPos++];
+  profileEnd(ProfileStage::Audio, profileStart);
+  return MonoOutput::from16Bit(sample);
 }
 
 void updateControl() {
   // コントロールレートごとの更新処理
   // 引数: なし
   // 説明: アナログ入力・キーボード・スイッチ・MIDI・シーケンサなどの入力を処理し、
-  //   表示更新と FFT 計算を順次呼び出します。
+  //   表示更新と FFT 計算を順次呼び出します。主な段ごとのサイクル数を profiler に記録します。
   // 戻り値: なし
   // 副作用: 多数のグローバル状態を更新する（params, sequencer, display, FFT バッファ等）。
+  const uint32_t tickStart = profileBegin();
+  uint32_t stageStart = tickStart;
   readAnalogs();
+  profileEnd(ProfileStage::ReadAnalogs, stageStart);
+  updateVoiceBudget(renderCyclesPeak);
+  renderCyclesPeak = 0;
+  updateVoices();
+  stageStart = profileBegin();
   scanKeyboard();
+  profileEnd(ProfileStage::ScanKeyboard, stageStart);
+  stageStart = profileBegin();
   readSwitches();
+  profileEnd(ProfileStage::ReadSwitches, stageStart);
+  stageStart = profileBegin();
   handleMIDI();
+  profileEnd(ProfileStage::HandleMidi, stageStart);
+  stageStart = profileBegin();
   updateSequencer();
+  profileEnd(ProfileStage::UpdateSequencer, stageStart);
   updateRandomTrigger();
+  updateModulation();
+  stageStart = profileBegin();
   updateDisplay();
+  profileEnd(ProfileStage::UpdateDisplay, stageStart);
+  stageStart = profileBegin();
   computeFFT();
+  profileEnd(ProfileStage::ComputeFft, stageStart);
+  serviceStorage();
+  serviceSerialConsole();
+  profileEnd(ProfileStage::ControlTick, tickStart);
 }
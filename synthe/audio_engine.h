@@ -4,6 +4,13 @@
 
 #include <MozziHeadersOnly.h>
 
+/**
+ * @brief オーディオエンジンの初期化（エンベロープ/LFO の初期値設定）
+ *
+ * setup() とホスト向けオフラインレンダラの双方から呼ばれます。
+ */
+void setupAudioEngine();
+
 /**
  * @brief 次のオーディオフレームを生成して返す（Mozzi 用）
  *
@@ -21,3 +28,61 @@ void updateControl();
  * @brief 再生クリックをトリガーする（UIフィードバック）
  */
 void triggerClick();
+
+/**
+ * @brief オーディオのサンプル時刻を返す
+ *
+ * 次に生成するサンプルの通し番号です（ブロック生成中はその時点の位置）。32bit でラップするので差分で使ってください。
+ */
+uint32_t audioSampleClock();
+
+/**
+ * @brief updateAudio() が返し終えたサンプルの数を返す
+ *
+ * 出力へ向かっているサンプルの位置です。audioSampleClock() より最大 1 ブロック遅れます。
+ * 受信時刻の記録（midi_input.h）に使います。
+ */
+uint32_t audioOutputClock();
+
+/**
+ * @brief ノートイベントを指定のサンプル時刻に発火するよう予約する
+ *
+ * renderBlock() がその位置でブロックを区切り、playSequencerNote() を呼びます。
+ * 時刻順に積んでください（FIFO なので並べ替えはしません）。
+ * @param sample audioSampleClock() と同じ基準の時刻
+ * @return 予約領域が満杯なら false
+ */
+bool scheduleNoteEvent(uint32_t sample, uint8_t note, bool noteOn);
+
+/**
+ * @brief あと何件予約できるかを返す
+ */
+uint8_t scheduledNoteSpace();
+
+/**
+ * @brief 予約済みのノートイベントを破棄する（ノートオフだけはその場で発火させる）
+ */
+void flushScheduledNotes();
+
+/**
+ * @brief 予約イベントと MIDI 入力のノートの発火を観測するコールバック（タイミング検証用、nullptr で解除）
+ */
+typedef void (*ScheduledNoteObserver)(uint32_t sample, uint8_t note, bool noteOn);
+void setScheduledNoteObserver(ScheduledNoteObserver observer);
+
+/**
+ * @brief ピッチベンドの目標値を設定する（-8192..8191、±PITCH_BEND_RANGE 半音）
+ *
+ * 値はコントロールティックごとに平滑化してから全ボイスのピッチとカットオフへ掛かります。
+ */
+void setPitchBend(int16_t value);
+
+/**
+ * @brief モジュレーション (CC1) の目標値を設定する（0..127、ピッチ/フィルタ LFO の深さに加わる）
+ */
+void setModWheel(uint8_t value);
+
+/**
+ * @brief ピッチベンドとモジュレーションを中央/0 へ戻す（リセットオールコントローラ）
+ */
+void resetControllers();
@@ -0,0 +1,68 @@
+#include "capture_ring.h"
+
+namespace {
+constexpr uint8_t SNAPSHOT_RETRIES = 3;
+}
+
+bool CaptureRing::copyValidated(int16_t *dest, uint32_t start, uint16_t count, uint32_t oldestTouched) const {
+  // リングから dest へコピーし、その間に読み出した範囲が上書きされていないか確認する
+  // 引数:
+  //   dest: 出力先
+  //   start: コピー開始位置（通し番号）
+  //   count: サンプル数
+  //   oldestTouched: このスナップショットのために読んだ最も古い位置（トリガ探索を含む）
+  // 説明:
+  //   生産者は位置 head のスロットを書いてから head を進めるため、
+  //   コピー後の head との差が CAPACITY 未満なら読んだスロットはすべて有効です。
+  // 戻り値: 有効なら true
+  // 副作用: dest を書き換える
+  for (uint16_t i = 0; i < count; ++i) {
+    dest[i] = buffer[(start + i) & (CAPACITY - 1)];
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint32_t now = head.load(std::memory_order_relaxed);
+  return now - oldestTouched < CAPACITY;
+}
+
+bool CaptureRing::snapshot(int16_t *dest, uint16_t count) const {
+  for (uint8_t attempt = 0; attempt < SNAPSHOT_RETRIES; ++attempt) {
+    uint32_t end = head.load(std::memory_order_acquire);
+    if (end < count) {
+      return false;
+    }
+    uint32_t start = end - count;
+    if (copyValidated(dest, start, count, start)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CaptureRing::snapshotTriggered(int16_t *dest, uint16_t count, int16_t level, bool *triggered) const {
+  for (uint8_t attempt = 0; attempt < SNAPSHOT_RETRIES; ++attempt) {
+    uint32_t end = head.load(std::memory_order_acquire);
+    if (end < count) {
+      return false;
+    }
+    uint32_t history = end < (CAPACITY - GUARD) ? end : (CAPACITY - GUARD);
+    uint32_t oldest = end - history;
+    uint32_t start = end - count;
+    bool found = false;
+    // 後ろ（新しい側）から探し、最新のトリガ位置を採用する
+    for (uint32_t i = end - count; i > oldest; --i) {
+      if (buffer[(i - 1) & (CAPACITY - 1)] < level && buffer[i & (CAPACITY - 1)] >= level) {
+        start = i;
+        found = true;
+        break;
+      }
+    }
+    uint32_t oldestTouched = found ? start - 1 : oldest;
+    if (copyValidated(dest, start, count, oldestTouched)) {
+      if (triggered != nullptr) {
+        *triggered = found;
+      }
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// capture_ring.h
+// オーディオ経路（生産者）から可視化（消費者）へ波形を渡す単一生産者/単一消費者リング。
+// 生産者は書き込んで位置を進めるだけでブロックせず、消費者は割り込みを禁止せずに
+// 連続した N サンプルのスナップショットを取り出します（seqlock 方式の検証付き）。
+
+#include <stdint.h>
+#include <atomic>
+
+class CaptureRing {
+public:
+  // リング容量（2 の冪）。スナップショット長の 2 倍あれば、コピー中に生産者が追い付くことはまずない。
+  static constexpr uint16_t CAPACITY = 256;
+
+  explicit CaptureRing(uint8_t decimationFactor = 1) { setDecimation(decimationFactor); }
+
+  /**
+   * @brief 間引き率を設定する（生産者側で n サンプルに 1 つだけ記録）
+   *
+   * @param factor 1 以上。1 で間引きなし。
+   */
+  void setDecimation(uint8_t factor) { decimation = factor == 0 ? 1 : factor; }
+
+  /**
+   * @brief サンプルを 1 つ記録する（生産者専用、オーディオ経路から呼ぶ）
+   *
+   * @details 古いサンプルは黙って上書きします。ロックや待ちは一切ありません。
+   */
+  void push(int16_t sample) {
+    if (++decimationCount < decimation) {
+      return;
+    }
+    decimationCount = 0;
+    uint32_t index = head.load(std::memory_order_relaxed);
+    buffer[index & (CAPACITY - 1)] = sample;
+    head.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief 最新の count サンプルを古い順に dest へコピーする（消費者専用）
+   *
+   * @param dest 出力先（count 要素）
+   * @param count CAPACITY / 2 以下
+   * @return 一貫したスナップショットが取れたら true。まだ溜まっていないか、
+   *         コピー中に上書きされ続けた場合は false（dest の内容は不定）。
+   */
+  bool snapshot(int16_t *dest, uint16_t count) const;
+
+  /**
+   * @brief 立ち上がりトリガ位置から count サンプルをコピーする（消費者専用）
+   *
+   * @details 直近の履歴から「前のサンプル < level <= 次のサンプル」となる最新の位置を探し、
+   *          そこから count サンプルを返します。見つからない場合は最新 count サンプル（オートトリガ）。
+   * @param level トリガレベル
+   * @param triggered トリガ位置が見つかったかどうか（nullptr 可）
+   * @return snapshot() と同じ
+   */
+  bool snapshotTriggered(int16_t *dest, uint16_t count, int16_t level, bool *triggered = nullptr) const;
+
+private:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY は 2 の冪である必要があります");
+  // トリガ探索で遡る範囲を CAPACITY から差し引く余裕（探索中に生産者が進める分）
+  static constexpr uint16_t GUARD = 32;
+
+  bool copyValidated(int16_t *dest, uint32_t start, uint16_t count, uint32_t oldestTouched) const;
+
+  int16_t buffer[CAPACITY] = {};
+  std::atomic<uint32_t> head{0};  // これまでに記録した総サンプル数
+  uint8_t decimation = 1;
+  uint8_t decimationCount = 0;
+};
@@ -3,6 +3,156 @@
 #define AUDIO_MODE STANDARD_PLUS
 #define MOZZI_CONTROL_RATE 128
 #define FAST_OSC_USE
+// FAST_OSC_USE 時に整数位相アキュムレータ版 (FastOscFixed) を使う。
+// コメントアウトすると float 版 FastOsc に戻ります。
+#define FAST_OSC_FIXED
+// 三角/ノコギリ/パルス/矩形を PolyBLEP/PolyBLAMP で帯域制限する（高音域の折り返しを低減）。
+#define FAST_OSC_BANDLIMITED
+#if defined(FAST_OSC_FIXED) && !defined(FAST_OSC_USE)
+#undef FAST_OSC_FIXED
+#endif
+
+// updateAudio() がまとめて生成するサンプル数（ブロックレンダリング）。
+// 大きいほどボイスごとの前処理が償却されますが、その分だけ出力遅延が増えます。
+#ifndef AUDIO_BLOCK_SIZE
+#define AUDIO_BLOCK_SIZE 32
+#endif
+
+// 静的に確保するボイス数の上限。同時発音数は実行時に CPU 負荷を測って
+// この範囲内で増減します（voice_manager.cpp の updateVoiceBudget()）。
+#ifndef POLY_VOICES_MAX
+#define POLY_VOICES_MAX 8
+#endif
+
+// シーケンサのイベント格納領域（バイト）。録音バッファ (512B) を除いた残りを全トラックで共有します
+// （トラックごとの上限は無く、マージも領域の中で行う）。1 イベントはティック単位の差分時間 + ノートで
+// 2〜3 バイト（packed_sequence.h、和音は 2 バイト、差分 16383 ティック以内は 3 バイト）なので、
+// 既定値で全体で 850〜1280 イベント入ります。
+#ifndef SEQ_STORE_BYTES
+#define SEQ_STORE_BYTES 3072
+#endif
+
+// シーケンサのトラック数、分解能（四分音符あたりのティック）、初期テンポ、1 小節の拍数
+#ifndef SEQ_TRACK_COUNT
+#define SEQ_TRACK_COUNT 4
+#endif
+#ifndef SEQ_PPQN
+#define SEQ_PPQN 480
+#endif
+#ifndef SEQ_DEFAULT_BPM
+#define SEQ_DEFAULT_BPM 120
+#endif
+#ifndef SEQ_BEATS_PER_BAR
+#define SEQ_BEATS_PER_BAR 4
+#endif
+
+// パッチとシーケンスを保存するフラッシュ領域（flash_store.h）。
+// FLASH_STORE_BASE から FLASH_STORE_PAGES ページを使います。既定は 64KB 品の末尾 8KB で、
+// スケッチがこの領域にかかる場合は起動時に検出して保存を無効にします（128KB 品なら 0x0801E000 などへ移せます）。
+// ページサイズは F103 の中容量品が 1KB、大容量品が 2KB です。
+#ifndef FLASH_STORE_BASE
+#define FLASH_STORE_BASE 0x0800E000UL
+#endif
+#ifndef FLASH_STORE_PAGES
+#define FLASH_STORE_PAGES 8
+#endif
+#ifndef FLASH_STORE_PAGE_SIZE
+#define FLASH_STORE_PAGE_SIZE 1024
+#endif
+// 1 レコードの最大バイト数（書き込み前に RAM へ写す大きさ。シーケンサのイベント列はこの大きさずつに分けて保存する）
+#ifndef FLASH_STORE_RECORD_BYTES
+#define FLASH_STORE_RECORD_BYTES 576
+#endif
+// 1 コントロールティックで書き込むハーフワード数の上限（1 つ約 52us CPU が止まる）
+#ifndef FLASH_STORE_HALFWORDS_PER_TICK
+#define FLASH_STORE_HALFWORDS_PER_TICK 8
+#endif
+// ページ消去の前に MIDI 入力が途切れている時間（ms）。消去中（約 20ms）はフラッシュからの読み出しが止まり、
+// USART1 の受信割り込みも動かないので、その間に届いたバイト（約 60 バイト分）は 1 バイトの受信レジスタで
+// 上書きされて失われます。演奏やクロックが続いている間は消去せず、消去済みページの予備で書き込みを続けます。
+#ifndef FLASH_ERASE_MIDI_IDLE_MS
+#define FLASH_ERASE_MIDI_IDLE_MS 250
+#endif
+
+// MIDI 入力（midi_input.h）。受信バイトのリングバッファと、組み立てたメッセージのキューの大きさ（どちらも 2 の冪）。
+// 31250bps は 1ms に約 3 バイトなので、コントロールティックの間隔（約 7.8ms）に届く分より十分大きくします。
+// フラッシュのページ消去中は受信割り込みも止まり、リングバッファでは取りこぼしを防げません
+// （消去は MIDI 入力が FLASH_ERASE_MIDI_IDLE_MS 途切れてから行う）。
+#ifndef MIDI_INPUT_RING_SIZE
+#define MIDI_INPUT_RING_SIZE 256
+#endif
+#ifndef MIDI_EVENT_QUEUE_SIZE
+#define MIDI_EVENT_QUEUE_SIZE 64
+#endif
+// 受信から発音までの遅延（サンプル）。一定にすることで、コントロールティックの間隔による揺れをなくします。
+// 受信後の最初のコントロールティックで組み立てて間に合うよう、ティック 1 回分 + ブロック 1 つ分が既定です。
+#ifndef MIDI_INPUT_LATENCY_SAMPLES
+#define MIDI_INPUT_LATENCY_SAMPLES (AUDIO_RATE / MOZZI_CONTROL_RATE + AUDIO_BLOCK_SIZE)
+#endif
+
+// ポットの入力（pot_scan.h, pot_filter.h）。
+// POT_ADC_BITS: ADC の分解能（STM32F103 は 12bit。ホストの ADC エミュレータも同じ）
+// POT_OVERSAMPLE_BITS: オーバーサンプリングで増やすビット数（チャンネルごとに 4^n 回の変換を足して n ビット右シフト）
+// POT_MAX_VALUE: オーバーサンプリング後の最大値
+// POT_SMOOTHING_SHIFT: 1 ティックで平滑化した値を目標との差の 1/2^n だけ近づける
+// POT_HYSTERESIS: 確定値を動かす最小の変化（POT_MAX_VALUE の単位）。止まっているポットのノイズより大きくします。
+#ifndef POT_ADC_BITS
+#define POT_ADC_BITS 12
+#endif
+#ifndef POT_OVERSAMPLE_BITS
+#define POT_OVERSAMPLE_BITS 2
+#endif
+#ifndef POT_MAX_VALUE
+#define POT_MAX_VALUE (((1 << POT_ADC_BITS) - 1) << POT_OVERSAMPLE_BITS)
+#endif
+#ifndef POT_SMOOTHING_SHIFT
+#define POT_SMOOTHING_SHIFT 2
+#endif
+#ifndef POT_HYSTERESIS
+#define POT_HYSTERESIS (POT_MAX_VALUE / 512 + 1)
+#endif
+
+// 演奏表現（audio_engine.cpp）。ベロシティはノートオンのときにボイスごとの固定小数点の係数へ換算し、
+// ピッチベンドと CC1（モジュレーション）はコントロールレートで平滑化してから LFO と同じ経路でピッチ/フィルタへ掛けます。
+// MIDI_DEFAULT_VELOCITY: ベロシティを持たない入力（鍵盤、シーケンサの再生、ランダム発音）のベロシティ
+// VELOCITY_TO_AMP_PERCENT: ベロシティ 0 付近で音量を何 % 下げるか（0 でベロシティを音量に使わない）
+// VELOCITY_TO_CUTOFF_HZ: ベロシティ 0 と 127 のカットオフの差（64 を中心に上下する）
+// PITCH_BEND_RANGE: ピッチベンドの幅（±半音）
+// MOD_WHEEL_PITCH_CENTS / MOD_WHEEL_FILTER_HZ: CC1 が最大のときにピッチ/フィルタ LFO の深さへ足す量
+// CONTROLLER_SMOOTHING_SHIFT: ピッチベンドと CC1 を 1 ティックで目標との差の 1/2^n だけ近づける
+#ifndef MIDI_DEFAULT_VELOCITY
+#define MIDI_DEFAULT_VELOCITY 100
+#endif
+#ifndef VELOCITY_TO_AMP_PERCENT
+#define VELOCITY_TO_AMP_PERCENT 75
+#endif
+#ifndef VELOCITY_TO_CUTOFF_HZ
+#define VELOCITY_TO_CUTOFF_HZ 1500
+#endif
+#ifndef PITCH_BEND_RANGE
+#define PITCH_BEND_RANGE 2
+#endif
+#ifndef MOD_WHEEL_PITCH_CENTS
+#define MOD_WHEEL_PITCH_CENTS 50
+#endif
+#ifndef MOD_WHEEL_FILTER_HZ
+#define MOD_WHEEL_FILTER_HZ 800
+#endif
+#ifndef CONTROLLER_SMOOTHING_SHIFT
+#define CONTROLLER_SMOOTHING_SHIFT 2
+#endif
+
+// updateAudio() と updateControl() の各段のサイクル数を記録する（profiler.h）。
+// シリアルの "prof" コマンドと OLED のデバッグページ（HOLD を押しながら SYNC）で確認できます。
+#define PROFILE_CYCLES
+
+// 可視化の波形キャプチャ。
+// VIS_CAPTURE_DECIMATION: n サンプルに 1 つだけ記録する（波形表示の時間幅は n 倍、FFT の帯域は 1/n）。
+// VIS_WAVEFORM_TRIGGERED: 波形表示を立ち上がりゼロクロスに同期させて静止させる。
+#ifndef VIS_CAPTURE_DECIMATION
+#define VIS_CAPTURE_DECIMATION 1
+#endif
+#define VIS_WAVEFORM_TRIGGERED
 
 // ============================================================================
 //  Input hardware selection
@@ -21,6 +171,12 @@
 #error "KEYBOARD_DRIVER_MCP23017 と KEYBOARD_DRIVER_TTP229 は同時に定義できません"
 #endif
 
+#if defined(KEYBOARD_DRIVER_MCP23017)
+// MCP23017 の INTB（行入力の変化割り込み）を MCU のピンへ配線した場合に定義してください。
+// 鍵盤に触れていない間はスキャン（I2C 通信）を止め、割り込みを受けてからスキャンします。
+// #define KEYBOARD_MCP23017_INT_PIN PB12
+#endif
+
 #if defined(KEYBOARD_DRIVER_TTP229)
 // TTP229 のクロック (SCL) とデータ (SDO) のピンは必ず定義してください。
 #ifndef TTP229_SCL_PIN
@@ -38,7 +194,17 @@
 #define TTP229_ACTIVE_STATE LOW
 #endif
 
+// クロックの最小半周期。読み出しは loop() から 1 エッジずつ進めるので、この時間を待つ間もブロックしません。
 #ifndef TTP229_CLOCK_DELAY_US
 #define TTP229_CLOCK_DELAY_US 5
 #endif
+
+// ポーリング時のフレーム間隔（TTP229 はフレーム間に 2ms 以上 SCL を HIGH に保つ必要がある）
+#ifndef TTP229_FRAME_INTERVAL_US
+#define TTP229_FRAME_INTERVAL_US 4000
+#endif
+
+// TTP229 を 2 線式のキー変化割り込み (DV) モードで使う場合に定義してください。
+// キー状態が変化したときだけ SDO に出る DV パルスを割り込みで受け、そのときだけ読み出します。
+// #define TTP229_DV_INTERRUPT
 #endif
@@ -0,0 +1,49 @@
+#pragma once
+
+// cycle_counter.h
+// 処理時間の計測用サイクルカウンタ。
+// 実機 (Cortex-M3) は DWT のサイクルカウンタ CYCCNT を、ホストビルドは実時間を CPU クロック換算した値を返します。
+// 32bit でラップするので、必ず差分（終了 - 開始）で使ってください。
+
+#include "config.h"
+
+#include <Arduino.h>
+#include <MozziHeadersOnly.h>
+
+#if defined(F_CPU)
+#define CPU_CLOCK_HZ F_CPU
+#else
+#define CPU_CLOCK_HZ 72000000UL
+#endif
+
+// 1 オーディオブロックの生成に使える CPU サイクル数
+constexpr uint32_t AUDIO_BLOCK_CYCLES =
+    static_cast<uint32_t>(static_cast<uint64_t>(CPU_CLOCK_HZ) * AUDIO_BLOCK_SIZE / AUDIO_RATE);
+
+#if defined(__arm__)
+namespace cycle_counter_detail {
+// コア依存のヘッダ (CMSIS) に頼らず、Cortex-M3 のレジスタを直接使う
+inline volatile uint32_t &demcr() { return *reinterpret_cast<volatile uint32_t *>(0xE000EDFCu); }
+inline volatile uint32_t &dwtCtrl() { return *reinterpret_cast<volatile uint32_t *>(0xE0001000u); }
+inline volatile uint32_t &dwtCyccnt() { return *reinterpret_cast<volatile uint32_t *>(0xE0001004u); }
+}  // namespace cycle_counter_detail
+
+/**
+ * @brief サイクルカウンタを有効にする（setup() で 1 回呼ぶ）
+ */
+inline void beginCycleCounter() {
+  cycle_counter_detail::demcr() |= (1u << 24);     // TRCENA
+  cycle_counter_detail::dwtCyccnt() = 0;
+  cycle_counter_detail::dwtCtrl() |= 1u;           // CYCCNTENA
+}
+
+/**
+ * @brief 現在のサイクルカウントを返す
+ */
+inline uint32_t cycleCount() {
+  return cycle_counter_detail::dwtCyccnt();
+}
+#else
+void beginCycleCounter();
+uint32_t cycleCount();
+#endif
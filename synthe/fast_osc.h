@@ -267,6 +267,44 @@ static const float SIN_QUARTER[256] = {
 1.0000000000e+00
 };
 
+// Quarter-wave sine table in Q15 for the fixed-point oscillator.
+// 257 entries cover 0..pi/2 inclusive (256 intervals) so that the index is a bit field of the phase.
+static const int16_t SIN_QUARTER_Q15[257] = {
+  0, 201, 402, 603, 804, 1005, 1206, 1407,
+  1608, 1809, 2009, 2210, 2410, 2611, 2811, 3012,
+  3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+  4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195,
+  6393, 6590, 6786, 6983, 7179, 7375, 7571, 7767,
+  7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+  9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849,
+  11039, 11228, 11417, 11605, 11793, 11980, 12167, 12353,
+  12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+  14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269,
+  15446, 15623, 15800, 15976, 16151, 16325, 16499, 16673,
+  16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+  18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357,
+  19519, 19680, 19841, 20000, 20159, 20317, 20475, 20631,
+  20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+  22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027,
+  23170, 23311, 23452, 23592, 23731, 23870, 24007, 24143,
+  24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+  25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198,
+  26319, 26438, 26556, 26674, 26790, 26905, 27019, 27133,
+  27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+  28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803,
+  28898, 28992, 29085, 29177, 29268, 29358, 29447, 29534,
+  29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+  30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783,
+  30852, 30919, 30985, 31050, 31113, 31176, 31237, 31297,
+  31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+  31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098,
+  32137, 32176, 32213, 32250, 32285, 32318, 32351, 32382,
+  32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+  32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717,
+  32728, 32737, 32745, 32752, 32757, 32761, 32765, 32766,
+  32767
+};
+
 template<int RATE>
 class FastPhasor {
 public:
@@ -297,6 +335,8 @@ public:
   FastOsc(Wave w = SINE): wave(w), phase(0.0f), inc(0.0f) {}
   void setWave(Wave w) { wave = w; }
   void setFreq(float freq) { inc = freq / RATE; }
+  // Q0.32 の位相増分から設定する（FastOscFixed と共通の変調パス用）
+  void setPhaseInc(uint32_t phaseInc) { inc = phaseInc * (1.0f / 4294967296.0f); }
   void setPhase(float p) { phase = p - floor(p); }
   // return float in range [-1,1]
   float next() {
@@ -319,6 +359,8 @@ private:
   float phase;
   float inc;
 
+public:
+  // 波形関数は MorphOsc からも共有する
   static float fast_sin(float p) {
     // p in [0,1) -> compute sin(2*pi*p) using quarter-wave table (0..pi/2)
     // Table has N entries for 0..pi/2. Use quadrant symmetry to cover 0..2pi.
@@ -359,3 +401,251 @@ private:
     return 2.0f * p - 1.0f; // linear ramp -1..1
   }
 };
+
+// Fixed-point variant of FastOsc (enable with FAST_OSC_FIXED in config.h).
+// STM32F103 には FPU が無いため、float 版は 1 サンプルごとにソフトウェア浮動小数点の
+// ライブラリ呼び出しが発生します。こちらは 32bit 位相アキュムレータと Q15 の
+// 1/4 周期正弦テーブルのみで波形を生成し、サンプル処理中に浮動小数点演算を行いません。
+//
+// phase: Q0.32 (1 周期 = 2^32)。出力は Q15 (-32768..32767)。
+// 理想波形との誤差（振幅 1.0 = 32767、全位相を走査して確認。host の osc_bench が毎回確かめます）:
+//   SINE     |err| <= 3 LSB (約 9e-5; テーブル丸め + 8bit 補間係数の切り捨て + 反転時の 1/65536 象限ずれ)
+//   TRIANGLE |err| <= 2 LSB
+//   SAW      |err| <= 2 LSB (位相の上位 16bit をそのまま使うので振幅が 32768 相当 + 切り捨て)
+//   SQUARE   誤差なし（±32767）
+// いずれも audio_engine で 8bit 振幅へ落とす際の量子化 (256 LSB) より十分小さい値です。
+// setFreq(float) は周波数変更時のみ float を使います（位相増分への変換 1 回）。
+template<int RATE>
+class FastOscFixed {
+public:
+  // *_BL は PolyBLEP/PolyBLAMP で帯域制限した波形セット（下記 "Band-limited wave set" 参照）
+  enum Wave {SINE, TRIANGLE, SAW, SQUARE, TRIANGLE_BL, SAW_BL, SQUARE_BL, PULSE_BL};
+  FastOscFixed(Wave w = SINE): wave(w), phase(0), inc(0), pulseWidth(0x80000000u) {}
+  void setWave(Wave w) { wave = w; }
+  // PULSE_BL のデューティ (Q0.32)
+  void setPulseWidth(uint32_t width) { pulseWidth = width; }
+  void setFreq(float freq) { inc = static_cast<uint32_t>(freq * (4294967296.0f / RATE)); }
+  // 位相増分を直接設定する（Q0.32 / sample）
+  void setPhaseInc(uint32_t phaseInc) { inc = phaseInc; }
+  void setPhase(uint32_t p) { phase = p; }
+  // return Q15 in range [-32768,32767]
+  int16_t next() {
+    phase += inc;
+    switch (wave) {
+      case SINE:
+        return sin_q15(phase);
+      case TRIANGLE:
+        return triangle_q15(phase);
+      case SAW:
+        return saw_q15(phase);
+      case SQUARE:
+        return (phase < 0x80000000u) ? 32767 : -32767;
+      case TRIANGLE_BL:
+        return triangle_bl_q15(phase, inc);
+      case SAW_BL:
+        return saw_bl_q15(phase, inc);
+      case SQUARE_BL:
+        return pulse_bl_q15(phase, 0x80000000u, inc);
+      case PULSE_BL:
+        return pulse_bl_q15(phase, pulseWidth, inc);
+    }
+    return 0;
+  }
+
+  static int16_t sin_q15(uint32_t p) {
+    // 上位 2bit が象限、続く 16bit が象限内の位置（うち上位 8bit がテーブル index、
+    // 下位 8bit が補間係数）。第 2/4 象限は位置を反転してテーブルを逆向きに引く。
+    uint32_t q = p >> 30;
+    uint32_t pos = (p >> 14) & 0xFFFFu;
+    if (q & 1u) pos = 0xFFFFu - pos;
+    uint32_t idx = pos >> 8;
+    int32_t frac = static_cast<int32_t>(pos & 0xFFu);
+    int32_t a = SIN_QUARTER_Q15[idx];
+    int32_t b = SIN_QUARTER_Q15[idx + 1];
+    int32_t v = a + (((b - a) * frac) >> 8);
+    return static_cast<int16_t>((q & 2u) ? -v : v);
+  }
+  static int16_t triangle_q15(uint32_t p) {
+    // 1/4 周期ずらした位相の中心 (0.5) からの距離で三角波を作る
+    uint32_t x = p + 0x40000000u;
+    uint32_t d = (x >= 0x80000000u) ? x - 0x80000000u : 0x80000000u - x;
+    int32_t v = 32768 - static_cast<int32_t>(d >> 15);
+    return static_cast<int16_t>(v > 32767 ? 32767 : v);
+  }
+  static int16_t saw_q15(uint32_t p) {
+    return static_cast<int16_t>(static_cast<int32_t>(p - 0x80000000u) >> 16);
+  }
+
+  // ---- Band-limited wave set ----
+  // 不連続点（SAW/SQUARE/PULSE）の前後 1 サンプルに 2 次の PolyBLEP 残差を、
+  // 折れ点（TRIANGLE）の前後 1 サンプルに 3 次の PolyBLAMP 残差を加えてエイリアスを抑えます。
+  // dt は位相増分 (Q0.32)。補正は不連続点から dt 以内のサンプルでのみ計算され、除算も
+  // そこでしか発生しないため、平均コストは素朴な波形に比較演算を数個足した程度です。
+  // Mozzi の 2048 エントリ帯域制限テーブル (saw2048 / square_no_alias_2048) の代わりに使えます。
+  // dt < 2^15（約 0.25Hz 未満）では補正を行いません。
+
+  // 不連続点からの距離 d (< dt) を Q15 の 0..1 に正規化する
+  static int32_t blep_position_q15(uint32_t d, uint32_t dt) {
+    uint32_t x = d / (dt >> 15);
+    return static_cast<int32_t>(x > 32768u ? 32768u : x);
+  }
+  // 高さ 2 (-1 -> +1) の立ち上がりステップに対する PolyBLEP 残差 (Q15)
+  //   直後: -(1 - x)^2, 直前: (1 - x)^2   (x は不連続点からの距離 / dt)
+  static int32_t poly_blep_q15(uint32_t t, uint32_t dt) {
+    if ((dt >> 15) == 0) return 0;
+    if (t < dt) {
+      int32_t z = 32768 - blep_position_q15(t, dt);
+      return -((z * z) >> 15);
+    }
+    uint32_t r = 0u - t;
+    if (r <= dt) {
+      int32_t z = 32768 - blep_position_q15(r, dt);
+      return (z * z) >> 15;
+    }
+    return 0;
+  }
+  // 傾きが 1/sample 変化する折れ点に対する PolyBLAMP 残差 (Q15): (1 - |x|)^3 / 6
+  static int32_t poly_blamp_q15(uint32_t t, uint32_t dt) {
+    if ((dt >> 15) == 0) return 0;
+    uint32_t d;
+    if (t < dt) {
+      d = t;
+    } else if ((0u - t) <= dt) {
+      d = 0u - t;
+    } else {
+      return 0;
+    }
+    int32_t z = 32768 - blep_position_q15(d, dt);
+    int32_t z3 = (((z * z) >> 15) * z) >> 15;
+    return z3 / 6;
+  }
+  static int16_t clamp_q15(int32_t v) {
+    return static_cast<int16_t>(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+  }
+  static int16_t saw_bl_q15(uint32_t p, uint32_t dt) {
+    // 周期の頭で +1 -> -1 に落ちるので立ち上がり残差を引く
+    return clamp_q15(saw_q15(p) - poly_blep_q15(p, dt));
+  }
+  static int16_t pulse_bl_q15(uint32_t p, uint32_t width, uint32_t dt) {
+    // 周期の頭で立ち上がり、width で立ち下がる
+    int32_t naive = (p < width) ? 32767 : -32767;
+    return clamp_q15(naive + poly_blep_q15(p, dt) - poly_blep_q15(p - width, dt));
+  }
+  static int16_t triangle_bl_q15(uint32_t p, uint32_t dt) {
+    // 折れ点は 1/4 周期（頂点: 傾き -8/周期）と 3/4 周期（谷: +8/周期）。
+    // 1 サンプルあたりの傾き変化は 8 * dt (Q15 では dt >> 14)。
+    int64_t slope = static_cast<int64_t>(dt >> 14);
+    int32_t peak = poly_blamp_q15(p - 0x40000000u, dt);
+    int32_t trough = poly_blamp_q15(p - 0xC0000000u, dt);
+    int32_t correction = static_cast<int32_t>((slope * (trough - peak)) >> 15);
+    return clamp_q15(triangle_q15(p) + correction);
+  }
+
+private:
+  Wave wave;
+  uint32_t phase;
+  uint32_t inc;
+  uint32_t pulseWidth;
+};
+
+// Morphing oscillator: one shared phase per voice, evaluates only the two shapes
+// of the active morph region.
+// モーフ位置 (0..4) の整数部が領域、小数部がブレンド量です:
+//   0: SINE -> TRIANGLE, 1: TRIANGLE -> SAW, 2: SAW -> PULSE, 3: PULSE -> SQUARE, 4: SQUARE
+// 4 本のオシレータと位相器を並走させていた従来方式と違い、位相は 1 本なので領域を
+// またいでも波形の位相が揃ったまま切り替わります。領域の分岐は render() の入口で一度だけ行い、
+// サンプルループは 2 波形の評価と補間のみになります。
+// 出力は Q15。FAST_OSC_FIXED 時は整数演算のみ、それ以外は FastOsc の float 波形関数を使います。
+// FAST_OSC_BANDLIMITED 時は TRIANGLE/SAW/PULSE/SQUARE を FastOscFixed の帯域制限版で評価します。
+template<int RATE>
+class MorphOsc {
+public:
+  enum Shape {SINE, TRIANGLE, SAW, PULSE, SQUARE};
+  MorphOsc(): phase(0), inc(0) {}
+  void setFreq(float freq) { inc = static_cast<uint32_t>(freq * (4294967296.0f / RATE)); }
+  void setPhaseInc(uint32_t phaseInc) { inc = phaseInc; }
+  void setPhase(uint32_t p) { phase = p; }
+
+  // count サンプルを out に書き出す。
+  //   region: 0..4, blendQ8: 0..256, pulseWidth: PULSE のデューティ (Q0.32)
+  void render(int16_t *out, uint8_t count, uint8_t region, int32_t blendQ8, uint32_t pulseWidth) {
+    if (blendQ8 <= 0 || region >= 4) {
+      switch (region) {
+        case 0: renderSingle<SINE>(out, count, pulseWidth); break;
+        case 1: renderSingle<TRIANGLE>(out, count, pulseWidth); break;
+        case 2: renderSingle<SAW>(out, count, pulseWidth); break;
+        case 3: renderSingle<PULSE>(out, count, pulseWidth); break;
+        default: renderSingle<SQUARE>(out, count, pulseWidth); break;
+      }
+      return;
+    }
+    switch (region) {
+      case 0: renderPair<SINE, TRIANGLE>(out, count, blendQ8, pulseWidth); break;
+      case 1: renderPair<TRIANGLE, SAW>(out, count, blendQ8, pulseWidth); break;
+      case 2: renderPair<SAW, PULSE>(out, count, blendQ8, pulseWidth); break;
+      default: renderPair<PULSE, SQUARE>(out, count, blendQ8, pulseWidth); break;
+    }
+  }
+
+private:
+  uint32_t phase;
+  uint32_t inc;
+
+  template<Shape S>
+  static int16_t shape(uint32_t p, uint32_t pulseWidth, uint32_t dt) {
+#if defined(FAST_OSC_BANDLIMITED)
+    switch (S) {
+      case TRIANGLE: return FastOscFixed<RATE>::triangle_bl_q15(p, dt);
+      case SAW: return FastOscFixed<RATE>::saw_bl_q15(p, dt);
+      case PULSE: return FastOscFixed<RATE>::pulse_bl_q15(p, pulseWidth, dt);
+      case SQUARE: return FastOscFixed<RATE>::pulse_bl_q15(p, 0x80000000u, dt);
+      default: break;
+    }
+#else
+    (void)dt;
+#endif
+    switch (S) {
+      case SINE:
+#if defined(FAST_OSC_FIXED)
+        return FastOscFixed<RATE>::sin_q15(p);
+#else
+        return static_cast<int16_t>(FastOsc<RATE>::fast_sin(p * (1.0f / 4294967296.0f)) * 32767.0f);
+#endif
+      case TRIANGLE:
+#if defined(FAST_OSC_FIXED)
+        return FastOscFixed<RATE>::triangle_q15(p);
+#else
+        return static_cast<int16_t>(FastOsc<RATE>::fast_triangle(p * (1.0f / 4294967296.0f)) * 32767.0f);
+#endif
+      case SAW:
+        return static_cast<int16_t>(static_cast<int32_t>(p - 0x80000000u) >> 16);
+      case PULSE:
+        return (p < pulseWidth) ? 32767 : -32767;
+      case SQUARE:
+        return (p < 0x80000000u) ? 32767 : -32767;
+    }
+    return 0;
+  }
+
+  template<Shape S>
+  void renderSingle(int16_t *out, uint8_t count, uint32_t pulseWidth) {
+    uint32_t p = phase;
+    for (uint8_t i = 0; i < count; ++i) {
+      p += inc;
+      out[i] = shape<S>(p, pulseWidth, inc);
+    }
+    phase = p;
+  }
+
+  template<Shape A, Shape B>
+  void renderPair(int16_t *out, uint8_t count, int32_t blendQ8, uint32_t pulseWidth) {
+    uint32_t p = phase;
+    for (uint8_t i = 0; i < count; ++i) {
+      p += inc;
+      int32_t a = shape<A>(p, pulseWidth, inc);
+      int32_t b = shape<B>(p, pulseWidth, inc);
+      out[i] = static_cast<int16_t>(a + (((b - a) * blendQ8) >> 8));
+    }
+    phase = p;
+  }
+};
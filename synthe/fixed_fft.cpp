@@ -0,0 +1,140 @@
+#include "fixed_fft.h"
+
+namespace {
+constexpr uint16_t HALF = FIXED_FFT_BINS;
+constexpr uint8_t HALF_BITS = 6;
+static_assert((1u << HALF_BITS) == HALF, "FIXED_FFT_BINS は 2^HALF_BITS である必要があります");
+static_assert(FIXED_FFT_BUTTERFLIES == (HALF / 2) * HALF_BITS, "バタフライ数が段数と一致しません");
+
+// cos(2*pi*k/128), sin(2*pi*k/128) (k = 0..63) の Q15 表
+const int16_t TWIDDLE_COS[HALF] = {
+  32767, 32729, 32610, 32413, 32138, 31786, 31357, 30853,
+  30274, 29622, 28899, 28106, 27246, 26320, 25330, 24279,
+  23170, 22006, 20788, 19520, 18205, 16846, 15447, 14010,
+  12540, 11039, 9512, 7962, 6393, 4808, 3212, 1608,
+  0, -1608, -3212, -4808, -6393, -7962, -9512, -11039,
+  -12540, -14010, -15447, -16846, -18205, -19520, -20788, -22006,
+  -23170, -24279, -25330, -26320, -27246, -28106, -28899, -29622,
+  -30274, -30853, -31357, -31786, -32138, -32413, -32610, -32729
+};
+const int16_t TWIDDLE_SIN[HALF] = {
+  0, 1608, 3212, 4808, 6393, 7962, 9512, 11039,
+  12540, 14010, 15447, 16846, 18205, 19520, 20788, 22006,
+  23170, 24279, 25330, 26320, 27246, 28106, 28899, 29622,
+  30274, 30853, 31357, 31786, 32138, 32413, 32610, 32729,
+  32767, 32729, 32610, 32413, 32138, 31786, 31357, 30853,
+  30274, 29622, 28899, 28106, 27246, 26320, 25330, 24279,
+  23170, 22006, 20788, 19520, 18205, 16846, 15447, 14010,
+  12540, 11039, 9512, 7962, 6393, 4808, 3212, 1608
+};
+// Hamming 窓 0.54 - 0.46 cos(2*pi*n/(N-1)) の前半 (n = 0..63)。後半は対称。
+const int16_t HAMMING_Q15[HALF] = {
+  2621, 2640, 2695, 2787, 2916, 3080, 3281, 3516,
+  3787, 4091, 4429, 4799, 5201, 5633, 6095, 6585,
+  7102, 7646, 8214, 8805, 9418, 10051, 10703, 11371,
+  12056, 12754, 13464, 14185, 14914, 15650, 16391, 17136,
+  17881, 18626, 19369, 20108, 20841, 21566, 22282, 22986,
+  23678, 24354, 25015, 25658, 26281, 26883, 27463, 28019,
+  28549, 29053, 29529, 29976, 30393, 30780, 31134, 31455,
+  31742, 31995, 32213, 32396, 32543, 32653, 32727, 32763
+};
+
+int32_t mulQ15(int32_t a, int32_t b) {
+  return static_cast<int32_t>((static_cast<int64_t>(a) * b + (1 << 14)) >> 15);
+}
+
+uint16_t bitReverse(uint16_t v) {
+  uint16_t r = 0;
+  for (uint8_t i = 0; i < HALF_BITS; ++i) {
+    r = static_cast<uint16_t>((r << 1) | (v & 1u));
+    v >>= 1;
+  }
+  return r;
+}
+
+int32_t windowed(const int16_t *ring, uint16_t start, uint16_t n) {
+  uint16_t w = n < HALF ? n : static_cast<uint16_t>(FIXED_FFT_SIZE - 1 - n);
+  int16_t sample = ring[(start + n) & (FIXED_FFT_SIZE - 1)];
+  return (static_cast<int32_t>(sample) * HAMMING_Q15[w] + (1 << 14)) >> 15;
+}
+
+uint32_t approxMagnitude(int32_t re, int32_t im) {
+  uint32_t a = static_cast<uint32_t>(re < 0 ? -re : re);
+  uint32_t b = static_cast<uint32_t>(im < 0 ? -im : im);
+  uint32_t hi = a > b ? a : b;
+  uint32_t lo = a > b ? b : a;
+  return ((hi * 15u) >> 4) + ((lo * 15u) >> 5);
+}
+void butterfly(FixedFftComplex *work, uint16_t index) {
+  // 時間間引き (DIT) 基数 2。index = 段 * 32 + 段内の番号。
+  // 64 点の回転因子 W64^m は 128 点表の 2m 番目を使う。
+  constexpr uint16_t PER_STAGE = HALF / 2;
+  uint8_t stage = static_cast<uint8_t>(index / PER_STAGE);
+  uint16_t j = index % PER_STAGE;
+  uint16_t half = static_cast<uint16_t>(1u << stage);
+  uint16_t k = j & (half - 1);
+  uint16_t base = static_cast<uint16_t>((j >> stage) << (stage + 1));
+  uint16_t twiddle = static_cast<uint16_t>(k << (HALF_BITS - stage));
+  int32_t c = TWIDDLE_COS[twiddle];
+  int32_t s = TWIDDLE_SIN[twiddle];
+  FixedFftComplex &a = work[base + k];
+  FixedFftComplex &b = work[base + k + half];
+  // t = b * (c - js)
+  int32_t tr = mulQ15(b.re, c) + mulQ15(b.im, s);
+  int32_t ti = mulQ15(b.im, c) - mulQ15(b.re, s);
+  b.re = a.re - tr;
+  b.im = a.im - ti;
+  a.re += tr;
+  a.im += ti;
+}
+
+uint32_t splitBin(const FixedFftComplex *work, uint16_t k) {
+  // Z[k] から偶数列 Fe と奇数列 Fo を取り出し X[k] = Fe[k] + W128^k Fo[k] を求める
+  const FixedFftComplex &a = work[k];
+  const FixedFftComplex &b = work[(HALF - k) & (HALF - 1)];
+  int32_t feRe = (a.re + b.re) >> 1;
+  int32_t feIm = (a.im - b.im) >> 1;
+  int32_t foRe = (a.im + b.im) >> 1;
+  int32_t foIm = (b.re - a.re) >> 1;
+  int32_t c = TWIDDLE_COS[k];
+  int32_t s = TWIDDLE_SIN[k];
+  int32_t re = feRe + mulQ15(foRe, c) + mulQ15(foIm, s);
+  int32_t im = feIm + mulQ15(foIm, c) - mulQ15(foRe, s);
+  return approxMagnitude(re, im);
+}
+}  // namespace
+
+void fixedFftLoad(const int16_t *ring, uint16_t start, FixedFftComplex *work) {
+  static_assert((FIXED_FFT_SIZE & (FIXED_FFT_SIZE - 1)) == 0, "FIXED_FFT_SIZE は 2 の冪");
+  for (uint16_t i = 0; i < HALF; ++i) {
+    FixedFftComplex &dst = work[bitReverse(i)];
+    dst.re = windowed(ring, start, static_cast<uint16_t>(2 * i));
+    dst.im = windowed(ring, start, static_cast<uint16_t>(2 * i + 1));
+  }
+}
+
+void fixedFftTransform(FixedFftComplex *work) {
+  uint16_t cursor = 0;
+  while (cursor < FIXED_FFT_BUTTERFLIES) {
+    butterfly(work, cursor++);
+  }
+}
+
+void fixedFftMagnitude(const FixedFftComplex *work, uint32_t *magnitude) {
+  for (uint16_t k = 0; k < HALF; ++k) {
+    magnitude[k] = splitBin(work, k);
+  }
+}
+
+bool fixedFftResume(FixedFftComplex *work, uint32_t *magnitude, uint16_t &cursor, uint16_t budget) {
+  while (budget-- > 0 && cursor < FIXED_FFT_STEPS) {
+    if (cursor < FIXED_FFT_BUTTERFLIES) {
+      butterfly(work, cursor);
+    } else {
+      uint16_t k = cursor - FIXED_FFT_BUTTERFLIES;
+      magnitude[k] = splitBin(work, k);
+    }
+    ++cursor;
+  }
+  return cursor >= FIXED_FFT_STEPS;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// fixed_fft.h
+// 可視化用の固定小数点 実数入力 FFT（128 点）。
+// 128 点の実数列を 64 点の複素列に詰めて基数 2 の FFT を行い、最後に実数 FFT へ分離します。
+// 窓関数 (Hamming) と回転因子は Q15 の定数テーブル、データは int32、振幅は
+// alpha-max-plus-beta-min (alpha = 15/16, beta = 15/32, 最大誤差 約 6%) で近似します。
+// 出力振幅は正規化しない DFT と同じスケール（arduinoFFT の complexToMagnitude() 相当）です。
+
+constexpr uint16_t FIXED_FFT_SIZE = 128;
+constexpr uint16_t FIXED_FFT_BINS = FIXED_FFT_SIZE / 2;
+// 64 点複素 FFT のバタフライ総数（6 段 x 32）と、実数分離を含めた総演算数
+constexpr uint16_t FIXED_FFT_BUTTERFLIES = (FIXED_FFT_BINS / 2) * 6;
+constexpr uint16_t FIXED_FFT_STEPS = FIXED_FFT_BUTTERFLIES + FIXED_FFT_BINS;
+
+struct FixedFftComplex {
+  int32_t re;
+  int32_t im;
+};
+
+/**
+ * @brief 環状バッファから窓関数を掛けて FFT 作業領域へ読み込む
+ *
+ * @param ring FIXED_FFT_SIZE サンプルの環状バッファ
+ * @param start 最も古いサンプルの位置
+ * @param work FIXED_FFT_BINS 要素の作業領域（偶数/奇数サンプルを実部/虚部に詰め、ビット反転順に並べる）
+ */
+void fixedFftLoad(const int16_t *ring, uint16_t start, FixedFftComplex *work);
+
+/**
+ * @brief 64 点複素 FFT のバタフライ演算を全段実行する
+ */
+void fixedFftTransform(FixedFftComplex *work);
+
+/**
+ * @brief 実数 FFT へ分離し、各ビンの振幅を求める
+ *
+ * @param work fixedFftTransform() 済みの作業領域
+ * @param magnitude FIXED_FFT_BINS 要素の出力（ビン 0..63 の振幅）
+ */
+void fixedFftMagnitude(const FixedFftComplex *work, uint32_t *magnitude);
+
+/**
+ * @brief FFT を途中から再開し、最大 budget 演算だけ進める
+ *
+ * fixedFftLoad() の後に cursor = 0 から呼び始め、true が返るまで繰り返し呼びます。
+ * 1 演算はバタフライ 1 回または実数分離 1 ビンで、全体で FIXED_FFT_STEPS 演算です。
+ *
+ * @param work fixedFftLoad() 済みの作業領域
+ * @param magnitude FIXED_FFT_BINS 要素の出力。完了するまで途中の値が混在します。
+ * @param cursor 進捗（呼び出し側が保持）
+ * @param budget この呼び出しで実行する最大演算数
+ * @return すべて完了したら true
+ */
+bool fixedFftResume(FixedFftComplex *work, uint32_t *magnitude, uint16_t &cursor, uint16_t budget);
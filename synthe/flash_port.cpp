@@ -0,0 +1,52 @@
+#include "flash_port.h"
+
+#if defined(ARDUINO_ARCH_STM32)
+#include <Arduino.h>
+
+// リンカスクリプトが定義する初期値付きデータの位置（フラッシュ上のイメージ末尾の計算に使う）
+extern "C" uint32_t _sidata;
+extern "C" uint32_t _sdata;
+extern "C" uint32_t _edata;
+
+namespace {
+uint32_t pageAddress(uint8_t page) {
+  return FLASH_STORE_BASE + static_cast<uint32_t>(page) * FLASH_STORE_PAGE_SIZE;
+}
+}  // namespace
+
+bool flashPortBegin() {
+  // 領域の確認
+  // 引数: なし
+  // 説明: スケッチのイメージ末尾（コード + 初期値付きデータ）が領域より前にあり、
+  //   領域がチップのフラッシュ容量（FLASHSIZE_BASE の KB 値）に収まるかを確かめます。
+  // 戻り値: 使えるなら true
+  // 副作用: なし
+  const uint32_t imageEnd = reinterpret_cast<uint32_t>(&_sidata) +
+                            (reinterpret_cast<uint32_t>(&_edata) - reinterpret_cast<uint32_t>(&_sdata));
+  const uint32_t flashEnd = FLASH_BASE + (static_cast<uint32_t>(*reinterpret_cast<const uint16_t *>(FLASHSIZE_BASE)) << 10);
+  return imageEnd <= FLASH_STORE_BASE && pageAddress(FLASH_STORE_PAGES) <= flashEnd;
+}
+
+const uint8_t *flashPageData(uint8_t page) {
+  return reinterpret_cast<const uint8_t *>(pageAddress(page));
+}
+
+bool flashErasePage(uint8_t page) {
+  FLASH_EraseInitTypeDef erase = {};
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.PageAddress = pageAddress(page);
+  erase.NbPages = 1;
+  uint32_t pageError = 0;
+  HAL_FLASH_Unlock();
+  const HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &pageError);
+  HAL_FLASH_Lock();
+  return status == HAL_OK;
+}
+
+bool flashProgramHalfword(uint8_t page, uint16_t offset, uint16_t value) {
+  HAL_FLASH_Unlock();
+  const HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, pageAddress(page) + offset, value);
+  HAL_FLASH_Lock();
+  return status == HAL_OK;
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+// flash_port.h
+// flash_store が使うフラッシュ操作。領域は config.h の FLASH_STORE_PAGES 個のページで、
+// ページ番号 (0..FLASH_STORE_PAGES-1) とページ内オフセットで指定します。
+// 実機は STM32F1 の HAL で実装し（flash_port.cpp）、ホストはファイルに保存するエミュレータ
+// （host/flash_emulator.cpp）が同じ関数を実装します。
+// F103 はフラッシュが 1 バンクなので、消去/書き込み中は CPU の命令フェッチも止まります
+// （ハーフワード書き込み約 52us、ページ消去約 20ms）。
+
+#include "config.h"
+
+#include <stdint.h>
+
+/**
+ * @brief 領域を使えるか確認する
+ * @return 使えるなら true（実機はスケッチ本体と重なっていないか、フラッシュ容量に収まるかを確認）
+ */
+bool flashPortBegin();
+
+/**
+ * @brief ページの内容を返す（メモリマップされた読み出し）
+ */
+const uint8_t *flashPageData(uint8_t page);
+
+/**
+ * @brief ページを消去する（全バイト 0xFF）
+ * @return 成功なら true
+ */
+bool flashErasePage(uint8_t page);
+
+/**
+ * @brief ハーフワードを書き込む
+ *
+ * 消去済み (0xFFFF) の位置にだけ書き込めます。
+ * @param offset ページ内のバイトオフセット（偶数）
+ * @return 成功なら true
+ */
+bool flashProgramHalfword(uint8_t page, uint16_t offset, uint16_t value);
@@ -0,0 +1,557 @@
+#include "flash_store.h"
+
+#include "flash_port.h"
+
+namespace {
+constexpr uint8_t NO_PAGE = 0xFF;
+constexpr uint8_t NO_KEY = 0xFF;
+constexpr uint16_t PAGE_MAGIC = 0x5346;  // "FS"
+constexpr uint16_t PAGE_HEADER_BYTES = 8;
+constexpr uint8_t RECORD_TAG = 0xA5;
+constexpr uint16_t RECORD_OVERHEAD = 6;  // 長さ + タグ/キー + CRC
+constexpr uint16_t PAGE_PAYLOAD_BYTES = FLASH_STORE_PAGE_SIZE - PAGE_HEADER_BYTES;
+// 有効なレコードの合計がこれを超える書き込みは受け付けない（整理で必ず空きページを作れる範囲）
+constexpr uint32_t LIVE_BYTES_LIMIT = static_cast<uint32_t>(FLASH_STORE_PAGES - 2) * PAGE_PAYLOAD_BYTES / 2;
+
+static_assert(FLASH_STORE_PAGES >= 3 && FLASH_STORE_PAGES < NO_PAGE, "FLASH_STORE_PAGES must be 3..254");
+static_assert(FLASH_STORE_PAGE_SIZE % 2 == 0 && FLASH_STORE_PAGE_SIZE <= 32768, "FLASH_STORE_PAGE_SIZE must be even");
+static_assert(FLASH_STORE_RECORD_BYTES + RECORD_OVERHEAD <= PAGE_PAYLOAD_BYTES, "a record must fit in one page");
+static_assert(STORE_KEY_COUNT <= 16, "pendingKeys is a 16-bit mask");
+
+enum class PageState : uint8_t { Erased, Used, Dirty };
+
+struct PageInfo {
+  PageState state;
+  uint32_t sequence;     // 使い始めた順の番号（大きいほど新しい）
+  uint16_t writeOffset;  // 次のレコードを書く位置
+  uint16_t liveBytes;    // このページにある有効なレコードのバイト数
+};
+
+struct IndexEntry {
+  uint8_t page;  // NO_PAGE ならレコードなし
+  uint16_t offset;
+};
+
+// 書き込み中のレコード。新規はステージングから CRC を計算しながら、整理のコピーはフラッシュから
+// レコード全体をそのまま 1 ハーフワードずつ書く。
+struct RecordWriter {
+  bool active;
+  bool copy;
+  uint8_t key;
+  uint16_t length;
+  const uint8_t *source;
+  uint8_t page;
+  uint16_t offset;
+  uint16_t position;  // レコード内の書き込み済みバイト数
+  uint16_t total;
+  uint16_t crc;
+};
+
+bool available = false;
+StoreSerializer recordSerializer = nullptr;
+PageInfo pages[FLASH_STORE_PAGES];
+IndexEntry keyIndex[STORE_KEY_COUNT];
+uint8_t headPage = NO_PAGE;
+uint32_t nextSequence = 0;
+uint16_t pendingKeys = 0;
+uint16_t errorCount = 0;
+
+uint8_t staging[FLASH_STORE_RECORD_BYTES];
+uint8_t stagedKey = NO_KEY;
+uint16_t stagedLength = 0;
+
+RecordWriter writer;
+
+// 整理中のページと、次に調べるレコードの位置
+uint8_t gcPage = NO_PAGE;
+uint16_t gcOffset = 0;
+
+uint16_t readHalfword(uint8_t page, uint16_t offset) {
+  const uint8_t *data = flashPageData(page);
+  return static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8));
+}
+
+uint16_t recordBytes(uint16_t length) {
+  return static_cast<uint16_t>(RECORD_OVERHEAD + ((length + 1u) & ~1u));
+}
+
+uint16_t crcUpdate(uint16_t crc, uint8_t value) {
+  // CRC-16/CCITT (多項式 0x1021)
+  crc ^= static_cast<uint16_t>(value << 8);
+  for (uint8_t bit = 0; bit < 8; ++bit) {
+    crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+  }
+  return crc;
+}
+
+uint16_t crcBegin(uint8_t key, uint16_t length) {
+  uint16_t crc = crcUpdate(0xFFFF, key);
+  crc = crcUpdate(crc, static_cast<uint8_t>(length));
+  return crcUpdate(crc, static_cast<uint8_t>(length >> 8));
+}
+
+uint16_t crcFinish(uint16_t crc) {
+  // 0xFFFF は「CRC 未書き込み」と区別できないので 0 に置き換える
+  return crc == 0xFFFF ? 0 : crc;
+}
+
+enum class RecordCheck : uint8_t { Valid, Invalid, End, Corrupt };
+
+RecordCheck checkRecord(uint8_t page, uint16_t offset, uint8_t *key, uint16_t *length) {
+  // レコードの検査
+  // 引数:
+  //   page, offset: レコードの先頭
+  //   key, length: 有効なレコードのキーと長さを返す（Invalid でも長さは返す）
+  // 説明: 長さが 0xFFFF なら空き領域の始まり、ページに収まらなければ壊れたデータとします。
+  //   タグ・キー・CRC のどれかが合わなければ（書き込み途中を含む）長さの分だけ読み飛ばせるレコードです。
+  // 戻り値: Valid / Invalid（読み飛ばす）/ End（空き領域）/ Corrupt（以降は読めない）
+  // 副作用: なし
+  if (offset + RECORD_OVERHEAD > FLASH_STORE_PAGE_SIZE) {
+    return RecordCheck::End;
+  }
+  const uint16_t len = readHalfword(page, offset);
+  if (len == 0xFFFF) {
+    return RecordCheck::End;
+  }
+  if (offset + recordBytes(len) > FLASH_STORE_PAGE_SIZE) {
+    return RecordCheck::Corrupt;
+  }
+  *length = len;
+  const uint16_t tagKey = readHalfword(page, offset + 2);
+  const uint8_t k = static_cast<uint8_t>(tagKey);
+  if ((tagKey >> 8) != RECORD_TAG || k >= STORE_KEY_COUNT) {
+    return RecordCheck::Invalid;
+  }
+  const uint8_t *payload = flashPageData(page) + offset + 4;
+  uint16_t crc = crcBegin(k, len);
+  for (uint16_t i = 0; i < len; ++i) {
+    crc = crcUpdate(crc, payload[i]);
+  }
+  if (readHalfword(page, offset + recordBytes(len) - 2) != crcFinish(crc)) {
+    return RecordCheck::Invalid;
+  }
+  *key = k;
+  return RecordCheck::Valid;
+}
+
+uint8_t countPages(PageState state) {
+  uint8_t count = 0;
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    if (pages[p].state == state) {
+      count++;
+    }
+  }
+  return count;
+}
+
+uint8_t firstPage(PageState state) {
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    if (pages[p].state == state) {
+      return p;
+    }
+  }
+  return NO_PAGE;
+}
+
+uint8_t oldestUsedPage() {
+  uint8_t oldest = NO_PAGE;
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    if (pages[p].state == PageState::Used &&
+        (oldest == NO_PAGE || static_cast<int32_t>(pages[p].sequence - pages[oldest].sequence) < 0)) {
+      oldest = p;
+    }
+  }
+  return oldest;
+}
+
+uint32_t totalLiveBytes() {
+  uint32_t total = 0;
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    total += pages[p].liveBytes;
+  }
+  return total;
+}
+
+void erasePage(uint8_t page) {
+  if (!flashErasePage(page)) {
+    errorCount++;
+    pages[page].state = PageState::Dirty;
+    return;
+  }
+  pages[page] = {PageState::Erased, 0, PAGE_HEADER_BYTES, 0};
+}
+
+bool openPage(bool useReserve) {
+  // 新しいページを使い始める
+  // 引数:
+  //   useReserve: 最後の 1 枚の消去済みページ（整理のコピー用の予備）も使うなら true
+  // 説明: 先頭ページの次から巡回して最初の消去済みページにヘッダを書き、先頭ページにします。
+  //   番号順に巡回するので、消去は全ページに均等に回ります。
+  // 戻り値: 使い始められたら true
+  // 副作用: headPage, pages, nextSequence を更新する。
+  if (countPages(PageState::Erased) < (useReserve ? 1 : 2)) {
+    return false;
+  }
+  uint8_t page = headPage == NO_PAGE ? 0 : static_cast<uint8_t>((headPage + 1) % FLASH_STORE_PAGES);
+  while (pages[page].state != PageState::Erased) {
+    page = static_cast<uint8_t>((page + 1) % FLASH_STORE_PAGES);
+  }
+  // マジックを最後に書くので、途中で電源が落ちたページはマウント時に消去される
+  const uint32_t sequence = nextSequence;
+  if (!flashProgramHalfword(page, 0, static_cast<uint16_t>(sequence)) ||
+      !flashProgramHalfword(page, 2, static_cast<uint16_t>(sequence >> 16)) ||
+      !flashProgramHalfword(page, 4, PAGE_MAGIC)) {
+    errorCount++;
+    pages[page].state = PageState::Dirty;
+    return false;
+  }
+  pages[page] = {PageState::Used, sequence, PAGE_HEADER_BYTES, 0};
+  headPage = page;
+  nextSequence++;
+  return true;
+}
+
+bool headHasRoom(uint16_t bytes) {
+  return headPage != NO_PAGE && pages[headPage].writeOffset + bytes <= FLASH_STORE_PAGE_SIZE;
+}
+
+void beginWriter(bool copy, uint8_t key, uint16_t length, const uint8_t *source) {
+  writer.active = true;
+  writer.copy = copy;
+  writer.key = key;
+  writer.length = length;
+  writer.source = source;
+  writer.page = headPage;
+  writer.offset = pages[headPage].writeOffset;
+  writer.position = 0;
+  writer.total = recordBytes(length);
+  writer.crc = crcBegin(key, length);
+  // 書き込み途中で止まっても次のレコードはこの後ろから始める
+  pages[headPage].writeOffset = static_cast<uint16_t>(writer.offset + writer.total);
+}
+
+uint16_t nextWriterHalfword() {
+  // 書き込むハーフワードを作る（新規レコードは CRC をここで積算する）
+  const uint16_t pos = writer.position;
+  if (writer.copy) {
+    return static_cast<uint16_t>(writer.source[pos] | (writer.source[pos + 1] << 8));
+  }
+  if (pos == 0) {
+    return writer.length;
+  }
+  if (pos == 2) {
+    return static_cast<uint16_t>((RECORD_TAG << 8) | writer.key);
+  }
+  if (pos == writer.total - 2) {
+    return crcFinish(writer.crc);
+  }
+  const uint16_t i = static_cast<uint16_t>(pos - 4);
+  const uint8_t lo = writer.source[i];
+  writer.crc = crcUpdate(writer.crc, lo);
+  uint8_t hi = 0xFF;
+  if (i + 1u < writer.length) {
+    hi = writer.source[i + 1];
+    writer.crc = crcUpdate(writer.crc, hi);
+  }
+  return static_cast<uint16_t>(lo | (hi << 8));
+}
+
+void finishWriter() {
+  // 書き終えたレコードを索引に登録し、古いレコードの分を有効バイト数から引く
+  IndexEntry &entry = keyIndex[writer.key];
+  if (entry.page != NO_PAGE) {
+    pages[entry.page].liveBytes -= recordBytes(readHalfword(entry.page, entry.offset));
+  }
+  entry.page = writer.page;
+  entry.offset = writer.offset;
+  pages[writer.page].liveBytes += writer.total;
+  writer.active = false;
+}
+
+void stepWriter() {
+  if (!flashProgramHalfword(writer.page, writer.offset + writer.position, nextWriterHalfword())) {
+    // 失敗したページにはもう書かない（書きかけのレコードは CRC が合わないので読み飛ばされる）
+    errorCount++;
+    pages[writer.page].writeOffset = FLASH_STORE_PAGE_SIZE;
+    writer.active = false;
+    return;
+  }
+  writer.position += 2;
+  if (writer.position >= writer.total) {
+    finishWriter();
+  }
+}
+
+bool startNextCopy() {
+  // 整理中のページから、まだ有効なレコードを 1 つ先頭ページへ写し始める
+  // 戻り値: コピーを始めたら true。有効なレコードが残っていなければページを消去待ちにして false、
+  //   写す先のページがなければ整理をやめて false（ページはそのまま残す）。
+  uint8_t key = 0;
+  uint16_t length = 0;
+  while (gcOffset < pages[gcPage].writeOffset) {
+    const uint16_t offset = gcOffset;
+    const RecordCheck check = checkRecord(gcPage, offset, &key, &length);
+    if (check == RecordCheck::End || check == RecordCheck::Corrupt) {
+      break;
+    }
+    gcOffset = static_cast<uint16_t>(offset + recordBytes(length));
+    if (check == RecordCheck::Valid && keyIndex[key].page == gcPage && keyIndex[key].offset == offset) {
+      const uint16_t total = recordBytes(length);
+      if (!headHasRoom(total) && !openPage(true)) {
+        errorCount++;
+        gcPage = NO_PAGE;
+        return false;
+      }
+      beginWriter(true, key, length, flashPageData(gcPage) + offset);
+      return true;
+    }
+  }
+  pages[gcPage].state = PageState::Dirty;
+  gcPage = NO_PAGE;
+  return false;
+}
+
+bool canCollect(uint8_t page) {
+  // 整理できるページか（先頭ページ以外で、有効なレコードを写す予備のページがあるか、写すものがない）
+  return page != NO_PAGE && page != headPage &&
+         (countPages(PageState::Erased) > 0 || pages[page].liveBytes == 0);
+}
+
+bool stageNextKey() {
+  // 書き込み待ちのキーを 1 つ選んでステージングに内容を作る
+  for (uint8_t key = 0; key < STORE_KEY_COUNT; ++key) {
+    const uint16_t bit = static_cast<uint16_t>(1u << key);
+    if ((pendingKeys & bit) == 0) {
+      continue;
+    }
+    pendingKeys &= static_cast<uint16_t>(~bit);
+    uint16_t length = 0;
+    if (recordSerializer == nullptr || !recordSerializer(key, staging, sizeof(staging), &length) ||
+        length > sizeof(staging)) {
+      errorCount++;
+      continue;
+    }
+    stagedKey = key;
+    stagedLength = length;
+    return true;
+  }
+  return false;
+}
+
+enum class Step : uint8_t { Continue, Stop };
+
+Step startNextJob(bool quiet) {
+  // 次の作業を始める
+  // 引数:
+  //   quiet: ページ消去をしてよいなら true
+  // 説明: 優先順は 整理中のページのコピー → 消去待ちページの消去（quiet のときだけ）→
+  //   書き込み待ちのレコード → quiet のときの先回りの整理 です。レコードを書く場所がなければ、
+  //   最も古いページの整理を始めるか、消去待ちのページが消去できるまで待ちます。
+  // 戻り値: 続けて作業できるなら Continue、このティックはもう何もしないなら Stop
+  // 副作用: writer, gcPage, stagedKey, pages を更新し、ページを消去することがある。
+  if (gcPage != NO_PAGE) {
+    startNextCopy();
+    return Step::Continue;
+  }
+
+  const uint8_t dirty = firstPage(PageState::Dirty);
+  if (quiet && dirty != NO_PAGE) {
+    // 消去は 1 ティックに 1 ページだけ（約 20ms）
+    erasePage(dirty);
+    return Step::Stop;
+  }
+
+  if (stagedKey == NO_KEY && !stageNextKey()) {
+    // 書くものがなければ、静かなうちに次の書き込み用の消去済みページを用意しておく
+    const uint8_t oldest = oldestUsedPage();
+    if (quiet && dirty == NO_PAGE && countPages(PageState::Erased) < 2 && canCollect(oldest) &&
+        pages[oldest].liveBytes < pages[oldest].writeOffset - PAGE_HEADER_BYTES) {
+      gcPage = oldest;
+      gcOffset = PAGE_HEADER_BYTES;
+      return Step::Continue;
+    }
+    return Step::Stop;
+  }
+
+  const uint16_t total = recordBytes(stagedLength);
+  if (headHasRoom(total) || openPage(false)) {
+    beginWriter(false, stagedKey, stagedLength, staging);
+    stagedKey = NO_KEY;
+    return Step::Continue;
+  }
+  if (dirty != NO_PAGE) {
+    return Step::Stop;
+  }
+  const uint8_t oldest = oldestUsedPage();
+  const IndexEntry &previous = keyIndex[stagedKey];
+  const uint32_t replaced = previous.page != NO_PAGE ? recordBytes(readHalfword(previous.page, previous.offset)) : 0;
+  if (!canCollect(oldest) || totalLiveBytes() - replaced + total > LIVE_BYTES_LIMIT) {
+    // 容量不足: このレコードは書かない
+    errorCount++;
+    stagedKey = NO_KEY;
+    return Step::Continue;
+  }
+  gcPage = oldest;
+  gcOffset = PAGE_HEADER_BYTES;
+  return Step::Continue;
+}
+
+void scanPage(uint8_t page) {
+  // ページのレコードを先頭から読み、有効なものを索引に登録する（同じキーは後のものが勝つ）
+  uint16_t offset = PAGE_HEADER_BYTES;
+  uint8_t key = 0;
+  uint16_t length = 0;
+  for (;;) {
+    const RecordCheck check = checkRecord(page, offset, &key, &length);
+    if (check == RecordCheck::End) {
+      break;
+    }
+    if (check == RecordCheck::Corrupt) {
+      offset = FLASH_STORE_PAGE_SIZE;
+      break;
+    }
+    if (check == RecordCheck::Valid) {
+      keyIndex[key].page = page;
+      keyIndex[key].offset = offset;
+    }
+    offset = static_cast<uint16_t>(offset + recordBytes(length));
+  }
+  pages[page].writeOffset = offset;
+}
+
+bool pageErased(uint8_t page) {
+  const uint8_t *data = flashPageData(page);
+  for (uint16_t i = 0; i < FLASH_STORE_PAGE_SIZE; ++i) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool mountFlashStore(StoreSerializer serializer) {
+  // 保存領域の読み込み
+  // 引数:
+  //   serializer: レコードの内容を作る関数
+  // 説明: 各ページのヘッダを読んで使用中/消去済み/壊れたページに分け、使用中のページを
+  //   古い順に読んで各キーの最新のレコードを索引にします。壊れたページはここで消去します。
+  // 戻り値: 領域が使えるなら true
+  // 副作用: 内部状態をすべて初期化し、フラッシュを消去することがある。
+  recordSerializer = serializer;
+  available = flashPortBegin();
+  headPage = NO_PAGE;
+  nextSequence = 0;
+  pendingKeys = 0;
+  stagedKey = NO_KEY;
+  gcPage = NO_PAGE;
+  writer.active = false;
+  for (uint8_t k = 0; k < STORE_KEY_COUNT; ++k) {
+    keyIndex[k].page = NO_PAGE;
+  }
+  if (!available) {
+    return false;
+  }
+
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    pages[p] = {PageState::Erased, 0, PAGE_HEADER_BYTES, 0};
+    if (readHalfword(p, 4) == PAGE_MAGIC) {
+      pages[p].state = PageState::Used;
+      pages[p].sequence = readHalfword(p, 0) | (static_cast<uint32_t>(readHalfword(p, 2)) << 16);
+    } else if (!pageErased(p)) {
+      pages[p].state = PageState::Dirty;
+    }
+  }
+
+  // 使用中のページを古い順に読む
+  uint8_t order[FLASH_STORE_PAGES];
+  uint8_t used = 0;
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    if (pages[p].state != PageState::Used) {
+      continue;
+    }
+    uint8_t i = used++;
+    while (i > 0 && static_cast<int32_t>(pages[order[i - 1]].sequence - pages[p].sequence) > 0) {
+      order[i] = order[i - 1];
+      --i;
+    }
+    order[i] = p;
+  }
+  for (uint8_t i = 0; i < used; ++i) {
+    scanPage(order[i]);
+  }
+  if (used > 0) {
+    headPage = order[used - 1];
+    nextSequence = pages[headPage].sequence + 1;
+  }
+  for (uint8_t k = 0; k < STORE_KEY_COUNT; ++k) {
+    if (keyIndex[k].page != NO_PAGE) {
+      pages[keyIndex[k].page].liveBytes += recordBytes(readHalfword(keyIndex[k].page, keyIndex[k].offset));
+    }
+  }
+  for (uint8_t p = 0; p < FLASH_STORE_PAGES; ++p) {
+    if (pages[p].state == PageState::Dirty) {
+      erasePage(p);
+    }
+  }
+  return true;
+}
+
+bool requestStoreWrite(uint8_t key) {
+  if (!available || key >= STORE_KEY_COUNT) {
+    return false;
+  }
+  pendingKeys |= static_cast<uint16_t>(1u << key);
+  return true;
+}
+
+bool storeRead(uint8_t key, const uint8_t **data, uint16_t *length) {
+  if (!available || key >= STORE_KEY_COUNT || keyIndex[key].page == NO_PAGE) {
+    return false;
+  }
+  const IndexEntry &entry = keyIndex[key];
+  *length = readHalfword(entry.page, entry.offset);
+  *data = flashPageData(entry.page) + entry.offset + 4;
+  return true;
+}
+
+void serviceFlashStore(bool quiet) {
+  // 書き込みと整理の実行
+  // 引数:
+  //   quiet: 音が出ていないなら true（ページ消去をしてよい）
+  // 説明: 書き込み中のレコードを FLASH_STORE_HALFWORDS_PER_TICK ハーフワードまで進め、
+  //   終われば次の作業（整理のコピー、消去、書き込み待ちのレコード）を始めます。
+  // 戻り値: なし
+  // 副作用: フラッシュへ書き込み、quiet なら 1 ページ消去することがある。
+  if (!available) {
+    return;
+  }
+  int16_t budget = FLASH_STORE_HALFWORDS_PER_TICK;
+  while (budget > 0) {
+    if (writer.active) {
+      stepWriter();
+      budget--;
+      continue;
+    }
+    if (startNextJob(quiet) == Step::Stop) {
+      break;
+    }
+  }
+}
+
+bool isFlashStoreIdle() {
+  return !writer.active && stagedKey == NO_KEY && pendingKeys == 0 && gcPage == NO_PAGE;
+}
+
+StoreStatus flashStoreStatus() {
+  StoreStatus status;
+  status.available = available;
+  status.idle = isFlashStoreIdle();
+  status.erasedPages = countPages(PageState::Erased);
+  status.dirtyPages = countPages(PageState::Dirty);
+  status.liveBytes = static_cast<uint16_t>(totalLiveBytes());
+  status.pendingKeys = pendingKeys;
+  status.pageOpens = nextSequence;
+  status.errors = errorCount;
+  return status;
+}
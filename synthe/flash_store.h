@@ -0,0 +1,85 @@
+#pragma once
+
+// flash_store.h
+// フラッシュの空きページを循環ログとして使う、キー付きレコードの保存領域。
+// レコードは常に末尾へ追記し、同じキーは後から書いたものが有効です。消去済みページが
+// 足りなくなると最も古いページの有効なレコードを末尾へ写してからそのページを消去するため、
+// 全ページが順番に消去されて書き換え回数が平均化されます。
+// 各レコードは CRC-16 付きで、CRC を最後に書くので書き込み途中で電源が落ちたレコードは無視されます。
+//
+// 書き込みは serviceFlashStore() がコントロールティックごとに少しずつ進めます
+// （FLASH_STORE_HALFWORDS_PER_TICK ハーフワードまで）。F103 のページ消去は約 20ms CPU を止めるので、
+// 消去は音が出ておらず MIDI 入力も途切れているとき（quiet）だけ行い、それ以外では消去済みページの予備で
+// 書き込みを続けます。
+//
+// ページの構成: [シーケンス番号 下位][上位][マジック][予備] の 8 バイトのヘッダ + レコード列
+// レコードの構成: [長さ][タグ << 8 | キー][データ（偶数バイトに詰める）][CRC]（各 16bit）
+
+#include "config.h"
+
+#include <stdint.h>
+
+// 使えるキーの数（0..STORE_KEY_COUNT-1）
+constexpr uint8_t STORE_KEY_COUNT = 16;
+
+/**
+ * @brief レコードの内容を作る関数
+ *
+ * 書き込みを始める直前に呼ばれ、その時点の内容を out に書きます。
+ * @param key requestStoreWrite() に渡したキー
+ * @param out 書き込み先（FLASH_STORE_RECORD_BYTES バイト）
+ * @param capacity out のバイト数
+ * @param length 書いたバイト数を返す
+ * @return 作れなければ false（書き込みを取りやめる）
+ */
+typedef bool (*StoreSerializer)(uint8_t key, uint8_t *out, uint16_t capacity, uint16_t *length);
+
+/**
+ * @brief 保存領域の状態（シリアルの "store" コマンド用）
+ */
+struct StoreStatus {
+  bool available;        // 領域が使える
+  bool idle;             // 書き込み/整理の途中でない
+  uint8_t erasedPages;   // 消去済みのページ数
+  uint8_t dirtyPages;    // 消去待ちのページ数
+  uint16_t liveBytes;    // 有効なレコードの合計バイト数
+  uint16_t pendingKeys;  // 書き込み待ちのキー（ビットマスク）
+  uint32_t pageOpens;    // これまでにページを使い始めた回数（÷ページ数が 1 ページあたりの消去回数の目安）
+  uint16_t errors;       // 書き込みの失敗と取りやめの回数
+};
+
+/**
+ * @brief 保存領域を読み込み、キーの索引を作る
+ *
+ * ヘッダが壊れたページはこの中で消去します（startMozzi() 前の setup() から呼ぶこと）。
+ * @param serializer レコードの内容を作る関数
+ * @return 領域が使えるなら true
+ */
+bool mountFlashStore(StoreSerializer serializer);
+
+/**
+ * @brief キーの書き込みを予約する（内容は書き込みを始めるときに serializer で作る）
+ * @return 領域が使えないか、キーが範囲外なら false
+ */
+bool requestStoreWrite(uint8_t key);
+
+/**
+ * @brief キーの最新のレコードを返す
+ * @param data フラッシュ上のデータ（次の serviceFlashStore() までに使うこと）
+ * @param length データのバイト数
+ * @return レコードがあれば true
+ */
+bool storeRead(uint8_t key, const uint8_t **data, uint16_t *length);
+
+/**
+ * @brief 書き込みと整理を進める（updateControl() から毎ティック呼ぶ）
+ * @param quiet 音が出ておらず MIDI の受信も途切れている（ページ消去で CPU が止まってもよい）なら true
+ */
+void serviceFlashStore(bool quiet);
+
+/**
+ * @brief 書き込み待ちや途中の作業がなければ true
+ */
+bool isFlashStoreIdle();
+
+StoreStatus flashStoreStatus();
@@ -1,43 +1,190 @@
 #include "hardware_inputs.h"
 
+#include "midi_clock.h"
+#include "pot_filter.h"
+#include "pot_scan.h"
+#include "profiler.h"
 #include "sequencer.h"
+#include "storage.h"
 #include "synth_state.h"
 
 #include <MozziHeadersOnly.h>
-#include <string.h>
-
-extern float readNormalizedPot(uint8_t pin);
 
 namespace {
-uint8_t lastKeyState[KEY_COUNT];
+// latchPots() 後、ポットがこれ以上動いたら再び params へ反映する（ポットの値、全体の 3%）
+constexpr uint16_t POT_PICKUP_THRESHOLD = POT_MAX_VALUE * 3 / 100;
+PotFilter potFilters[ANALOG_INPUT_COUNT];
+uint8_t primedPots = 0;
+uint16_t latchedPotValues[ANALOG_INPUT_COUNT];
+uint8_t latchedPots = 0;
+// 最後に LFO へ設定した周波数（テンポ同期中はテンポでも変わるので、値で比べる）
+float appliedLfoRate = -1.0f;
 
-#if defined(KEYBOARD_DRIVER_TTP229)
-uint16_t readTtp229State() {
-  static_assert(KEY_COUNT <= 16, "TTP229 は最大16キーまでサポートします");
-  uint16_t state = 0;
+bool primePot(uint8_t index, uint16_t raw) {
+  // 最初の読み取りではフィルタを今の位置から始める（起動直後に 0 から寄っていかないように）
+  const uint8_t bit = static_cast<uint8_t>(1u << index);
+  if ((primedPots & bit) != 0) {
+    return false;
+  }
+  potFilters[index].reset(raw);
+  primedPots |= bit;
+  return true;
+}
 
-  // SCL をハイにしてから 1 サイクル分のディレイを入れる
-  digitalWrite(TTP229_SCL_PIN, HIGH);
-  delayMicroseconds(TTP229_CLOCK_DELAY_US);
+bool readPot(uint8_t index, float &value) {
+  // ポットを読み、確定値が変わったときだけ true を返す（latchPots() で止めている間は位置が離れるまで false）
+  const uint16_t raw = potScanValue(index);
+  if (!primePot(index, raw) && !potFilters[index].push(raw)) {
+    return false;
+  }
+  const uint16_t settled = potFilters[index].value();
+  const uint8_t bit = static_cast<uint8_t>(1u << index);
+  if ((latchedPots & bit) != 0) {
+    const uint16_t distance = settled > latchedPotValues[index] ? settled - latchedPotValues[index]
+                                                                : latchedPotValues[index] - settled;
+    if (distance < POT_PICKUP_THRESHOLD) {
+      return false;
+    }
+    latchedPots &= static_cast<uint8_t>(~bit);
+  }
+  value = settled / ANALOG_MAX_VALUE;
+  return true;
+}
 
-  for (uint8_t index = 0; index < KEY_COUNT; ++index) {
-    digitalWrite(TTP229_SCL_PIN, LOW);
-    delayMicroseconds(TTP229_CLOCK_DELAY_US);
+static_assert(KEY_COUNT <= 32, "キー状態は 32bit マスクで保持します");
+// 押下中のキーのビットマスク（bit index = keyMidiNotes のインデックス）
+uint32_t lastKeyMask = 0;
 
-    bool active = digitalRead(TTP229_SDO_PIN) == TTP229_ACTIVE_STATE;
-    if (active) {
-      state |= (static_cast<uint16_t>(1) << index);
+void dispatchKeyChanges(uint32_t keyMask) {
+  // 前回のキーマスクとの差分からノートイベントを発生させる
+  // 引数:
+  //   keyMask: 今回スキャンした押下中キーのビットマスク
+  // 説明: 変化したビットだけを走査し、押されたキーは handleNoteOn、離されたキーは handleNoteOff へ渡します。
+  // 戻り値: なし
+  // 副作用: `lastKeyMask` を更新し、ノートのオン/オフを発火する。
+  uint32_t changed = keyMask ^ lastKeyMask;
+  for (uint8_t index = 0; changed != 0; ++index, changed >>= 1) {
+    if ((changed & 1u) == 0) {
+      continue;
+    }
+    if (keyMask & (1ul << index)) {
+      handleNoteOn(keyMidiNotes[index], MIDI_DEFAULT_VELOCITY);
+    } else {
+      handleNoteOff(keyMidiNotes[index]);
     }
-
-    digitalWrite(TTP229_SCL_PIN, HIGH);
-    delayMicroseconds(TTP229_CLOCK_DELAY_US);
   }
+  lastKeyMask = keyMask;
+}
+
+#if defined(KEYBOARD_DRIVER_TTP229)
+static_assert(KEY_COUNT <= 16, "TTP229 は最大16キーまでサポートします");
+
+// TTP229 のノンブロッキング読み出し。SCL の 1 エッジごとに状態を進める。
+enum class Ttp229Phase : uint8_t { Idle, ClockLow, ClockHigh };
+
+struct Ttp229Reader {
+  Ttp229Phase phase = Ttp229Phase::Idle;
+  uint8_t bit = 0;
+  uint16_t shift = 0;
+  uint32_t lastEdgeUs = 0;
+  uint16_t keyMask = 0;  // 最後に読み終えたフレーム
+  bool frameReady = false;
+};
+
+Ttp229Reader ttp229;
+#if defined(TTP229_DV_INTERRUPT)
+volatile bool ttp229DataValid = false;
 
-  return state;
+void onTtp229DataValid() {
+  // SDO の DV パルス（キー状態変化）の割り込みハンドラ。フラグを立てるだけ。
+  ttp229DataValid = true;
 }
 #endif
 
+void serviceTtp229() {
+  // TTP229 のシリアル読み出しを 1 エッジだけ進める
+  // 引数: なし
+  // 説明:
+  //   前回のエッジから TTP229_CLOCK_DELAY_US 経っていなければ何もせずに戻ります（待たない）。
+  //   Idle ではフレーム開始条件（ポーリング間隔の経過、または DV 割り込み）を確認し、
+  //   SCL の立ち下がり後に SDO を読み、立ち上がりで次のビットへ進みます。
+  //   KEY_COUNT ビット読み終えたら `keyMask` に公開して `frameReady` を立てます。
+  // 戻り値: なし
+  // 副作用: SCL ピンを操作する。`ttp229` を更新する。
+  uint32_t now = micros();
+  uint32_t elapsed = now - ttp229.lastEdgeUs;
+  switch (ttp229.phase) {
+    case Ttp229Phase::Idle:
+#if defined(TTP229_DV_INTERRUPT)
+      if (!ttp229DataValid) {
+        return;
+      }
+#else
+      if (elapsed < TTP229_FRAME_INTERVAL_US) {
+        return;
+      }
+#endif
+      ttp229.bit = 0;
+      ttp229.shift = 0;
+      digitalWrite(TTP229_SCL_PIN, LOW);
+      ttp229.phase = Ttp229Phase::ClockLow;
+      break;
+    case Ttp229Phase::ClockLow:
+      if (elapsed < TTP229_CLOCK_DELAY_US) {
+        return;
+      }
+      if (digitalRead(TTP229_SDO_PIN) == TTP229_ACTIVE_STATE) {
+        ttp229.shift |= static_cast<uint16_t>(1u << ttp229.bit);
+      }
+      digitalWrite(TTP229_SCL_PIN, HIGH);
+      if (++ttp229.bit < KEY_COUNT) {
+        ttp229.phase = Ttp229Phase::ClockHigh;
+        break;
+      }
+      ttp229.keyMask = ttp229.shift;
+      ttp229.frameReady = true;
+      ttp229.phase = Ttp229Phase::Idle;
+#if defined(TTP229_DV_INTERRUPT)
+      // 読み出し中のデータ変化でも割り込みが立つので、フレーム完了時に捨てる
+      ttp229DataValid = false;
+#endif
+      break;
+    case Ttp229Phase::ClockHigh:
+      if (elapsed < TTP229_CLOCK_DELAY_US) {
+        return;
+      }
+      digitalWrite(TTP229_SCL_PIN, LOW);
+      ttp229.phase = Ttp229Phase::ClockLow;
+      break;
+  }
+  ttp229.lastEdgeUs = now;
+}
+#endif
+
+#if defined(KEYBOARD_MCP23017_INT_PIN)
+// 割り込みモードの状態。`keyboardScanActive` が false の間は I2C に触らない。
+volatile bool keyboardInterruptFlag = false;
+bool keyboardScanActive = false;
 
+void onKeyboardInterrupt() {
+  // INTB（行入力の変化）の割り込みハンドラ。I2C はここでは使わず、フラグを立てるだけ。
+  keyboardInterruptFlag = true;
+}
+
+void armKeyboardInterrupt() {
+  // 全列を LOW に駆動して割り込み待ちに戻る
+  // 説明: どのキーが押されても行が LOW に変化して INTB が発生する状態にします。
+  //   GPB を読むと割り込みが解除され比較基準が更新されるため、フラグを先に下ろしてから読み、
+  //   その時点で既に押されているキーがあればスキャンを継続します（再アーム中の押下を取りこぼさない）。
+  // 戻り値: なし
+  // 副作用: `keyboardInterruptFlag` / `keyboardScanActive` を更新する。I2C 2 トランザクション。
+  constexpr uint8_t ROW_MASK = static_cast<uint8_t>((1u << KEY_ROWS) - 1);
+  keyboardExpander.writeGPIOA(static_cast<uint8_t>(~((1u << KEY_COLS) - 1)));
+  keyboardInterruptFlag = false;
+  uint8_t rows = static_cast<uint8_t>(~keyboardExpander.readGPIOB()) & ROW_MASK;
+  keyboardScanActive = rows != 0;
+}
+#endif
 }
 
 void setupKeyboardExpander() {
@@ -46,62 +193,108 @@ void setupKeyboardExpander() {
   pinMode(TTP229_SDO_PIN, INPUT);
   digitalWrite(TTP229_SCL_PIN, HIGH);
 
-  memset(lastKeyState, 0, sizeof(lastKeyState));
+  ttp229 = Ttp229Reader();
+  ttp229.lastEdgeUs = micros();
+  lastKeyMask = 0;
+#if defined(TTP229_DV_INTERRUPT)
+  attachInterrupt(digitalPinToInterrupt(TTP229_SDO_PIN), onTtp229DataValid, FALLING);
+#endif
 #else
   // キーボード用I2Cエキスパンダ初期化
   // 引数: なし
   // 説明: MCP23017 をキーボード行列用に設定し、行/列ピンの入出力を構成します。
+  //   列は GPA0..、行は GPB0.. に接続されている前提です（スキャンはポート単位で読み書きする）。
   // 戻り値: なし
   // 副作用: エキスパンダのピンモードと状態を設定する。
+  static_assert(KEY_COLS <= 8 && KEY_ROWS <= 8, "列は GPA、行は GPB の 1 ポートに収める必要があります");
   keyboardExpander.begin_I2C(MCP_KEYBOARD_ADDR);
 
   for (uint8_t col = 0; col < KEY_COLS; ++col) {
     keyboardExpander.pinMode(col, OUTPUT);
-    keyboardExpander.digitalWrite(col, HIGH);
   }
+  keyboardExpander.writeGPIOA(0xFF);
   for (uint8_t row = 0; row < KEY_ROWS; ++row) {
     keyboardExpander.pinMode(8 + row, INPUT_PULLUP);
   }
 
-  memset(lastKeyState, 0, sizeof(lastKeyState));
+  lastKeyMask = 0;
+
+#if defined(KEYBOARD_MCP23017_INT_PIN)
+  // 行入力 (GPB) の変化で INTB をアクティブ LOW にする
+  keyboardExpander.setupInterrupts(false, false, LOW);
+  for (uint8_t row = 0; row < KEY_ROWS; ++row) {
+    keyboardExpander.setupInterruptPin(8 + row, CHANGE);
+  }
+  pinMode(KEYBOARD_MCP23017_INT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(KEYBOARD_MCP23017_INT_PIN), onKeyboardInterrupt, FALLING);
+  armKeyboardInterrupt();
+#endif
 #endif
 }
 
 void scanKeyboard() {
 #if defined(KEYBOARD_DRIVER_TTP229)
-  uint16_t state = readTtp229State();
-
-  for (uint8_t index = 0; index < KEY_COUNT; ++index) {
-    bool pressed = (state & (static_cast<uint16_t>(1) << index)) != 0;
-    if (pressed && !lastKeyState[index]) {
-      handleNoteOn(keyMidiNotes[index]);
-    } else if (!pressed && lastKeyState[index]) {
-      handleNoteOff(keyMidiNotes[index]);
-    }
-    lastKeyState[index] = pressed;
+  // TTP229: 読み出しは serviceKeyboard() がバックグラウンドで進めるので、ここでは完成したマスクの差分だけを取る
+  serviceTtp229();
+  if (ttp229.frameReady) {
+    ttp229.frameReady = false;
+    dispatchKeyChanges(ttp229.keyMask);
   }
 #else
   // キーボードスキャン
   // 引数: なし
-  // 説明: 各列を順に LOW にして行の入力を読み取り、状態変化があれば
-  //   `handleNoteOn` / `handleNoteOff` を呼び出します。
+  // 説明: 列ごとに GPA へ「その列だけ LOW」のマスクを 1 回書き、GPB を 1 回読んで行の状態を得ます。
+  //   1 列あたり 2 トランザクション（従来は digitalWrite の読み書き x2 と digitalRead x5 で 9 回）です。
+  //   得られたキーマスクを前回と比較し、変化したキーだけ `handleNoteOn` / `handleNoteOff` を呼び出します。
+  //   書き込み後の I2C 読み出し自体が数十 us かかるため、行の安定待ちの delay は入れません。
+  //   KEYBOARD_MCP23017_INT_PIN 定義時は、割り込みが来るまでスキャンせず、全キーが離されたら
+  //   再び割り込み待ちに戻ります（鍵盤に触れていない間の I2C 通信はゼロ）。
   // 戻り値: なし
-  // 副作用: キーノートのオン/オフイベントを発生させる。
+  // 副作用: キーノートのオン/オフイベントを発生させる。I2C バスを使用する。
+#if defined(KEYBOARD_MCP23017_INT_PIN)
+  if (!keyboardScanActive) {
+    if (!keyboardInterruptFlag) {
+      return;
+    }
+    keyboardScanActive = true;
+  }
+#endif
+  constexpr uint8_t ROW_MASK = static_cast<uint8_t>((1u << KEY_ROWS) - 1);
+  uint32_t keyMask = 0;
   for (uint8_t col = 0; col < KEY_COLS; ++col) {
-    keyboardExpander.digitalWrite(col, LOW);
-    delayMicroseconds(5);
-
-    for (uint8_t row = 0; row < KEY_ROWS; ++row) {
-      bool pressed = keyboardExpander.digitalRead(8 + row) == LOW;
-      uint8_t index = row * KEY_COLS + col;
-      if (pressed && !lastKeyState[index]) {
-        handleNoteOn(keyMidiNotes[index]);
-      } else if (!pressed && lastKeyState[index]) {
-        handleNoteOff(keyMidiNotes[index]);
+    keyboardExpander.writeGPIOA(static_cast<uint8_t>(~(1u << col)));
+    uint8_t rows = static_cast<uint8_t>(~keyboardExpander.readGPIOB()) & ROW_MASK;
+    for (uint8_t row = 0; rows != 0; ++row, rows >>= 1) {
+      if (rows & 1u) {
+        keyMask |= 1ul << (row * KEY_COLS + col);
       }
-      lastKeyState[index] = pressed;
     }
-    keyboardExpander.digitalWrite(col, HIGH);
+  }
+  dispatchKeyChanges(keyMask);
+#if defined(KEYBOARD_MCP23017_INT_PIN)
+  if (keyMask == 0) {
+    armKeyboardInterrupt();
+    return;
+  }
+#endif
+  keyboardExpander.writeGPIOA(0xFF);
+#endif
+}
+
+void serviceKeyboard() {
+  // キーボードのバックグラウンド処理
+  // 引数: なし
+  // 説明: loop() から audioHook() の後に毎回呼びます。
+  //   TTP229: シリアル読み出しを 1 エッジ進めます（ブロックしない）。
+  //   MCP23017 割り込みモード: 割り込み待ちの間に INTB が発生していれば、次のコントロールティックを
+  //   待たずにその場でスキャンします（ノートオンの遅延がコントロールレートではなく割り込みで決まる）。
+  // 戻り値: なし
+  // 副作用: scanKeyboard() と同じ
+#if defined(KEYBOARD_DRIVER_TTP229)
+  serviceTtp229();
+#elif defined(KEYBOARD_MCP23017_INT_PIN)
+  if (!keyboardScanActive && keyboardInterruptFlag) {
+    scanKeyboard();
   }
 #endif
 }
@@ -140,7 +333,11 @@ void readSwitches() {
   static bool lastRandom = false;
 
   if (recordPressed && !lastRecord) {
-    if (isSequencerRecording()) {
+    // HOLD を押しながらの RECORD はソングとパッチ 0 をフラッシュへ保存
+    if (holdPressed) {
+      saveSong();
+      savePatch(0);
+    } else if (isSequencerRecording()) {
       endRecording();
     } else {
       beginRecording();
@@ -156,15 +353,25 @@ void readSwitches() {
     }
   }
   if (clearPressed && !lastClear) {
-    stopPlayback();
+    // CLEAR は選択中のトラックだけ、HOLD を押しながらなら全トラックを消す
     abortRecording();
-    clearSequence();
+    if (holdPressed) {
+      clearAllTracks();
+    } else {
+      clearSequence();
+    }
   }
   if (holdPressed && !lastHold) {
     releaseAllHeldNotes();
   }
   if (syncPressed && !lastSync) {
-    resetPlaybackMarkers();
+    // HOLD を押しながらの SYNC は OLED のデバッグページ（サイクル計測）の切り替え
+    if (holdPressed) {
+      toggleProfilePage();
+    } else {
+      resetPlaybackMarkers();
+      restartMidiClock();
+    }
   }
   if (randomPressed && !lastRandom) {
     triggerRandomNote();
@@ -181,24 +388,66 @@ void readSwitches() {
 void readAnalogs() {
   // アナログ入力読み取り
   // 引数: なし
-  // 説明: 各ポットから正規化値を読み、パラメータ（モーフ、エンベロープ、フィルタ等）に反映します。
+  // 説明: 各ポットを平滑化とヒステリシス (pot_filter.h) に通し、確定値が変わったポットだけ
+  //   パラメータ（モーフ、エンベロープ、フィルタ等）に反映して paramsDirty を立てます。
+  //   エンベロープは paramsDirty が立っているときだけ全ボイスへ設定し、LFO は周波数が変わったときだけ
+  //   設定するので、ポットが止まっていればこの関数はほとんど何もしません。
+  //   latchPots() で止めているポットは、動かされるまで反映しません。
   // 戻り値: なし
-  // 副作用: `params` と関連するエンベロープ/LFO の設定を更新する。
-  params.waveMorph = readNormalizedPot(analogPins[0]) * 4.0f;
-  params.envAttack = 5.0f + 500.0f * readNormalizedPot(analogPins[1]);
-  params.envSustain = readNormalizedPot(analogPins[2]);
-  params.envRelease = 20.0f + 1000.0f * readNormalizedPot(analogPins[3]);
-  params.filterCutoff = 200.0f + 3200.0f * readNormalizedPot(analogPins[4]);
-  params.filterResonance = 0.1f + 0.85f * readNormalizedPot(analogPins[5]);
+  // 副作用: `params`, `paramsDirty` と関連するエンベロープ/LFO の設定を更新する。
+  float value = 0.0f;
+  if (readPot(0, value)) {
+    params.waveMorph = value * 4.0f;
+    paramsDirty |= PARAM_DIRTY_TIMBRE;
+  }
+  if (readPot(1, value)) {
+    params.envAttack = 5.0f + 500.0f * value;
+    paramsDirty |= PARAM_DIRTY_ENVELOPE;
+  }
+  if (readPot(2, value)) {
+    params.envSustain = value;
+    paramsDirty |= PARAM_DIRTY_ENVELOPE;
+  }
+  if (readPot(3, value)) {
+    params.envRelease = 20.0f + 1000.0f * value;
+    paramsDirty |= PARAM_DIRTY_ENVELOPE;
+  }
+  if (readPot(4, value)) {
+    // カットオフは LFO と合わせて毎ティック計算するので印は要らない
+    params.filterCutoff = 200.0f + 3200.0f * value;
+  }
+  if (readPot(5, value)) {
+    params.filterResonance = 0.1f + 0.85f * value;
+    paramsDirty |= PARAM_DIRTY_TIMBRE;
+  }
 
   // 各ボイスのエンベロープ設定を更新
-  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-    envelopeInstance[i].setAttackTime(static_cast<unsigned int>(params.envAttack));
-    envelopeInstance[i].setDecayTime(0);
-    envelopeInstance[i].setSustainLevel(static_cast<uint8_t>(params.envSustain * 255.0f));
-    envelopeInstance[i].setReleaseTime(static_cast<unsigned int>(params.envRelease));
+  if ((paramsDirty & PARAM_DIRTY_ENVELOPE) != 0) {
+    paramsDirty &= static_cast<uint8_t>(~PARAM_DIRTY_ENVELOPE);
+    for (uint8_t i = 0; i < POLY_VOICES; ++i) {
+      envelopeInstance[i].setAttackTime(static_cast<unsigned int>(params.envAttack));
+      envelopeInstance[i].setDecayTime(0);
+      envelopeInstance[i].setADLevels(255, static_cast<uint8_t>(params.envSustain * 255.0f));
+      envelopeInstance[i].setReleaseTime(static_cast<unsigned int>(params.envRelease));
+    }
   }
 
-  lfoPitch.setFreq(params.lfoRate);
-  lfoFilter.setFreq(params.lfoRate * 0.75f);
+  // LFO はテンポ同期中ならテンポから決まる（フィルタ側は同期していても 3/4 の速さでずらす）
+  const float lfoRate = syncedLfoRate(params.lfoRate);
+  if (lfoRate != appliedLfoRate) {
+    appliedLfoRate = lfoRate;
+    lfoPitch.setFreq(lfoRate);
+    lfoFilter.setFreq(lfoRate * 0.75f);
+  }
+}
+
+void latchPots() {
+  for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+    const uint16_t raw = potScanValue(i);
+    if (!primePot(i, raw)) {
+      potFilters[i].push(raw);
+    }
+    latchedPotValues[i] = potFilters[i].value();
+  }
+  latchedPots = static_cast<uint8_t>((1u << ANALOG_INPUT_COUNT) - 1);
 }
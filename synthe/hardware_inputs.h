@@ -10,10 +10,19 @@ void setupKeyboardExpander();
 /**
  * @brief キーボードをスキャンしてキーイベントを処理する
  *
- * 各列を順にアクティブにして行入力を読み、状態変化があればノートのオン/オフを発火します。
+ * MCP23017 では各列を順にアクティブにして行入力を読み、TTP229 では読み終えたキーマスクを使い、
+ * 状態変化があればノートのオン/オフを発火します。
  */
 void scanKeyboard();
 
+/**
+ * @brief キーボードのバックグラウンド処理を進める
+ *
+ * TTP229 のシリアル読み出しを 1 エッジ進め、MCP23017 割り込みモードでは保留中の割り込みを
+ * その場でスキャンします。loop() から毎回呼び出してください（ブロックしません）。
+ */
+void serviceKeyboard();
+
 /**
  * @brief スイッチ用 I2C エキスパンダを初期化する
  */
@@ -28,3 +37,10 @@ void readSwitches();
  * @brief アナログ入力（ポット）を読み取り params 等に反映する
  */
 void readAnalogs();
+
+/**
+ * @brief 現在のポット位置を覚え、そこから動かされるまで params へ反映しない
+ *
+ * パッチを読み込んだ直後に、ポットの位置で読み込んだ値が上書きされないようにします。
+ */
+void latchPots();
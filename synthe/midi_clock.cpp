@@ -0,0 +1,321 @@
+#include "midi_clock.h"
+
+#include "audio_engine.h"
+#include "config.h"
+#include "sequencer.h"
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+// MIDI クロック 1 つあたりのシーケンサのティック
+constexpr uint32_t TICKS_PER_CLOCK = SEQ_PPQN / 24;
+static_assert(SEQ_PPQN % 24 == 0, "SEQ_PPQN は 24 の倍数にしてください");
+// 推定の補正の強さ: 予測とのずれの 1/8 を位相に、1/64 を周期に足す（揺れ ±1ms を約 1/3 に抑え、
+// テンポの変化には 1 拍ほどで追従する）
+constexpr int32_t PHASE_GAIN_SHIFT = 3;
+constexpr int32_t PERIOD_GAIN_SHIFT = 6;
+
+ClockMode clockMode = ClockMode::Internal;
+uint8_t lfoSyncDivision = 0;
+
+// ---- スレーブ ----
+ClockEstimator estimator;
+// スタート/コンティニューを受けて、次のクロックで再生を始める
+bool startPending = false;
+// 外部クロックで再生中（スタート後の最初のクロックから）
+bool slavePlaying = false;
+// 再生を始めた位置と、そこからのクロック数
+uint32_t startTick = 0;
+uint32_t clocksSinceStart = 0;
+// コンティニューで再開する位置（ソングポジションかストップした位置）
+uint32_t resumeTick = 0;
+
+// ---- マスター ----
+bool masterPlaying = false;
+// 次にクロックを送るティック（シーケンサの通算ティック）
+uint32_t nextClockTick = 0;
+
+void sendRealtime(uint8_t status) {
+  Serial1.write(status);
+}
+
+void slaveClock(uint32_t sample) {
+  // クロック 1 つ: 推定を更新し、再生中ならその（推定した）時刻を次のクロック位置に合わせる
+  const uint8_t clocks = estimator.clock(sample);
+  if (clocks == 0) {
+    return;
+  }
+  const float bpm = estimator.hasPeriod() ? estimator.bpm() : getSequencerTempo();
+  if (startPending) {
+    startPending = false;
+    slavePlaying = true;
+    clocksSinceStart = 0;
+    startTick = resumeTick;
+    if (estimator.hasPeriod()) {
+      setSequencerTempo(bpm);
+    }
+    startPlaybackAt(startTick, sample);
+    startTick = sequencerTickAt(sample);
+    return;
+  }
+  if (slavePlaying && isSequencerPlaying()) {
+    clocksSinceStart += clocks;
+    alignSequencerClock(estimator.lastClockSample(), startTick + clocksSinceStart * TICKS_PER_CLOCK, bpm);
+  } else if (estimator.hasPeriod()) {
+    setSequencerTempo(bpm);
+  }
+}
+}  // namespace
+
+// ---- ClockEstimator ----
+
+void ClockEstimator::reset() {
+  started = false;
+  lastRaw = 0;
+  predicted = 0;
+  predictedFrac = 0;
+  periodQ8 = 0;
+  acquireStart = 0;
+  acquireClocks = 0;
+  consistentClocks = 0;
+  outliers = 0;
+}
+
+void ClockEstimator::advance(int32_t amountQ8) {
+  // 推定時刻を amountQ8 (Q8) だけ進める（負なら戻す）
+  const int32_t sum = predictedFrac + amountQ8;
+  predicted += static_cast<uint32_t>(sum >> 8);
+  predictedFrac = sum & 0xFF;
+}
+
+uint8_t ClockEstimator::clock(uint32_t sample) {
+  // クロックの受け取り
+  // 引数:
+  //   sample: 受信したサンプル時刻（揺れを含む）
+  // 説明: 2 つ目のクロックで周期の初期値を決め、以降は予測時刻（前回の推定 + 周期）との差 e で
+  //   位相を e/8、周期を e/64 だけ補正します。e が周期のほぼ整数倍（MAX_MISSING_CLOCKS まで）なら
+  //   途中のクロックが抜けたものとして予測をその分進めてから補正します。それ以外で |e| が周期の半分以上なら
+  //   重複や外れとみなして捨て、それが RESYNC_OUTLIERS 回続いたらテンポが大きく変わったとみなして
+  //   今の間隔から推定をやり直します。
+  // 戻り値: 推定した時刻を何クロック分進めたか（捨てたら 0）
+  // 副作用: 推定の状態を更新する。
+  if (!started) {
+    started = true;
+    lastRaw = sample;
+    predicted = sample;
+    predictedFrac = 0;
+    return 1;
+  }
+  const uint32_t previous = lastRaw;
+  const uint32_t interval = sample - previous;
+  lastRaw = sample;
+  if (periodQ8 == 0) {
+    periodQ8 = interval << 8;
+    predicted = sample;
+    predictedFrac = 0;
+    acquireStart = previous;
+    acquireClocks = 1;
+    return 1;
+  }
+
+  const uint32_t savedPredicted = predicted;
+  const int32_t savedFrac = predictedFrac;
+  uint8_t clocks = 0;
+  int32_t errorQ8;
+  do {
+    advance(static_cast<int32_t>(periodQ8));
+    clocks++;
+    errorQ8 = (static_cast<int32_t>(sample - predicted) << 8) - predictedFrac;
+  } while (static_cast<int64_t>(errorQ8) * 2 >= periodQ8 && clocks <= MAX_MISSING_CLOCKS);
+  if (static_cast<uint32_t>(abs(errorQ8)) * 2 >= periodQ8) {
+    consistentClocks = 0;
+    if (++outliers >= RESYNC_OUTLIERS) {
+      outliers = 0;
+      periodQ8 = interval << 8;
+      predicted = sample;
+      predictedFrac = 0;
+      acquireStart = previous;
+      acquireClocks = 1;
+      return 1;
+    }
+    // 捨てたクロックでは予測を進めない（次のクロックで抜けとして扱える）
+    predicted = savedPredicted;
+    predictedFrac = savedFrac;
+    return 0;
+  }
+  outliers = 0;
+  if (consistentClocks < LOCK_CLOCKS) {
+    // 捕捉中: 周期は捕捉を始めてからの平均間隔、位相は差の半分を補正する
+    consistentClocks++;
+    acquireClocks += clocks;
+    periodQ8 = static_cast<uint32_t>((static_cast<uint64_t>(sample - acquireStart) << 8) / acquireClocks);
+    advance(errorQ8 >> 1);
+    return clocks;
+  }
+  advance(errorQ8 >> PHASE_GAIN_SHIFT);
+  periodQ8 = static_cast<uint32_t>(static_cast<int32_t>(periodQ8) + (errorQ8 >> PERIOD_GAIN_SHIFT));
+  return clocks;
+}
+
+float ClockEstimator::bpm() const {
+  return periodQ8 > 0 ? (AUDIO_RATE * 60.0f * 256.0f) / (24.0f * periodQ8) : 0.0f;
+}
+
+// ---- モード ----
+
+void setClockMode(ClockMode mode) {
+  if (mode == clockMode) {
+    return;
+  }
+  if (clockMode == ClockMode::Master && masterPlaying) {
+    sendRealtime(0xFC);
+  }
+  clockMode = mode;
+  estimator.reset();
+  startPending = false;
+  slavePlaying = false;
+  masterPlaying = false;
+  nextClockTick = (sequencerTickAt(audioOutputClock()) / TICKS_PER_CLOCK + 1) * TICKS_PER_CLOCK;
+}
+
+ClockMode getClockMode() {
+  return clockMode;
+}
+
+void receiveMidiClock(const MidiMessage &message, uint32_t sample) {
+  // リアルタイムメッセージの処理（スレーブのときだけ）
+  // 引数:
+  //   message: クロック/スタート/コンティニュー/ストップ/ソングポジション
+  //   sample: このメッセージを鳴らす時刻（handleMIDI() が組み立てた時点ではまだ先の時刻）
+  // 説明: スタートは頭から、コンティニューは再開位置から、次のクロックで再生を始めます。
+  //   ストップでは再生を止め、その位置をコンティニューの再開位置にします。
+  // 戻り値: なし
+  // 副作用: シーケンサのテンポ・位置・再生状態を変える。
+  if (clockMode != ClockMode::Slave) {
+    return;
+  }
+  switch (message.type) {
+    case MidiMessage::Type::Clock:
+      slaveClock(sample);
+      break;
+    case MidiMessage::Type::Start:
+      resumeTick = 0;
+      startPending = true;
+      estimator.restart();
+      break;
+    case MidiMessage::Type::Continue:
+      startPending = true;
+      estimator.restart();
+      break;
+    case MidiMessage::Type::Stop:
+      startPending = false;
+      if (slavePlaying) {
+        resumeTick = startTick + clocksSinceStart * TICKS_PER_CLOCK;
+        slavePlaying = false;
+        stopPlayback();
+      }
+      break;
+    case MidiMessage::Type::SongPosition:
+      // 16 分音符単位
+      resumeTick = static_cast<uint32_t>(message.value()) * (SEQ_PPQN / 4);
+      break;
+    default:
+      break;
+  }
+}
+
+void serviceMidiClock() {
+  // マスターのクロック送信
+  // 引数: なし
+  // 説明: 再生の開始/停止を見てスタート/ストップを送り、出力済みのサンプル位置が次のクロックの
+  //   ティックに達したらクロックを送ります。テンポ変更や SYNC で位置が大きく飛んだら、
+  //   次のクロックを現在位置の次の区切りに合わせ直します。
+  // 戻り値: なし
+  // 副作用: Serial1 へ送信する。
+  if (clockMode != ClockMode::Master) {
+    return;
+  }
+  const bool playing = isSequencerPlaying();
+  if (playing != masterPlaying) {
+    masterPlaying = playing;
+    sendRealtime(playing ? 0xFA : 0xFC);
+    if (playing) {
+      nextClockTick = sequencerTickAt(audioSampleClock());
+      nextClockTick = (nextClockTick + TICKS_PER_CLOCK - 1) / TICKS_PER_CLOCK * TICKS_PER_CLOCK;
+    }
+  }
+  const uint32_t now = audioOutputClock();
+  const int32_t drift = static_cast<int32_t>(sequencerTickAt(now) - nextClockTick);
+  if (drift > static_cast<int32_t>(TICKS_PER_CLOCK * 4) || drift < -static_cast<int32_t>(TICKS_PER_CLOCK * 4)) {
+    nextClockTick = (sequencerTickAt(now) / TICKS_PER_CLOCK + 1) * TICKS_PER_CLOCK;
+  }
+  while (static_cast<int32_t>(now - sequencerSampleAt(nextClockTick)) >= 0) {
+    sendRealtime(0xF8);
+    nextClockTick += TICKS_PER_CLOCK;
+  }
+}
+
+void restartMidiClock() {
+  if (clockMode == ClockMode::Master && masterPlaying) {
+    sendRealtime(0xFA);
+    nextClockTick = 0;
+  }
+}
+
+void setLfoSyncDivision(uint8_t division) {
+  lfoSyncDivision = division;
+}
+
+uint8_t getLfoSyncDivision() {
+  return lfoSyncDivision;
+}
+
+float syncedLfoRate(float freeRate) {
+  // 全音符を division 等分した長さで 1 周: 4 拍 = 240 / bpm 秒
+  if (lfoSyncDivision == 0) {
+    return freeRate;
+  }
+  return getSequencerTempo() * lfoSyncDivision / 240.0f;
+}
+
+bool handleClockCommand(const char *line) {
+  // クロックのシリアルコマンド
+  // 引数:
+  //   line: 改行を除いた 1 行
+  // 戻り値: "clock" コマンドなら true
+  // 副作用: モードと LFO の同期を変更し、Serial へ状態を出力する。
+  if (strncmp(line, "clock", 5) != 0 || (line[5] != '\0' && line[5] != ' ')) {
+    return false;
+  }
+  const char *args = line[5] == ' ' ? line + 6 : line + 5;
+  if (strcmp(args, "int") == 0) {
+    setClockMode(ClockMode::Internal);
+  } else if (strcmp(args, "master") == 0) {
+    setClockMode(ClockMode::Master);
+  } else if (strcmp(args, "slave") == 0) {
+    setClockMode(ClockMode::Slave);
+  } else if (strncmp(args, "lfo ", 4) == 0) {
+    setLfoSyncDivision(static_cast<uint8_t>(constrain(atoi(args + 4), 0, 64)));
+  } else if (args[0] != '\0') {
+    Serial.println("clock: int|master|slave, lfo <division, 0 = free>");
+    return true;
+  }
+  static const char *const modeNames[] = {"int", "master", "slave"};
+  Serial.print("clock: ");
+  Serial.print(modeNames[static_cast<uint8_t>(clockMode)]);
+  Serial.print(" bpm ");
+  Serial.print(static_cast<double>(getSequencerTempo()), 2);
+  if (clockMode == ClockMode::Slave) {
+    Serial.print(estimator.locked() ? " locked" : " unlocked");
+  }
+  Serial.print(" lfo ");
+  if (lfoSyncDivision == 0) {
+    Serial.println("free");
+  } else {
+    Serial.print("1/");
+    Serial.println(static_cast<unsigned int>(lfoSyncDivision));
+  }
+  return true;
+}
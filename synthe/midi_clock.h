@@ -0,0 +1,133 @@
+#pragma once
+
+// midi_clock.h
+// MIDI クロック (24 PPQN) の同期。
+//   内部 (Internal)  シーケンサは自分のテンポで動き、クロックは送らない
+//   マスター (Master) 自分のテンポで Serial1 からクロックとスタート/ストップを送る
+//   スレーブ (Slave)  受信したクロックからテンポと位置を推定してシーケンサを追従させる
+//
+// スレーブの推定は 2 次の PLL です。次のクロックの時刻を予測し、実際との差の一部で位相（予測時刻）と
+// 周期を補正するので、受信の揺れ（USB-MIDI 変換器などで 1ms 前後）がテンポと発音位置に直接は出ません。
+// ロックするまで（最初の 1 拍）は周期を受信開始からの平均間隔で求め、早く正しいテンポに寄せます。
+// 周期のほぼ整数倍だけ遅れたクロックは途中が抜けたものとして位置を進め、それ以外で周期の半分以上ずれた
+// クロック（重複など）は無視し、続いたときだけ推定をやり直します。
+//
+// LFO は全音符の分割数を指定するとテンポに同期した周期になります（4 なら四分音符 1 つで 1 周）。
+
+#include "midi_parser.h"
+
+#include <stdint.h>
+
+/**
+ * @brief クロックの周期と位相の推定（シーケンサに依存しない純粋な計算、ホストで単体試験する）
+ */
+class ClockEstimator {
+public:
+  ClockEstimator() { reset(); }
+
+  void reset();
+
+  /**
+   * @brief 周期は残したまま、次のクロックを位相の基準にし直す（スタート/コンティニューの後、クロックが途切れていてもよい）
+   */
+  void restart() { started = false; }
+
+  /**
+   * @brief クロックを 1 つ受け取る
+   * @param sample 受信（発火）したサンプル時刻
+   * @return 推定した時刻を何クロック分進めたか（通常は 1、抜けていれば 2 以上、重複や外れとみなして捨てたら 0）
+   */
+  uint8_t clock(uint32_t sample);
+
+  /**
+   * @brief 周期が安定した（十分な数のクロックが予測どおりに来た）
+   */
+  bool locked() const { return consistentClocks >= LOCK_CLOCKS; }
+
+  /**
+   * @brief 周期を推定できている（2 つ以上のクロックを受け取った）
+   */
+  bool hasPeriod() const { return periodQ8 > 0; }
+
+  /**
+   * @brief 最後のクロックの（揺れを除いた）推定時刻
+   */
+  uint32_t lastClockSample() const { return predicted; }
+
+  /**
+   * @brief 推定したクロックの周期（サンプル、Q8）
+   */
+  uint32_t clockPeriodQ8() const { return periodQ8; }
+
+  /**
+   * @brief 推定したテンポ（周期を推定できていなければ 0）
+   */
+  float bpm() const;
+
+private:
+  // ロックとみなす連続クロック数（1 拍）、推定をやり直すまでの外れクロック数、抜けとみなす最大の連続数
+  static constexpr uint8_t LOCK_CLOCKS = 24;
+  static constexpr uint8_t RESYNC_OUTLIERS = 3;
+  static constexpr uint8_t MAX_MISSING_CLOCKS = 3;
+
+  void advance(int32_t amountQ8);
+
+  bool started;
+  uint32_t lastRaw;       // 最後に受け取ったクロックの時刻（揺れを含む）
+  uint32_t predicted;     // 推定したクロックの時刻（整数部）
+  int32_t predictedFrac;  // 同じく小数部 (Q8, 0..255)
+  uint32_t periodQ8;      // 周期（サンプル、Q8）
+  uint32_t acquireStart;  // ロックするまでは周期を acquireStart からの平均間隔で求める
+  uint16_t acquireClocks;
+  uint8_t consistentClocks;
+  uint8_t outliers;
+};
+
+enum class ClockMode : uint8_t { Internal, Master, Slave };
+
+void setClockMode(ClockMode mode);
+ClockMode getClockMode();
+
+/**
+ * @brief 受信したクロック/スタート/コンティニュー/ストップ/ソングポジションを処理する（handleMIDI() から呼ばれる）
+ * @param sample メッセージの発火時刻（受信時刻 + MIDI_INPUT_LATENCY_SAMPLES、呼ばれた時点ではまだ先）
+ *
+ * スレーブのときだけ、クロックでテンポと位置を合わせ、スタート/コンティニュー後の最初のクロックで
+ * 再生を始め、ストップで止めます。ソングポジションはコンティニューの再開位置になります。
+ * イベントキューを通さず組み立てた時点で呼ぶので、再生開始の位置は発火時刻より前に決まり、
+ * 先頭のノートも遅れずに予約できます。
+ */
+void receiveMidiClock(const MidiMessage &message, uint32_t sample);
+
+/**
+ * @brief マスターのクロック送信（loop() から audioHook() のたびに呼ぶ）
+ *
+ * シーケンサのティック (SEQ_PPQN / 24 ごと) に合わせて、そのサンプルが出力されたときに 0xF8 を送ります。
+ * 止まっている間もクロックは送り続け、再生の開始/停止で 0xFA/0xFC を送ります。
+ */
+void serviceMidiClock();
+
+/**
+ * @brief シーケンサを頭から再生し直したことを知らせる（SYNC ボタン）。マスターならスタートを送り直す
+ */
+void restartMidiClock();
+
+/**
+ * @brief LFO のテンポ同期
+ * @param division 全音符の分割数（4 = 四分音符で 1 周、0 = 同期しない）
+ */
+void setLfoSyncDivision(uint8_t division);
+uint8_t getLfoSyncDivision();
+
+/**
+ * @brief LFO の周波数を返す（同期していれば現在のテンポから、していなければ freeRate）
+ */
+float syncedLfoRate(float freeRate);
+
+/**
+ * @brief クロックのシリアルコマンドを処理する（serial_console.h から呼ばれる）
+ *
+ * "clock" で状態を出力、"clock int|master|slave" で切り替え、"clock lfo <分割数>" で LFO を同期します。
+ * @return "clock" で始まる行なら true（処理済み）
+ */
+bool handleClockCommand(const char *line);
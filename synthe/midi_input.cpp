@@ -1,45 +1,137 @@
 #include "midi_input.h"
 
+#include "audio_engine.h"
+#include "config.h"
+#include "midi_clock.h"
 #include "sequencer.h"
 
 #include <Arduino.h>
 
-void handleMIDI() {
+namespace {
+// 受信バイトのリングバッファ（容量は 2 の冪）。書き手は midiInputReceive()、読み手は handleMIDI() だけなので、
+// 添字をそれぞれが 1 つだけ書き換える限り排他は不要（Cortex-M3 の 16bit の読み書きは分断されない）。
+struct ReceivedByte {
+  uint32_t sample;
+  uint8_t value;
+};
+ReceivedByte receiveRing[MIDI_INPUT_RING_SIZE];
+volatile uint16_t receiveHead = 0;
+volatile uint16_t receiveTail = 0;
+static_assert((MIDI_INPUT_RING_SIZE & (MIDI_INPUT_RING_SIZE - 1)) == 0, "MIDI_INPUT_RING_SIZE は 2 の冪にしてください");
+
+// 組み立てたメッセージのキュー（発火時刻順）。書き手は handleMIDI()、読み手はオーディオ経路。
+MidiEvent eventQueue[MIDI_EVENT_QUEUE_SIZE];
+volatile uint8_t eventHead = 0;
+volatile uint8_t eventTail = 0;
+static_assert((MIDI_EVENT_QUEUE_SIZE & (MIDI_EVENT_QUEUE_SIZE - 1)) == 0, "MIDI_EVENT_QUEUE_SIZE は 2 の冪にしてください");
+
+MidiParser parser;
+MidiInputStats stats = {0, 0, 0, 0, 0};
+// 最後に受信したバイトの時刻（audioOutputClock() の基準）。書き手は midiInputReceive() だけ
+volatile uint32_t lastReceiveSample = 0;
+volatile bool anyReceived = false;
+}  // namespace
+
+void midiInputReceive(uint8_t value, uint32_t sample) {
+  const uint16_t head = receiveHead;
+  const uint16_t next = (head + 1) & (MIDI_INPUT_RING_SIZE - 1);
+  if (next == receiveTail) {
+    stats.ringOverflows++;
+    return;
+  }
+  receiveRing[head] = {sample, value};
+  receiveHead = next;
+  lastReceiveSample = sample;
+  anyReceived = true;
+}
+
+void pollMidiInput() {
+  const uint32_t now = audioOutputClock();
   while (Serial1.available() > 0) {
-    static uint8_t runningStatus = 0;
-    uint8_t byte = Serial1.read();
+    midiInputReceive(static_cast<uint8_t>(Serial1.read()), now);
+  }
+}
 
-    if (byte & 0x80) {
-      runningStatus = byte;
+void handleMIDI() {
+  // 受信バイトの組み立て
+  // 引数: なし
+  // 説明: リングバッファのバイトを順にパーサへ渡し、そろったメッセージを
+  //   「先頭バイトではなく最後のバイトの受信時刻 + MIDI_INPUT_LATENCY_SAMPLES」を発火時刻として
+  //   イベントキューへ積みます。遅延はコントロールティック 1 回分とブロック 1 つ分を見込んでいるので、
+  //   通常は発火時刻の前にキューへ入ります（間に合わなければ次のサンプルで発火し、lateEvents に数える）。
+  //   クロックなどの同期メッセージはキューへ積まず、発火時刻を付けてそのまま midi_clock.h へ渡します。
+  // 戻り値: なし
+  // 副作用: receiveTail, eventQueue, eventHead, stats を更新する。
+  const uint32_t rendered = audioSampleClock();
+  while (receiveTail != receiveHead) {
+    const ReceivedByte received = receiveRing[receiveTail];
+    receiveTail = (receiveTail + 1) & (MIDI_INPUT_RING_SIZE - 1);
+    stats.bytes++;
+    if (!parser.push(received.value)) {
+      continue;
+    }
+    stats.events++;
+    const MidiMessage &message = parser.message();
+    const uint32_t sample = received.sample + MIDI_INPUT_LATENCY_SAMPLES;
+    if (message.type >= MidiMessage::Type::SongPosition) {  // ソングポジションとリアルタイム
+      receiveMidiClock(message, sample);
+      continue;
+    }
+    const uint8_t next = (eventHead + 1) & (MIDI_EVENT_QUEUE_SIZE - 1);
+    if (next == eventTail) {
+      stats.queueOverflows++;
       continue;
     }
+    if (static_cast<int32_t>(sample - rendered) < 0) {
+      stats.lateEvents++;
+    }
+    eventQueue[eventHead] = {sample, message};
+    eventHead = next;
+  }
+}
+
+const MidiEvent *peekMidiEvent() {
+  return eventTail != eventHead ? &eventQueue[eventTail] : nullptr;
+}
+
+void popMidiEvent() {
+  if (eventTail != eventHead) {
+    eventTail = (eventTail + 1) & (MIDI_EVENT_QUEUE_SIZE - 1);
+  }
+}
 
-    static uint8_t data1 = 0;
-    static bool waitingForData2 = false;
-
-    if (runningStatus >= 0x80 && runningStatus < 0xF0) {
-      if (!waitingForData2) {
-        data1 = byte;
-        waitingForData2 = true;
-      } else {
-        waitingForData2 = false;
-        uint8_t data2 = byte;
-        uint8_t status = runningStatus & 0xF0;
-        switch (status) {
-          case 0x90:
-            if (data2 > 0) {
-              handleNoteOn(data1);
-            } else {
-              handleNoteOff(data1);
-            }
-            break;
-          case 0x80:
-            handleNoteOff(data1);
-            break;
-          default:
-            break;
-        }
+void playMidiEvent(const MidiMessage &message) {
+  // メッセージの実行（全チャンネルを受け付ける）
+  switch (message.type) {
+    case MidiMessage::Type::NoteOn:
+      handleNoteOn(message.data1, message.data2);
+      break;
+    case MidiMessage::Type::NoteOff:
+      handleNoteOff(message.data1);
+      break;
+    case MidiMessage::Type::PitchBend:
+      setPitchBend(message.value());
+      break;
+    case MidiMessage::Type::ControlChange:
+      if (message.data1 == 1) {
+        setModWheel(message.data2);
+      } else if (message.data1 == 121) {
+        resetControllers();
       }
-    }
+      break;
+    default:
+      break;
+  }
+}
+
+MidiInputStats midiInputStats() {
+  return stats;
+}
+
+uint32_t midiInputIdleSamples() {
+  // 最後の受信からの経過（audioOutputClock() の基準、まだ何も受信していなければ最大値）
+  if (!anyReceived) {
+    return UINT32_MAX;
   }
+  return audioOutputClock() - lastReceiveSample;
 }
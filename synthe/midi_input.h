@@ -1,8 +1,82 @@
 #pragma once
 
+// midi_input.h
+// Serial1 の MIDI 入力。受信バイトは受信した時点のサンプル時刻付きでリングバッファに積み
+// (midiInputReceive())、コントロールティックごとに handleMIDI() がメッセージに組み立てて (midi_parser.h)
+// イベントキューへ移します。オーディオ経路は各イベントを「受信時刻 + MIDI_INPUT_LATENCY_SAMPLES」の
+// サンプルで発火させるので、コントロールティックの間隔 (約 7.8ms) による揺れが出ません。
+// クロックなどの同期メッセージはキューへ積まず、組み立てた時点で発火時刻とともに midi_clock.h へ渡します。
+//
+// リングバッファとイベントキューはどちらも書き手と読み手が 1 つずつのロックフリーのキューです。
+// midiInputReceive() は割り込みからも呼べます。
+
+#include "midi_parser.h"
+
+#include <stdint.h>
+
+/**
+ * @brief 発火時刻付きのメッセージ
+ */
+struct MidiEvent {
+  uint32_t sample;  // audioSampleClock() と同じ基準の発火時刻
+  MidiMessage message;
+};
+
 /**
- * @brief MIDI 入力を処理する（Serial1 からの MIDI を想定）
+ * @brief 受信の統計（取りこぼしと遅延の確認用）
+ */
+struct MidiInputStats {
+  uint32_t bytes;           // 受信したバイト数
+  uint32_t events;          // 組み立てたメッセージの数
+  uint16_t ringOverflows;   // リングバッファが満杯で捨てたバイト数
+  uint16_t queueOverflows;  // イベントキューが満杯で捨てたメッセージの数
+  uint16_t lateEvents;      // 発火時刻を過ぎてから届いたメッセージの数（遅延が足りない）
+};
+
+/**
+ * @brief 受信した 1 バイトをリングバッファに積む（割り込みから呼べる）
+ * @param value 受信したバイト
+ * @param sample 受信した時点の audioOutputClock()
+ */
+void midiInputReceive(uint8_t value, uint32_t sample);
+
+/**
+ * @brief Serial1 の受信済みバイトを受信時刻付きでリングバッファへ移す（loop() から audioHook() のたびに呼ぶ）
  *
- * 受信した MIDI メッセージを解析し、ノートオン/オフ等の処理を行います。
+ * Arduino コアが UART の割り込みを持っているため、割り込みの代わりに頻繁に呼んで時刻を付けます。
+ * 時刻の分解能は呼び出し間隔（通常は数サンプル）になります。
+ */
+void pollMidiInput();
+
+/**
+ * @brief リングバッファのバイトをメッセージに組み立ててイベントキューへ移す（updateControl() から呼ぶ）
  */
 void handleMIDI();
+
+/**
+ * @brief イベントキューの先頭を返す（オーディオ経路から呼ぶ）
+ * @return キューが空なら nullptr
+ */
+const MidiEvent *peekMidiEvent();
+
+/**
+ * @brief イベントキューの先頭を捨てる
+ */
+void popMidiEvent();
+
+/**
+ * @brief メッセージを実行する（発火時刻に renderBlock() から呼ばれる）
+ *
+ * ノートオン/オフは演奏入力として handleNoteOn()/handleNoteOff() に渡します（録音中なら録音される）。
+ * ピッチベンド、CC1（モジュレーション）、CC121（リセットオールコントローラ）はオーディオエンジンへ渡します。
+ */
+void playMidiEvent(const MidiMessage &message);
+
+MidiInputStats midiInputStats();
+
+/**
+ * @brief 最後に MIDI のバイトを受信してからのサンプル数（まだ受信していなければ UINT32_MAX）
+ *
+ * フラッシュのページ消去（storage.h）を、受信が途切れているときに限るために使います。
+ */
+uint32_t midiInputIdleSamples();
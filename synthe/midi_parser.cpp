@@ -0,0 +1,118 @@
+#include "midi_parser.h"
+
+namespace {
+uint8_t dataBytesFor(uint8_t status) {
+  // ステータスに続くデータバイト数
+  switch (status & 0xF0) {
+    case 0xC0:
+    case 0xD0:
+      return 1;
+    case 0xF0:
+      // システムコモン: ソングポジションは 2、MTC クォーターフレームとソングセレクトは 1、その他は 0
+      return status == 0xF2 ? 2 : (status == 0xF1 || status == 0xF3 ? 1 : 0);
+    default:
+      return 2;
+  }
+}
+}  // namespace
+
+void MidiParser::reset() {
+  runningStatus = 0;
+  dataCount = 0;
+  dataNeeded = 0;
+  inSysex = false;
+  current = {MidiMessage::Type::NoteOff, 0, 0, 0};
+}
+
+bool MidiParser::push(uint8_t byte) {
+  // 1 バイトの読み込み
+  // 引数:
+  //   byte: 受信した 1 バイト
+  // 説明: リアルタイムメッセージはその場で返し、状態は変えません。それ以外のステータスバイトは
+  //   組み立て中のメッセージと SysEx を打ち切り、新しいメッセージを始めます。データバイトは
+  //   ステータスに必要な数がそろったらメッセージにし、チャンネルメッセージなら同じステータスで次を待ちます。
+  // 戻り値: メッセージがそろったら true
+  // 副作用: 状態を進め、メッセージがそろったら current を書き換える。
+  if (byte >= 0xF8) {
+    switch (byte) {
+      case 0xF8:
+        current.type = MidiMessage::Type::Clock;
+        return true;
+      case 0xFA:
+        current.type = MidiMessage::Type::Start;
+        return true;
+      case 0xFB:
+        current.type = MidiMessage::Type::Continue;
+        return true;
+      case 0xFC:
+        current.type = MidiMessage::Type::Stop;
+        return true;
+      default:
+        // アクティブセンシング、システムリセット、未定義
+        return false;
+    }
+  }
+
+  if (byte & 0x80) {
+    inSysex = byte == 0xF0;
+    dataCount = 0;
+    if (byte >= 0xF0) {
+      // SysEx とシステムコモンはランニングステータスを取り消す。データのないもの (F6, F7) はここで終わり。
+      dataNeeded = dataBytesFor(byte);
+      runningStatus = !inSysex && dataNeeded > 0 ? byte : 0;
+      return false;
+    }
+    runningStatus = byte;
+    dataNeeded = dataBytesFor(byte);
+    return false;
+  }
+
+  if (inSysex || runningStatus == 0) {
+    return false;
+  }
+  data[dataCount++] = byte;
+  if (dataCount < dataNeeded) {
+    return false;
+  }
+  dataCount = 0;
+  return finishMessage();
+}
+
+bool MidiParser::finishMessage() {
+  // データがそろったメッセージを current にする（システムコモンはここでランニングステータスを終える）
+  const uint8_t status = runningStatus;
+  current.channel = status & 0x0F;
+  current.data1 = data[0];
+  current.data2 = dataNeeded > 1 ? data[1] : 0;
+  switch (status & 0xF0) {
+    case 0x80:
+      current.type = MidiMessage::Type::NoteOff;
+      return true;
+    case 0x90:
+      current.type = current.data2 > 0 ? MidiMessage::Type::NoteOn : MidiMessage::Type::NoteOff;
+      return true;
+    case 0xA0:
+      current.type = MidiMessage::Type::PolyPressure;
+      return true;
+    case 0xB0:
+      current.type = MidiMessage::Type::ControlChange;
+      return true;
+    case 0xC0:
+      current.type = MidiMessage::Type::ProgramChange;
+      return true;
+    case 0xD0:
+      current.type = MidiMessage::Type::ChannelPressure;
+      return true;
+    case 0xE0:
+      current.type = MidiMessage::Type::PitchBend;
+      return true;
+    default:
+      runningStatus = 0;
+      if (status == 0xF2) {
+        current.channel = 0;
+        current.type = MidiMessage::Type::SongPosition;
+        return true;
+      }
+      return false;
+  }
+}
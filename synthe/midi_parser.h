@@ -0,0 +1,70 @@
+#pragma once
+
+// midi_parser.h
+// MIDI 1.0 のバイト列をメッセージに組み立てる状態機械。1 バイトずつ push() します。
+//
+// - チャンネルメッセージはランニングステータスに対応します（ベロシティ 0 のノートオンはノートオフ）。
+// - リアルタイムメッセージ (F8..FF) はメッセージの途中に割り込んでもよく、ランニングステータスや
+//   組み立て中のデータを変えません。
+// - SysEx (F0..F7) は中身を読み飛ばします。F7 以外のステータスバイトでも SysEx は終わります。
+// - システムコモン (F1..F7) はランニングステータスを取り消します。ソングポジションだけをメッセージにします。
+// - ステータスの前に来たデータバイト（受信の途中から始めたときなど）は捨てます。
+
+#include <stdint.h>
+
+/**
+ * @brief 組み立てたメッセージ
+ */
+struct MidiMessage {
+  enum class Type : uint8_t {
+    NoteOff,
+    NoteOn,
+    PolyPressure,
+    ControlChange,
+    ProgramChange,
+    ChannelPressure,
+    PitchBend,
+    SongPosition,
+    Clock,
+    Start,
+    Continue,
+    Stop
+  };
+  Type type;
+  uint8_t channel;  // チャンネルメッセージのみ（0..15）
+  uint8_t data1;    // ノート番号、コントロール番号、プログラム番号、プレッシャー
+  uint8_t data2;    // ベロシティ、コントロール値、ポリプレッシャー
+
+  /**
+   * @brief 14bit の値（ピッチベンドとソングポジション）。ピッチベンドは中央が 0 (-8192..8191)
+   */
+  int16_t value() const {
+    const int16_t raw = static_cast<int16_t>((data2 << 7) | data1);
+    return type == Type::PitchBend ? static_cast<int16_t>(raw - 8192) : raw;
+  }
+};
+
+class MidiParser {
+public:
+  MidiParser() { reset(); }
+
+  void reset();
+
+  /**
+   * @brief 1 バイト読み込む
+   * @return メッセージがそろったら true（message() で取り出す）
+   */
+  bool push(uint8_t value);
+
+  const MidiMessage &message() const { return current; }
+
+private:
+  bool finishMessage();
+
+  uint8_t runningStatus;  // 組み立て中のメッセージのステータス（0 ならデータバイトを捨てる）
+  uint8_t data[2];
+  uint8_t dataCount;
+  uint8_t dataNeeded;
+  bool inSysex;
+  MidiMessage current;
+};
@@ -0,0 +1,88 @@
+#include "packed_sequence.h"
+
+#include <string.h>
+
+bool PackedSequence::assign(const PackedSequence &other) {
+  if (other.used > capacityBytes) {
+    return false;
+  }
+  memcpy(bytes, other.bytes, other.used);
+  used = other.used;
+  count = other.count;
+  endTime = other.endTime;
+  return true;
+}
+
+bool PackedSequence::load(const uint8_t *data, uint16_t length) {
+  clear();
+  if (length > capacityBytes) {
+    return false;
+  }
+  for (Reader reader(data, length); !reader.done(); reader.advance()) {
+    append(reader.event().time, reader.event().note, reader.event().noteOn);
+  }
+  // 符号化は一意なので、全部読めていれば同じ長さになる
+  return used == length;
+}
+
+bool PackedSequence::append(uint32_t time, uint8_t note, bool noteOn) {
+  // イベントの追記
+  // 引数:
+  //   time: 先頭からの絶対時間
+  //   note: MIDI ノート番号（下位 7bit を使う）
+  //   noteOn: ノートオンなら true
+  // 説明: 直前のイベントからの差分を VLQ（上位の 7bit から、継続バイトは最上位ビットを立てる）で
+  //   書き、続けてノートバイトを書きます。全体が収まらない場合は何も書きません。
+  // 戻り値: 追記できたら true
+  // 副作用: bytes, used, count, endTime を更新する。
+  uint32_t delta = time > endTime ? time - endTime : 0;
+  uint8_t groups[MAX_DELTA_BYTES];
+  uint8_t groupCount = 0;
+  do {
+    groups[groupCount++] = static_cast<uint8_t>(delta & 0x7F);
+    delta >>= 7;
+  } while (delta != 0);
+
+  if (static_cast<uint16_t>(capacityBytes - used) < groupCount + 1u) {
+    return false;
+  }
+  while (groupCount > 1) {
+    bytes[used++] = static_cast<uint8_t>(groups[--groupCount] | 0x80);
+  }
+  bytes[used++] = groups[0];
+  bytes[used++] = static_cast<uint8_t>((note & 0x7F) | (noteOn ? 0x80 : 0x00));
+  count++;
+  if (time > endTime) {
+    endTime = time;
+  }
+  return true;
+}
+
+void PackedSequence::Reader::advance() {
+  // 次のイベントの復号
+  // 引数: なし
+  // 説明: 差分時間を読み出して現在時刻に加え、ノートバイトを分解します。
+  //   差分が MAX_DELTA_BYTES を超える、または途中で末尾に達した場合は終端として扱います。
+  // 戻り値: なし
+  // 副作用: pos, current, valid を更新する。
+  valid = false;
+  uint32_t delta = 0;
+  for (uint8_t i = 0; i < MAX_DELTA_BYTES; ++i) {
+    if (pos >= end) {
+      return;
+    }
+    uint8_t b = data[pos++];
+    delta = (delta << 7) | (b & 0x7F);
+    if ((b & 0x80) == 0) {
+      if (pos >= end) {
+        return;
+      }
+      uint8_t noteByte = data[pos++];
+      current.time += delta;
+      current.note = noteByte & 0x7F;
+      current.noteOn = (noteByte & 0x80) != 0;
+      valid = true;
+      return;
+    }
+  }
+}
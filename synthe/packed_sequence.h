@@ -0,0 +1,144 @@
+#pragma once
+
+// packed_sequence.h
+// シーケンサのイベント列を可変長の差分時間で詰めて格納するバイト列。
+// 1 イベントは「差分時間 (VLQ: 7bit ずつ上位から、最上位ビットが継続フラグ)」+「ノートバイト」です。
+// ノートバイトの最上位ビットがノートオン (1) / ノートオフ (0)、下位 7bit が MIDI ノート番号です。
+// 時間の単位は呼び出し側が決めます（シーケンサは四分音符 SEQ_PPQN 分割のティック）。差分 127 以下は 2 バイト、
+// 16383 以下は 3 バイト、2097151 以下は 4 バイトです（480 PPQN なら 16 分音符 1 つ分で 2 バイト、8 小節以内で 3 バイト）。
+
+#include <stdint.h>
+
+class PackedSequence {
+public:
+  /**
+   * @brief 復号したイベント（time は先頭からの絶対時間）
+   */
+  struct Event {
+    uint32_t time;
+    uint8_t note;
+    bool noteOn;
+  };
+
+  /**
+   * @brief 先頭から順にイベントを復号する読み出し位置
+   *
+   * @details done() でなければ event() が現在のイベントを指します。advance() で次へ進みます。
+   *          シーケンスへ追記しても既存の Reader は追記前の末尾で止まります。
+   */
+  class Reader {
+  public:
+    Reader() : data(nullptr), pos(0), end(0), current{0, 0, false}, valid(false) {}
+    Reader(const uint8_t *bytes, uint16_t length) : data(bytes), pos(0), end(length), current{0, 0, false}, valid(false) {
+      advance();
+    }
+
+    bool done() const { return !valid; }
+    const Event &event() const { return current; }
+
+    /**
+     * @brief 次のイベントを復号する（末尾または壊れたデータなら done() になる）
+     */
+    void advance();
+
+    /**
+     * @brief バイト列を移した後で読み出し元を付け替える（位置と現在のイベントはそのまま）
+     */
+    void rebase(const uint8_t *bytes) { data = bytes; }
+
+  private:
+    const uint8_t *data;
+    uint16_t pos;
+    uint16_t end;
+    Event current;
+    bool valid;
+  };
+
+  // 差分時間 1 つの最大バイト数（32bit を 7bit ずつ）とイベント 1 つの最大バイト数
+  static constexpr uint8_t MAX_DELTA_BYTES = 5;
+  static constexpr uint8_t MAX_EVENT_BYTES = MAX_DELTA_BYTES + 1;
+
+  /**
+   * @brief 差分時間 delta のイベント 1 つを符号化したバイト数
+   */
+  static uint8_t encodedSize(uint32_t delta) {
+    uint8_t size = 2;
+    while (delta >>= 7) {
+      size++;
+    }
+    return size;
+  }
+
+  /**
+   * @param storage 格納先（呼び出し側が静的に確保する）
+   * @param capacity storage のバイト数
+   */
+  PackedSequence(uint8_t *storage, uint16_t capacity) : bytes(storage), capacityBytes(capacity) { clear(); }
+  PackedSequence() : bytes(nullptr), capacityBytes(0) { clear(); }
+
+  /**
+   * @brief 格納先を付け替えて空にする（配列で確保したシーケンスの初期化用）
+   */
+  void attach(uint8_t *storage, uint16_t capacity) {
+    bytes = storage;
+    capacityBytes = capacity;
+    clear();
+  }
+
+  /**
+   * @brief 呼び出し側が内容を storage へ移した後で格納先を付け替える（件数と末尾の時刻はそのまま）
+   *
+   * 複数のシーケンスで 1 つの領域を共有し、詰め直すときに使います。
+   * @param capacity bytesUsed() 以上
+   */
+  void relocate(uint8_t *storage, uint16_t capacity) {
+    bytes = storage;
+    capacityBytes = capacity;
+  }
+
+  /**
+   * @brief 別のシーケンスの内容をコピーする
+   * @return 容量が足りなければ false（内容は変更しない）
+   */
+  bool assign(const PackedSequence &other);
+
+  /**
+   * @brief 保存しておいたバイト列（data() の内容）を読み込む
+   *
+   * 復号しながら追記し直すので、件数と末尾の時刻も復元されます。
+   * @return 容量が足りないか、最後まで復号できなければ false（読めたところまでは残る）
+   */
+  bool load(const uint8_t *data, uint16_t length);
+
+  void clear() {
+    used = 0;
+    count = 0;
+    endTime = 0;
+  }
+
+  /**
+   * @brief イベントを末尾に追加する
+   *
+   * @param time 先頭からの絶対時間。直前のイベントより前の時刻は直前と同時刻として扱います。
+   * @return 容量が足りなければ false（何も書き込まない）
+   */
+  bool append(uint32_t time, uint8_t note, bool noteOn);
+
+  Reader reader() const { return Reader(bytes, used); }
+
+  uint16_t eventCount() const { return count; }
+  uint16_t bytesUsed() const { return used; }
+  uint16_t capacity() const { return capacityBytes; }
+  // 最後のイベントの時刻（空なら 0）
+  uint32_t lastTime() const { return endTime; }
+  const uint8_t *data() const { return bytes; }
+  // 格納先そのもの（領域を共有する呼び出し側が、relocate() の前後で内容を動かすときに使う）
+  uint8_t *data() { return bytes; }
+
+private:
+  uint8_t *bytes;
+  uint16_t capacityBytes;
+  uint16_t used;
+  uint16_t count;
+  uint32_t endTime;
+};
@@ -0,0 +1,46 @@
+#include "pot_filter.h"
+
+#include "config.h"
+
+namespace {
+uint16_t snapToEnds(uint16_t value) {
+  // 端から POT_HYSTERESIS / 2 以内は端の値にする（ノイズは端で片側に切られるので、平均は端まで届かない）。
+  // 幅をヒステリシスの半分にして、境目で止まっているポットが端とその手前を行き来しないようにする
+  constexpr uint16_t END_ZONE = POT_HYSTERESIS / 2;
+  if (value <= END_ZONE) {
+    return 0;
+  }
+  return value >= POT_MAX_VALUE - END_ZONE ? POT_MAX_VALUE : value;
+}
+}  // namespace
+
+void PotFilter::reset(uint16_t raw) {
+  smoothedQ4 = static_cast<uint32_t>(raw) << 4;
+  settled = snapToEnds(raw);
+}
+
+bool PotFilter::push(uint16_t raw) {
+  // ADC 値の取り込み
+  // 引数:
+  //   raw: potScanValue() の値
+  // 説明: 平滑化した値を目標との差の 1/2^POT_SMOOTHING_SHIFT ずつ近づけ（Q4 で保持して端数で止まらない
+  //   ようにする）、確定値との差が POT_HYSTERESIS を超えたら確定値をその値へ移します。
+  //   端 (0 と最大値) の近くは端の値とみなし、差が小さくても移すので、
+  //   ポットを回し切れば必ず端の値になります。
+  // 戻り値: 確定値が変わったら true
+  // 副作用: smoothedQ4, settled を更新する。
+  const int32_t target = static_cast<int32_t>(raw) << 4;
+  smoothedQ4 = static_cast<uint32_t>(static_cast<int32_t>(smoothedQ4) +
+                                     ((target - static_cast<int32_t>(smoothedQ4)) >> POT_SMOOTHING_SHIFT));
+  const uint16_t smoothed = snapToEnds(static_cast<uint16_t>((smoothedQ4 + 8) >> 4));
+  if (smoothed == settled) {
+    return false;
+  }
+  const uint16_t distance = smoothed > settled ? smoothed - settled : settled - smoothed;
+  const bool atEnd = smoothed == 0 || smoothed == POT_MAX_VALUE;
+  if (distance <= POT_HYSTERESIS && !atEnd) {
+    return false;
+  }
+  settled = smoothed;
+  return true;
+}
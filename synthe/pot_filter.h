@@ -0,0 +1,37 @@
+#pragma once
+
+// pot_filter.h
+// ポット 1 本分の平滑化とヒステリシス。pot_scan のオーバーサンプリングした値を整数の 1 次 IIR で平滑化し、確定値から
+// POT_HYSTERESIS を超えて離れたときだけ確定値を動かします。止まっているポットのノイズでは確定値が
+// 変わらないので、下流（エンベロープ時間、LFO、フィルタ係数）の計算はポットを動かしたときだけで済みます。
+
+#include <stdint.h>
+
+/**
+ * @brief ポット 1 本の入力フィルタ（ハードウェアに依存しない純粋な計算）
+ */
+class PotFilter {
+public:
+  PotFilter() { reset(0); }
+
+  /**
+   * @brief 平滑化の状態と確定値を raw に合わせる（起動直後の最初の読み取りに使う）
+   */
+  void reset(uint16_t raw);
+
+  /**
+   * @brief ポットの値を 1 つ取り込む
+   * @param raw potScanValue() の値（0..ANALOG_MAX_VALUE）
+   * @return 確定値が変わったら true
+   */
+  bool push(uint16_t raw);
+
+  /**
+   * @brief 確定値（0..ANALOG_MAX_VALUE）
+   */
+  uint16_t value() const { return settled; }
+
+private:
+  uint32_t smoothedQ4;  // 平滑化した値 (Q4)
+  uint16_t settled;
+};
@@ -0,0 +1,102 @@
+#include "pot_scan.h"
+
+#if defined(ARDUINO_ARCH_STM32)
+#include "synth_state.h"
+
+#include <Arduino.h>
+#include <pinmap.h>
+
+namespace {
+static_assert(ANALOG_INPUT_COUNT <= 16, "レギュラーチャンネルのスキャンは 16 本まで");
+
+// DMA が書く循環バッファ。1 行が 1 回のスキャン（analogPins の順）
+volatile uint16_t scanBuffer[POT_SCAN_SAMPLES][ANALOG_INPUT_COUNT];
+ADC_HandleTypeDef scanAdc = {};
+DMA_HandleTypeDef scanDma = {};
+bool scanRunning = false;
+
+bool configureChannel(uint8_t index) {
+  // analogPins[index] の ADC チャンネルをスキャンの index + 1 番目に登録し、ピンをアナログ入力にする
+  const PinName pin = analogInputToPinName(analogPins[index]);
+  if (pinmap_peripheral(pin, PinMap_ADC) != reinterpret_cast<void *>(ADC1)) {
+    return false;
+  }
+  pinmap_pinout(pin, PinMap_ADC);
+  ADC_ChannelConfTypeDef channel = {};
+  channel.Channel = STM_PIN_CHANNEL(pinmap_function(pin, PinMap_ADC));
+  channel.Rank = index + 1;
+  // ADC クロック 12MHz (PCLK2/6) で 1 変換 252 クロック = 21us。6 本 × 16 回で約 2ms ごとにバッファが一巡する
+  channel.SamplingTime = ADC_SAMPLETIME_239CYCLES_5;
+  return HAL_ADC_ConfigChannel(&scanAdc, &channel) == HAL_OK;
+}
+}  // namespace
+
+bool potScanBegin() {
+  // ADC スキャンの開始
+  // 引数: なし
+  // 説明: ADC1 を analogPins の全チャンネルのスキャン + 連続変換にし、DMA1 チャンネル 1 を循環モードで
+  //   scanBuffer へつなぎます。F103 の ADC にはハードウェアのオーバーサンプリングが無いので、
+  //   バッファ全体を読む側で足します（potScanValue）。DMA の割り込みは NVIC で有効にしないので CPU は止まりません。
+  // 戻り値: 設定できたら true
+  // 副作用: ADC1 と DMA1 チャンネル 1 を占有する。
+  __HAL_RCC_ADC1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  scanDma.Instance = DMA1_Channel1;
+  scanDma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  scanDma.Init.PeriphInc = DMA_PINC_DISABLE;
+  scanDma.Init.MemInc = DMA_MINC_ENABLE;
+  scanDma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  scanDma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  scanDma.Init.Mode = DMA_CIRCULAR;
+  scanDma.Init.Priority = DMA_PRIORITY_LOW;
+  if (HAL_DMA_Init(&scanDma) != HAL_OK) {
+    return false;
+  }
+  __HAL_LINKDMA(&scanAdc, DMA_Handle, scanDma);
+
+  scanAdc.Instance = ADC1;
+  scanAdc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+  scanAdc.Init.ScanConvMode = ADC_SCAN_ENABLE;
+  scanAdc.Init.ContinuousConvMode = ENABLE;
+  scanAdc.Init.NbrOfConversion = ANALOG_INPUT_COUNT;
+  scanAdc.Init.DiscontinuousConvMode = DISABLE;
+  scanAdc.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  if (HAL_ADC_Init(&scanAdc) != HAL_OK) {
+    return false;
+  }
+  for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; ++i) {
+    if (!configureChannel(i)) {
+      return false;
+    }
+  }
+  if (HAL_ADCEx_Calibration_Start(&scanAdc) != HAL_OK) {
+    return false;
+  }
+  if (HAL_ADC_Start_DMA(&scanAdc, const_cast<uint32_t *>(reinterpret_cast<volatile uint32_t *>(scanBuffer)),
+                        POT_SCAN_SAMPLES * ANALOG_INPUT_COUNT) != HAL_OK) {
+    return false;
+  }
+  scanRunning = true;
+  return true;
+}
+
+uint16_t potScanValue(uint8_t index) {
+  // オーバーサンプリングした値
+  // 引数:
+  //   index: analogPins のインデックス
+  // 説明: バッファにあるこのチャンネルの POT_SCAN_SAMPLES 回分の変換を足し、POT_OVERSAMPLE_BITS だけ
+  //   右シフトします（4^n 回の和を n ビット落とすと、ノイズでディザされた n ビット分の分解能が残る）。
+  //   DMA が書いている途中の行は前の周回の値と混ざりますが、どちらも数 ms 以内の変換です。
+  // 戻り値: 0..POT_MAX_VALUE
+  // 副作用: なし
+  if (!scanRunning || index >= ANALOG_INPUT_COUNT) {
+    return 0;
+  }
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < POT_SCAN_SAMPLES; ++i) {
+    sum += scanBuffer[i][index];
+  }
+  return static_cast<uint16_t>(sum >> POT_OVERSAMPLE_BITS);
+}
+#endif
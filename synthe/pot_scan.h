@@ -0,0 +1,31 @@
+#pragma once
+
+// pot_scan.h
+// 6 本のポット (analogPins) の読み取り。実機は ADC1 をスキャン + 連続変換モードで回し、DMA が循環バッファへ
+// 書き続けます（pot_scan.cpp）。コントロールティックはバッファに溜まった変換を足してオーバーサンプリングした
+// 整数値を読むだけなので、変換を待ちません。
+// ホストは同じ関数を ADC エミュレータ（host/adc_emulator.cpp）が実装し、スクリプトのポット値や
+// 記録したポットのトレースから同じ値を作ります。
+
+#include "config.h"
+
+#include <stdint.h>
+
+// チャンネルごとに足す変換の数（4^POT_OVERSAMPLE_BITS）
+constexpr uint8_t POT_SCAN_SAMPLES = 1u << (2 * POT_OVERSAMPLE_BITS);
+
+/**
+ * @brief ADC と DMA を設定してスキャンを始める
+ *
+ * これ以降 ADC1 はスキャン専用になるので、analogRead() は呼ばないでください。
+ * @return 設定できたら true（失敗したら potScanValue() は 0 を返す）
+ */
+bool potScanBegin();
+
+/**
+ * @brief ポットの値（0..POT_MAX_VALUE）
+ *
+ * 直近 POT_SCAN_SAMPLES 回の変換を足し、POT_OVERSAMPLE_BITS だけ分解能を上げた値です。
+ * @param index analogPins のインデックス
+ */
+uint16_t potScanValue(uint8_t index);
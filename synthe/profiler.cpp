@@ -0,0 +1,147 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+constexpr uint8_t STAGE_COUNT = static_cast<uint8_t>(ProfileStage::Count);
+
+const char *const STAGE_NAMES[STAGE_COUNT] = {
+    "AUD", "ANA", "KEY", "SW", "MIDI", "SEQ", "DISP", "FFT", "CTRL",
+};
+
+ProfileStats stats[STAGE_COUNT];
+uint32_t audioMisses = 0;
+uint32_t controlMisses = 0;
+bool pageVisible = false;
+
+void clearStats() {
+  for (uint8_t i = 0; i < STAGE_COUNT; ++i) {
+    stats[i].minCycles = UINT32_MAX;
+    stats[i].maxCycles = 0;
+    stats[i].totalCycles = 0;
+    stats[i].calls = 0;
+  }
+  audioMisses = 0;
+  controlMisses = 0;
+}
+
+struct StatsInitializer {
+  StatsInitializer() { clearStats(); }
+} statsInitializer;
+}  // namespace
+
+#if defined(PROFILE_CYCLES)
+namespace {
+// 前回のコントロールティック以降に updateAudio() が使ったサイクル数
+uint32_t audioCyclesThisTick = 0;
+}  // namespace
+
+void profileEnd(ProfileStage stage, uint32_t startCycles) {
+  // 計測区間の記録
+  // 引数:
+  //   stage: 計測区間
+  //   startCycles: profileBegin() の戻り値
+  // 説明: 経過サイクル数で最小/最大/合計を更新します。Audio は 1 ブロック周期、
+  //   ControlTick はそのティックのオーディオ処理を含めて 1 ティック周期を超えたら超過として数えます。
+  // 戻り値: なし
+  // 副作用: stats とデッドライン超過回数を更新する。
+  const uint32_t elapsed = cycleCount() - startCycles;
+  ProfileStats &s = stats[static_cast<uint8_t>(stage)];
+  if (elapsed < s.minCycles) {
+    s.minCycles = elapsed;
+  }
+  if (elapsed > s.maxCycles) {
+    s.maxCycles = elapsed;
+  }
+  s.totalCycles += elapsed;
+  s.calls++;
+
+  if (stage == ProfileStage::Audio) {
+    audioCyclesThisTick += elapsed;
+    if (elapsed > AUDIO_BLOCK_CYCLES) {
+      audioMisses++;
+    }
+  } else if (stage == ProfileStage::ControlTick) {
+    if (elapsed + audioCyclesThisTick > CONTROL_TICK_CYCLES) {
+      controlMisses++;
+    }
+    audioCyclesThisTick = 0;
+  }
+}
+#endif
+
+const ProfileStats &profileStats(ProfileStage stage) {
+  return stats[static_cast<uint8_t>(stage)];
+}
+
+const char *profileStageName(ProfileStage stage) {
+  return STAGE_NAMES[static_cast<uint8_t>(stage)];
+}
+
+uint32_t profileDeadlineMisses(ProfileStage stage) {
+  if (stage == ProfileStage::Audio) {
+    return audioMisses;
+  }
+  if (stage == ProfileStage::ControlTick) {
+    return controlMisses;
+  }
+  return 0;
+}
+
+void resetProfile() {
+  clearStats();
+}
+
+void printProfileReport(Print &out) {
+  // 統計の出力
+  // 引数:
+  //   out: 出力先（Serial など）
+  // 説明: 区間ごとに呼び出し回数と最小/平均/最大サイクル数を 1 行ずつ出力し、
+  //   最後にデッドライン超過回数とそれぞれの予算（サイクル数）を出力します。
+  // 戻り値: なし
+  // 副作用: out へ書き込む。
+  char line[64];
+  out.println("stage      calls      min      avg      max  (cycles)");
+  for (uint8_t i = 0; i < STAGE_COUNT; ++i) {
+    const ProfileStats &s = stats[i];
+    const unsigned long avg = s.calls ? static_cast<unsigned long>(s.totalCycles / s.calls) : 0;
+    snprintf(line, sizeof(line), "%-5s %10lu %8lu %8lu %8lu", STAGE_NAMES[i], static_cast<unsigned long>(s.calls),
+             s.calls ? static_cast<unsigned long>(s.minCycles) : 0UL, avg, static_cast<unsigned long>(s.maxCycles));
+    out.println(line);
+  }
+  snprintf(line, sizeof(line), "misses audio %lu (>%lu) control %lu (>%lu)", static_cast<unsigned long>(audioMisses),
+           static_cast<unsigned long>(AUDIO_BLOCK_CYCLES), static_cast<unsigned long>(controlMisses),
+           static_cast<unsigned long>(CONTROL_TICK_CYCLES));
+  out.println(line);
+}
+
+bool handleProfileCommand(const char *line) {
+  // 計測用シリアルコマンドの実行
+  // 引数:
+  //   line: 改行を除いた 1 行
+  // 戻り値: "prof" コマンドなら true
+  // 副作用: 統計のクリア、デバッグページの切り替え、Serial への出力を行う。
+  if (strncmp(line, "prof", 4) != 0 || (line[4] != '\0' && line[4] != ' ')) {
+    return false;
+  }
+  if (line[4] == '\0') {
+    printProfileReport(Serial);
+  } else if (strcmp(line + 5, "reset") == 0) {
+    resetProfile();
+    Serial.println("prof: reset");
+  } else if (strcmp(line + 5, "page") == 0) {
+    toggleProfilePage();
+  } else {
+    Serial.println("prof: commands are 'prof', 'prof reset', 'prof page'");
+  }
+  return true;
+}
+
+void toggleProfilePage() {
+  pageVisible = !pageVisible;
+}
+
+bool isProfilePageVisible() {
+  return pageVisible;
+}
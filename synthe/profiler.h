@@ -0,0 +1,109 @@
+#pragma once
+
+// profiler.h
+// updateAudio() と updateControl() の各段のサイクル数（最小/平均/最大）とデッドライン超過を記録します。
+// 計測値は cycle_counter.h のサイクル数（実機は DWT、ホストは実時間換算）です。
+// 結果はシリアルコマンド（"prof"、serial_console.h）と OLED のデバッグページで確認できます。
+
+#include "config.h"
+#include "cycle_counter.h"
+
+#include <Arduino.h>
+
+/**
+ * @brief 計測区間
+ */
+enum class ProfileStage : uint8_t {
+  Audio,           // updateAudio() 1 回（ブロック生成を含む呼び出しが最大値になる）
+  ReadAnalogs,
+  ScanKeyboard,
+  ReadSwitches,
+  HandleMidi,
+  UpdateSequencer,
+  UpdateDisplay,
+  ComputeFft,
+  ControlTick,     // updateControl() 全体
+  Count
+};
+
+/**
+ * @brief 計測区間ごとの統計
+ */
+struct ProfileStats {
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+  uint32_t calls;
+};
+
+// 1 コントロールティックに使える CPU サイクル数
+constexpr uint32_t CONTROL_TICK_CYCLES = static_cast<uint32_t>(CPU_CLOCK_HZ / MOZZI_CONTROL_RATE);
+
+#if defined(PROFILE_CYCLES)
+/**
+ * @brief 計測開始時刻を返す
+ */
+inline uint32_t profileBegin() {
+  return cycleCount();
+}
+
+/**
+ * @brief 計測区間を終えて統計に加える
+ *
+ * Audio はブロック周期 (AUDIO_BLOCK_CYCLES) を、ControlTick はそのティック中の
+ * オーディオ処理と合わせてティック周期 (CONTROL_TICK_CYCLES) を超えたらデッドライン超過として数えます。
+ * @param stage 計測区間
+ * @param startCycles profileBegin() の戻り値
+ */
+void profileEnd(ProfileStage stage, uint32_t startCycles);
+#else
+inline uint32_t profileBegin() {
+  return 0;
+}
+inline void profileEnd(ProfileStage, uint32_t) {}
+#endif
+
+/**
+ * @brief 計測区間の統計を返す
+ */
+const ProfileStats &profileStats(ProfileStage stage);
+
+/**
+ * @brief 計測区間の短い表示名を返す（OLED/シリアル用）
+ */
+const char *profileStageName(ProfileStage stage);
+
+/**
+ * @brief デッドライン超過の回数を返す
+ * @param stage ProfileStage::Audio または ProfileStage::ControlTick（それ以外は 0）
+ */
+uint32_t profileDeadlineMisses(ProfileStage stage);
+
+/**
+ * @brief 統計とデッドライン超過回数をクリアする
+ */
+void resetProfile();
+
+/**
+ * @brief 統計を 1 区間 1 行で出力する
+ */
+void printProfileReport(Print &out);
+
+/**
+ * @brief 計測用のシリアルコマンドを処理する
+ *
+ * "prof" で統計を出力、"prof reset" でクリア、"prof page" で OLED のデバッグページを切り替えます。
+ * @param line 改行を除いた 1 行
+ * @return "prof" で始まる行なら true（処理済み）
+ */
+bool handleProfileCommand(const char *line);
+
+/**
+ * @brief OLED のデバッグページ表示を切り替える
+ */
+void toggleProfilePage();
+
+/**
+ * @brief デバッグページを表示中かどうか
+ */
+bool isProfilePageVisible();
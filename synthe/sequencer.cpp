@@ -1,46 +1,154 @@
 #include "sequencer.h"
 
 #include "audio_engine.h"
+#include "packed_sequence.h"
 #include "synth_state.h"
+#include "voice_manager.h"
 
 #include <Arduino.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace {
-struct SequencerEvent {
+// ---- テンポとティック ----
+// イベントは小節の頭を 0 とするティック (SEQ_PPQN / 四分音符) で保持し、再生時にサンプル時刻へ換算する。
+constexpr uint32_t TICKS_PER_BAR = static_cast<uint32_t>(SEQ_PPQN) * SEQ_BEATS_PER_BAR;
+// スウィングをかける音価（16 分音符）。2 つで 1 組にして、後ろ側を遅らせる。
+constexpr uint32_t SWING_GRID_TICKS = SEQ_PPQN / 4;
+
+// 再生イベントを先行して予約する範囲。次のコントロールティックまで（ブロックの先行生成分を含む）。
+constexpr uint32_t SCHEDULE_AHEAD_SAMPLES = AUDIO_RATE / MOZZI_CONTROL_RATE + AUDIO_BLOCK_SIZE;
+
+float tempoBpm = SEQ_DEFAULT_BPM;
+// 1 ティックあたりのサンプル数 (Q16.16)
+uint32_t samplesPerTickQ16 = 0;
+// ティックとサンプル時刻の対応点（再生開始やテンポ変更のときに現在位置で付け替える）
+uint32_t anchorSample = 0;
+uint32_t anchorTick = 0;
+
+// 入力クオンタイズの単位（ティック、0 で無効）とスウィング量（50 で無効、後ろの 16 分の位置を % で表す）
+uint16_t quantizeTicks = 0;
+uint8_t swingPercent = 50;
+
+// ---- トラック ----
+// 録音中のイベント。時刻順に挿入しておき、ループ 1 周ごと・満杯・録音終了のときにトラックへマージする。
+// 演奏入力は renderBlock() からも届くので、recordEvent() は挿入と印付けだけを行い、
+// マージは updateSequencer()（コントロールの文脈）が行う。
+struct RecordedEvent {
+  uint32_t tick;
   uint8_t note;
   bool noteOn;
-  uint32_t timestamp;
+  bool nextPass;  // 周回が変わってからマージまでの間に録った（次の周回のマージに回す）
 };
+constexpr uint8_t TAKE_CAPACITY = 64;
+RecordedEvent take[TAKE_CAPACITY];
+uint8_t takeCount = 0;
+// 録音中のループの周回（通算ティック / loopTicks）。変わったらマージする。
+uint32_t takePass = 0;
+// 周回が変わったか録音バッファが満杯になった（updateSequencer() がマージする）
+bool takeFlushPending = false;
+// 周回が変わってまだマージしていない（この間のイベントに nextPass を付ける）
+bool takePassChanged = false;
+// マージを待つ間に録音バッファが満杯で捨てたイベントの数
+uint16_t takeDropped = 0;
 
-constexpr uint16_t MAX_SEQ_EVENTS = 256;
-SequencerEvent sequenceBuffer[MAX_SEQ_EVENTS];
-uint16_t sequenceLength = 0;
-uint32_t sequenceDuration = 0;
+// 全トラックで共有するイベント領域（SEQ_STORE_BYTES から録音バッファ分を除く）。
+// トラックは番号順に隙間なく並び、空きは最後に書き込んだトラックの直後にまとめて置く（makeRoomAfter()）。
+constexpr uint16_t POOL_BYTES = SEQ_STORE_BYTES - sizeof(take);
+uint8_t trackPool[POOL_BYTES];
 
-bool sequencerRecording = false;
-bool sequencerPlaying = false;
+struct Track {
+  PackedSequence events;          // ループ先頭からのティック
+  PackedSequence::Reader reader;  // 次に予約するイベント
+  uint32_t loopBase;              // 現在の周回の先頭（再生開始からの通算ティック）
+  uint32_t activeNotes[4];        // ノートオンを予約済みでノートオフをまだ予約していないノート（128bit）
+  bool muted;
+  bool soloed;
+};
+Track tracks[SEQ_TRACK_COUNT];
+// 録音をトラックへマージできなかった（領域が足りない）。トラックを消すまで表示する
+bool storeFull = false;
+// トラックの内容の版。内容を変えるたびに増やし、分けて保存したレコードが同じ時点のものか確かめる
+uint16_t contentRevision = 0;
+
+struct TrackInitializer {
+  TrackInitializer() {
+    for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+      tracks[t].events.attach(trackPool, 0);
+    }
+    tracks[SEQ_TRACK_COUNT - 1].events.attach(trackPool, POOL_BYTES);
+  }
+} trackInitializer;
 
-uint32_t recordStartMs = 0;
-uint32_t playbackStartMs = 0;
-uint16_t playbackIndex = 0;
+uint16_t poolUsed() {
+  uint16_t used = 0;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    used += tracks[t].events.bytesUsed();
+  }
+  return used;
+}
 
-uint32_t sequenceOriginalTimestamp[MAX_SEQ_EVENTS];
+void placeTrack(Track &track, uint16_t offset, uint16_t capacity) {
+  // トラックの内容を trackPool の offset へ移し、格納先と読み出し位置を付け替える
+  uint8_t *storage = trackPool + offset;
+  memmove(storage, track.events.data(), track.events.bytesUsed());
+  track.events.relocate(storage, capacity);
+  track.reader.rebase(storage);
+}
+
+void makeRoomAfter(uint8_t t) {
+  // トラック t の直後に空きを集める
+  // 引数:
+  //   t: これから追記/マージするトラック
+  // 説明: t 以前のトラックを領域の先頭から、t より後のトラックを末尾から詰め直します。
+  //   前側は番号の小さい順に下へ、後ろ側は大きい順に上へしか動かないので、memmove で重なっても壊れません。
+  //   t の容量は次のトラックの先頭までになり、他のトラックの容量は使用量ちょうどです
+  //   （別のトラックへ書き足すときは、先にこの関数で空きを寄せ直す）。
+  // 戻り値: なし
+  // 副作用: trackPool の内容と各トラックの格納先・読み出し位置を更新する。
+  uint16_t offset = 0;
+  for (uint8_t i = 0; i <= t; ++i) {
+    const uint16_t used = tracks[i].events.bytesUsed();
+    placeTrack(tracks[i], offset, used);
+    offset += used;
+  }
+  uint16_t top = POOL_BYTES;
+  for (uint8_t i = SEQ_TRACK_COUNT - 1; i > t; --i) {
+    const uint16_t used = tracks[i].events.bytesUsed();
+    top -= used;
+    placeTrack(tracks[i], top, used);
+  }
+  tracks[t].events.relocate(trackPool + offset - tracks[t].events.bytesUsed(),
+                            static_cast<uint16_t>(top - (offset - tracks[t].events.bytesUsed())));
+}
+
+// 全トラック共通のループ長（ティック、0 ならまだ最初の録音をしていない）
+uint32_t loopTicks = 0;
+uint8_t selectedTrack = 0;
+uint8_t recordTrack = 0;
+// ループ長を決める最初の録音中
+bool firstTake = false;
+// この通算ティック未満のイベントは予約済み
+uint32_t scheduledUntilTick = 0;
+
+// 次のイベント時刻が早い順にトラック番号を並べた二分ヒープ（トラック数に対して O(log n) で取り出す）
+uint8_t trackHeap[SEQ_TRACK_COUNT];
+
+// ノートオンをクオンタイズでずらした量（ノート番号ごと）。ノートオフも同じだけずらして音の長さを保つ。
+// 同時に押せる数に上限を設けないよう全ノート分を持つ（ずれはクオンタイズ単位の半分までなので int16_t に入る）。
+int16_t quantizeShifts[128];
+
+bool sequencerRecording = false;
+bool sequencerPlaying = false;
 
 uint8_t heldNotes[KEY_COUNT];
 uint8_t heldCount = 0;
 
-uint8_t activeSequencerNotes[KEY_COUNT];
-uint8_t activeSequencerCount = 0;
-
 bool randomNoteActive = false;
 uint8_t randomNoteValue = 0;
 uint32_t randomNoteStart = 0;
 
-float midiToFreq(float note) {
-  return 440.0f * powf(2.0f, (note - 69.0f) / 12.0f);
-}
-
 void pushHeld(uint8_t note) {
   if (heldCount < KEY_COUNT) {
     heldNotes[heldCount++] = note;
@@ -59,192 +167,625 @@ void popHeld(uint8_t note) {
   }
 }
 
-uint8_t currentHeldNote() {
-  return heldCount == 0 ? 0 : heldNotes[heldCount - 1];
+// ---- 時間の換算 ----
+void updateSamplesPerTick() {
+  samplesPerTickQ16 = static_cast<uint32_t>((AUDIO_RATE * 60.0f * 65536.0f) / (tempoBpm * SEQ_PPQN));
 }
 
-void registerSequencerNote(uint8_t note) {
-  if (activeSequencerCount < KEY_COUNT) {
-    activeSequencerNotes[activeSequencerCount++] = note;
+struct TempoInitializer {
+  TempoInitializer() { updateSamplesPerTick(); }
+} tempoInitializer;
+
+uint32_t tickAt(uint32_t sample) {
+  int32_t delta = static_cast<int32_t>(sample - anchorSample);
+  uint64_t magnitude = (static_cast<uint64_t>(delta < 0 ? -static_cast<int64_t>(delta) : delta) << 16) / samplesPerTickQ16;
+  return delta < 0 ? anchorTick - static_cast<uint32_t>(magnitude) : anchorTick + static_cast<uint32_t>(magnitude);
+}
+
+uint32_t sampleAt(uint32_t tick) {
+  int64_t delta = static_cast<int32_t>(tick - anchorTick);
+  return anchorSample + static_cast<uint32_t>((delta * samplesPerTickQ16) >> 16);
+}
+
+uint32_t swingTick(uint32_t tick) {
+  // 16 分の組の後ろ側を swingPercent の位置まで遅らせる（組の中で区分線形に写す）
+  if (swingPercent == 50) {
+    return tick;
+  }
+  const uint32_t pair = SWING_GRID_TICKS * 2;
+  const uint32_t split = pair * swingPercent / 100;
+  const uint32_t x = tick % pair;
+  const uint32_t y = x < SWING_GRID_TICKS ? x * split / SWING_GRID_TICKS
+                                          : split + (x - SWING_GRID_TICKS) * (pair - split) / SWING_GRID_TICKS;
+  return tick - x + y;
+}
+
+uint32_t unswingTick(uint32_t tick) {
+  // swingTick() の逆写像（録音した時刻をスウィング前のグリッドへ戻す）
+  if (swingPercent == 50) {
+    return tick;
+  }
+  const uint32_t pair = SWING_GRID_TICKS * 2;
+  const uint32_t split = pair * swingPercent / 100;
+  const uint32_t y = tick % pair;
+  const uint32_t x = y < split ? y * SWING_GRID_TICKS / split
+                               : SWING_GRID_TICKS + (y - split) * SWING_GRID_TICKS / (pair - split);
+  return tick - y + x;
+}
+
+// ---- ミュート/ソロと発音中ノート ----
+bool anySoloed() {
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    if (tracks[t].soloed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isTrackAudible(uint8_t t) {
+  return !tracks[t].muted && (tracks[t].soloed || !anySoloed());
+}
+
+void setActive(Track &track, uint8_t note, bool active) {
+  uint32_t bit = 1UL << (note & 31);
+  if (active) {
+    track.activeNotes[note >> 5] |= bit;
+  } else {
+    track.activeNotes[note >> 5] &= ~bit;
+  }
+}
+
+bool isActive(const Track &track, uint8_t note) {
+  return (track.activeNotes[note >> 5] & (1UL << (note & 31))) != 0;
+}
+
+uint8_t activeCount(const Track &track) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    for (uint32_t bits = track.activeNotes[i]; bits != 0; bits &= bits - 1) {
+      count++;
+    }
   }
+  return count;
 }
 
-void unregisterSequencerNote(uint8_t note) {
-  for (uint8_t i = 0; i < activeSequencerCount; ++i) {
-    if (activeSequencerNotes[i] == note) {
-      for (uint8_t j = i; j < activeSequencerCount - 1; ++j) {
-        activeSequencerNotes[j] = activeSequencerNotes[j + 1];
+bool scheduleTrackRelease(Track &track, uint32_t sample) {
+  // トラックで鳴り残っているノートのノートオフを予約する（全件入らなければ何もしない）
+  if (scheduledNoteSpace() < activeCount(track)) {
+    return false;
+  }
+  for (uint8_t note = 0; note < 128; ++note) {
+    if (isActive(track, note)) {
+      scheduleNoteEvent(sample, note, false);
+      setActive(track, note, false);
+    }
+  }
+  return true;
+}
+
+void releaseAllSequencerNotes() {
+  // 予約済みイベントを破棄し、再生で鳴っているノートをすべてその場で止める
+  flushScheduledNotes();
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    for (uint8_t note = 0; note < 128; ++note) {
+      if (isActive(tracks[t], note)) {
+        playSequencerNote(note, false);
       }
-      activeSequencerCount--;
-      break;
     }
+    memset(tracks[t].activeNotes, 0, sizeof(tracks[t].activeNotes));
   }
 }
 
-void clearActiveSequencerNotes() {
-  while (activeSequencerCount > 0) {
-    uint8_t note = activeSequencerNotes[activeSequencerCount - 1];
-    handleNoteOff(note);
-    activeSequencerCount--;
+// ---- イベントのマージ用優先度キュー ----
+uint32_t trackKey(uint8_t t) {
+  // 次に処理する時刻（通算ティック）。イベントが尽きたトラックはループ終端。
+  const Track &track = tracks[t];
+  return track.reader.done() ? track.loopBase + loopTicks : track.loopBase + track.reader.event().time;
+}
+
+bool keyLess(uint8_t a, uint8_t b) {
+  return static_cast<int32_t>(trackKey(a) - trackKey(b)) < 0;
+}
+
+void siftDown(uint8_t i) {
+  for (;;) {
+    uint8_t smallest = i;
+    uint8_t left = static_cast<uint8_t>(i * 2 + 1);
+    uint8_t right = static_cast<uint8_t>(i * 2 + 2);
+    if (left < SEQ_TRACK_COUNT && keyLess(trackHeap[left], trackHeap[smallest])) {
+      smallest = left;
+    }
+    if (right < SEQ_TRACK_COUNT && keyLess(trackHeap[right], trackHeap[smallest])) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    uint8_t tmp = trackHeap[i];
+    trackHeap[i] = trackHeap[smallest];
+    trackHeap[smallest] = tmp;
+    i = smallest;
+  }
+}
+
+void rebuildHeap() {
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    trackHeap[t] = t;
+  }
+  for (int8_t i = SEQ_TRACK_COUNT / 2 - 1; i >= 0; --i) {
+    siftDown(static_cast<uint8_t>(i));
+  }
+}
+
+void seekTrack(Track &track) {
+  // 予約済みの位置（scheduledUntilTick）の次のイベントへ読み出し位置を合わせる
+  track.reader = track.events.reader();
+  if (!sequencerPlaying) {
+    return;
+  }
+  const int32_t position = static_cast<int32_t>(scheduledUntilTick - track.loopBase);
+  while (!track.reader.done() && static_cast<int32_t>(track.reader.event().time) < position) {
+    track.reader.advance();
+  }
+}
+
+void rewindTracks() {
+  // 全トラックを通算ティック 0 から再生し直す状態にする
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    tracks[t].loopBase = 0;
+    tracks[t].reader = tracks[t].events.reader();
+  }
+  scheduledUntilTick = 0;
+  rebuildHeap();
+}
+
+bool allTracksEmpty() {
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    if (tracks[t].events.eventCount() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---- 録音 ----
+uint8_t nextMerged(uint8_t i, bool wholeTake) {
+  // i 以降で今回マージする録音イベントの位置（なければ takeCount）
+  while (i < takeCount && take[i].nextPass && !wholeTake) {
+    ++i;
+  }
+  return i;
+}
+
+bool takeFits(const PackedSequence &events, uint16_t gap, bool wholeTake) {
+  // マージの結果が空きに収まるかを、書き込まずに確かめる
+  // 引数:
+  //   events: 録音先トラック
+  //   gap: トラックの直後の空き（バイト）
+  //   wholeTake: nextPass のイベントもマージするなら true
+  // 説明: flushTake() は既存のイベントを空きの分だけ後ろへずらし、先頭から併合し直します。
+  //   併合した列を書いた位置が、まだ読んでいない既存のイベントの位置を越えないことを、
+  //   符号化したバイト数だけを数えて確かめます（最後の時点の条件が「全体が収まる」と同じ）。
+  // 戻り値: マージできるなら true
+  // 副作用: なし
+  PackedSequence::Reader reader = events.reader();
+  uint32_t written = 0;
+  uint32_t consumed = 0;
+  uint32_t lastWritten = 0;
+  uint32_t lastRead = 0;
+  uint8_t i = nextMerged(0, wholeTake);
+  while (!reader.done() || i < takeCount) {
+    uint32_t time;
+    if (reader.done() || (i < takeCount && take[i].tick < reader.event().time)) {
+      time = take[i].tick;
+      i = nextMerged(i + 1, wholeTake);
+    } else {
+      time = reader.event().time;
+      consumed += PackedSequence::encodedSize(time - lastRead);
+      lastRead = time;
+      reader.advance();
+    }
+    time = max(time, lastWritten);
+    written += PackedSequence::encodedSize(time - lastWritten);
+    lastWritten = time;
+    if (written > gap + consumed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool flushTake(bool wholeTake) {
+  // 録音バッファを録音先トラックへマージする（コントロールの文脈でだけ呼ぶ）
+  // 引数:
+  //   wholeTake: nextPass のイベントもマージするなら true（録音の終了時など）
+  // 説明: 空きを録音先トラックの直後へ寄せ、既存のイベント列を空きの末尾側へずらしてから、
+  //   録音バッファ（時刻順）と併合して領域の先頭から書き直します。作業用の領域は使わないので、
+  //   1 トラックで共有領域をすべて使えます。同時刻では既存のイベントを先にします。
+  //   nextPass のイベントは（wholeTake でなければ）印を外してバッファに残します。
+  //   入り切らない場合はトラックを変更せず、捨てた録音をシリアルへ知らせて storeFull を立てます。
+  // 戻り値: マージできたら true
+  // 副作用: trackPool と tracks[recordTrack] を更新し、読み出し位置とヒープを合わせ直す。
+  takeFlushPending = false;
+  takePassChanged = false;
+  if (takeDropped > 0) {
+    Serial.print("seq: take buffer full, ");
+    Serial.print(static_cast<unsigned int>(takeDropped));
+    Serial.println(" events dropped");
+    takeDropped = 0;
   }
+  if (takeCount == 0) {
+    return true;
+  }
+  Track &track = tracks[recordTrack];
+  makeRoomAfter(recordTrack);
+  const uint16_t used = track.events.bytesUsed();
+  const uint16_t capacity = track.events.capacity();
+  const uint16_t gap = capacity - used;
+  if (!takeFits(track.events, gap, wholeTake)) {
+    Serial.print("seq: store full, T");
+    Serial.print(static_cast<unsigned int>(recordTrack + 1));
+    Serial.print(" take of ");
+    Serial.print(static_cast<unsigned int>(takeCount));
+    Serial.println(" events not recorded");
+    storeFull = true;
+    takeCount = 0;
+    return false;
+  }
+
+  uint8_t *region = track.events.data();
+  memmove(region + gap, region, used);
+  PackedSequence::Reader reader(region + gap, used);
+  track.events.attach(region, capacity);
+  uint8_t i = nextMerged(0, wholeTake);
+  while (!reader.done() || i < takeCount) {
+    if (reader.done() || (i < takeCount && take[i].tick < reader.event().time)) {
+      track.events.append(take[i].tick, take[i].note, take[i].noteOn);
+      i = nextMerged(i + 1, wholeTake);
+    } else {
+      const PackedSequence::Event &evt = reader.event();
+      track.events.append(evt.time, evt.note, evt.noteOn);
+      reader.advance();
+    }
+  }
+  uint8_t kept = 0;
+  for (i = 0; i < takeCount && !wholeTake; ++i) {
+    if (take[i].nextPass) {
+      take[kept] = take[i];
+      take[kept++].nextPass = false;
+    }
+  }
+  takeCount = kept;
+  contentRevision++;
+  seekTrack(track);
+  rebuildHeap();
+  return true;
 }
 
-void finalizeSequence() {
-  if (sequenceLength == 0) {
-    sequenceDuration = 0;
+int16_t takeQuantizeShift(uint8_t note) {
+  const int16_t shift = quantizeShifts[note & 0x7F];
+  quantizeShifts[note & 0x7F] = 0;
+  return shift;
+}
+
+void recordEvent(uint8_t note, bool noteOn) {
+  // 演奏したノートを録音バッファへ追加する
+  // 引数:
+  //   note: MIDI ノート番号
+  //   noteOn: ノートオンなら true
+  // 説明: 現在のサンプル時刻をティックに換算し、スウィングを戻してからノートオンをクオンタイズします
+  //   （ノートオフは対応するノートオンと同じだけずらす）。renderBlock() からも呼ばれるので
+  //   トラックへはマージせず、ループの周回が変わったときと満杯のときは takeFlushPending を立てて
+  //   updateSequencer() に任せます。周回が変わってからマージまでのイベントには nextPass を付け、
+  //   マージを待つ間に満杯ならイベントを捨てて数えます。
+  // 戻り値: なし
+  // 副作用: take, quantizeShifts, takeFlushPending, takeDropped を更新する。
+  uint32_t tick = tickAt(audioSampleClock());
+  if (loopTicks > 0) {
+    uint32_t pass = tick / loopTicks;
+    if (pass != takePass) {
+      takePass = pass;
+      takePassChanged = true;
+      takeFlushPending = true;
+    }
+    tick %= loopTicks;
+  }
+  int32_t position = static_cast<int32_t>(unswingTick(tick));
+
+  if (noteOn) {
+    int16_t shift = 0;
+    if (quantizeTicks > 0) {
+      int32_t snapped = (position + quantizeTicks / 2) / quantizeTicks * quantizeTicks;
+      shift = static_cast<int16_t>(snapped - position);
+    }
+    quantizeShifts[note & 0x7F] = shift;
+    position += shift;
+  } else {
+    position += takeQuantizeShift(note);
+  }
+  if (loopTicks > 0) {
+    if (position < 0) {
+      position += static_cast<int32_t>(loopTicks);
+    } else if (static_cast<uint32_t>(position) >= loopTicks) {
+      position -= static_cast<int32_t>(loopTicks);
+    }
+  } else if (position < 0) {
+    position = 0;
+  }
+
+  if (takeCount == TAKE_CAPACITY) {
+    takeDropped++;
+    takeFlushPending = true;
     return;
   }
-  for (uint16_t i = 0; i < sequenceLength; ++i) {
-    sequenceOriginalTimestamp[i] = sequenceBuffer[i].timestamp;
+  uint8_t i = takeCount++;
+  while (i > 0 && take[i - 1].tick > static_cast<uint32_t>(position)) {
+    take[i] = take[i - 1];
+    --i;
+  }
+  take[i] = {static_cast<uint32_t>(position), note, noteOn, takePassChanged};
+  if (takeCount == TAKE_CAPACITY) {
+    takeFlushPending = true;
+  }
+}
+
+void serviceTake() {
+  // 予約されたマージを行い、できなければ録音を終える（updateSequencer() から）
+  if (sequencerRecording && takeFlushPending && !flushTake(false)) {
+    endRecording();
+  }
+}
+
+void resetLoopIfEmpty() {
+  if (allTracksEmpty()) {
+    loopTicks = 0;
+    sequencerPlaying = false;
   }
-  sequenceDuration = sequenceOriginalTimestamp[sequenceLength - 1] + 1;
 }
 }  // namespace
 
-void handleNoteOn(uint8_t note) {
-  // ポリフォニー対応ノートオン処理
-  // 動作: 空きボイスを探して割り当て、対応する voiceTargetFreq とエンベロープをトリガーする。
+void handleNoteOn(uint8_t note, uint8_t velocity) {
+  // ポリフォニー対応ノートオン処理（演奏入力）
+  // 動作: ボイスマネージャでボイスを割り当て（必要なら奪い）、周波数とエンベロープをトリガーする。
+  //   録音中なら録音先トラックへ記録する。
   pushHeld(note);
-  // 単純なボイスアロケータ: 空きボイスを探すか、最初のボイスを奪う
-  int8_t slot = -1;
-  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-    if (!voiceActive[i]) { slot = i; break; }
-  }
-  if (slot == -1) slot = 0;
-  voiceNote[slot] = note;
-  voiceTargetFreq[slot] = midiToFreq(static_cast<float>(note) + params.pitchOffset);
-  voiceActive[slot] = true;
-  // トリガー: 各ボイスの ADSR に対して noteOn
-  envelopeInstance[slot].noteOn();
+  voiceNoteOn(note, velocity);
 
-  if (sequencerRecording && sequenceLength < MAX_SEQ_EVENTS) {
-    sequenceBuffer[sequenceLength++] = {note, true, millis() - recordStartMs};
+  if (sequencerRecording) {
+    recordEvent(note, true);
   }
 }
 
 void handleNoteOff(uint8_t note) {
-  // ポリフォニー対応ノートオフ処理
+  // ポリフォニー対応ノートオフ処理（演奏入力）
   popHeld(note);
-  if (sequencerRecording && sequenceLength < MAX_SEQ_EVENTS) {
-    sequenceBuffer[sequenceLength++] = {note, false, millis() - recordStartMs};
+  if (sequencerRecording) {
+    recordEvent(note, false);
   }
 
-  // ノート番号に割り当てられたボイスを探索してリリースする
-  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-    if (voiceActive[i] && voiceNote[i] == note) {
-      // ADSR をオフにしてボイスを非アクティブにする（発音の終了は ADSR に依存）
-  envelopeInstance[i].noteOff();
-      voiceActive[i] = false;
-      break;
-    }
-  }
+  // ノート番号に割り当てられたボイスをリリースへ移す。
+  // ボイスはエンベロープのリリースが終わるまで鳴り続け、updateVoices() が解放する。
+  voiceNoteOff(note);
+}
 
-  // もう保持ノートが無ければ（全て解放状態）、追加の処理は不要
+void playSequencerNote(uint8_t note, bool noteOn) {
+  // 予約したイベントの発火（renderBlock() から、予約したサンプルの位置で呼ばれる）
+  // 再生したノートは録音しない（オーバーダブで二重にならないように）。
+  if (noteOn) {
+    voiceNoteOn(note, MIDI_DEFAULT_VELOCITY);
+    triggerClick();
+  } else {
+    voiceNoteOff(note);
+  }
 }
 
 void clearSequence() {
-  // シーケンスをクリアする
+  // 選択中のトラックをクリアする
   // 引数: なし
-  // 説明: 再生中のノートをすべてオフにして、シーケンスバッファと再生マーカーをリセットします。
+  // 説明: 再生中のノートをすべてオフにして、選択中トラックのイベントを消します。
+  //   全トラックが空になったらループ長も捨てて再生を止めます（次の録音で長さを決め直す）。
   // 戻り値: なし
-  // 副作用: sequenceLength, sequenceDuration, playbackIndex などをリセットする。
-  clearActiveSequencerNotes();
-  sequenceLength = 0;
-  sequenceDuration = 0;
-  playbackIndex = 0;
-  activeSequencerCount = 0;
+  // 副作用: tracks[selectedTrack], loopTicks, sequencerPlaying を更新する。
+  releaseAllSequencerNotes();
+  tracks[selectedTrack].events.clear();
+  storeFull = false;
+  contentRevision++;
+  seekTrack(tracks[selectedTrack]);
+  rebuildHeap();
+  resetLoopIfEmpty();
+}
+
+void clearAllTracks() {
+  // 全トラックをクリアする
+  releaseAllSequencerNotes();
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    tracks[t].events.clear();
+  }
+  storeFull = false;
+  contentRevision++;
+  rewindTracks();
+  resetLoopIfEmpty();
 }
 
 void beginRecording() {
   // 録音開始
   // 引数: なし
-  // 説明: 現在の再生を停止してシーケンスをクリアし、録音モードに入ります。
+  // 説明: 選択中のトラックへの録音を始めます。ループ長が未確定なら今を 1 小節目の頭として
+  //   ティックを数え始め（最初の録音）、確定済みなら再生しながら重ね録り（オーバーダブ）します。
   // 戻り値: なし
-  // 副作用: sequencerRecording を true にして記録開始時刻を保存する。
-  sequencerPlaying = false;
-  sequencerRecording = false;
-  clearSequence();
+  // 副作用: sequencerRecording を true にする。最初の録音ならティックの基準を現在に合わせる。
+  if (sequencerRecording) {
+    return;
+  }
+  recordTrack = selectedTrack;
+  takeCount = 0;
+  takeFlushPending = false;
+  takePassChanged = false;
+  takeDropped = 0;
+  memset(quantizeShifts, 0, sizeof(quantizeShifts));
+  if (loopTicks == 0) {
+    firstTake = true;
+    sequencerPlaying = false;
+    anchorSample = audioSampleClock();
+    anchorTick = 0;
+  } else {
+    firstTake = false;
+    if (!sequencerPlaying) {
+      startPlayback();
+    }
+    takePass = tickAt(audioSampleClock()) / loopTicks;
+  }
   sequencerRecording = true;
-  recordStartMs = millis();
 }
 
 void endRecording() {
   // 録音終了
   // 引数: なし
-  // 説明: 録音モードを終了し、録音されたシーケンスがあれば最終化処理を行います。
+  // 説明: 録音バッファをトラックへマージします。最初の録音なら、終了時刻を小節単位に切り上げて
+  //   ループ長にします（何も録れていなければループ長は未確定のまま）。
   // 戻り値: なし
-  // 副作用: sequencerRecording を false にする。
+  // 副作用: sequencerRecording を false にし、loopTicks を決めることがある。
+  if (!sequencerRecording) {
+    return;
+  }
   sequencerRecording = false;
-  if (sequenceLength > 0) {
-    finalizeSequence();
+  if (firstTake) {
+    firstTake = false;
+    uint32_t endTick = tickAt(audioSampleClock());
+    loopTicks = max(TICKS_PER_BAR, (endTick + TICKS_PER_BAR - 1) / TICKS_PER_BAR * TICKS_PER_BAR);
+    flushTake(true);
+    resetLoopIfEmpty();
+  } else {
+    flushTake(true);
   }
 }
 
 void startPlayback() {
   // 再生開始
   // 引数: なし
-  // 説明: シーケンスが存在する場合、再生モードに入り再生マーカーを初期化します。
+  // 説明: ループ長が確定していれば、今をループの先頭として全トラックを再生します。
+  // 戻り値: なし
+  // 副作用: sequencerPlaying を true にし、ティックの基準を現在に合わせる。
+  startPlaybackAt(0, audioSampleClock());
+}
+
+void startPlaybackAt(uint32_t tick, uint32_t sample) {
+  // 位置を指定した再生開始（MIDI クロックのスタート/コンティニュー用）
+  // 引数:
+  //   tick: 再生を始める位置（ループ先頭からのティック、ループ長を超えたら折り返す）
+  //   sample: その位置を鳴らすサンプル時刻（先の時刻でもよい）
+  // 説明: 各トラックの周回と読み出し位置を tick に合わせ、tick より前のイベントは予約しません。
   // 戻り値: なし
-  // 副作用: sequencerPlaying を true にする。
-  if (sequenceLength == 0) {
+  // 副作用: sequencerPlaying を true にし、ティックの基準と各トラックの読み出し位置を更新する。
+  if (loopTicks == 0) {
     return;
   }
+  anchorSample = sample;
+  anchorTick = tick % loopTicks;
   sequencerPlaying = true;
-  playbackIndex = 0;
-  playbackStartMs = millis();
+  scheduledUntilTick = anchorTick;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    tracks[t].loopBase = 0;
+    seekTrack(tracks[t]);
+  }
+  rebuildHeap();
 }
 
 void stopPlayback() {
   // 再生停止
   // 引数: なし
-  // 説明: 再生モードを終了し、再生インデックスをリセットします。
+  // 説明: 再生モードを終了し、重ね録り中ならそれも終えます。予約済みのノートオンは捨て、
+  //   再生で鳴っていたノートは止めます。
   // 戻り値: なし
   // 副作用: sequencerPlaying を false にする。
+  if (sequencerRecording && !firstTake) {
+    endRecording();
+  }
   sequencerPlaying = false;
-  playbackIndex = 0;
+  releaseAllSequencerNotes();
 }
 
 void resetPlaybackMarkers() {
   // 再生マーカーをリセット
   // 引数: なし
-  // 説明: 再生位置と開始時刻を現在に合わせ、再生中のノートをクリアします。
+  // 説明: 再生中のノートを止め、再生中なら今をループの先頭として頭から再生し直します。
   // 戻り値: なし
-  // 副作用: playbackIndex と playbackStartMs を更新する。
-  playbackIndex = 0;
-  playbackStartMs = millis();
-  clearActiveSequencerNotes();
+  // 副作用: ティックの基準と各トラックの読み出し位置を更新する。
+  releaseAllSequencerNotes();
+  if (firstTake) {
+    return;
+  }
+  if (sequencerRecording) {
+    if (!flushTake(true)) {
+      endRecording();
+    }
+    takePass = 0;
+  }
+  anchorSample = audioSampleClock();
+  anchorTick = 0;
+  rewindTracks();
 }
 
 void updateSequencer() {
   // シーケンサの定期更新
   // 引数: なし
-  // 説明: 再生中であれば経過時間に基づいてシーケンスイベントを発火します。
+  // 説明: 再生中であれば、次のコントロールティックまで（SCHEDULE_AHEAD_SAMPLES）に鳴らすイベントを
+  //   サンプル時刻付きでオーディオ経路へ予約します。トラックは次のイベント時刻の早い順に
+  //   ヒープから取り出すので、コストはトラック数ではなく予約するイベント数に比例します。
+  //   イベントが尽きたトラックはループ終端で鳴り残りのノートオフを予約し、次の周回の先頭へ戻ります。
+  //   ミュート（またはソロ外）のトラックはノートオンを予約せず、鳴っているノートは止めます。
+  //   予約領域が満杯なら残りは次のティックで予約します。
   // 戻り値: なし
-  // 副作用: ノートのオン/オフを実行し、再生位置を進める。
-  if (!sequencerPlaying || sequenceLength == 0) {
+  //   録音バッファのマージが予約されていれば、先に行います（recordEvent() は renderBlock() から
+  //   呼ばれることがあるので、重いマージはここで行う）。
+  // 副作用: オーディオ経路へイベントを予約し、各トラックの再生位置を進める。録音をマージすることがある。
+  serviceTake();
+  if (!sequencerPlaying || loopTicks == 0) {
     return;
   }
 
-  uint32_t now = millis();
-  uint32_t elapsed = now - playbackStartMs;
+  const uint32_t releaseSample = sampleAt(swingTick(scheduledUntilTick));
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    if (!isTrackAudible(t)) {
+      scheduleTrackRelease(tracks[t], releaseSample);
+    }
+  }
 
-  while (playbackIndex < sequenceLength && elapsed >= sequenceOriginalTimestamp[playbackIndex]) {
-    SequencerEvent &evt = sequenceBuffer[playbackIndex];
-    if (evt.noteOn) {
-      handleNoteOn(evt.note);
-      registerSequencerNote(evt.note);
-      triggerClick();
+  const uint32_t horizonTick = tickAt(audioSampleClock() + SCHEDULE_AHEAD_SAMPLES);
+  uint32_t reachedTick = horizonTick;
+  for (;;) {
+    const uint8_t t = trackHeap[0];
+    Track &track = tracks[t];
+    const uint32_t key = trackKey(t);
+    if (static_cast<int32_t>(key - horizonTick) >= 0) {
+      break;
+    }
+    const uint32_t when = sampleAt(swingTick(key));
+    if (track.reader.done()) {
+      if (!scheduleTrackRelease(track, when)) {
+        reachedTick = key;
+        break;
+      }
+      track.loopBase += loopTicks;
+      track.reader = track.events.reader();
     } else {
-      handleNoteOff(evt.note);
-      unregisterSequencerNote(evt.note);
+      const PackedSequence::Event &evt = track.reader.event();
+      bool wanted = evt.noteOn ? isTrackAudible(t) : isActive(track, evt.note);
+      if (wanted) {
+        if (!scheduleNoteEvent(when, evt.note, evt.noteOn)) {
+          reachedTick = key;
+          break;
+        }
+        setActive(track, evt.note, evt.noteOn);
+      }
+      track.reader.advance();
     }
-    playbackIndex++;
+    siftDown(0);
   }
-
-  if (sequenceDuration > 0 && elapsed >= sequenceDuration) {
-    playbackStartMs = now;
-    playbackIndex = 0;
-    clearActiveSequencerNotes();
+  // 基準を先の時刻に付け替えた直後（MIDI クロックの再生開始）は予約済みの位置を戻さない
+  if (static_cast<int32_t>(reachedTick - scheduledUntilTick) > 0) {
+    scheduledUntilTick = reachedTick;
   }
 }
 
@@ -263,20 +804,107 @@ bool isSequencerPlaying() {
   return sequencerPlaying;
 }
 
+bool isSequencerStoreFull() {
+  return storeFull;
+}
+
 uint16_t getSequenceLength() {
-  return sequenceLength;
+  return tracks[selectedTrack].events.eventCount();
 }
 
 void abortRecording() {
+  // 録音の中止: 録音バッファを捨てる（最初の録音ならトラックも空に戻す）
+  if (!sequencerRecording) {
+    return;
+  }
   sequencerRecording = false;
+  takeCount = 0;
+  if (firstTake) {
+    firstTake = false;
+    tracks[recordTrack].events.clear();
+    contentRevision++;
+    resetLoopIfEmpty();
+  }
+}
+
+void selectTrack(uint8_t track) {
+  // 録音中は録音先を変えない（次の録音から反映）
+  if (track < SEQ_TRACK_COUNT) {
+    selectedTrack = track;
+  }
+}
+
+uint8_t getSelectedTrack() {
+  return selectedTrack;
+}
+
+void setTrackMuted(uint8_t track, bool muted) {
+  if (track < SEQ_TRACK_COUNT) {
+    tracks[track].muted = muted;
+  }
+}
+
+bool isTrackMuted(uint8_t track) {
+  return track < SEQ_TRACK_COUNT && tracks[track].muted;
+}
+
+void setTrackSoloed(uint8_t track, bool soloed) {
+  if (track < SEQ_TRACK_COUNT) {
+    tracks[track].soloed = soloed;
+  }
+}
+
+bool isTrackSoloed(uint8_t track) {
+  return track < SEQ_TRACK_COUNT && tracks[track].soloed;
+}
+
+void setSequencerTempo(float bpm) {
+  // テンポ変更
+  // 引数:
+  //   bpm: 四分音符/分（20..300 に制限）
+  // 説明: 現在位置でティックとサンプル時刻の対応を付け替えてから 1 ティックの長さを変えるので、
+  //   再生位置は飛びません。予約済みのイベント（次のティックまで）は元のテンポのまま鳴ります。
+  // 戻り値: なし
+  // 副作用: tempoBpm, samplesPerTickQ16, ティックの基準を更新する。
+  const uint32_t now = audioSampleClock();
+  anchorTick = tickAt(now);
+  anchorSample = now;
+  tempoBpm = constrain(bpm, 20.0f, 300.0f);
+  updateSamplesPerTick();
+}
+
+void alignSequencerClock(uint32_t sample, uint32_t tick, float bpm) {
+  // 外部クロックへの追従: sample の時点を tick とし、以降は bpm で進める
+  anchorSample = sample;
+  anchorTick = tick;
+  tempoBpm = constrain(bpm, 20.0f, 300.0f);
+  updateSamplesPerTick();
+}
+
+uint32_t sequencerTickAt(uint32_t sample) {
+  return tickAt(sample);
+}
+
+uint32_t sequencerSampleAt(uint32_t tick) {
+  return sampleAt(tick);
+}
+
+float getSequencerTempo() {
+  return tempoBpm;
+}
+
+void setQuantizeDivision(uint8_t division) {
+  // 入力クオンタイズ: 全音符を division 等分したグリッドへノートオンを寄せる（0 で無効）
+  quantizeTicks = division == 0 ? 0 : static_cast<uint16_t>(TICKS_PER_BAR / SEQ_BEATS_PER_BAR * 4 / division);
+}
+
+void setSwingPercent(uint8_t percent) {
+  swingPercent = constrain(percent, static_cast<uint8_t>(50), static_cast<uint8_t>(75));
 }
 
 void releaseAllHeldNotes() {
   if (heldCount > 0) {
-    for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-      envelopeInstance[i].noteOff();
-      voiceActive[i] = false;
-    }
+    voiceReleaseAll();
     heldCount = 0;
   }
 }
@@ -287,8 +915,291 @@ void triggerRandomNote() {
     randomNoteActive = false;
   }
   randomNoteValue = random(48, 73);
-  handleNoteOn(randomNoteValue);
+  handleNoteOn(randomNoteValue, MIDI_DEFAULT_VELOCITY);
   triggerClick();
   randomNoteStart = millis();
   randomNoteActive = true;
 }
+
+namespace {
+// 保存形式の版と大きさ（saveSequencerSettings()）
+constexpr uint8_t SETTINGS_VERSION = 2;
+constexpr uint16_t SETTINGS_BYTES = 18 + 2 * SEQ_TRACK_COUNT;
+static_assert(SEQ_SAVE_PARTS * SEQ_SAVE_PART_BYTES >= POOL_BYTES, "too few save parts for the event store");
+static_assert(SEQ_SAVE_PARTS <= 16, "loadedParts holds one bit per save part");
+
+// 読み込み中のソング（loadSequencerSettings() で設定し、loadSequencerPart() が確かめる）
+uint16_t loadRevision = 0;
+uint16_t loadLengths[SEQ_TRACK_COUNT];
+uint16_t loadTotal = 0;
+uint16_t loadedParts = 0;
+
+void putU16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+uint16_t getU16(const uint8_t *data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+}  // namespace
+
+bool saveSequencerSettings(uint8_t *out, uint16_t capacity, uint16_t *length) {
+  // ソング設定の書き出し
+  // 説明: [版][トラック数][PPQN x2][ループ長 x4][テンポ x100 x2][クオンタイズ x2][スウィング]
+  //   [ミュート][ソロ][選択トラック][内容の版 x2][トラックごとのイベント列のバイト数 x2 ...]
+  //   （リトルエンディアン）を書きます。
+  // 戻り値: capacity が足りなければ false
+  // 副作用: なし
+  if (capacity < SETTINGS_BYTES) {
+    return false;
+  }
+  uint8_t muteMask = 0;
+  uint8_t soloMask = 0;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    muteMask |= tracks[t].muted ? static_cast<uint8_t>(1u << t) : 0;
+    soloMask |= tracks[t].soloed ? static_cast<uint8_t>(1u << t) : 0;
+  }
+  out[0] = SETTINGS_VERSION;
+  out[1] = SEQ_TRACK_COUNT;
+  putU16(out + 2, SEQ_PPQN);
+  putU16(out + 4, static_cast<uint16_t>(loopTicks));
+  putU16(out + 6, static_cast<uint16_t>(loopTicks >> 16));
+  putU16(out + 8, static_cast<uint16_t>(tempoBpm * 100.0f + 0.5f));
+  putU16(out + 10, quantizeTicks);
+  out[12] = swingPercent;
+  out[13] = muteMask;
+  out[14] = soloMask;
+  out[15] = selectedTrack;
+  putU16(out + 16, contentRevision);
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    putU16(out + 18 + 2 * t, tracks[t].events.bytesUsed());
+  }
+  *length = SETTINGS_BYTES;
+  return true;
+}
+
+bool loadSequencerSettings(const uint8_t *data, uint16_t length) {
+  // ソング設定の読み込み
+  // 説明: 形式を確かめてから再生と録音を止め、全トラックを空にして設定を反映します。
+  //   イベント列は続けて loadSequencerPart() で読み込み、endSequencerLoad() でトラックに分けます。
+  // 戻り値: 形式が合わないか、イベント列が領域に入らなければ false
+  // 副作用: シーケンサの状態をすべて置き換える。
+  if (length < SETTINGS_BYTES || data[0] != SETTINGS_VERSION || data[1] != SEQ_TRACK_COUNT ||
+      getU16(data + 2) != SEQ_PPQN) {
+    return false;
+  }
+  uint32_t total = 0;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    total += getU16(data + 18 + 2 * t);
+  }
+  if (total > POOL_BYTES) {
+    return false;
+  }
+  abortRecording();
+  stopPlayback();
+  clearAllTracks();
+  loopTicks = getU16(data + 4) | (static_cast<uint32_t>(getU16(data + 6)) << 16);
+  setSequencerTempo(getU16(data + 8) / 100.0f);
+  quantizeTicks = getU16(data + 10);
+  setSwingPercent(data[12]);
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    tracks[t].muted = (data[13] & (1u << t)) != 0;
+    tracks[t].soloed = (data[14] & (1u << t)) != 0;
+  }
+  selectTrack(data[15]);
+  loadRevision = getU16(data + 16);
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    loadLengths[t] = getU16(data + 18 + 2 * t);
+  }
+  loadTotal = static_cast<uint16_t>(total);
+  loadedParts = 0;
+  return true;
+}
+
+bool saveSequencerPart(uint8_t part, uint8_t *out, uint16_t capacity, uint16_t *length) {
+  // イベント列の分割書き出し
+  // 引数:
+  //   part: 何番目の SEQ_SAVE_PART_BYTES か
+  // 説明: [内容の版 x2] に続けて、全トラックを番号順に連結した列の part 番目の範囲を書きます。
+  //   トラックの間には空きが挟まることがあるので、範囲に掛かるトラックごとに写します。
+  //   範囲が列の外なら版だけのレコードになります。
+  // 戻り値: part が範囲外か capacity が足りなければ false
+  // 副作用: なし
+  const uint16_t total = poolUsed();
+  const uint32_t begin = static_cast<uint32_t>(part) * SEQ_SAVE_PART_BYTES;
+  const uint16_t bytes = begin < total ? static_cast<uint16_t>(min<uint32_t>(SEQ_SAVE_PART_BYTES, total - begin)) : 0;
+  if (part >= SEQ_SAVE_PARTS || capacity < 2 + bytes) {
+    return false;
+  }
+  putU16(out, contentRevision);
+  uint32_t trackStart = 0;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    const uint16_t used = tracks[t].events.bytesUsed();
+    const uint32_t from = max<uint32_t>(begin, trackStart);
+    const uint32_t to = min<uint32_t>(begin + bytes, trackStart + used);
+    if (from < to) {
+      memcpy(out + 2 + (from - begin), tracks[t].events.data() + (from - trackStart), to - from);
+    }
+    trackStart += used;
+  }
+  *length = static_cast<uint16_t>(2 + bytes);
+  return true;
+}
+
+bool loadSequencerPart(uint8_t part, const uint8_t *data, uint16_t length) {
+  // 分割したイベント列を trackPool の同じ位置へ写す（トラックへの割り当ては endSequencerLoad()）
+  const uint32_t begin = static_cast<uint32_t>(part) * SEQ_SAVE_PART_BYTES;
+  const uint16_t bytes = begin < loadTotal ? static_cast<uint16_t>(min<uint32_t>(SEQ_SAVE_PART_BYTES, loadTotal - begin)) : 0;
+  if (part >= SEQ_SAVE_PARTS || length != 2 + bytes || getU16(data) != loadRevision) {
+    return false;
+  }
+  memcpy(trackPool + begin, data + 2, bytes);
+  loadedParts |= static_cast<uint16_t>(1u << part);
+  return true;
+}
+
+bool endSequencerLoad() {
+  // 読み込みの終了
+  // 引数: なし
+  // 説明: 連結したイベント列が揃っていれば、先頭から loadLengths ずつ各トラックに割り当て、
+  //   その場で復号し直して件数と末尾の時刻を復元します（符号化は一意なので同じバイト列に上書きされる）。
+  //   空きは最後のトラックの直後に置きます。
+  // 戻り値: レコードが欠けているか復号できなければ false（全トラックを空にする）
+  // 副作用: trackPool と全トラック、読み出し位置とヒープを更新する。
+  const uint8_t partsNeeded = static_cast<uint8_t>((loadTotal + SEQ_SAVE_PART_BYTES - 1) / SEQ_SAVE_PART_BYTES);
+  const uint16_t neededMask = static_cast<uint16_t>((1u << partsNeeded) - 1);
+  bool loaded = (loadedParts & neededMask) == neededMask;
+  uint16_t offset = 0;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT && loaded; ++t) {
+    const uint16_t used = loadLengths[t];
+    const uint16_t capacity = t == SEQ_TRACK_COUNT - 1 ? static_cast<uint16_t>(POOL_BYTES - offset) : used;
+    tracks[t].events.relocate(trackPool + offset, capacity);
+    loaded = tracks[t].events.load(trackPool + offset, used);
+    offset += used;
+  }
+  loadedParts = 0;
+  if (!loaded) {
+    clearAllTracks();
+    return false;
+  }
+  contentRevision++;
+  rewindTracks();
+  return true;
+}
+
+void beginSequencerImport() {
+  // 外部データ（SMF など）の読み込み開始: 録音と再生を止め、全トラックとループ長を捨てる
+  abortRecording();
+  stopPlayback();
+  clearAllTracks();
+}
+
+bool importSequencerEvent(uint8_t track, uint32_t tick, uint8_t note, bool noteOn) {
+  // 書き足すトラックの直後に空きが無ければ寄せてから追記する（同じトラックへ続けて書く間は動かさない）
+  if (track >= SEQ_TRACK_COUNT) {
+    return false;
+  }
+  contentRevision++;
+  if (tracks[track].events.append(tick, note, noteOn)) {
+    return true;
+  }
+  makeRoomAfter(track);
+  return tracks[track].events.append(tick, note, noteOn);
+}
+
+void endSequencerImport(uint32_t endTick) {
+  // 読み込みの終了
+  // 引数:
+  //   endTick: 曲の終わり（ティック）
+  // 説明: 曲の終わりと全イベントを含むように、ループ長を小節単位に切り上げて決めます。
+  //   ノートオンはループの終わりちょうどに置けない（次の周回の頭と重なる）ので、その次の小節まで含めます。
+  //   イベントがなければループ長は未確定のままです。
+  // 戻り値: なし
+  // 副作用: loopTicks と各トラックの読み出し位置を更新する。
+  uint32_t lastTick = endTick;
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    for (PackedSequence::Reader reader = tracks[t].events.reader(); !reader.done(); reader.advance()) {
+      const PackedSequence::Event &e = reader.event();
+      lastTick = max(lastTick, e.noteOn ? e.time + 1 : e.time);
+    }
+  }
+  loopTicks = max(TICKS_PER_BAR, (lastTick + TICKS_PER_BAR - 1) / TICKS_PER_BAR * TICKS_PER_BAR);
+  rewindTracks();
+  resetLoopIfEmpty();
+}
+
+const PackedSequence &getSequencerTrack(uint8_t track) {
+  return tracks[track < SEQ_TRACK_COUNT ? track : 0].events;
+}
+
+uint32_t getSequencerLoopTicks() {
+  return loopTicks;
+}
+
+bool handleSequencerCommand(const char *line) {
+  // シーケンサのシリアルコマンド
+  // 引数:
+  //   line: 改行を除いた 1 行
+  // 説明: "seq <コマンド> <値>" を解釈して設定を変え、最後に状態を 1 行ずつ出力します。
+  //   トラック番号は 1 から数えます。mute/solo は切り替えです。
+  // 戻り値: "seq" コマンドなら true
+  // 副作用: トラック選択・ミュート・ソロ・テンポ・クオンタイズ・スウィングを変更し、Serial へ出力する。
+  if (strncmp(line, "seq", 3) != 0 || (line[3] != '\0' && line[3] != ' ')) {
+    return false;
+  }
+  const char *args = line[3] == ' ' ? line + 4 : line + 3;
+  const char *value = strchr(args, ' ');
+  const long number = value != nullptr ? atol(value + 1) : 0;
+  const uint8_t track = static_cast<uint8_t>(number - 1);
+
+  if (strncmp(args, "track ", 6) == 0) {
+    selectTrack(track);
+  } else if (strncmp(args, "mute ", 5) == 0) {
+    setTrackMuted(track, !isTrackMuted(track));
+  } else if (strncmp(args, "solo ", 5) == 0) {
+    setTrackSoloed(track, !isTrackSoloed(track));
+  } else if (strncmp(args, "bpm ", 4) == 0) {
+    setSequencerTempo(static_cast<float>(atof(value + 1)));
+  } else if (strncmp(args, "quant ", 6) == 0) {
+    setQuantizeDivision(static_cast<uint8_t>(number));
+  } else if (strncmp(args, "swing ", 6) == 0) {
+    setSwingPercent(static_cast<uint8_t>(constrain(number, 0L, 100L)));
+  } else if (strcmp(args, "clear all") == 0) {
+    abortRecording();
+    clearAllTracks();
+  } else if (strcmp(args, "clear") == 0) {
+    abortRecording();
+    clearSequence();
+  } else if (args[0] != '\0') {
+    Serial.println("seq: track|mute|solo <n>, bpm <x>, quant <div>, swing <50..75>, clear [all]");
+    return true;
+  }
+
+  Serial.print(sequencerRecording ? "seq: REC" : (sequencerPlaying ? "seq: PLAY" : "seq: STOP"));
+  Serial.print(" bpm ");
+  Serial.print(static_cast<double>(tempoBpm), 1);
+  Serial.print(" loop ");
+  Serial.print(static_cast<unsigned long>(loopTicks / TICKS_PER_BAR));
+  Serial.print(" bars quant ");
+  Serial.print(quantizeTicks == 0 ? 0u : static_cast<unsigned int>(TICKS_PER_BAR / SEQ_BEATS_PER_BAR * 4 / quantizeTicks));
+  Serial.print(" swing ");
+  Serial.println(static_cast<unsigned int>(swingPercent));
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    Serial.print(t == selectedTrack ? "> T" : "  T");
+    Serial.print(static_cast<unsigned int>(t + 1));
+    Serial.print(" ");
+    Serial.print(static_cast<unsigned int>(tracks[t].events.eventCount()));
+    Serial.print(" ev ");
+    Serial.print(static_cast<unsigned int>(tracks[t].events.bytesUsed()));
+    Serial.print(" B");
+    Serial.print(tracks[t].muted ? " mute" : "");
+    Serial.println(tracks[t].soloed ? " solo" : "");
+  }
+  Serial.print("  free ");
+  Serial.print(static_cast<unsigned int>(POOL_BYTES - poolUsed()));
+  Serial.print("/");
+  Serial.print(static_cast<unsigned int>(POOL_BYTES));
+  Serial.println(storeFull ? " B (full: last take not recorded)" : " B");
+  return true;
+}
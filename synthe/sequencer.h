@@ -1,17 +1,27 @@
 #pragma once
 
+// sequencer.h
+// 複数トラックのループシーケンサ。イベントはテンポに依存しないティック (SEQ_PPQN / 四分音符) で保持し、
+// 再生時にテンポとスウィングを掛けてサンプル時刻へ換算します。最初の録音でループ長（小節単位）が決まり、
+// 以降の録音は再生しながら選択中のトラックへ重ね録り（オーバーダブ）します。
+
+#include "config.h"
+#include "packed_sequence.h"
+
 #include <Arduino.h>
 
 /**
- * @brief ノートオンイベントの処理
+ * @brief ノートオンイベントの処理（演奏入力）
  * @param note MIDIノート番号
+ * @param velocity ベロシティ（1..127、音量とカットオフに掛かる）
  *
  * ノートを保持リストに追加し、ターゲット周波数を更新してエンベロープを開始します。
+ * 録音中なら録音先トラックへ記録します（トラックはベロシティを持たないので、再生は MIDI_DEFAULT_VELOCITY）。
  */
-void handleNoteOn(uint8_t note);
+void handleNoteOn(uint8_t note, uint8_t velocity);
 
 /**
- * @brief ノートオフイベントの処理
+ * @brief ノートオフイベントの処理（演奏入力）
  * @param note MIDIノート番号
  *
  * ノートを保持リストから削除し、必要ならエンベロープをオフにします。
@@ -19,43 +29,68 @@ void handleNoteOn(uint8_t note);
 void handleNoteOff(uint8_t note);
 
 /**
- * @brief シーケンスを完全にクリアする
+ * @brief 予約したシーケンスイベントを発火する（オーディオ経路から呼ばれる）
+ * @param note MIDIノート番号
+ * @param noteOn ノートオンなら true（クリックも鳴らす）
+ *
+ * scheduleNoteEvent() で予約したイベントが、予約したサンプルの位置で renderBlock() から呼ばれます。
+ * 再生したノートは録音しません。
+ */
+void playSequencerNote(uint8_t note, bool noteOn);
+
+/**
+ * @brief 選択中のトラックをクリアする
  *
- * シーケンスバッファと再生マーカー、アクティブノートをリセットします。
+ * 再生中のノートを止めてトラックのイベントを消します。全トラックが空になったらループ長も捨てます。
  */
 void clearSequence();
 
+/**
+ * @brief 全トラックをクリアする（ループ長も捨てる）
+ */
+void clearAllTracks();
+
 /**
  * @brief 録音を開始する
  *
- * 現在のシーケンスをクリアし、録音モードに入ります。
+ * ループ長が未確定なら最初の録音として今から小節を数え始め、確定済みなら再生しながら
+ * 選択中のトラックへ重ね録りします。
  */
 void beginRecording();
 
 /**
  * @brief 録音を終了する
  *
- * 録音を停止し、録音済みシーケンスの最終化を行います。
+ * 録音したイベントをトラックへマージします。最初の録音なら終了位置を小節単位に切り上げてループ長にします。
  */
 void endRecording();
 
 /**
- * @brief シーケンス再生を開始する
+ * @brief シーケンス再生を開始する（今をループの先頭にする）
  */
 void startPlayback();
 
 /**
- * @brief シーケンス再生を停止する
+ * @brief 位置と時刻を指定して再生を開始する（MIDI クロックのスタート/コンティニュー用）
+ * @param tick 再生を始める位置（ループ先頭からのティック）
+ * @param sample その位置を鳴らす audioSampleClock() 基準の時刻（先の時刻でもよい）
+ */
+void startPlaybackAt(uint32_t tick, uint32_t sample);
+
+/**
+ * @brief シーケンス再生を停止する（重ね録り中なら録音も終える）
  */
 void stopPlayback();
 
 /**
- * @brief 再生位置とタイマーをリセットする
+ * @brief 再生中のノートを止め、再生中なら今をループの先頭にして頭から再生し直す
  */
 void resetPlaybackMarkers();
 
 /**
- * @brief シーケンサの定期更新（イベント発火）
+ * @brief シーケンサの定期更新（イベント予約）
+ *
+ * 次のコントロールティックまでに鳴らすイベントをサンプル時刻付きでオーディオ経路へ予約します。
  */
 void updateSequencer();
 
@@ -75,10 +110,63 @@ bool isSequencerRecording();
 bool isSequencerPlaying();
 
 /**
- * @brief 現在のシーケンス長を返す
+ * @brief 録音をトラックへマージできずに捨てたか（共有のイベント領域が満杯。トラックを消すと戻る）
+ */
+bool isSequencerStoreFull();
+
+/**
+ * @brief 選択中のトラックのイベント数を返す
  */
 uint16_t getSequenceLength();
 
+/**
+ * @brief 録音・クリアの対象にするトラックを選ぶ（0..SEQ_TRACK_COUNT-1）
+ */
+void selectTrack(uint8_t track);
+uint8_t getSelectedTrack();
+
+/**
+ * @brief トラックのミュート/ソロ
+ *
+ * ソロのトラックが 1 つでもあれば、ソロのトラックだけが鳴ります。鳴らなくなったトラックの
+ * 発音中のノートは次の更新で止めます。
+ */
+void setTrackMuted(uint8_t track, bool muted);
+bool isTrackMuted(uint8_t track);
+void setTrackSoloed(uint8_t track, bool soloed);
+bool isTrackSoloed(uint8_t track);
+
+/**
+ * @brief テンポ (BPM) を設定する（再生位置は保ったまま）
+ */
+void setSequencerTempo(float bpm);
+float getSequencerTempo();
+
+/**
+ * @brief 外部クロックに合わせる: sample の時点を通算ティック tick とし、以降は bpm で進める（midi_clock.h 用）
+ *
+ * setSequencerTempo() と違い、位置も付け替えます。予約済みのイベント（次のティックまで）はそのまま鳴ります。
+ */
+void alignSequencerClock(uint32_t sample, uint32_t tick, float bpm);
+
+/**
+ * @brief 再生開始からの通算ティックとサンプル時刻の換算（スウィングなし、止まっている間も現在のテンポで進む）
+ */
+uint32_t sequencerTickAt(uint32_t sample);
+uint32_t sequencerSampleAt(uint32_t tick);
+
+/**
+ * @brief 録音時のクオンタイズを設定する
+ * @param division 全音符の分割数（4 = 四分音符, 16 = 16 分音符, 0 = 無効）
+ */
+void setQuantizeDivision(uint8_t division);
+
+/**
+ * @brief スウィング量を設定する
+ * @param percent 16 分音符の組で後ろ側を置く位置（50 = なし, 最大 75）
+ */
+void setSwingPercent(uint8_t percent);
+
 /**
  * @brief 録音を中止する（途中キャンセル）
  */
@@ -93,3 +181,81 @@ void releaseAllHeldNotes();
  * @brief ランダムノートをトリガーする
  */
 void triggerRandomNote();
+
+/**
+ * @brief シーケンサのシリアルコマンドを処理する（serial_console.h から呼ばれる）
+ *
+ * "seq" で状態を出力し、"seq track|mute|solo <1..>"、"seq bpm <値>"、"seq quant <分割数>"、
+ * "seq swing <50..75>"、"seq clear [all]" で設定します（トラック番号は 1 から）。
+ * @param line 改行を除いた 1 行
+ * @return "seq" で始まる行なら true（処理済み）
+ */
+bool handleSequencerCommand(const char *line);
+
+/**
+ * @brief ソングの設定（ループ長・テンポ・クオンタイズ・スウィング・ミュート/ソロ）を書き出す（storage.h 用）
+ * @param out 書き込み先
+ * @param capacity out のバイト数
+ * @param length 書いたバイト数を返す
+ * @return capacity が足りなければ false
+ */
+bool saveSequencerSettings(uint8_t *out, uint16_t capacity, uint16_t *length);
+
+/**
+ * @brief saveSequencerSettings() の内容を読み込む（再生と録音は止める）
+ * @return 形式（版・トラック数・分解能）が合わなければ false（何も変えない）
+ */
+bool loadSequencerSettings(const uint8_t *data, uint16_t length);
+
+// 保存時にイベント列を分けるレコード 1 つの大きさ（先頭の版 2 バイトを除く）と、その数の上限
+constexpr uint16_t SEQ_SAVE_PART_BYTES = FLASH_STORE_RECORD_BYTES - 2;
+constexpr uint8_t SEQ_SAVE_PARTS = (SEQ_STORE_BYTES + SEQ_SAVE_PART_BYTES - 1) / SEQ_SAVE_PART_BYTES;
+
+/**
+ * @brief 全トラックのイベント列（番号順に連結）のうち part 番目の SEQ_SAVE_PART_BYTES を書き出す（storage.h 用）
+ *
+ * 1 トラックが領域全体を使うこともあるので、レコードの大きさではなく連結した列を等分して保存します。
+ * 先頭にトラックの内容の版を付け、saveSequencerSettings() と同じ時点のものか読み込み時に確かめます。
+ * @return part が範囲外か capacity が足りなければ false
+ */
+bool saveSequencerPart(uint8_t part, uint8_t *out, uint16_t capacity, uint16_t *length);
+
+/**
+ * @brief saveSequencerPart() の内容を読み込む（loadSequencerSettings() の後、全部読んだら endSequencerLoad()）
+ * @return 版か長さが設定と合わなければ false（読み込まない）
+ */
+bool loadSequencerPart(uint8_t part, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief 読み込んだイベント列をトラックに分ける
+ * @return 必要なレコードが欠けているか壊れていれば false（全トラックを空にする）
+ */
+bool endSequencerLoad();
+
+/**
+ * @brief 外部データ（smf_transfer.h の SMF など）の読み込みを始める（録音と再生を止め、全トラックを空にする）
+ */
+void beginSequencerImport();
+
+/**
+ * @brief 読み込み中のトラックにイベントを追加する（トラックごとに時刻順に渡すこと）
+ * @param tick ループ先頭からのティック (SEQ_PPQN / 四分音符)
+ * @return トラックが範囲外か容量が足りなければ false（追加しない）
+ */
+bool importSequencerEvent(uint8_t track, uint32_t tick, uint8_t note, bool noteOn);
+
+/**
+ * @brief 読み込みを終えてループ長を決める
+ * @param endTick 曲の終わり（ティック）。全イベントを含むように小節単位に切り上げる
+ */
+void endSequencerImport(uint32_t endTick);
+
+/**
+ * @brief トラックのイベント列（ループ先頭からのティック）を返す（書き出し用）
+ */
+const PackedSequence &getSequencerTrack(uint8_t track);
+
+/**
+ * @brief ループ長（ティック、未確定なら 0）を返す
+ */
+uint32_t getSequencerLoopTicks();
@@ -0,0 +1,49 @@
+#include "serial_console.h"
+
+#include "midi_clock.h"
+#include "profiler.h"
+#include "sequencer.h"
+#include "smf_transfer.h"
+#include "storage.h"
+
+#include <Arduino.h>
+
+namespace {
+// 行バッファ（収まらない行は捨てる。"smf " + 16 進数 64 文字が収まる大きさ）
+char commandLine[80];
+uint8_t commandLength = 0;
+
+void runCommand(const char *line) {
+  // 1 行の実行: 各モジュールのハンドラに順に渡し、どれも受け付けなければ使い方を出す
+  if (line[0] == '\0') {
+    return;
+  }
+  if (handleProfileCommand(line) || handleSequencerCommand(line) || handleStorageCommand(line) ||
+      handleSmfCommand(line) || handleClockCommand(line)) {
+    return;
+  }
+  Serial.println("commands: prof [reset|page], seq [track|mute|solo|bpm|quant|swing|clear] ..., save|load song|patch <n>, store, smf export|import, clock [int|master|slave|lfo <n>]");
+}
+}  // namespace
+
+void serviceSerialConsole() {
+  // シリアルコマンドの受信
+  // 引数: なし
+  // 説明: 受信済みのバイトだけを読み、改行で 1 行を確定して runCommand() に渡します。
+  //   バッファに収まらない行（79 文字超）は捨てます。SMF の書き出し中なら 1 行送ります。
+  // 戻り値: なし
+  // 副作用: Serial の受信バッファを消費する。
+  serviceSmfTransfer();
+  while (Serial.available() > 0) {
+    char c = static_cast<char>(Serial.read());
+    if (c == '\r' || c == '\n') {
+      if (commandLength < sizeof(commandLine)) {
+        commandLine[commandLength] = '\0';
+        runCommand(commandLine);
+      }
+      commandLength = 0;
+    } else if (commandLength < sizeof(commandLine)) {
+      commandLine[commandLength++] = c;
+    }
+  }
+}
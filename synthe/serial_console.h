@@ -0,0 +1,15 @@
+#pragma once
+
+// serial_console.h
+// USB シリアル (Serial) の行コマンド。1 行を先頭の単語で各モジュールのハンドラへ振り分けます。
+//   prof ...  サイクル計測 (profiler.h)
+//   seq ...   シーケンサのトラック/テンポ/クオンタイズ (sequencer.h)
+//   save/load/store  パッチとソングの保存 (storage.h)
+//   smf ...   Standard MIDI File の読み込み/書き出し (smf_transfer.h)
+
+/**
+ * @brief Serial から受信済みのバイトを読み、改行ごとにコマンドを実行する（ブロックしない）
+ *
+ * updateControl() から毎ティック呼び出してください。
+ */
+void serviceSerialConsole();
@@ -0,0 +1,518 @@
+#include "smf.h"
+
+#include "config.h"
+
+namespace {
+constexpr uint32_t CHUNK_MTHD = 0x4D546864UL;  // "MThd"
+constexpr uint32_t CHUNK_MTRK = 0x4D54726BUL;  // "MTrk"
+constexpr uint8_t META_END_OF_TRACK = 0x2F;
+constexpr uint8_t META_TEMPO = 0x51;
+constexpr uint8_t META_TIME_SIGNATURE = 0x58;
+// 差分時間の VLQ は SMF の規定で 4 バイトまで
+constexpr uint8_t MAX_VLQ_BYTES = 4;
+// 書き出すノートオンのベロシティ（シーケンサはベロシティを持たない）
+constexpr uint8_t EXPORT_VELOCITY = 100;
+
+uint8_t vlqLength(uint32_t number) {
+  uint8_t length = 1;
+  while (number >= 0x80) {
+    number >>= 7;
+    length++;
+  }
+  return length;
+}
+
+uint8_t dataBytesFor(uint8_t status) {
+  // プログラムチェンジとチャンネルプレッシャーだけデータが 1 バイト
+  const uint8_t kind = status & 0xF0;
+  return kind == 0xC0 || kind == 0xD0 ? 1 : 2;
+}
+}  // namespace
+
+// ---- 読み込み ----
+
+void SmfReader::reset() {
+  state = State::ChunkId;
+  counter = 0;
+  value = 0;
+  chunkId = 0;
+  chunkLeft = 0;
+  inTrack = false;
+  headerSeen = false;
+  smfFormat = 0;
+  smfTracks = 0;
+  smfDivision = 0;
+  tracksDone = 0;
+  trackTick = 0;
+  runningStatus = 0;
+  dataCount = 0;
+  dataNeeded = 0;
+  metaType = 0;
+  skipLeft = 0;
+  current = {Event::Type::Note, 0, 0, 0, 0, 0, 0};
+}
+
+bool SmfReader::push(uint8_t byte) {
+  // 1 バイトの読み込み
+  // 引数:
+  //   byte: ファイルの次の 1 バイト
+  // 説明: チャンクの外ではチャンク ID と長さを読み、MThd ならヘッダ、MTrk ならイベント列として、
+  //   それ以外のチャンクは長さ分を読み飛ばします。MThd より前に他のチャンクがあれば形式エラーです。
+  // 戻り値: イベントがそろったら true
+  // 副作用: 状態を進め、イベントがそろったら current を書き換える。
+  switch (state) {
+    case State::Error:
+      return false;
+
+    case State::ChunkId:
+    case State::ChunkLength:
+      value = (value << 8) | byte;
+      if (++counter == 4) {
+        chunkId = value;
+        value = 0;
+        state = State::ChunkLength;
+        return false;
+      }
+      if (counter < 8) {
+        return false;
+      }
+      chunkLeft = value;
+      counter = 0;
+      value = 0;
+      if (chunkId == CHUNK_MTHD && !headerSeen) {
+        state = chunkLeft >= 6 ? State::Header : State::Error;
+      } else if (!headerSeen) {
+        fail();
+      } else if (chunkId == CHUNK_MTRK && chunkLeft > 0) {
+        inTrack = true;
+        trackTick = 0;
+        runningStatus = 0;
+        state = State::Delta;
+      } else if (chunkId == CHUNK_MTRK) {
+        tracksDone++;
+        state = State::ChunkId;
+      } else {
+        state = chunkLeft > 0 ? State::SkipChunk : State::ChunkId;
+      }
+      return false;
+
+    case State::Header:
+      // [形式 x2][トラック数 x2][分解能 x2]（ビッグエンディアン）、7 バイト目以降は読み飛ばす
+      if (counter < 6) {
+        value = (value << 8) | byte;
+        if (++counter % 2 == 0) {
+          const uint16_t field = static_cast<uint16_t>(value);
+          value = 0;
+          if (counter == 2) {
+            smfFormat = field;
+          } else if (counter == 4) {
+            smfTracks = field;
+          } else {
+            smfDivision = field;
+            // Type 2（独立した複数のパターン）と SMPTE 分解能は扱わない
+            if (smfFormat > 1 || (smfDivision & 0x8000) != 0 || smfDivision == 0) {
+              fail();
+              return false;
+            }
+            headerSeen = true;
+          }
+        }
+      }
+      if (--chunkLeft == 0) {
+        counter = 0;
+        state = State::ChunkId;
+      }
+      return false;
+
+    case State::SkipChunk:
+      if (--chunkLeft == 0) {
+        state = State::ChunkId;
+      }
+      return false;
+
+    default:
+      return pushTrackByte(byte);
+  }
+}
+
+bool SmfReader::readVlq(uint8_t byte) {
+  // VLQ を 1 バイト読み、読み終えたら true（value に結果）。長すぎれば形式エラー。
+  value = (value << 7) | (byte & 0x7F);
+  if ((byte & 0x80) == 0) {
+    counter = 0;
+    return true;
+  }
+  if (++counter >= MAX_VLQ_BYTES) {
+    fail();
+  }
+  return false;
+}
+
+bool SmfReader::finishChannelMessage() {
+  // チャンネルメッセージがそろった: ノートオン/オフだけをイベントにする
+  state = State::Delta;
+  const uint8_t kind = runningStatus & 0xF0;
+  if (kind != 0x80 && kind != 0x90) {
+    return false;
+  }
+  current.type = Event::Type::Note;
+  current.track = static_cast<uint8_t>(tracksDone);
+  current.channel = runningStatus & 0x0F;
+  current.note = data[0];
+  current.velocity = kind == 0x90 ? data[1] : 0;
+  current.tick = trackTick;
+  return true;
+}
+
+bool SmfReader::pushTrackByte(uint8_t byte) {
+  // MTrk チャンクの 1 バイト
+  // 説明: [差分時間 VLQ][イベント] の繰り返しを読みます。ステータスバイトのないチャンネルメッセージは
+  //   直前のステータス（ランニングステータス）を使います。メタイベントと SysEx は長さを読んで飛ばし、
+  //   SysEx の後はランニングステータスを取り消します。
+  // 戻り値: イベントがそろったら true
+  // 副作用: 状態を進める。トラックが終わったら tracksDone を増やす。
+  bool ready = false;
+  chunkLeft--;
+  switch (state) {
+    case State::Delta:
+      if (readVlq(byte)) {
+        trackTick += value;
+        value = 0;
+        state = State::Status;
+      }
+      break;
+
+    case State::Status:
+      if (byte == 0xFF) {
+        state = State::MetaType;
+      } else if (byte == 0xF0 || byte == 0xF7) {
+        runningStatus = 0;
+        value = 0;
+        state = State::SysexLength;
+      } else if (byte >= 0xF0) {
+        fail();
+      } else if (byte & 0x80) {
+        runningStatus = byte;
+        dataCount = 0;
+        dataNeeded = dataBytesFor(byte);
+        state = State::Data;
+      } else if (runningStatus == 0) {
+        fail();
+      } else {
+        data[0] = byte;
+        dataCount = 1;
+        dataNeeded = dataBytesFor(runningStatus);
+        if (dataCount >= dataNeeded) {
+          ready = finishChannelMessage();
+        } else {
+          state = State::Data;
+        }
+      }
+      break;
+
+    case State::Data:
+      if (byte & 0x80) {
+        fail();
+        break;
+      }
+      data[dataCount++] = byte;
+      if (dataCount >= dataNeeded) {
+        ready = finishChannelMessage();
+      }
+      break;
+
+    case State::MetaType:
+      metaType = byte;
+      value = 0;
+      state = State::MetaLength;
+      break;
+
+    case State::MetaLength:
+      if (!readVlq(byte)) {
+        break;
+      }
+      skipLeft = value;
+      value = 0;
+      dataCount = 0;
+      if (metaType == META_END_OF_TRACK) {
+        current.type = Event::Type::TrackEnd;
+        current.track = static_cast<uint8_t>(tracksDone);
+        current.tick = trackTick;
+        ready = true;
+        inTrack = false;
+        tracksDone++;
+        state = chunkLeft > 0 ? State::SkipChunk : State::ChunkId;
+        return ready;
+      }
+      state = skipLeft > 0 ? State::MetaData : State::Delta;
+      break;
+
+    case State::MetaData:
+      if (metaType == META_TEMPO && dataCount < 3) {
+        data[dataCount++] = byte;
+      }
+      if (--skipLeft == 0) {
+        state = State::Delta;
+        if (metaType == META_TEMPO && dataCount == 3) {
+          current.type = Event::Type::Tempo;
+          current.track = static_cast<uint8_t>(tracksDone);
+          current.tick = trackTick;
+          current.tempo = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+          ready = current.tempo > 0;
+        }
+      }
+      break;
+
+    case State::SysexLength:
+      if (readVlq(byte)) {
+        skipLeft = value;
+        value = 0;
+        state = skipLeft > 0 ? State::SkipData : State::Delta;
+      }
+      break;
+
+    case State::SkipData:
+      if (--skipLeft == 0) {
+        state = State::Delta;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (chunkLeft == 0 && inTrack && state != State::Error) {
+    // 終端 (FF 2F 00) のないままチャンクが尽きた: トラックは終わりにする（途中のイベントは捨てる）
+    inTrack = false;
+    tracksDone++;
+    counter = 0;
+    value = 0;
+    state = State::ChunkId;
+  }
+  return ready;
+}
+
+// ---- 書き出し ----
+
+SmfWriter::SmfWriter(const PackedSequence *const *tracks, uint8_t count, uint32_t loopTicks, float bpm,
+                     uint8_t beatsPerBar)
+    : sources(tracks),
+      sourceCount(count > 16 ? 16 : count),
+      lengthTicks(loopTicks),
+      tempo(static_cast<uint32_t>(60000000.0f / (bpm > 0.0f ? bpm : SEQ_DEFAULT_BPM) + 0.5f)),
+      beats(beatsPerBar),
+      totalBytes(0),
+      phase(Phase::Header),
+      conductorStep(0),
+      track(0),
+      lastTick(0),
+      statusSent(false),
+      releaseNote(0),
+      active{0, 0, 0, 0},
+      pendingLength(0),
+      pendingPos(0) {
+  // ファイルの大きさ: ヘッダ、テンポ/拍子のトラック、空でないトラックごとのチャンク
+  totalBytes = 14 + 8 + 7 + 8 + vlqLength(lengthTicks) + 3;
+  for (uint8_t t = 0; t < sourceCount; ++t) {
+    if (sources[t]->eventCount() > 0) {
+      totalBytes += 8 + trackBytes(t);
+    }
+  }
+}
+
+bool SmfWriter::next(uint8_t &byte) {
+  if (pendingPos >= pendingLength) {
+    pendingLength = 0;
+    pendingPos = 0;
+    while (pendingLength == 0 && phase != Phase::Done) {
+      fill();
+    }
+    if (pendingLength == 0) {
+      return false;
+    }
+  }
+  byte = pending[pendingPos++];
+  return true;
+}
+
+void SmfWriter::putVlq(uint32_t number) {
+  uint8_t shift = static_cast<uint8_t>((vlqLength(number) - 1) * 7);
+  while (shift > 0) {
+    putByte(static_cast<uint8_t>(((number >> shift) & 0x7F) | 0x80));
+    shift = static_cast<uint8_t>(shift - 7);
+  }
+  putByte(static_cast<uint8_t>(number & 0x7F));
+}
+
+void SmfWriter::putU32(uint32_t number) {
+  putByte(static_cast<uint8_t>(number >> 24));
+  putByte(static_cast<uint8_t>(number >> 16));
+  putByte(static_cast<uint8_t>(number >> 8));
+  putByte(static_cast<uint8_t>(number));
+}
+
+void SmfWriter::putDelta(uint32_t time) {
+  // ループ長を超える時刻はループの終わりに寄せる
+  if (time > lengthTicks) {
+    time = lengthTicks;
+  }
+  putVlq(time > lastTick ? time - lastTick : 0);
+  if (time > lastTick) {
+    lastTick = time;
+  }
+}
+
+void SmfWriter::setActive(uint8_t note, bool on) {
+  const uint32_t bit = 1UL << (note & 31);
+  if (on) {
+    active[note >> 5] |= bit;
+  } else {
+    active[note >> 5] &= ~bit;
+  }
+}
+
+void SmfWriter::findTrack() {
+  // track から先で最初の空でないトラックへ（なければ書き終わり）
+  while (track < sourceCount && sources[track]->eventCount() == 0) {
+    track++;
+  }
+  phase = track < sourceCount ? Phase::TrackHeader : Phase::Done;
+}
+
+void SmfWriter::startTrack() {
+  reader = sources[track]->reader();
+  lastTick = 0;
+  statusSent = false;
+  releaseNote = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    active[i] = 0;
+  }
+  phase = Phase::TrackEvents;
+}
+
+uint32_t SmfWriter::trackBytes(uint8_t index) const {
+  // トラックのチャンクの中身のバイト数（チャンクヘッダに書くため、写しで一度書き出して数える）
+  SmfWriter counter = *this;
+  counter.track = index;
+  counter.startTrack();
+  uint32_t bytes = 0;
+  while (counter.phase != Phase::TrackHeader && counter.phase != Phase::Done) {
+    counter.pendingLength = 0;
+    counter.fill();
+    bytes += counter.pendingLength;
+  }
+  return bytes;
+}
+
+void SmfWriter::fill() {
+  // 次の 1 まとまり（ヘッダ、メタイベント 1 つ、ノートイベント 1 つなど、16 バイト以内）を pending に作る
+  // 説明: トラック n のノートはチャンネル n のノートオン（ランニングステータス）で書き、
+  //   ノートオフはベロシティ 0 のノートオンにします。ループの終わりで鳴っているノート
+  //   （ループをまたいだノート）はそこでノートオフを書き、対になるノートオンのないノートオフは書きません。
+  // 副作用: phase と各トラックの書き出し位置を進める。
+  switch (phase) {
+    case Phase::Header: {
+      uint8_t trackTotal = 1;
+      for (uint8_t t = 0; t < sourceCount; ++t) {
+        trackTotal += sources[t]->eventCount() > 0 ? 1 : 0;
+      }
+      putU32(CHUNK_MTHD);
+      putU32(6);
+      putByte(0);
+      putByte(1);  // Type 1
+      putByte(0);
+      putByte(trackTotal);
+      putByte(static_cast<uint8_t>(SEQ_PPQN >> 8));
+      putByte(static_cast<uint8_t>(SEQ_PPQN & 0xFF));
+      phase = Phase::Conductor;
+      conductorStep = 0;
+      break;
+    }
+
+    case Phase::Conductor:
+      if (conductorStep == 0) {
+        putU32(CHUNK_MTRK);
+        putU32(7 + 8 + vlqLength(lengthTicks) + 3);
+      } else if (conductorStep == 1) {
+        putByte(0);
+        putByte(0xFF);
+        putByte(META_TEMPO);
+        putByte(3);
+        putByte(static_cast<uint8_t>(tempo >> 16));
+        putByte(static_cast<uint8_t>(tempo >> 8));
+        putByte(static_cast<uint8_t>(tempo));
+      } else if (conductorStep == 2) {
+        putByte(0);
+        putByte(0xFF);
+        putByte(META_TIME_SIGNATURE);
+        putByte(4);
+        putByte(beats);
+        putByte(2);   // 分母 2^2 = 4
+        putByte(24);  // メトロノームのクロック間隔
+        putByte(8);   // 四分音符あたりの 32 分音符の数
+      } else {
+        putVlq(lengthTicks);
+        putByte(0xFF);
+        putByte(META_END_OF_TRACK);
+        putByte(0);
+      }
+      if (++conductorStep >= CONDUCTOR_STEPS) {
+        track = 0;
+        findTrack();
+      }
+      break;
+
+    case Phase::TrackHeader:
+      putU32(CHUNK_MTRK);
+      putU32(trackBytes(track));
+      startTrack();
+      break;
+
+    case Phase::TrackEvents:
+      while (!reader.done()) {
+        const PackedSequence::Event e = reader.event();
+        reader.advance();
+        if (!e.noteOn && !isActive(e.note)) {
+          continue;
+        }
+        putDelta(e.time);
+        if (!statusSent) {
+          putByte(static_cast<uint8_t>(0x90 | (track & 0x0F)));
+          statusSent = true;
+        }
+        putByte(e.note);
+        putByte(e.noteOn ? EXPORT_VELOCITY : 0);
+        setActive(e.note, e.noteOn);
+        return;
+      }
+      phase = Phase::TrackRelease;
+      break;
+
+    case Phase::TrackRelease:
+      // ループの終わりで鳴ったままのノートを 1 つずつ止める（ステータスはノートオンを書いたときに送り済み）
+      while (releaseNote < 128) {
+        const uint8_t note = releaseNote++;
+        if (isActive(note)) {
+          putDelta(lengthTicks);
+          putByte(note);
+          putByte(0);
+          setActive(note, false);
+          return;
+        }
+      }
+      phase = Phase::TrackEnd;
+      break;
+
+    case Phase::TrackEnd:
+      putDelta(lengthTicks);
+      putByte(0xFF);
+      putByte(META_END_OF_TRACK);
+      putByte(0);
+      track++;
+      findTrack();
+      break;
+
+    case Phase::Done:
+      break;
+  }
+}
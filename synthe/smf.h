@@ -0,0 +1,160 @@
+#pragma once
+
+// smf.h
+// Standard MIDI File (SMF) のストリーミング読み書き。ファイル全体をメモリに置かず、
+// 読み込みは 1 バイトずつ push() し、書き出しは next() で 1 バイトずつ取り出します。
+// 使うメモリは数十バイトの固定領域だけなので、シリアル経由の転送にもそのまま使えます。
+//
+// 読み込みは Type 0/1 に対応し、ノートオン/オフ（ベロシティ 0 のノートオンはノートオフ）、
+// テンポ、トラック終端をイベントとして返します。その他のチャンネルメッセージ、メタイベント、
+// SysEx は読み飛ばします。時刻は SMF の分解能のままのティック（トラック先頭から）です。
+// 書き出しは Type 1 で、テンポ/拍子のトラックに続けて PackedSequence ごとに 1 トラックを書きます。
+
+#include "packed_sequence.h"
+
+#include <stdint.h>
+
+class SmfReader {
+public:
+  /**
+   * @brief 読み込んだイベント
+   */
+  struct Event {
+    enum class Type : uint8_t { Note, Tempo, TrackEnd };
+    Type type;
+    uint8_t track;     // MTrk チャンクの番号（0 から）
+    uint8_t channel;   // Note のみ
+    uint8_t note;      // Note のみ
+    uint8_t velocity;  // Note のみ（ノートオフは 0）
+    uint32_t tick;     // トラック先頭からのティック（SMF の分解能）
+    uint32_t tempo;    // Tempo のみ: 四分音符あたりのマイクロ秒
+  };
+
+  SmfReader() { reset(); }
+
+  void reset();
+
+  /**
+   * @brief 1 バイト読み込む
+   * @return イベントがそろったら true（event() で取り出す）
+   */
+  bool push(uint8_t value);
+
+  const Event &event() const { return current; }
+
+  // ヘッダ（MThd）を読み終えたか、形式、トラック数、四分音符あたりのティック
+  bool headerReady() const { return headerSeen; }
+  uint16_t format() const { return smfFormat; }
+  uint16_t trackCount() const { return smfTracks; }
+  uint16_t division() const { return smfDivision; }
+
+  /**
+   * @brief 形式が壊れているか、対応していない（SMPTE 分解能や Type 2）なら true（以降の入力は無視）
+   */
+  bool failed() const { return state == State::Error; }
+
+  /**
+   * @brief 全トラックを読み終えたら true
+   */
+  bool finished() const { return headerSeen && tracksDone >= smfTracks; }
+
+private:
+  enum class State : uint8_t {
+    ChunkId,
+    ChunkLength,
+    Header,
+    SkipChunk,
+    Delta,
+    Status,
+    Data,
+    MetaType,
+    MetaLength,
+    MetaData,
+    SysexLength,
+    SkipData,
+    Error
+  };
+
+  bool pushTrackByte(uint8_t value);
+  bool readVlq(uint8_t value);
+  bool finishChannelMessage();
+  void fail() { state = State::Error; }
+
+  State state;
+  uint8_t counter;       // チャンク ID/長さ/ヘッダ、VLQ の読み込み済みバイト数
+  uint32_t value;        // 読み込み中の数値（チャンク長、VLQ）
+  uint32_t chunkId;
+  uint32_t chunkLeft;    // チャンクの残りバイト数
+  bool inTrack;
+  bool headerSeen;
+  uint16_t smfFormat;
+  uint16_t smfTracks;
+  uint16_t smfDivision;
+  uint16_t tracksDone;
+  uint32_t trackTick;
+  uint8_t runningStatus;
+  uint8_t data[3];       // チャンネルメッセージのデータ、テンポの値
+  uint8_t dataCount;
+  uint8_t dataNeeded;
+  uint8_t metaType;
+  uint32_t skipLeft;     // 読み飛ばす残りバイト数（メタイベント/SysEx/未知のチャンク）
+  Event current;
+};
+
+class SmfWriter {
+public:
+  /**
+   * @param tracks 書き出すイベント列（空のものは書かない。トラック n はチャンネル n）
+   * @param count tracks の数（16 まで）
+   * @param loopTicks 各トラックの長さ（ティック、分解能は SEQ_PPQN）
+   * @param bpm テンポ
+   * @param beatsPerBar 拍子の分子（分母は 4）
+   */
+  SmfWriter(const PackedSequence *const *tracks, uint8_t count, uint32_t loopTicks, float bpm, uint8_t beatsPerBar);
+
+  /**
+   * @brief 次の 1 バイトを取り出す
+   * @return 書き終えていたら false
+   */
+  bool next(uint8_t &value);
+
+  /**
+   * @brief ファイル全体のバイト数
+   */
+  uint32_t size() const { return totalBytes; }
+
+private:
+  enum class Phase : uint8_t { Header, Conductor, TrackHeader, TrackEvents, TrackRelease, TrackEnd, Done };
+
+  static constexpr uint8_t CONDUCTOR_STEPS = 4;
+
+  uint32_t trackBytes(uint8_t index) const;
+  void fill();
+  void putVlq(uint32_t number);
+  void putU32(uint32_t number);
+  void putByte(uint8_t value) { pending[pendingLength++] = value; }
+  void putDelta(uint32_t time);
+  void findTrack();
+  void startTrack();
+  bool isActive(uint8_t note) const { return (active[note >> 5] >> (note & 31)) & 1; }
+  void setActive(uint8_t note, bool on);
+
+  const PackedSequence *const *sources;
+  uint8_t sourceCount;
+  uint32_t lengthTicks;
+  uint32_t tempo;
+  uint8_t beats;
+  uint32_t totalBytes;
+
+  Phase phase;
+  uint8_t conductorStep;
+  uint8_t track;
+  PackedSequence::Reader reader;
+  uint32_t lastTick;
+  bool statusSent;     // このトラックでランニングステータスのステータスバイトを書いた
+  uint8_t releaseNote;
+  uint32_t active[4];  // 書き出し中のトラックで鳴っているノート（ループ終端でノートオフを書く）
+  uint8_t pending[16];
+  uint8_t pendingLength;
+  uint8_t pendingPos;
+};
@@ -0,0 +1,255 @@
+#include "smf_transfer.h"
+
+#include "config.h"
+#include "sequencer.h"
+#include "smf.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+namespace {
+// 1 行で送る 16 進数のバイト数（"smf " + 64 文字がコンソールの行バッファに収まる）
+constexpr uint8_t HEX_BYTES_PER_LINE = 32;
+constexpr uint8_t HEX_LINE_CHARS = 4 + HEX_BYTES_PER_LINE * 2 + 2;
+
+// ---- 読み込み ----
+SmfReader importReader;
+SmfImportStatus importStatus = {false, 0, 0, 0, 0, 0, 0};
+// 読み込み元（Type 0 はチャンネル、Type 1 は MTrk の番号）とトラックの対応。見つかった順に割り当てる。
+uint8_t importSources[SEQ_TRACK_COUNT];
+uint8_t importSourceCount = 0;
+uint32_t importEndTick = 0;
+bool importTempoSet = false;
+bool importing = false;
+
+// ---- 書き出し ----
+const PackedSequence *exportTracks[SEQ_TRACK_COUNT];
+SmfWriter exportWriter(exportTracks, 0, 0, SEQ_DEFAULT_BPM, SEQ_BEATS_PER_BAR);
+bool exporting = false;
+// シリアルへ書き出し中
+bool serialExport = false;
+
+uint32_t toSequencerTicks(uint32_t tick) {
+  // ファイルの分解能から SEQ_PPQN へ（四捨五入）
+  const uint16_t division = importReader.division();
+  return static_cast<uint32_t>((static_cast<uint64_t>(tick) * SEQ_PPQN + division / 2) / division);
+}
+
+int8_t trackForSource(uint8_t source) {
+  for (uint8_t i = 0; i < importSourceCount; ++i) {
+    if (importSources[i] == source) {
+      return static_cast<int8_t>(i);
+    }
+  }
+  if (importSourceCount >= SEQ_TRACK_COUNT) {
+    return -1;
+  }
+  importSources[importSourceCount] = source;
+  return static_cast<int8_t>(importSourceCount++);
+}
+
+void importEvent(const SmfReader::Event &e) {
+  // 読み込んだイベントをシーケンサへ渡す
+  // 説明: 全イベントの時刻は曲の終わりの候補にします。ノートは読み込み元ごとのトラックへ追加し、
+  //   テンポは最初の 1 つだけを使います。
+  // 副作用: importStatus, importEndTick を更新し、シーケンサのトラックへ追記する。
+  const uint32_t tick = toSequencerTicks(e.tick);
+  if (tick > importEndTick) {
+    importEndTick = tick;
+  }
+  if (e.type == SmfReader::Event::Type::Tempo) {
+    if (!importTempoSet) {
+      setSequencerTempo(60000000.0f / e.tempo);
+      importTempoSet = true;
+    }
+    return;
+  }
+  if (e.type != SmfReader::Event::Type::Note) {
+    return;
+  }
+  const int8_t track = trackForSource(importReader.format() == 0 ? e.channel : e.track);
+  if (track >= 0 && importSequencerEvent(static_cast<uint8_t>(track), tick, e.note, e.velocity > 0)) {
+    importStatus.notes++;
+  } else {
+    importStatus.dropped++;
+  }
+}
+
+int8_t hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return static_cast<int8_t>(c - '0');
+  }
+  if (c >= 'a' && c <= 'f') {
+    return static_cast<int8_t>(c - 'a' + 10);
+  }
+  if (c >= 'A' && c <= 'F') {
+    return static_cast<int8_t>(c - 'A' + 10);
+  }
+  return -1;
+}
+
+bool pushHexLine(const char *hex) {
+  // 16 進数の 1 行を読み込みに渡す（2 文字で 1 バイト、それ以外の文字があれば false）
+  uint8_t bytes[HEX_BYTES_PER_LINE];
+  uint8_t count = 0;
+  while (hex[0] != '\0') {
+    const int8_t high = hexValue(hex[0]);
+    const int8_t low = high >= 0 ? hexValue(hex[1]) : -1;
+    if (low < 0) {
+      return false;
+    }
+    bytes[count++] = static_cast<uint8_t>((high << 4) | low);
+    hex += 2;
+    if (count == sizeof(bytes)) {
+      if (!pushSmfImport(bytes, count)) {
+        return false;
+      }
+      count = 0;
+    }
+  }
+  return pushSmfImport(bytes, count);
+}
+
+void printImportResult(bool ok) {
+  const SmfImportStatus status = smfImportStatus();
+  Serial.print(ok ? "smf: imported type " : "smf: import failed, type ");
+  Serial.print(static_cast<unsigned int>(status.format));
+  Serial.print(", ");
+  Serial.print(static_cast<unsigned int>(status.smfTracks));
+  Serial.print(" MTrk, ");
+  Serial.print(static_cast<unsigned long>(status.notes));
+  Serial.print(" notes, ");
+  Serial.print(static_cast<unsigned long>(status.dropped));
+  Serial.print(" dropped, loop ");
+  Serial.print(static_cast<unsigned long>(getSequencerLoopTicks() / (static_cast<uint32_t>(SEQ_PPQN) * SEQ_BEATS_PER_BAR)));
+  Serial.print(" bars, bpm ");
+  Serial.println(static_cast<double>(getSequencerTempo()), 1);
+}
+}  // namespace
+
+void beginSmfImport() {
+  beginSequencerImport();
+  importReader.reset();
+  importStatus = {false, 0, 0, 0, 0, 0, 0};
+  importSourceCount = 0;
+  importEndTick = 0;
+  importTempoSet = false;
+  importing = true;
+}
+
+bool pushSmfImport(const uint8_t *data, uint16_t length) {
+  // ファイルの続きの読み込み
+  // 引数:
+  //   data, length: ファイルの続きのバイト列（区切りはどこでもよい）
+  // 説明: 1 バイトずつパーサへ渡し、そろったイベントをその場でシーケンサへ渡します。
+  // 戻り値: 形式エラーなら false
+  // 副作用: importStatus とシーケンサのトラックを更新する。
+  if (!importing) {
+    return false;
+  }
+  for (uint16_t i = 0; i < length; ++i) {
+    if (importReader.push(data[i])) {
+      importEvent(importReader.event());
+    }
+  }
+  importStatus.bytes += length;
+  if (importReader.headerReady()) {
+    importStatus.format = importReader.format();
+    importStatus.smfTracks = importReader.trackCount();
+    importStatus.division = importReader.division();
+  }
+  return !importReader.failed();
+}
+
+bool endSmfImport() {
+  if (!importing) {
+    return false;
+  }
+  importing = false;
+  endSequencerImport(importEndTick);
+  importStatus.ok = importReader.finished() && !importReader.failed();
+  return importStatus.ok;
+}
+
+SmfImportStatus smfImportStatus() {
+  return importStatus;
+}
+
+uint32_t beginSmfExport() {
+  for (uint8_t t = 0; t < SEQ_TRACK_COUNT; ++t) {
+    exportTracks[t] = &getSequencerTrack(t);
+  }
+  exportWriter = SmfWriter(exportTracks, SEQ_TRACK_COUNT, getSequencerLoopTicks(), getSequencerTempo(), SEQ_BEATS_PER_BAR);
+  exporting = true;
+  return exportWriter.size();
+}
+
+uint16_t readSmfExport(uint8_t *out, uint16_t capacity) {
+  uint16_t count = 0;
+  while (exporting && count < capacity) {
+    if (!exportWriter.next(out[count])) {
+      exporting = false;
+      break;
+    }
+    count++;
+  }
+  return count;
+}
+
+bool handleSmfCommand(const char *line) {
+  // SMF のシリアルコマンド
+  // 引数:
+  //   line: 改行を除いた 1 行
+  // 説明: "smf export" で書き出しを始め（行の送信は serviceSmfTransfer()）、"smf import" で読み込みを始めます。
+  //   読み込み中は "smf <16進>" をファイルの続きとして渡し、"smf end" で確定して結果を出力します。
+  // 戻り値: "smf" コマンドなら true
+  // 副作用: シーケンサの内容を置き換えることがある。Serial へ出力する。
+  if (strncmp(line, "smf", 3) != 0 || (line[3] != '\0' && line[3] != ' ')) {
+    return false;
+  }
+  const char *args = line[3] == ' ' ? line + 4 : line + 3;
+  if (strcmp(args, "export") == 0) {
+    if (importing) {
+      endSmfImport();
+    }
+    Serial.print("smf: size ");
+    Serial.println(static_cast<unsigned long>(beginSmfExport()));
+    serialExport = true;
+  } else if (strcmp(args, "import") == 0) {
+    serialExport = false;
+    exporting = false;
+    beginSmfImport();
+  } else if (strcmp(args, "end") == 0 && importing) {
+    printImportResult(endSmfImport());
+  } else if (importing && args[0] != '\0') {
+    if (!pushHexLine(args)) {
+      printImportResult(endSmfImport());
+    }
+  } else {
+    Serial.println("smf: export | import, then 'smf <hex>' lines and 'smf end'");
+  }
+  return true;
+}
+
+void serviceSmfTransfer() {
+  // シリアルへの書き出し: 送信バッファに 1 行分の空きがあれば "smf <16進>" を 1 行送る
+  if (!serialExport || Serial.availableForWrite() < HEX_LINE_CHARS) {
+    return;
+  }
+  uint8_t bytes[HEX_BYTES_PER_LINE];
+  const uint16_t count = readSmfExport(bytes, sizeof(bytes));
+  if (count == 0) {
+    Serial.println("smf end");
+    serialExport = false;
+    return;
+  }
+  static const char digits[] = "0123456789ABCDEF";
+  char text[HEX_BYTES_PER_LINE * 2 + 1];
+  for (uint16_t i = 0; i < count; ++i) {
+    text[i * 2] = digits[bytes[i] >> 4];
+    text[i * 2 + 1] = digits[bytes[i] & 0x0F];
+  }
+  text[count * 2] = '\0';
+  Serial.print("smf ");
+  Serial.println(text);
+}
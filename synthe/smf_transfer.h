@@ -0,0 +1,74 @@
+#pragma once
+
+// smf_transfer.h
+// シーケンサの内容を Standard MIDI File (smf.h) として読み込み/書き出しします。
+// どちらも 1 バイトずつ流すので、ファイル全体を置くメモリは要りません。
+//
+// 読み込み: Type 0 はチャンネルごと、Type 1 は MTrk チャンクごとに、ノートが最初に現れた順で
+//   トラック 1..SEQ_TRACK_COUNT に割り当てます（入りきらない分は捨てて数えます）。時刻はファイルの
+//   分解能から SEQ_PPQN に換算し、最初のテンポを使い、ループ長は曲の終わりを小節単位に切り上げます。
+//   ベロシティ、2 つ目以降のテンポ、ノート以外のメッセージは捨てます。
+// 書き出し: Type 1（テンポ/拍子のトラック + 空でないトラックごとに 1 つ、トラック n はチャンネル n）。
+//
+// シリアル（本体にはファイルシステムがないため、16 進数の行で転送します）:
+//   smf export        "smf <16進>" の行で書き出し、"smf end" で終わる（1 ティックに 1 行）
+//   smf import        読み込みを始める。続けて "smf <16進>" を送り、"smf end" で確定する
+
+#include <stdint.h>
+
+/**
+ * @brief 読み込みの結果
+ */
+struct SmfImportStatus {
+  bool ok;              // 最後まで読めて形式も正しい
+  uint16_t format;
+  uint16_t smfTracks;   // ファイルの MTrk の数
+  uint16_t division;    // ファイルの分解能（四分音符あたりのティック）
+  uint32_t notes;       // トラックに入れたノートイベントの数
+  uint32_t dropped;     // 割り当てるトラックや容量が足りずに捨てたノートイベントの数
+  uint32_t bytes;       // 読み込んだバイト数
+};
+
+/**
+ * @brief 読み込みを始める（録音と再生を止め、全トラックを空にする）
+ */
+void beginSmfImport();
+
+/**
+ * @brief ファイルの続きを読み込む
+ * @return 形式エラーなら false（以降の入力は無視される）
+ */
+bool pushSmfImport(const uint8_t *data, uint16_t length);
+
+/**
+ * @brief 読み込みを終えてループ長とテンポを決める
+ * @return 全トラックを最後まで読めていれば true（途中まででも読めたイベントは残る）
+ */
+bool endSmfImport();
+
+SmfImportStatus smfImportStatus();
+
+/**
+ * @brief 現在のシーケンスの書き出しを始める
+ *
+ * 書き出し中はトラックを読みながら書くので、終わるまで録音やクリアをしないでください。
+ * @return ファイル全体のバイト数
+ */
+uint32_t beginSmfExport();
+
+/**
+ * @brief 書き出しの続きを取り出す
+ * @return out に書いたバイト数（0 なら書き終わり）
+ */
+uint16_t readSmfExport(uint8_t *out, uint16_t capacity);
+
+/**
+ * @brief SMF のシリアルコマンドを処理する（serial_console.h から呼ばれる）
+ * @return "smf" で始まる行なら true（処理済み）
+ */
+bool handleSmfCommand(const char *line);
+
+/**
+ * @brief シリアルへの書き出しを 1 行進める（serial_console.h から毎ティック呼ばれる）
+ */
+void serviceSmfTransfer();
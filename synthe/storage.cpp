@@ -0,0 +1,175 @@
+#include "storage.h"
+
+#include "flash_store.h"
+#include "hardware_inputs.h"
+#include "midi_input.h"
+#include "sequencer.h"
+#include "synth_state.h"
+#include "voice_manager.h"
+
+#include <string.h>
+
+namespace {
+// キーの割り当て: パッチ、ソングの設定、イベント列（全トラックを連結して分けたもの）
+constexpr uint8_t KEY_PATCH = 0;
+constexpr uint8_t KEY_SONG = KEY_PATCH + STORAGE_PATCH_SLOTS;
+constexpr uint8_t KEY_SONG_PART = KEY_SONG + 1;
+static_assert(KEY_SONG_PART + SEQ_SAVE_PARTS <= STORE_KEY_COUNT, "too many storage keys");
+
+// パッチの形式: [版][sizeof(SynthParams)][SynthParams]
+constexpr uint8_t PATCH_VERSION = 1;
+constexpr uint16_t PATCH_BYTES = 2 + sizeof(SynthParams);
+
+bool serializeRecord(uint8_t key, uint8_t *out, uint16_t capacity, uint16_t *length) {
+  // レコードの内容を作る（flash_store が書き込みを始める直前に呼ぶ）
+  if (key < KEY_SONG) {
+    if (capacity < PATCH_BYTES) {
+      return false;
+    }
+    out[0] = PATCH_VERSION;
+    out[1] = sizeof(SynthParams);
+    memcpy(out + 2, &params, sizeof(SynthParams));
+    *length = PATCH_BYTES;
+    return true;
+  }
+  if (key == KEY_SONG) {
+    return saveSequencerSettings(out, capacity, length);
+  }
+  return saveSequencerPart(static_cast<uint8_t>(key - KEY_SONG_PART), out, capacity, length);
+}
+
+void printStatus() {
+  const StoreStatus status = flashStoreStatus();
+  if (!status.available) {
+    Serial.println("store: unavailable (FLASH_STORE_BASE overlaps the sketch or lies beyond flash)");
+    return;
+  }
+  Serial.print("store: ");
+  Serial.print(static_cast<unsigned int>(status.erasedPages));
+  Serial.print("/");
+  Serial.print(static_cast<unsigned int>(FLASH_STORE_PAGES));
+  Serial.print(" pages erased, ");
+  Serial.print(static_cast<unsigned int>(status.dirtyPages));
+  Serial.print(" to erase, live ");
+  Serial.print(static_cast<unsigned int>(status.liveBytes));
+  Serial.print(" B, page opens ");
+  Serial.print(static_cast<unsigned long>(status.pageOpens));
+  Serial.print(", errors ");
+  Serial.print(static_cast<unsigned int>(status.errors));
+  Serial.println(status.idle ? "" : ", writing");
+
+  const uint8_t *data = nullptr;
+  uint16_t length = 0;
+  Serial.print("  song ");
+  Serial.print(storeRead(KEY_SONG, &data, &length) ? "saved" : "-");
+  Serial.print(", patches");
+  for (uint8_t slot = 0; slot < STORAGE_PATCH_SLOTS; ++slot) {
+    Serial.print(" ");
+    if (storeRead(KEY_PATCH + slot, &data, &length)) {
+      Serial.print(static_cast<unsigned int>(slot));
+    } else {
+      Serial.print("-");
+    }
+  }
+  Serial.println("");
+}
+}  // namespace
+
+void setupStorage() {
+  // 保存領域の準備
+  // 引数: なし
+  // 説明: 保存領域を読み込み（壊れたページの消去を含む）、保存済みのソングとパッチ 0 があれば読み込みます。
+  // 戻り値: なし
+  // 副作用: シーケンサと params を置き換えることがある。
+  if (!mountFlashStore(serializeRecord)) {
+    return;
+  }
+  loadSong();
+  loadPatch(0);
+}
+
+void serviceStorage() {
+  // ページ消去の間は USART の受信割り込みも止まるので、MIDI の受信が途切れているときだけ消去を許す
+  // （スレーブで外部クロックを受けている間はクロックが途切れないので消去しない）
+  constexpr uint32_t MIDI_IDLE_SAMPLES = static_cast<uint32_t>(FLASH_ERASE_MIDI_IDLE_MS) * AUDIO_RATE / 1000;
+  const bool quiet = soundingVoiceCount == 0 && !isSequencerPlaying() && !isSequencerRecording() &&
+                     midiInputIdleSamples() >= MIDI_IDLE_SAMPLES;
+  serviceFlashStore(quiet);
+}
+
+bool saveSong() {
+  bool requested = requestStoreWrite(KEY_SONG);
+  for (uint8_t part = 0; part < SEQ_SAVE_PARTS && requested; ++part) {
+    requested = requestStoreWrite(static_cast<uint8_t>(KEY_SONG_PART + part));
+  }
+  return requested;
+}
+
+bool loadSong() {
+  // ソングの読み込み
+  // 引数: なし
+  // 説明: 設定を読み込んでから（このときシーケンサは止まって空になる）イベント列のレコードを読み込み、
+  //   トラックに分けます。レコードが欠けているか設定と別の時点のもの（書き込みの間に録音した）なら
+  //   トラックは空のままです。
+  // 戻り値: 設定かイベント列が読めなければ false
+  // 副作用: シーケンサの状態を置き換える。
+  const uint8_t *data = nullptr;
+  uint16_t length = 0;
+  if (!storeRead(KEY_SONG, &data, &length) || !loadSequencerSettings(data, length)) {
+    return false;
+  }
+  for (uint8_t part = 0; part < SEQ_SAVE_PARTS; ++part) {
+    if (storeRead(static_cast<uint8_t>(KEY_SONG_PART + part), &data, &length)) {
+      loadSequencerPart(part, data, length);
+    }
+  }
+  return endSequencerLoad();
+}
+
+bool savePatch(uint8_t slot) {
+  return slot < STORAGE_PATCH_SLOTS && requestStoreWrite(static_cast<uint8_t>(KEY_PATCH + slot));
+}
+
+bool loadPatch(uint8_t slot) {
+  const uint8_t *data = nullptr;
+  uint16_t length = 0;
+  if (slot >= STORAGE_PATCH_SLOTS || !storeRead(static_cast<uint8_t>(KEY_PATCH + slot), &data, &length) ||
+      length != PATCH_BYTES || data[0] != PATCH_VERSION || data[1] != sizeof(SynthParams)) {
+    return false;
+  }
+  memcpy(&params, data + 2, sizeof(SynthParams));
+  paramsDirty = PARAM_DIRTY_ALL;
+  latchPots();
+  return true;
+}
+
+bool handleStorageCommand(const char *line) {
+  // 保存用シリアルコマンドの実行
+  // 引数:
+  //   line: 改行を除いた 1 行
+  // 戻り値: "store" / "save ..." / "load ..." なら true
+  // 副作用: 保存の予約、ソング/パッチの読み込み、Serial への出力を行う。
+  if (strcmp(line, "store") == 0) {
+    printStatus();
+    return true;
+  }
+  const bool save = strncmp(line, "save ", 5) == 0;
+  if (!save && strncmp(line, "load ", 5) != 0) {
+    return false;
+  }
+  const char *what = line + 5;
+  bool ok = false;
+  if (strcmp(what, "song") == 0) {
+    ok = save ? saveSong() : loadSong();
+  } else if (strncmp(what, "patch ", 6) == 0) {
+    const uint8_t slot = static_cast<uint8_t>(atoi(what + 6));
+    ok = save ? savePatch(slot) : loadPatch(slot);
+  } else {
+    Serial.println("store: 'save|load song', 'save|load patch <n>', 'store'");
+    return true;
+  }
+  Serial.print(save ? "save " : "load ");
+  Serial.print(what);
+  Serial.println(ok ? (save ? ": queued" : ": ok") : ": failed");
+  return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// storage.h
+// パッチ (SynthParams) とソング（シーケンサの設定と全トラック）をフラッシュ (flash_store.h) に保存します。
+// 保存は予約だけして、実際の書き込みは serviceStorage() が数十ティックかけて進めます。
+// 起動時にはソングとパッチ 0 を読み込みます。
+
+#include "config.h"
+
+#include <Arduino.h>
+
+// 保存できるパッチの数
+constexpr uint8_t STORAGE_PATCH_SLOTS = 4;
+
+/**
+ * @brief 保存領域を読み込み、保存済みのソングとパッチ 0 を復元する（setup() から startMozzi() の前に呼ぶ）
+ */
+void setupStorage();
+
+/**
+ * @brief 保存の書き込みを進める（updateControl() から毎ティック呼ぶ）
+ *
+ * ページ消去（約 20ms CPU が止まる）は、ボイスが鳴っておらずシーケンサも止まっているときだけ行います。
+ */
+void serviceStorage();
+
+/**
+ * @brief ソングの保存を予約する
+ *
+ * 設定とイベント列の各レコードは、それぞれの書き込みを始める時点の内容が保存されます
+ * （途中で録音すると時点がずれ、そのソングはイベント列を読み込めなくなる）。
+ * @return 保存領域が使えなければ false
+ */
+bool saveSong();
+
+/**
+ * @brief 保存したソングを読み込む（再生と録音は止まる）
+ * @return 保存されていないか形式が合わなければ false
+ */
+bool loadSong();
+
+/**
+ * @brief 現在の params をパッチとして保存する予約をする
+ * @param slot 0..STORAGE_PATCH_SLOTS-1
+ */
+bool savePatch(uint8_t slot);
+
+/**
+ * @brief パッチを params に読み込む（ポットは動かすまで反映されなくなる）
+ */
+bool loadPatch(uint8_t slot);
+
+/**
+ * @brief 保存用のシリアルコマンドを処理する（serial_console.h から呼ばれる）
+ *
+ * "store" で状態を出力、"save song"、"save patch <n>"、"load song"、"load patch <n>" で保存/読み込みします。
+ * @return 該当するコマンドなら true（処理済み）
+ */
+bool handleStorageCommand(const char *line);
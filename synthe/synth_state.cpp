@@ -29,70 +29,56 @@ U8G2_SSD1306_128X64_NONAME_F_HW_I2C display(U8G2_R0, /* reset=*/U8X8_PIN_NONE);
 // ボイス配列の実体（静的確保：ヒープを使用しない）
 
 #if defined(FAST_OSC_USE)
-#include "fast_osc.h"
 // 軽量オシレータを使う場合、テーブルを持たない実装を用意
-FastOsc<AUDIO_RATE> fastOscSin[POLY_VOICES];
-FastOsc<AUDIO_RATE> fastOscTri[POLY_VOICES];
-FastOsc<AUDIO_RATE> fastOscSaw[POLY_VOICES];
-FastOsc<AUDIO_RATE> fastOscSquare[POLY_VOICES];
+VoiceOsc voiceOsc[POLY_VOICES];
 #else
-Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> oscSin[POLY_VOICES] = {
-  Oscil<SIN2048_NUM_CELLS, AUDIO_RATE>(SIN2048_DATA),
-  Oscil<SIN2048_NUM_CELLS, AUDIO_RATE>(SIN2048_DATA),
-  Oscil<SIN2048_NUM_CELLS, AUDIO_RATE>(SIN2048_DATA),
-  Oscil<SIN2048_NUM_CELLS, AUDIO_RATE>(SIN2048_DATA)
-};
-Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE> oscTri[POLY_VOICES] = {
-  Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE>(TRIANGLE2048_DATA),
-  Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE>(TRIANGLE2048_DATA),
-  Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE>(TRIANGLE2048_DATA),
-  Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE>(TRIANGLE2048_DATA)
-};
-Oscil<SAW2048_NUM_CELLS, AUDIO_RATE> oscSaw[POLY_VOICES] = {
-  Oscil<SAW2048_NUM_CELLS, AUDIO_RATE>(SAW2048_DATA),
-  Oscil<SAW2048_NUM_CELLS, AUDIO_RATE>(SAW2048_DATA),
-  Oscil<SAW2048_NUM_CELLS, AUDIO_RATE>(SAW2048_DATA),
-  Oscil<SAW2048_NUM_CELLS, AUDIO_RATE>(SAW2048_DATA)
-};
-Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE> oscSquare[POLY_VOICES] = {
-  Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE>(SQUARE_NO_ALIAS_2048_DATA),
-  Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE>(SQUARE_NO_ALIAS_2048_DATA),
-  Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE>(SQUARE_NO_ALIAS_2048_DATA),
-  Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE>(SQUARE_NO_ALIAS_2048_DATA)
+Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> oscSin[POLY_VOICES];
+Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE> oscTri[POLY_VOICES];
+// ノコギリ/矩形は 2048 エントリのテーブルを持たず、PolyBLEP で帯域制限した整数オシレータを使う
+FastOscFixed<AUDIO_RATE> oscSaw[POLY_VOICES];
+FastOscFixed<AUDIO_RATE> oscSquare[POLY_VOICES];
+Phasor<AUDIO_RATE> pulsePhasor[POLY_VOICES];
+
+namespace {
+// ボイス数は POLY_VOICES_MAX で変わるので、テーブルと波形は初期化子ではなくループで設定する
+struct VoiceOscInitializer {
+  VoiceOscInitializer() {
+    for (uint8_t v = 0; v < POLY_VOICES; ++v) {
+      oscSin[v].setTable(SIN2048_DATA);
+      oscTri[v].setTable(TRIANGLE2048_DATA);
+      oscSaw[v].setWave(FastOscFixed<AUDIO_RATE>::SAW_BL);
+      oscSquare[v].setWave(FastOscFixed<AUDIO_RATE>::SQUARE_BL);
+    }
+  }
 };
+
+VoiceOscInitializer voiceOscInitializer;
+}  // namespace
 #endif
-Phasor<AUDIO_RATE> pulsePhasor[POLY_VOICES];
 
 #if defined(FAST_OSC_USE)
-FastOsc<AUDIO_RATE> lfoPitch;
-FastOsc<AUDIO_RATE> lfoFilter;
+LfoOsc lfoPitch;
+LfoOsc lfoFilter;
 
 namespace {
 struct FastOscInitializer {
   FastOscInitializer() {
-    for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-      fastOscSin[i].setWave(FastOsc<AUDIO_RATE>::SINE);
-      fastOscTri[i].setWave(FastOsc<AUDIO_RATE>::TRIANGLE);
-      fastOscSaw[i].setWave(FastOsc<AUDIO_RATE>::SAW);
-      fastOscSquare[i].setWave(FastOsc<AUDIO_RATE>::SQUARE);
-    }
-    lfoPitch.setWave(FastOsc<AUDIO_RATE>::SINE);
-    lfoFilter.setWave(FastOsc<AUDIO_RATE>::SINE);
+    lfoPitch.setWave(LfoOsc::SINE);
+    lfoFilter.setWave(LfoOsc::SINE);
   }
 };
 
 FastOscInitializer fastOscInitializer;
 }  // namespace
 #else
-Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> lfoPitch(SIN2048_DATA);
-Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> lfoFilter(SIN2048_DATA);
+LfoOsc lfoPitch(SIN2048_DATA);
+LfoOsc lfoFilter(SIN2048_DATA);
 #endif
 
 ADSR<CONTROL_RATE, AUDIO_RATE> envelopeInstance[POLY_VOICES];
 LowPassFilter filterInstance[POLY_VOICES];
 
 SynthParams params;
-float voiceCurrentFreq[POLY_VOICES] = {440.0f, 440.0f, 440.0f, 440.0f};
-float voiceTargetFreq[POLY_VOICES] = {440.0f, 440.0f, 440.0f, 440.0f};
-bool voiceActive[POLY_VOICES] = {false, false, false, false};
-uint8_t voiceNote[POLY_VOICES] = {0, 0, 0, 0};
+uint8_t paramsDirty = PARAM_DIRTY_ALL;
+float voiceCurrentFreq[POLY_VOICES];
+float voiceTargetFreq[POLY_VOICES];
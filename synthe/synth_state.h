@@ -16,14 +16,10 @@
 #include <tables/sin2048_int8.h>
 #if !defined(FAST_OSC_USE)
 #include <tables/triangle2048_int8.h>
-#include <tables/saw2048_int8.h>
-#include <tables/square_no_alias_2048_int8.h>
 #endif
 
-// Optional lightweight oscillator
-#if defined(FAST_OSC_USE)
+// Lightweight oscillators (ノコギリ/矩形は Mozzi テーブルの代わりに帯域制限版を常に使う)
 #include "fast_osc.h"
-#endif
 
 struct SynthParams {
   float pitchOffset = 0.0f;
@@ -42,11 +38,7 @@ struct SynthParams {
 constexpr uint8_t ANALOG_INPUT_COUNT = 6;
 extern const uint8_t analogPins[ANALOG_INPUT_COUNT];
 
-#if defined(ARDUINO_ARCH_STM32)
-constexpr float ANALOG_MAX_VALUE = 4095.0f;
-#else
-constexpr float ANALOG_MAX_VALUE = 1023.0f;
-#endif
+constexpr float ANALOG_MAX_VALUE = POT_MAX_VALUE;
 
 #if defined(KEYBOARD_DRIVER_MCP23017)
 constexpr uint8_t MCP_KEYBOARD_ADDR = 0x20;
@@ -82,39 +74,51 @@ extern U8G2_SSD1306_128X64_NONAME_F_HW_I2C display;
  * @brief グローバルなシンセパラメータ構造体
  */
 extern SynthParams params;
-// ポリフォニーボイス数
-constexpr uint8_t POLY_VOICES = 4;
+
+/**
+ * @brief params のどの部分が変わったか（書き換えた側が立て、反映した側が消す）
+ *
+ * 下流の再計算（エンベロープ時間、波形モーフ/レゾナンス/ゲインの係数）は立っているものだけ行います。
+ */
+enum ParamDirty : uint8_t {
+  PARAM_DIRTY_ENVELOPE = 1 << 0,  // envAttack, envSustain, envRelease → 各ボイスの ADSR
+  PARAM_DIRTY_TIMBRE = 1 << 1,    // waveMorph, filterResonance, masterGain → 変調ステージの共通係数
+  PARAM_DIRTY_ALL = PARAM_DIRTY_ENVELOPE | PARAM_DIRTY_TIMBRE
+};
+extern uint8_t paramsDirty;
+// ポリフォニーボイス数の上限（config.h の POLY_VOICES_MAX。実際に割り当てる数は voice_manager が CPU 負荷から決める）
+constexpr uint8_t POLY_VOICES = POLY_VOICES_MAX;
 
 // 各ボイスごとのオシレータ/フェーズ/エンベロープ/フィルタは静的確保されます。
 // 各配列の実体は synth_state.cpp に定義されています。
 #if defined(FAST_OSC_USE)
-extern FastOsc<AUDIO_RATE> fastOscSin[POLY_VOICES];
-extern FastOsc<AUDIO_RATE> fastOscTri[POLY_VOICES];
-extern FastOsc<AUDIO_RATE> fastOscSaw[POLY_VOICES];
-extern FastOsc<AUDIO_RATE> fastOscSquare[POLY_VOICES];
+// ボイスごとに位相 1 本のモーフオシレータ（有効な 2 波形のみ評価）
+typedef MorphOsc<AUDIO_RATE> VoiceOsc;
+extern VoiceOsc voiceOsc[POLY_VOICES];
 #else
 extern Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> oscSin[POLY_VOICES];
 extern Oscil<TRIANGLE2048_NUM_CELLS, AUDIO_RATE> oscTri[POLY_VOICES];
-extern Oscil<SAW2048_NUM_CELLS, AUDIO_RATE> oscSaw[POLY_VOICES];
-extern Oscil<SQUARE_NO_ALIAS_2048_NUM_CELLS, AUDIO_RATE> oscSquare[POLY_VOICES];
-#endif
+extern FastOscFixed<AUDIO_RATE> oscSaw[POLY_VOICES];
+extern FastOscFixed<AUDIO_RATE> oscSquare[POLY_VOICES];
 extern Phasor<AUDIO_RATE> pulsePhasor[POLY_VOICES];
+#endif
 
 // グローバル LFO（共有）
-#if defined(FAST_OSC_USE)
-extern FastOsc<AUDIO_RATE> lfoPitch;
-extern FastOsc<AUDIO_RATE> lfoFilter;
+// LFO は変調ステージ (updateControl) で 1 回ずつ進めるため、更新レートはコントロールレートです。
+#if defined(FAST_OSC_FIXED)
+typedef FastOscFixed<MOZZI_CONTROL_RATE> LfoOsc;
+#elif defined(FAST_OSC_USE)
+typedef FastOsc<MOZZI_CONTROL_RATE> LfoOsc;
 #else
-extern Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> lfoPitch;
-extern Oscil<SIN2048_NUM_CELLS, AUDIO_RATE> lfoFilter;
+typedef Oscil<SIN2048_NUM_CELLS, MOZZI_CONTROL_RATE> LfoOsc;
 #endif
+extern LfoOsc lfoPitch;
+extern LfoOsc lfoFilter;
 
 // 各ボイスのエンベロープ/フィルタはポインタで扱う
 extern ADSR<CONTROL_RATE, AUDIO_RATE> envelopeInstance[POLY_VOICES];
 extern LowPassFilter filterInstance[POLY_VOICES];
 
-// グローバルパラメータとボイス状態
+// ボイスごとの周波数（割り当て状態は voice_manager.h の voices / soundingVoices）
 extern float voiceCurrentFreq[POLY_VOICES];
 extern float voiceTargetFreq[POLY_VOICES];
-extern bool voiceActive[POLY_VOICES];
-extern uint8_t voiceNote[POLY_VOICES];
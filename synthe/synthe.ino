@@ -1,5 +1,6 @@
 #include "config.h"
-#define MOZZI_ANALOG_READ_RESOLUTION 12
+// ポットは pot_scan が ADC1 を DMA で回して読むので、Mozzi には ADC を使わせない
+#define MOZZI_ANALOG_READ MOZZI_ANALOG_READ_NONE
 
 #include <Arduino.h>
 #include <Mozzi.h>
@@ -7,16 +8,14 @@
 
 #include "audio_engine.h"
 #include "hardware_inputs.h"
+#include "midi_clock.h"
+#include "midi_input.h"
+#include "pot_scan.h"
 #include "sequencer.h"
+#include "storage.h"
 #include "synth_state.h"
 #include "visualizer.h"
 
-
-float readNormalizedPot(uint8_t pin) {
-  uint16_t value = mozziAnalogRead(pin);
-  return static_cast<float>(value) / ANALOG_MAX_VALUE;
-}
-
 // ============================================================
 //  Synth configuration for STM32F103 (Blue Pill) with Mozzi
 // ============================================================
@@ -34,7 +33,7 @@ float readNormalizedPot(uint8_t pin) {
 void setup() {
   // 初期セットアップ
   // 説明: I2C の初期化、ディスプレイ初期化、ランダムシード設定、
-  //   エキスパンダと MIDI シリアル、エンベロープ/LFO の初期値設定を行います。
+  //   エキスパンダと MIDI シリアル、ポットの ADC スキャン、エンベロープ/LFO の初期値設定を行います。
   // 戻り値: なし
   // 副作用: ハードウェア初期化を行う。
   Wire.begin();
@@ -49,17 +48,16 @@ void setup() {
 
 
   Serial1.begin(31250);
+  Serial.begin(115200);  // シリアルコマンド ("prof"、"seq"、"save" など) 用
 
-  // 各ボイスのエンベロープ設定を初期化
-  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-    envelopeInstance[i].setAttackTime(static_cast<unsigned int>(params.envAttack));
-    envelopeInstance[i].setDecayTime(0);
-    envelopeInstance[i].setSustainLevel(static_cast<uint8_t>(params.envSustain * 255.0f));
-    envelopeInstance[i].setReleaseTime(static_cast<unsigned int>(params.envRelease));
+  // ここから ADC1 はポットのスキャン専用（analogRead() は上の randomSeed() が最後）
+  if (!potScanBegin()) {
+    Serial.println("pots: ADC/DMA scan could not be started");
   }
 
-  lfoPitch.setFreq(params.lfoRate);
-  lfoFilter.setFreq(params.lfoRate * 0.75f);
+  setupAudioEngine();
+  // 保存済みのソングとパッチを読み込む（ページ消去で止まってもよいよう startMozzi() の前に行う）
+  setupStorage();
 
   startMozzi(MOZZI_CONTROL_RATE);
 }
@@ -67,7 +65,12 @@ void setup() {
 void loop() {
   // メインループ
   // 説明: Mozzi ライブラリのオーディオフックを呼び出し、オーディオ・コントロールの更新を行います。
+  //   MIDI の受信バイトはここで受信時刻を付けて取り込み、マスターならクロックを送ります
+  //   （どちらもコントロールティックを待たない）。
   // 戻り値: なし
   // 副作用: オーディオ出力とコントロール更新が実行される。
   audioHook();
+  pollMidiInput();
+  serviceMidiClock();
+  serviceKeyboard();
 }
@@ -1,22 +1,33 @@
 #include "visualizer.h"
 
+#include "capture_ring.h"
+#include "fixed_fft.h"
+#include "profiler.h"
 #include "sequencer.h"
 #include "synth_state.h"
+#include "voice_manager.h"
 
 #include <Arduino.h>
-#include <arduinoFFT.h>
 #include <math.h>
+#include <string.h>
 
 namespace {
-constexpr uint16_t FFT_SAMPLES = 128;
-constexpr double FFT_SAMPLE_RATE = static_cast<double>(AUDIO_RATE);
+constexpr uint16_t FFT_SAMPLES = FIXED_FFT_SIZE;
 
-double fftReal[FFT_SAMPLES];
-double fftImag[FFT_SAMPLES];
-ArduinoFFT<double> FFT(fftReal, fftImag, FFT_SAMPLES, FFT_SAMPLE_RATE);
+// 1 コントロールティックで進める FFT 演算数（FIXED_FFT_STEPS = 256 なので 8 ティックで完了）
+constexpr uint16_t FFT_STEPS_PER_TICK = 32;
 
-int16_t waveformBuffer[FFT_SAMPLES];
-volatile uint16_t waveformWriteIndex = 0;
+// 整数 FFT の作業領域と振幅。振幅は計算中の側と表示中の側の 2 面を持ち、
+// 完了時に入れ替えるので renderSpectrum() が途中結果を描くことはない。
+FixedFftComplex fftWork[FIXED_FFT_BINS];
+uint32_t fftMagnitude[2][FIXED_FFT_BINS];
+uint8_t fftFront = 0;
+bool fftRunning = false;
+uint16_t fftCursor = 0;
+
+// オーディオ経路から書き込まれる波形キャプチャ（SPSC リング）と、波形表示用の最後の有効フレーム
+CaptureRing captureRing(VIS_CAPTURE_DECIMATION);
+int16_t waveformFrame[FFT_SAMPLES];
 
 void renderWaveform(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
   // 描画用波形レンダラー
@@ -24,17 +35,27 @@ void renderWaveform(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
   //   x, y: フレームの左上座標（ピクセル）
   //   width, height: フレームの幅と高さ（ピクセル）
   // 説明:
-  //   内部バッファ `waveformBuffer` から波形サンプルを読み取り、指定領域内に波形をプロットします。
-  //   バッファは環状で書き込みインデックス `waveformWriteIndex` により最新位置が管理されています。
+  //   キャプチャリングから連続した FFT_SAMPLES サンプルのスナップショットを取り、指定領域内にプロットします。
+  //   VIS_WAVEFORM_TRIGGERED 時は立ち上がりゼロクロスに同期させて表示を静止させます。
+  //   スナップショットは一旦スタックに取り、取れたときだけ `waveformFrame` へ移すので、
+  //   取れなかった場合は前回のフレームを描きます（途中で書き換わったフレームは描かない）。
   // 戻り値: なし
-  // 副作用: ディスプレイにピクセルを描画する（`display` に依存）。
+  // 副作用: ディスプレイにピクセルを描画する（`display` に依存）。`waveformFrame` を更新する。
   // 注意: width が大きい場合はサンプルを間引いて表示します（パフォーマンスと表示密度の両立）。
+  int16_t frame[FFT_SAMPLES];
+#if defined(VIS_WAVEFORM_TRIGGERED)
+  const bool captured = captureRing.snapshotTriggered(frame, FFT_SAMPLES, 0);
+#else
+  const bool captured = captureRing.snapshot(frame, FFT_SAMPLES);
+#endif
+  if (captured) {
+    memcpy(waveformFrame, frame, sizeof(waveformFrame));
+  }
   display.drawFrame(x, y, width, height);
   uint8_t step = max<uint8_t>(1, FFT_SAMPLES / width);
-  uint16_t baseIndex = waveformWriteIndex;
   for (uint8_t i = 0; i < width - 1; ++i) {
-    uint16_t index = (baseIndex + i * step) % FFT_SAMPLES;
-    int16_t sample = waveformBuffer[index];
+    uint16_t index = (i * step) % FFT_SAMPLES;
+    int16_t sample = waveformFrame[index];
     int centered = static_cast<int>(y + (height / 2) - (sample / 32768.0f) * (height / 2 - 1));
     centered = constrain(centered, y + 1, y + height - 2);
     display.drawPixel(x + i + 1, centered);
@@ -47,20 +68,43 @@ void renderSpectrum(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
   //   x, y: フレームの左上座標（ピクセル）
   //   width, height: フレームの幅と高さ（ピクセル）
   // 説明:
-  //   FFT の計算結果（`fftReal` に格納された振幅）を縦棒グラフとして描画します。
+  //   FFT の計算結果（`fftMagnitude` の公開側に格納された振幅）を縦棒グラフとして描画します。
   //   対数スケール（log10(1 + magnitude)）で高さを決め、表示領域に収まるよう制限します。
   // 戻り値: なし
   // 副作用: ディスプレイにラインを描画する。
   // 注意: FFT は別関数 `computeFFT()` により更新されるため、本関数は描画のみを担当します。
   display.drawFrame(x, y, width, height);
-  uint8_t bins = min<uint8_t>(width - 2, FFT_SAMPLES / 2);
+  uint8_t bins = min<uint8_t>(width - 2, FIXED_FFT_BINS);
   for (uint8_t i = 0; i < bins; ++i) {
-    double magnitude = fftReal[i];
-    int barHeight = static_cast<int>(log10(1 + magnitude) * (height - 2));
+    float magnitude = static_cast<float>(fftMagnitude[fftFront][i]);
+    int barHeight = static_cast<int>(log10f(1.0f + magnitude) * (height - 2));
     barHeight = constrain(barHeight, 0, height - 2);
     display.drawLine(x + 1 + i, y + height - 1, x + 1 + i, y + height - 1 - barHeight);
   }
 }
+
+void renderProfilePage() {
+  // デバッグページ（サイクル計測）レンダラー
+  // 引数: なし
+  // 説明:
+  //   計測区間ごとに平均/最大サイクル数を 1 行ずつ描画します。AUD と CTRL の行には
+  //   デッドライン超過回数を "!n" で付けます。大文字と数字だけなので 7px 間隔で 9 行収まります。
+  // 戻り値: なし
+  // 副作用: ディスプレイに文字列を描画する。
+  char line[28];
+  for (uint8_t i = 0; i < static_cast<uint8_t>(ProfileStage::Count); ++i) {
+    ProfileStage stage = static_cast<ProfileStage>(i);
+    const ProfileStats &s = profileStats(stage);
+    unsigned long avg = s.calls ? static_cast<unsigned long>(s.totalCycles / s.calls) : 0;
+    int n = snprintf(line, sizeof(line), "%-4s%7lu%8lu", profileStageName(stage), avg,
+                     static_cast<unsigned long>(s.maxCycles));
+    if (stage == ProfileStage::Audio || stage == ProfileStage::ControlTick) {
+      snprintf(line + n, sizeof(line) - n, " !%lu", static_cast<unsigned long>(profileDeadlineMisses(stage)));
+    }
+    display.setCursor(0, 7 * (i + 1));
+    display.print(line);
+  }
+}
 }
 
 void updateDisplay() {
@@ -70,6 +114,7 @@ void updateDisplay() {
   //   各種パラメータ（周波数、モーフ、フィルタ、エンベロープ、シーケンサ状態）を表示し、
   //   波形とスペクトラムの描画を行った後、バッファをディスプレイへ送信します。
   //   更新レートは約50ms 毎に制限されています（フレームレート抑制）。
+  //   デバッグページが有効な間は代わりにサイクル計測の結果を表示します。
   // 戻り値: なし
   // 副作用: 表示バッファのクリア・描画・送信を行う。
   // 注意: この関数は UI 更新を行うのみで、FFT の計算や波形サンプルの収集は別関数で行われます。
@@ -82,13 +127,19 @@ void updateDisplay() {
 
   display.clearBuffer();
   display.setFont(u8g2_font_5x8_tr);
+  if (isProfilePageVisible()) {
+    renderProfilePage();
+    display.sendBuffer();
+    return;
+  }
   display.setCursor(0, 8);
   display.print("Freq:");
-  // ポリフォニー対応: 活動中のボイスから表示周波数を決定する（最初のアクティブボイスを表示）
+  // ポリフォニー対応: 押鍵中のボイスから表示周波数を決定する（リスト上で最初のボイスを表示）
   int displayFreq = 0;
-  for (uint8_t i = 0; i < POLY_VOICES; ++i) {
-    if (voiceActive[i]) {
-      displayFreq = static_cast<int>(voiceCurrentFreq[i]);
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    uint8_t v = soundingVoices[i];
+    if (voices[v].state != VoiceState::Release) {
+      displayFreq = static_cast<int>(voiceCurrentFreq[v]);
       break;
     }
   }
@@ -122,8 +173,13 @@ void updateDisplay() {
   } else {
     display.print("STOP");
   }
+  display.print(" T");
+  display.print(static_cast<int>(getSelectedTrack() + 1));
+  display.print(isTrackMuted(getSelectedTrack()) ? "m" : "");
+  display.print(isTrackSoloed(getSelectedTrack()) ? "s" : "");
   display.print(" E:");
   display.print(getSequenceLength());
+  display.print(isSequencerStoreFull() ? " FULL" : "");
 
   renderWaveform(64, 0, 63, 31);
   renderSpectrum(64, 32, 63, 31);
@@ -132,44 +188,47 @@ void updateDisplay() {
 }
 
 void pushSampleForFFT(int16_t sample) {
-  // 波形サンプルを FFT 用環状バッファに追加する
+  // 波形サンプルをキャプチャリングに追加する
   // 引数:
   //   sample: 16ビットPCM相当の波形サンプル（-32768..32767）
   // 説明:
-  //   呼び出されると最新のサンプルが `waveformBuffer` に格納され、書き込みインデックスが進みます。
+  //   `captureRing` の生産者側。VIS_CAPTURE_DECIMATION に従って間引いて記録します。
   // 戻り値: なし
-  // 副作用: グローバルバッファを書き換える。割り込みコンテキストから呼ぶ可能性がある場合は
-  //   `waveformWriteIndex` が volatile として定義されているため原子性に注意。
-  waveformBuffer[waveformWriteIndex] = sample;
-  waveformWriteIndex = (waveformWriteIndex + 1) % FFT_SAMPLES;
+  // 副作用: キャプチャリングを書き換える。ロックや割り込み禁止は行わないので
+  //   オーディオ割り込みから呼んでもブロックしない。
+  captureRing.push(sample);
 }
 
 void computeFFT() {
-  // FFT を計算して振幅スペクトルを更新する
+  // FFT を少しずつ計算して振幅スペクトルを更新する
   // 引数: なし
   // 説明:
-  //   内部の波形環状バッファから一定数（FFT_SAMPLES）分のサンプルを取り出し、
-  //   arduinoFFT ライブラリで窓関数・FFT・複素数からの振幅変換を行い、結果を `fftReal` に格納します。
-  //   実行間隔は約100ms に制限されています。
+  //   約100ms 毎にキャプチャリングから 1 回だけスナップショットを取り（窓関数込みで作業領域へ読み込み）、
+  //   以降のティックで FFT_STEPS_PER_TICK 演算ずつ固定小数点 FFT（fixed_fft.h）を進めます。
+  //   完了したら振幅バッファの表裏を入れ替えて公開します。
+  //   1 ティックあたりの処理量が一定になるため、鍵盤スキャンや MIDI 処理の遅延が周期的に跳ねません。
   // 戻り値: なし
-  // 副作用: `fftReal` / `fftImag` を上書きする。
-  // 注意: 呼び出し元が定期的に呼ぶことを想定。データ取り出し時に `waveformWriteIndex` が更新される
-  //   可能性があるため、正確な位相/時間整合が必要ならロックを検討してください。
-  static uint32_t lastFFT = 0;
-  uint32_t now = millis();
-  if (now - lastFFT < 100) {
+  // 副作用: `fftWork` / `fftMagnitude` / `fftFront` を更新する。
+  // 注意: updateControl() から毎ティック呼ぶことを想定。
+  if (!fftRunning) {
+    static uint32_t lastFFT = 0;
+    uint32_t now = millis();
+    if (now - lastFFT < 100) {
+      return;
+    }
+    int16_t frame[FFT_SAMPLES];
+    if (!captureRing.snapshot(frame, FFT_SAMPLES)) {
+      return;  // まだ溜まっていないか上書きが続いた。次のティックで再試行する
+    }
+    lastFFT = now;
+    fixedFftLoad(frame, 0, fftWork);
+    fftCursor = 0;
+    fftRunning = true;
     return;
   }
-  lastFFT = now;
 
-  uint16_t start = waveformWriteIndex;
-  for (uint16_t i = 0; i < FFT_SAMPLES; ++i) {
-    uint16_t idx = (start + i) % FFT_SAMPLES;
-    fftReal[i] = static_cast<double>(waveformBuffer[idx]);
-    fftImag[i] = 0.0;
+  if (fixedFftResume(fftWork, fftMagnitude[fftFront ^ 1], fftCursor, FFT_STEPS_PER_TICK)) {
+    fftFront ^= 1;
+    fftRunning = false;
   }
-
-  FFT.windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-  FFT.compute(FFT_FORWARD);
-  FFT.complexToMagnitude();
 }
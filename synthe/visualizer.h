@@ -23,10 +23,10 @@ void updateDisplay();
 void pushSampleForFFT(int16_t sample);
 
 /**
- * @brief FFT を計算してスペクトル結果を更新する
+ * @brief FFT を少しずつ計算してスペクトル結果を更新する
  *
- * @details 内部の波形バッファから FFT_SAMPLES 分のデータを取り出し、窓関数適用、FFT 計算、
- *          複素->振幅変換を実行します。結果はグローバル配列（fftReal/fftImag）に格納されます。
- * @note 実行間隔は内部で制限されています（約100ms）。
+ * @details 約100ms 毎に内部の波形バッファをスナップショットし、その後のコントロールティックで
+ *          一定数ずつ固定小数点 FFT を進めます。完了した時点で振幅を表示側へ公開します。
+ * @note 毎コントロールティック呼び出してください。1 回あたりの処理時間はほぼ一定です。
  */
 void computeFFT();
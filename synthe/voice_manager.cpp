@@ -0,0 +1,254 @@
+#include "voice_manager.h"
+
+#include "cycle_counter.h"
+
+#include <math.h>
+
+Voice voices[POLY_VOICES];
+uint8_t soundingVoices[POLY_VOICES];
+uint8_t soundingVoiceCount = 0;
+uint8_t voiceBudget = POLY_VOICES;
+
+namespace {
+constexpr uint8_t MIDI_NOTE_COUNT = 128;
+// ノート → ボイス番号 + 1（0 は未割り当て。ゼロ初期化のままで使える）
+uint8_t noteToVoice[MIDI_NOTE_COUNT];
+uint32_t noteOnCounter = 0;
+uint8_t fadingVoiceCount = 0;
+
+// 負荷制御。ブロック生成がブロック周期の SHED を超えたら減らし、
+// 1 ボイス足しても GROW 未満と見込める状態が GROW_HOLD_TICKS 続いたら増やす。
+// 残りの時間は Mozzi の出力処理と updateControl() のために空けておく。
+constexpr uint32_t SHED_CYCLES = AUDIO_BLOCK_CYCLES * 3 / 4;
+constexpr uint32_t GROW_CYCLES = AUDIO_BLOCK_CYCLES * 3 / 5;
+constexpr uint8_t GROW_HOLD_TICKS = MOZZI_CONTROL_RATE / 2;
+// 負荷超過で消すボイスのリリース時間
+constexpr unsigned int SHED_RELEASE_MS = 8;
+// ボイスが鳴っていないときのブロックの生成サイクル（ミックス・イベントの発火・波形の記録などの固定分、移動平均）
+uint32_t baseCostCycles = 0;
+// 1 ボイスあたりの推定生成サイクル（固定分を引いたブロックのコストを発音数で割ったものの移動平均）
+uint32_t voiceCostCycles = GROW_CYCLES / POLY_VOICES;
+uint8_t growHoldTicks = 0;
+
+float midiToFreq(float note) {
+  return 440.0f * powf(2.0f, (note - 69.0f) / 12.0f);
+}
+
+void addSounding(uint8_t v) {
+  soundingVoices[soundingVoiceCount++] = v;
+}
+
+void removeSounding(uint8_t v) {
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    if (soundingVoices[i] == v) {
+      soundingVoices[i] = soundingVoices[--soundingVoiceCount];
+      return;
+    }
+  }
+}
+
+void unmapNote(uint8_t v) {
+  uint8_t note = voices[v].note;
+  if (noteToVoice[note] == v + 1) {
+    noteToVoice[note] = 0;
+  }
+}
+
+int8_t pickVictim(bool includeFading) {
+  // 奪う/消すボイスを選ぶ
+  // 説明: リリース中で最もエンベロープが小さいボイス、無ければ最も古くノートオンされたボイス。
+  //   includeFading が false なら既に消している途中のボイスは除きます。
+  // 戻り値: ボイス番号（候補が無ければ -1）
+  int8_t quietest = -1;
+  int8_t oldest = -1;
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    uint8_t v = soundingVoices[i];
+    const Voice &voice = voices[v];
+    if (voice.fading && !includeFading) {
+      continue;
+    }
+    if (voice.state == VoiceState::Release && (quietest < 0 || voice.level < voices[quietest].level)) {
+      quietest = static_cast<int8_t>(v);
+    }
+    if (oldest < 0 || static_cast<int32_t>(voice.order - voices[oldest].order) < 0) {
+      oldest = static_cast<int8_t>(v);
+    }
+  }
+  return quietest >= 0 ? quietest : oldest;
+}
+
+uint8_t allocateVoice() {
+  // 割り当てるボイスを選ぶ
+  // 説明: 割り当て中のボイスが voiceBudget 未満なら待機中のボイスを使い、そうでなければ
+  //   発音中のボイスから pickVictim() で奪います。
+  // 戻り値: ボイス番号
+  // 副作用: なし
+  if (soundingVoiceCount - fadingVoiceCount < voiceBudget && soundingVoiceCount < POLY_VOICES) {
+    for (uint8_t v = 0; v < POLY_VOICES; ++v) {
+      if (voices[v].state == VoiceState::Idle) {
+        return v;
+      }
+    }
+  }
+  int8_t victim = pickVictim(true);
+  return victim >= 0 ? static_cast<uint8_t>(victim) : 0;
+}
+
+void clearFading(uint8_t v) {
+  // 短いリリースで消していたボイスを再利用する/解放するときはリリース時間を params に戻す
+  if (voices[v].fading) {
+    voices[v].fading = false;
+    fadingVoiceCount--;
+    envelopeInstance[v].setReleaseTime(static_cast<unsigned int>(params.envRelease));
+  }
+}
+
+void fadeOutVoice(uint8_t v) {
+  // 負荷超過時にボイスを短いリリースで消す（ぶつ切りによるクリックを避ける）
+  // リリース時間は clearFading() で戻す（進行中のリリースには影響しない）。
+  unmapNote(v);
+  envelopeInstance[v].setReleaseTime(SHED_RELEASE_MS);
+  envelopeInstance[v].noteOff();
+  voices[v].state = VoiceState::Release;
+  voices[v].fading = true;
+  fadingVoiceCount++;
+}
+
+void freeVoice(uint8_t v) {
+  unmapNote(v);
+  clearFading(v);
+  voices[v].state = VoiceState::Idle;
+  voices[v].level = 0;
+  removeSounding(v);
+}
+}  // namespace
+
+uint8_t voiceNoteOn(uint8_t note, uint8_t velocity) {
+  // ノートオンのボイス割り当て
+  // 引数:
+  //   note: MIDI ノート番号
+  //   velocity: ベロシティ（変調ステージが次に見たときに音量/カットオフの係数へ換算する）
+  // 説明: 同じノートが既に割り当て済みならそのボイスを再トリガーします。新しく割り当てる場合、
+  //   奪ったボイスの旧ノートの対応は外します。エンベロープはリセットせずに noteOn するので、
+  //   奪われたボイスも現在のレベルからアタックし直します（クリック防止）。
+  // 戻り値: ボイス番号
+  // 副作用: voices, soundingVoices, noteToVoice, voiceTargetFreq, envelopeInstance を更新する。
+  note &= 0x7F;
+  uint8_t v;
+  if (noteToVoice[note] != 0) {
+    v = noteToVoice[note] - 1;
+  } else {
+    v = allocateVoice();
+    if (voices[v].state != VoiceState::Idle) {
+      unmapNote(v);
+    }
+  }
+  if (voices[v].state == VoiceState::Idle) {
+    addSounding(v);
+  }
+  clearFading(v);
+
+  Voice &voice = voices[v];
+  voice.state = VoiceState::Attack;
+  voice.note = note;
+  voice.velocity = velocity;
+  voice.trigger++;
+  voice.order = ++noteOnCounter;
+  voice.attackTicks = static_cast<uint16_t>(params.envAttack * MOZZI_CONTROL_RATE / 1000.0f) + 1;
+  noteToVoice[note] = v + 1;
+
+  voiceTargetFreq[v] = midiToFreq(static_cast<float>(note) + params.pitchOffset);
+  envelopeInstance[v].noteOn();
+  return v;
+}
+
+void voiceNoteOff(uint8_t note) {
+  note &= 0x7F;
+  if (noteToVoice[note] == 0) {
+    return;
+  }
+  uint8_t v = noteToVoice[note] - 1;
+  noteToVoice[note] = 0;
+  envelopeInstance[v].noteOff();
+  voices[v].state = VoiceState::Release;
+}
+
+void voiceReleaseAll() {
+  for (uint8_t i = 0; i < soundingVoiceCount; ++i) {
+    uint8_t v = soundingVoices[i];
+    if (voices[v].state != VoiceState::Release) {
+      unmapNote(v);
+      envelopeInstance[v].noteOff();
+      voices[v].state = VoiceState::Release;
+    }
+  }
+}
+
+void updateVoices() {
+  // コントロールレートでのボイス状態遷移
+  // 引数: なし
+  // 説明: 発音中ボイスのエンベロープを 1 ステップ進め、アタック時間が過ぎたらサステインへ、
+  //   エンベロープが終了（playing() == false）したら待機へ戻してリストから外します。
+  // 戻り値: なし
+  // 副作用: envelopeInstance, voices, soundingVoices を更新する。
+  for (uint8_t i = soundingVoiceCount; i-- > 0;) {
+    uint8_t v = soundingVoices[i];
+    Voice &voice = voices[v];
+    envelopeInstance[v].update();
+    if (!envelopeInstance[v].playing()) {
+      freeVoice(v);
+      continue;
+    }
+    if (voice.state == VoiceState::Attack && --voice.attackTicks == 0) {
+      voice.state = VoiceState::Sustain;
+    }
+  }
+}
+
+int8_t voiceForNote(uint8_t note) {
+  return static_cast<int8_t>(noteToVoice[note & 0x7F]) - 1;
+}
+
+void updateVoiceBudget(uint32_t peakBlockCycles) {
+  // CPU 負荷に応じた同時発音数の調整
+  // 引数:
+  //   peakBlockCycles: 前回の呼び出し以降で最も重かったオーディオブロックの生成サイクル数
+  // 説明:
+  //   ブロックのコストを「固定分 + 発音数 x 1 ボイスあたり」とみなします。発音していないときのコストで
+  //   固定分を、固定分を引いて発音中のボイス数で割ったもので 1 ボイスあたりのコストを推定（どちらも移動平均）し、
+  //   実測が SHED_CYCLES を超えるか、現在の上限数で鳴らすと超えると見込まれる場合は上限を 1 減らします。
+  //   上限を 1 増やしても GROW_CYCLES に収まる見込みが GROW_HOLD_TICKS 続いたら 1 増やします。
+  //   上限を超えて鳴っているボイスは fadeOutVoice() で短いリリースをかけて消します。
+  // 戻り値: なし
+  // 副作用: baseCostCycles, voiceCostCycles, voiceBudget, voices, envelopeInstance を更新する。
+  if (soundingVoiceCount > 0) {
+    const uint32_t voicesCycles = peakBlockCycles > baseCostCycles ? peakBlockCycles - baseCostCycles : 0;
+    int32_t perVoice = static_cast<int32_t>(voicesCycles / soundingVoiceCount);
+    voiceCostCycles = static_cast<uint32_t>(static_cast<int32_t>(voiceCostCycles) +
+                                            (perVoice - static_cast<int32_t>(voiceCostCycles)) / 8);
+  } else {
+    baseCostCycles = static_cast<uint32_t>(static_cast<int32_t>(baseCostCycles) +
+                                           (static_cast<int32_t>(peakBlockCycles) - static_cast<int32_t>(baseCostCycles)) / 8);
+  }
+
+  bool overloaded = peakBlockCycles > SHED_CYCLES || baseCostCycles + voiceBudget * voiceCostCycles > SHED_CYCLES;
+  if (overloaded && voiceBudget > 1) {
+    voiceBudget--;
+    growHoldTicks = 0;
+  } else if (voiceBudget < POLY_VOICES && baseCostCycles + (voiceBudget + 1u) * voiceCostCycles < GROW_CYCLES) {
+    if (++growHoldTicks >= GROW_HOLD_TICKS) {
+      voiceBudget++;
+      growHoldTicks = 0;
+    }
+  } else {
+    growHoldTicks = 0;
+  }
+
+  while (soundingVoiceCount - fadingVoiceCount > voiceBudget) {
+    int8_t victim = pickVictim(false);
+    if (victim < 0) {
+      break;
+    }
+    fadeOutVoice(static_cast<uint8_t>(victim));
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "synth_state.h"
+
+#include <Arduino.h>
+
+// voice_manager.h
+// ボイスアロケータ。ボイスごとの状態（待機/アタック/サステイン/リリース）を管理し、
+// エンベロープが実際に 0 へ到達するまでリリース中のボイスを鳴らし続けます。
+// 同時に割り当てるボイス数 (voiceBudget) は、オーディオブロックの生成サイクル数を測って
+// POLY_VOICES の範囲で増減させます。
+
+enum class VoiceState : uint8_t { Idle, Attack, Sustain, Release };
+
+struct Voice {
+  VoiceState state;
+  uint8_t note;
+  uint8_t level;         // 直近ブロック末尾のエンベロープ値（オーディオ側が更新、スティール判定用）
+  uint8_t velocity;      // ノートオンのベロシティ（変調ステージが音量/カットオフの係数にする）
+  uint8_t trigger;       // ノートオンのたびに増える（変調ステージがランプを初期化する目印）
+  uint16_t attackTicks;  // アタック終了までの残りコントロールティック
+  uint32_t order;        // ノートオン順の通し番号（小さいほど古い）
+  bool fading;           // 負荷超過で短いリリースをかけて消している途中
+};
+
+extern Voice voices[POLY_VOICES];
+
+// 発音中（Idle 以外）のボイス番号の詰めたリスト。オーディオループはこれだけを回す。
+extern uint8_t soundingVoices[POLY_VOICES];
+extern uint8_t soundingVoiceCount;
+
+// 現在割り当て可能なボイス数（1..POLY_VOICES）
+extern uint8_t voiceBudget;
+
+/**
+ * @brief ノートにボイスを割り当てて発音を開始する
+ *
+ * 同じノートが発音中ならそのボイスを再トリガーし、そうでなければ
+ * 待機中（voiceBudget 未満のとき）→ リリース中で最も小さい → 最も古い、の順に選んだボイスを使います。
+ * @param note MIDI ノート番号
+ * @param velocity ベロシティ（1..127）
+ * @return 割り当てたボイス番号
+ */
+uint8_t voiceNoteOn(uint8_t note, uint8_t velocity);
+
+/**
+ * @brief ノートに割り当てられたボイスをリリースへ移す（未割り当てなら何もしない）
+ */
+void voiceNoteOff(uint8_t note);
+
+/**
+ * @brief 発音中の全ボイスをリリースへ移す
+ */
+void voiceReleaseAll();
+
+/**
+ * @brief コントロールレートでのボイス更新
+ *
+ * 発音中ボイスのエンベロープを進め、状態を遷移させ、エンベロープが終わったボイスを解放します。
+ */
+void updateVoices();
+
+/**
+ * @brief ノートを発音しているボイス番号を返す（無ければ -1）
+ */
+int8_t voiceForNote(uint8_t note);
+
+/**
+ * @brief オーディオの生成負荷から割り当て可能なボイス数を調整する
+ *
+ * 負荷が上限を超えたら即座に 1 ボイス減らし、超過分のボイスを短いリリースで消します。
+ * 1 ボイス増やしても余裕がある状態がしばらく続いたら 1 ボイス増やします。
+ * @param peakBlockCycles 前回の呼び出し以降で最も重かったブロックの生成サイクル数
+ */
+void updateVoiceBudget(uint32_t peakBlockCycles);